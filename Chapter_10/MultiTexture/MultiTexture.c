@@ -52,39 +52,6 @@ typedef struct
 
 } UserData;
 
-///
-// Load texture from disk
-//
-GLuint LoadTexture ( void *ioContext, char *fileName )
-{
-   int width,
-       height;
-
-   char *buffer = esLoadTGA ( ioContext, fileName, &width, &height );
-   GLuint texId;
-
-   if ( buffer == NULL )
-   {
-      esLogMessage ( "Error loading (%s) image.\n", fileName );
-      return 0;
-   }
-
-   glGenTextures ( 1, &texId );
-   glBindTexture ( GL_TEXTURE_2D, texId );
-
-   glTexImage2D ( GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, buffer );
-   glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
-   glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-   glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
-   glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
-
-   free ( buffer );
-
-   return texId;
-}
-
-
-
 ///
 // Initialize the shader and program object
 //
@@ -119,6 +86,10 @@ int Init ( ESContext *esContext )
       "  outColor = baseColor * (lightColor + 0.25);       \n"
       "}                                                   \n";
 
+   // Start loading the textures while the shaders compile
+   userData->baseMapTexId = esLoadTextureAsync ( esContext, "basemap.tga", GL_RGB, GL_LINEAR, GL_CLAMP_TO_EDGE );
+   userData->lightMapTexId = esLoadTextureAsync ( esContext, "lightmap.tga", GL_RGB, GL_LINEAR, GL_CLAMP_TO_EDGE );
+
    // Load the shaders and get a linked program object
    userData->programObject = esLoadProgram ( vShaderStr, fShaderStr );
 
@@ -126,11 +97,8 @@ int Init ( ESContext *esContext )
    userData->baseMapLoc = glGetUniformLocation ( userData->programObject, "s_baseMap" );
    userData->lightMapLoc = glGetUniformLocation ( userData->programObject, "s_lightMap" );
 
-   // Load the textures
-   userData->baseMapTexId = LoadTexture ( esContext->platformData, "basemap.tga" );
-   userData->lightMapTexId = LoadTexture ( esContext->platformData, "lightmap.tga" );
-
-   if ( userData->baseMapTexId == 0 || userData->lightMapTexId == 0 )
+   // Wait for the textures
+   if ( userData->baseMapTexId == 0 || userData->lightMapTexId == 0 || !esTextureLoaderFinish () )
    {
       return FALSE;
    }
@@ -199,12 +167,14 @@ void ShutDown ( ESContext *esContext )
 {
    UserData *userData = esContext->userData;
 
+   esTextureLoaderShutdown ();
+
    // Delete texture object
    glDeleteTextures ( 1, &userData->baseMapTexId );
    glDeleteTextures ( 1, &userData->lightMapTexId );
 
    // Delete program object
-   glDeleteProgram ( userData->programObject );
+   esDeleteProgram ( userData->programObject );
 }
 
 int esMain ( ESContext *esContext )
@@ -243,14 +243,18 @@ void Draw ( ESContext *esContext )
    glBindFramebuffer ( GL_FRAMEBUFFER, userData->fbo );
    glClear ( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
    glDrawBuffers ( 4, attachments );
+   esProfilerBegin ( "DrawGeometry" );
    DrawGeometry ( esContext );
+   esProfilerEnd ();
 
    // SECOND: copy the four output buffers into four window quadrants
    // with framebuffer blits
 
    // Restore the default framebuffer
    glBindFramebuffer ( GL_DRAW_FRAMEBUFFER, defaultFramebuffer );
+   esProfilerBegin ( "BlitTextures" );
    BlitTextures ( esContext );
+   esProfilerEnd ();
 }
 
 ///
@@ -267,7 +271,9 @@ void ShutDown ( ESContext *esContext )
    glDeleteFramebuffers ( 1, &userData->fbo );
 
    // Delete program object
-   glDeleteProgram ( userData->programObject );
+   esDeleteProgram ( userData->programObject );
+
+   esProfilerShutdown ();
 }
 
 int esMain ( ESContext *esContext )
@@ -32,37 +32,30 @@
 // ParticleSystem.c
 //
 //    This is an example that demonstrates rendering a particle system
-//    using a vertex shader and point sprites.
+//    using point sprites.  The particles are simulated on the CPU by the
+//    esParticleSystem engine in Common, which lets them fall and bounce
+//    off the floor.  The smoke is alpha blended, so the engine sorts the
+//    particles back to front before drawing them.
 //
 #include <stdlib.h>
-#include <math.h>
+#include <string.h>
 #include "esUtil.h"
 
 #define NUM_PARTICLES   1000
-#define PARTICLE_SIZE   7
-
-#define ATTRIBUTE_LIFETIME_LOCATION       0
-#define ATTRIBUTE_STARTPOSITION_LOCATION  1
-#define ATTRIBUTE_ENDPOSITION_LOCATION    2
 
 typedef struct
 {
-   // Handle to a program object
-   GLuint programObject;
-
-   // Uniform location
-   GLint timeLoc;
-   GLint colorLoc;
-   GLint centerPositionLoc;
-   GLint samplerLoc;
+   // Particle system simulated on the CPU and the emitter of the explosions
+   ESParticleSystem *particles;
+   ESParticleEmitter emitter;
 
    // Texture handle
    GLuint textureId;
 
-   // Particle vertex data
-   float particleData[ NUM_PARTICLES * PARTICLE_SIZE ];
+   // Random numbers for the explosion locations and colors
+   ESRandom rng;
 
-   // Current time
+   // Time since the last explosion
    float time;
 
 } UserData;
@@ -74,7 +67,7 @@ GLuint LoadTexture ( void *ioContext, char *fileName )
 {
    int width,
        height;
-   char *buffer = esLoadTGA ( ioContext, fileName, &width, &height );
+   const char *buffer = esMapTGA ( ioContext, fileName, &width, &height );
    GLuint texId;
 
    if ( buffer == NULL )
@@ -92,93 +85,59 @@ GLuint LoadTexture ( void *ioContext, char *fileName )
    glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
    glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
 
-   free ( buffer );
+   // The smoke density in the red channel doubles as its alpha
+   glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, GL_RED );
+
+   esReleaseTGA ( buffer );
 
    return texId;
 }
 
 
 ///
-// Initialize the shader and program object
+// Initialize the particle system
 //
 int Init ( ESContext *esContext )
 {
    UserData *userData = esContext->userData;
-   int i;
-
-   char vShaderStr[] =
-      "#version 300 es                                      \n"
-      "uniform float u_time;                                \n"
-      "uniform vec3 u_centerPosition;                       \n"
-      "layout(location = 0) in float a_lifetime;            \n"
-      "layout(location = 1) in vec3 a_startPosition;        \n"
-      "layout(location = 2) in vec3 a_endPosition;          \n"
-      "out float v_lifetime;                                \n"
-      "void main()                                          \n"
-      "{                                                    \n"
-      "  if ( u_time <= a_lifetime )                        \n"
-      "  {                                                  \n"
-      "    gl_Position.xyz = a_startPosition +              \n"
-      "                      (u_time * a_endPosition);      \n"
-      "    gl_Position.xyz += u_centerPosition;             \n"
-      "    gl_Position.w = 1.0;                             \n"
-      "  }                                                  \n"
-      "  else                                               \n"
-      "  {                                                  \n"
-      "     gl_Position = vec4( -1000, -1000, 0, 0 );       \n"
-      "  }                                                  \n"
-      "  v_lifetime = 1.0 - ( u_time / a_lifetime );        \n"
-      "  v_lifetime = clamp ( v_lifetime, 0.0, 1.0 );       \n"
-      "  gl_PointSize = ( v_lifetime * v_lifetime ) * 40.0; \n"
-      "}";
-
-   char fShaderStr[] =
-      "#version 300 es                                      \n"
-      "precision mediump float;                             \n"
-      "uniform vec4 u_color;                                \n"
-      "in float v_lifetime;                                 \n"
-      "layout(location = 0) out vec4 fragColor;             \n"
-      "uniform sampler2D s_texture;                         \n"
-      "void main()                                          \n"
-      "{                                                    \n"
-      "  vec4 texColor;                                     \n"
-      "  texColor = texture( s_texture, gl_PointCoord );    \n"
-      "  fragColor = vec4( u_color ) * texColor;            \n"
-      "  fragColor.a *= v_lifetime;                         \n"
-      "}                                                    \n";
-
-   // Load the shaders and get a linked program object
-   userData->programObject = esLoadProgram ( vShaderStr, fShaderStr );
-
-   // Get the uniform locations
-   userData->timeLoc = glGetUniformLocation ( userData->programObject, "u_time" );
-   userData->centerPositionLoc = glGetUniformLocation ( userData->programObject, "u_centerPosition" );
-   userData->colorLoc = glGetUniformLocation ( userData->programObject, "u_color" );
-   userData->samplerLoc = glGetUniformLocation ( userData->programObject, "s_texture" );
-
-   glClearColor ( 0.0f, 0.0f, 0.0f, 0.0f );
-
-   // Fill in particle data array
-   srand ( 0 );
-
-   for ( i = 0; i < NUM_PARTICLES; i++ )
+   ESParticleEmitter *emitter = &userData->emitter;
+   ESParticleDrawOptions options;
+
+   // Explosions are bursts of particles, two can overlap for a moment
+   userData->particles = esParticleSystemCreate ( 2 * NUM_PARTICLES, ES_PARTICLES_CPU );
+
+   memset ( emitter, 0, sizeof ( ESParticleEmitter ) );
+   emitter->lifetime = 1.0f;
+   emitter->capacity = 2 * NUM_PARTICLES;
+   emitter->positionSpread[0] = emitter->positionSpread[1] = emitter->positionSpread[2] = 0.125f;
+   emitter->velocitySpread[0] = emitter->velocitySpread[1] = emitter->velocitySpread[2] = 1.0f;
+   emitter->acceleration[1] = -1.5f;
+   emitter->minSize = 20.0f;
+   emitter->maxSize = 40.0f;
+
+   // The particles bounce off the floor
+   emitter->collisionPlane[1] = 1.0f;
+   emitter->collisionPlane[3] = 0.9f;
+   emitter->restitution = 0.6f;
+
+   if ( userData->particles == NULL ||
+         esParticleSystemAddEmitter ( userData->particles, emitter ) < 0 )
    {
-      float *particleData = &userData->particleData[i * PARTICLE_SIZE];
+      return FALSE;
+   }
 
-      // Lifetime of particle
-      ( *particleData++ ) = ( ( float ) ( rand() % 10000 ) / 10000.0f );
+   memset ( &options, 0, sizeof ( ESParticleDrawOptions ) );
+   options.blend = ES_PARTICLES_BLEND_ALPHA;
+   options.downsample = 1;
 
-      // End position of particle
-      ( *particleData++ ) = ( ( float ) ( rand() % 10000 ) / 5000.0f ) - 1.0f;
-      ( *particleData++ ) = ( ( float ) ( rand() % 10000 ) / 5000.0f ) - 1.0f;
-      ( *particleData++ ) = ( ( float ) ( rand() % 10000 ) / 5000.0f ) - 1.0f;
+   if ( !esParticleSystemSetDrawOptions ( userData->particles, &options ) )
+   {
+      return FALSE;
+   }
 
-      // Start position of particle
-      ( *particleData++ ) = ( ( float ) ( rand() % 10000 ) / 40000.0f ) - 0.125f;
-      ( *particleData++ ) = ( ( float ) ( rand() % 10000 ) / 40000.0f ) - 0.125f;
-      ( *particleData++ ) = ( ( float ) ( rand() % 10000 ) / 40000.0f ) - 0.125f;
+   glClearColor ( 0.0f, 0.0f, 0.0f, 0.0f );
 
-   }
+   esRandomSeed ( &userData->rng, 0, 0 );
 
    // Initialize time to cause reset on first update
    userData->time = 1.0f;
@@ -199,44 +158,35 @@ int Init ( ESContext *esContext )
 void Update ( ESContext *esContext, float deltaTime )
 {
    UserData *userData = esContext->userData;
+   ESParticleEmitter *emitter = &userData->emitter;
 
    userData->time += deltaTime;
 
-   glUseProgram ( userData->programObject );
-
    if ( userData->time >= 1.0f )
    {
-      float centerPos[3];
-      float color[4];
-
       userData->time = 0.0f;
 
       // Pick a new start location and color
-      centerPos[0] = ( ( float ) ( rand() % 10000 ) / 10000.0f ) - 0.5f;
-      centerPos[1] = ( ( float ) ( rand() % 10000 ) / 10000.0f ) - 0.5f;
-      centerPos[2] = ( ( float ) ( rand() % 10000 ) / 10000.0f ) - 0.5f;
-
-      glUniform3fv ( userData->centerPositionLoc, 1, &centerPos[0] );
+      esRandomFloats ( &userData->rng, emitter->position, 3, -0.5f, 0.5f );
 
       // Random color
-      color[0] = ( ( float ) ( rand() % 10000 ) / 20000.0f ) + 0.5f;
-      color[1] = ( ( float ) ( rand() % 10000 ) / 20000.0f ) + 0.5f;
-      color[2] = ( ( float ) ( rand() % 10000 ) / 20000.0f ) + 0.5f;
-      color[3] = 0.5;
+      esRandomFloats ( &userData->rng, emitter->color, 3, 0.5f, 1.0f );
+      emitter->color[3] = 0.5;
 
-      glUniform4fv ( userData->colorLoc, 1, &color[0] );
+      esParticleSystemSetEmitter ( userData->particles, 0, emitter );
+      esParticleSystemBurst ( userData->particles, 0, NUM_PARTICLES );
    }
 
-   // Load uniform time variable
-   glUniform1f ( userData->timeLoc, userData->time );
+   esParticleSystemUpdate ( userData->particles, deltaTime );
 }
 
 ///
-// Draw a triangle using the shader pair created in Init()
+// Draw the particles streamed by the last update
 //
 void Draw ( ESContext *esContext )
 {
    UserData *userData = esContext->userData;
+   ESMatrix identity;
 
    // Set the viewport
    glViewport ( 0, 0, esContext->width, esContext->height );
@@ -244,39 +194,9 @@ void Draw ( ESContext *esContext )
    // Clear the color buffer
    glClear ( GL_COLOR_BUFFER_BIT );
 
-   // Use the program object
-   glUseProgram ( userData->programObject );
-
-   // Load the vertex attributes
-   glVertexAttribPointer ( ATTRIBUTE_LIFETIME_LOCATION, 1, GL_FLOAT,
-                           GL_FALSE, PARTICLE_SIZE * sizeof ( GLfloat ),
-                           userData->particleData );
-
-   glVertexAttribPointer ( ATTRIBUTE_ENDPOSITION_LOCATION, 3, GL_FLOAT,
-                           GL_FALSE, PARTICLE_SIZE * sizeof ( GLfloat ),
-                           &userData->particleData[1] );
-
-   glVertexAttribPointer ( ATTRIBUTE_STARTPOSITION_LOCATION, 3, GL_FLOAT,
-                           GL_FALSE, PARTICLE_SIZE * sizeof ( GLfloat ),
-                           &userData->particleData[4] );
+   esMatrixLoadIdentity ( &identity );
 
-
-   glEnableVertexAttribArray ( ATTRIBUTE_LIFETIME_LOCATION );
-   glEnableVertexAttribArray ( ATTRIBUTE_ENDPOSITION_LOCATION );
-   glEnableVertexAttribArray ( ATTRIBUTE_STARTPOSITION_LOCATION );
-
-   // Blend particles
-   glEnable ( GL_BLEND );
-   glBlendFunc ( GL_SRC_ALPHA, GL_ONE );
-
-   // Bind the texture
-   glActiveTexture ( GL_TEXTURE0 );
-   glBindTexture ( GL_TEXTURE_2D, userData->textureId );
-
-   // Set the sampler texture unit to 0
-   glUniform1i ( userData->samplerLoc, 0 );
-
-   glDrawArrays ( GL_POINTS, 0, NUM_PARTICLES );
+   esParticleSystemDraw ( userData->particles, &identity, userData->textureId );
 }
 
 ///
@@ -289,14 +209,15 @@ void ShutDown ( ESContext *esContext )
    // Delete texture object
    glDeleteTextures ( 1, &userData->textureId );
 
-   // Delete program object
-   glDeleteProgram ( userData->programObject );
+   esParticleSystemDestroy ( userData->particles );
+
+   esProfilerShutdown ();
 }
 
 
 int esMain ( ESContext *esContext )
 {
-   esContext->userData = malloc ( sizeof ( UserData ) );
+   esContext->userData = calloc ( 1, sizeof ( UserData ) );
 
    esCreateWindow ( esContext, "ParticleSystem", 640, 480, ES_WINDOW_RGB );
 
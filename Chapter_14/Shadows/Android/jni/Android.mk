@@ -10,9 +10,13 @@ LOCAL_MODULE    := Shadows
 LOCAL_CFLAGS    += -DANDROID
 
 
-LOCAL_SRC_FILES := $(COMMON_SRC_PATH)/esShader.c \
+LOCAL_SRC_FILES := $(COMMON_SRC_PATH)/esCulling.c \
+				   $(COMMON_SRC_PATH)/esJobs.c \
+				   $(COMMON_SRC_PATH)/esProfiler.c \
+				   $(COMMON_SRC_PATH)/esShader.c \
 				   $(COMMON_SRC_PATH)/esShapes.c \
 				   $(COMMON_SRC_PATH)/esTransform.c \
+				   $(COMMON_SRC_PATH)/esUniformRing.c \
 				   $(COMMON_SRC_PATH)/esUtil.c \
 				   $(COMMON_SRC_PATH)/Android/esUtil_Android.c \
 				   $(SRC_PATH)/Shadows.c
@@ -38,25 +38,46 @@
 #include "esUtil.h"
 
 #include <stdio.h>
+#include <string.h>
 
 #define POSITION_LOC    0
 #define COLOR_LOC       1
 
+// Uniform buffer binding point of the Transforms block
+#define TRANSFORMS_BINDING    0
+
+// Render passes, each culls the models against its own frustum
+#define SHADOW_PASS     0
+#define SCENE_PASS      1
+
+// Per-object matrices, laid out like the std140 Transforms block
+typedef struct
+{
+   ESMatrix mvpMatrix;
+   ESMatrix mvpLightMatrix;
+} Transforms;
+
 typedef struct
 {
    // Handle to a program object
    GLuint sceneProgramObject;
    GLuint shadowMapProgramObject;
 
-   // Uniform locations
-   GLint  sceneMvpLoc;
-   GLint  shadowMapMvpLoc;
-   GLint  sceneMvpLightLoc;
-   GLint  shadowMapMvpLightLoc;
+   // Offsets of this frame's Transforms blocks in the uniform ring
+   GLintptr groundTransformsOffset;
+   GLintptr cubeTransformsOffset;
+
+   // Whether each model is inside the frustum of each pass this frame
+   GLboolean groundVisible[2];
+   GLboolean cubeVisible[2];
 
    // Sampler location
    GLint shadowMapSamplerLoc;
 
+   // Resolve pass uniform locations
+   GLint screenTextureLoc;
+   GLint screenSamplesLoc;
+
    // shadow map Texture handle
    GLuint shadowMapTextureId;
    GLuint shadowMapBufferId;
@@ -455,11 +476,16 @@ int Init ( ESContext *esContext )
 {
    GLfloat *positions;
    GLuint *indices;
+   ESProgram programs[3];
 
    UserData *userData =(UserData *) esContext->userData;
    const char vShadowMapShaderStr[] =  
       "#version 300 es                                  \n"
-      "uniform mat4 u_mvpLightMatrix;                   \n"
+      "layout(std140) uniform Transforms                \n"
+      "{                                                \n"
+      "   mat4 u_mvpMatrix;                             \n"
+      "   mat4 u_mvpLightMatrix;                        \n"
+      "};                                               \n"
       "layout(location = 0) in vec4 a_position;         \n"
       "out vec4 v_color;                                \n"
       "void main()                                      \n"
@@ -476,8 +502,11 @@ int Init ( ESContext *esContext )
 
     const char vSceneShaderStr[] =  
       "#version 300 es                                   \n"
-      "uniform mat4 u_mvpMatrix;                         \n"
-      "uniform mat4 u_mvpLightMatrix;                    \n"
+      "layout(std140) uniform Transforms                 \n"
+      "{                                                 \n"
+      "   mat4 u_mvpMatrix;                              \n"
+      "   mat4 u_mvpLightMatrix;                         \n"
+      "};                                                \n"
       "layout(location = 0) in vec4 a_position;          \n"
       "layout(location = 1) in vec4 a_color;             \n"
       "out vec4 v_color;                                 \n"
@@ -562,24 +591,20 @@ const char fScreenShaderStr[] =
    userData->msaa_level_ = 4;
    printf("mass level:%d\n", userData->msaa_level_);
 
-   // Load the shaders and get a linked program object
-   userData->shadowMapProgramObject = esLoadProgram ( vShadowMapShaderStr, fShadowMapShaderStr );
-   userData->sceneProgramObject = esLoadProgram ( vSceneShaderStr, fSceneShaderStr );
-
-   userData->screen_shader_ID_ = esLoadProgram (vScreenShaderStr, fScreenShaderStr);
-
-   // Get the uniform locations
-   userData->sceneMvpLoc = glGetUniformLocation ( userData->sceneProgramObject, "u_mvpMatrix" );
-   userData->shadowMapMvpLoc = glGetUniformLocation ( userData->shadowMapProgramObject, "u_mvpMatrix" );
-   userData->sceneMvpLightLoc = glGetUniformLocation ( userData->sceneProgramObject, "u_mvpLightMatrix" );
-   userData->shadowMapMvpLightLoc = glGetUniformLocation ( userData->shadowMapProgramObject, "u_mvpLightMatrix" );
-
-   // Get the sampler location
-   userData->shadowMapSamplerLoc = glGetUniformLocation ( userData->sceneProgramObject, "s_shadowMap" );
+   // Start building all three programs, the driver compiles them while the
+   // geometry is set up
+   memset ( programs, 0, sizeof ( programs ) );
+   programs[0].vertShaderSrc = vShadowMapShaderStr;
+   programs[0].fragShaderSrc = fShadowMapShaderStr;
+   programs[1].vertShaderSrc = vSceneShaderStr;
+   programs[1].fragShaderSrc = fSceneShaderStr;
+   programs[2].vertShaderSrc = vScreenShaderStr;
+   programs[2].fragShaderSrc = fScreenShaderStr;
+   esLoadProgramsAsync ( programs, 3 );
 
    // Generate the vertex and index data for the ground
    userData->groundGridSize = 3;
-   userData->groundNumIndices = esGenSquareGrid( userData->groundGridSize, &positions, &indices );
+   userData->groundNumIndices = esGenSquareGridStrip( userData->groundGridSize, &positions, &indices );
 
    // Index buffer object for the ground model
    glGenBuffers ( 1, &userData->groundIndicesIBO );
@@ -657,6 +682,36 @@ const char fScreenShaderStr[] =
       return FALSE;
    }
 
+   // Wait for the programs
+   if ( !esFinishPrograms ( programs, 3 ) )
+   {
+      return FALSE;
+   }
+
+   userData->shadowMapProgramObject = programs[0].programObject;
+   userData->sceneProgramObject = programs[1].programObject;
+   userData->screen_shader_ID_ = programs[2].programObject;
+
+   // Both passes read the matrices from the Transforms block
+   glUniformBlockBinding ( userData->sceneProgramObject,
+                           esGetUniformBlockIndex ( userData->sceneProgramObject, "Transforms" ),
+                           TRANSFORMS_BINDING );
+   glUniformBlockBinding ( userData->shadowMapProgramObject,
+                           esGetUniformBlockIndex ( userData->shadowMapProgramObject, "Transforms" ),
+                           TRANSFORMS_BINDING );
+
+   if ( !esUniformRingInit ( 64 * 1024 ) )
+   {
+      return FALSE;
+   }
+
+   // Get the uniform locations
+   userData->screenTextureLoc = esGetUniformLocation ( userData->screen_shader_ID_, "screenTexture" );
+   userData->screenSamplesLoc = esGetUniformLocation ( userData->screen_shader_ID_, "samples" );
+
+   // Get the sampler location
+   userData->shadowMapSamplerLoc = esGetUniformLocation ( userData->sceneProgramObject, "s_shadowMap" );
+
    glClearColor ( 1.0f, 1.0f, 1.0f, 0.0f );
 
    // disable culling
@@ -664,56 +719,113 @@ const char fScreenShaderStr[] =
 
    // enable depth test
    glEnable ( GL_DEPTH_TEST );
+
+   // the ground is drawn as strips joined by primitive restart
+   glEnable ( GL_PRIMITIVE_RESTART_FIXED_INDEX );
 printf("init successful contex\n");
    return TRUE;
 }
 
 ///
-// Draw the model
+// Stage the matrices of every object and upload them in one go
 //
-void DrawScene ( ESContext *esContext, 
-                 GLint mvpLoc, 
-                 GLint mvpLightLoc )
+int UploadTransforms ( ESContext *esContext )
+{
+   UserData *userData =(UserData *) esContext->userData;
+   Transforms *ground = esUniformRingAlloc ( sizeof ( Transforms ), &userData->groundTransformsOffset );
+   Transforms *cube = esUniformRingAlloc ( sizeof ( Transforms ), &userData->cubeTransformsOffset );
+
+   if ( ground == NULL || cube == NULL )
+   {
+      return FALSE;
+   }
+
+   ground->mvpMatrix = userData->groundMvpMatrix;
+   ground->mvpLightMatrix = userData->groundMvpLightMatrix;
+   cube->mvpMatrix = userData->cubeMvpMatrix;
+   cube->mvpLightMatrix = userData->cubeMvpLightMatrix;
+
+   esUniformRingUpload ();
+   return TRUE;
+}
+
+///
+// Test a model's local bounds against the frustum of its MVP matrix
+//
+GLboolean ModelVisible ( const ESMatrix *mvp, const GLfloat boxMin[3], const GLfloat boxMax[3] )
+{
+   GLfloat planes[6][4];
+
+   esFrustumPlanesFromMatrix ( planes, mvp );
+   return esBoxInFrustum ( planes, boxMin, boxMax );
+}
+
+///
+// Find the models visible from the light and from the eye
+//
+void CullScene ( ESContext *esContext )
+{
+   // The grid spans [0,1] in x and y and the cube is centered on the origin
+   static const GLfloat groundMin[3] = { 0.0f, 0.0f, 0.0f };
+   static const GLfloat groundMax[3] = { 1.0f, 1.0f, 0.0f };
+   static const GLfloat cubeMin[3] = { -0.5f, -0.5f, -0.5f };
+   static const GLfloat cubeMax[3] = { 0.5f, 0.5f, 0.5f };
+   UserData *userData =(UserData *) esContext->userData;
+
+   userData->groundVisible[SHADOW_PASS] = ModelVisible ( &userData->groundMvpLightMatrix, groundMin, groundMax );
+   userData->groundVisible[SCENE_PASS] = ModelVisible ( &userData->groundMvpMatrix, groundMin, groundMax );
+   userData->cubeVisible[SHADOW_PASS] = ModelVisible ( &userData->cubeMvpLightMatrix, cubeMin, cubeMax );
+   userData->cubeVisible[SCENE_PASS] = ModelVisible ( &userData->cubeMvpMatrix, cubeMin, cubeMax );
+}
+
+///
+// Draw the models visible in a pass
+//
+void DrawScene ( ESContext *esContext, int pass )
 {
    UserData *userData =(UserData *) esContext->userData;
  
    // Draw the ground
-   // Load the vertex position
-   glBindBuffer ( GL_ARRAY_BUFFER, userData->groundPositionVBO );
-   glVertexAttribPointer ( POSITION_LOC, 3, GL_FLOAT, 
-                           GL_FALSE, 3 * sizeof(GLfloat), (const void*)NULL );
-   glEnableVertexAttribArray ( POSITION_LOC );   
+   if ( userData->groundVisible[pass] )
+   {
+      // Load the vertex position
+      glBindBuffer ( GL_ARRAY_BUFFER, userData->groundPositionVBO );
+      glVertexAttribPointer ( POSITION_LOC, 3, GL_FLOAT, 
+                              GL_FALSE, 3 * sizeof(GLfloat), (const void*)NULL );
+      glEnableVertexAttribArray ( POSITION_LOC );   
 
-   // Bind the index buffer
-   glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, userData->groundIndicesIBO );
+      // Bind the index buffer
+      glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, userData->groundIndicesIBO );
 
-   // Load the MVP matrix for the ground model
-   glUniformMatrix4fv ( mvpLoc, 1, GL_FALSE, (GLfloat*) &userData->groundMvpMatrix.m[0][0] );
-   glUniformMatrix4fv ( mvpLightLoc, 1, GL_FALSE, (GLfloat*) &userData->groundMvpLightMatrix.m[0][0] );
+      // Bind the MVP matrices for the ground model
+      esUniformRingBind ( TRANSFORMS_BINDING, userData->groundTransformsOffset, sizeof ( Transforms ) );
 
-   // Set the ground color to light gray
-   glVertexAttrib4f ( COLOR_LOC, 0.9f, 0.9f, 0.9f, 1.0f );
+      // Set the ground color to light gray
+      glVertexAttrib4f ( COLOR_LOC, 0.9f, 0.9f, 0.9f, 1.0f );
 
-   glDrawElements ( GL_TRIANGLES, userData->groundNumIndices, GL_UNSIGNED_INT, (const void*)NULL );
+      glDrawElements ( GL_TRIANGLE_STRIP, userData->groundNumIndices, GL_UNSIGNED_INT, (const void*)NULL );
+   }
 
    // Draw the cube
-   // Load the vertex position
-   glBindBuffer( GL_ARRAY_BUFFER, userData->cubePositionVBO );
-   glVertexAttribPointer ( POSITION_LOC, 3, GL_FLOAT, 
-                           GL_FALSE, 3 * sizeof(GLfloat), (const void*)NULL );
-   glEnableVertexAttribArray ( POSITION_LOC );   
+   if ( userData->cubeVisible[pass] )
+   {
+      // Load the vertex position
+      glBindBuffer( GL_ARRAY_BUFFER, userData->cubePositionVBO );
+      glVertexAttribPointer ( POSITION_LOC, 3, GL_FLOAT, 
+                              GL_FALSE, 3 * sizeof(GLfloat), (const void*)NULL );
+      glEnableVertexAttribArray ( POSITION_LOC );   
 
-   // Bind the index buffer
-   glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, userData->cubeIndicesIBO );
+      // Bind the index buffer
+      glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, userData->cubeIndicesIBO );
 
-   // Load the MVP matrix for the cube model
-   glUniformMatrix4fv ( mvpLoc, 1, GL_FALSE, (GLfloat*) &userData->cubeMvpMatrix.m[0][0] );
-   glUniformMatrix4fv ( mvpLightLoc, 1, GL_FALSE, (GLfloat*) &userData->cubeMvpLightMatrix.m[0][0] );
+      // Bind the MVP matrices for the cube model
+      esUniformRingBind ( TRANSFORMS_BINDING, userData->cubeTransformsOffset, sizeof ( Transforms ) );
 
-   // Set the cube color to red
-   glVertexAttrib4f ( COLOR_LOC, 1.0f, 0.0f, 0.0f, 1.0f );
+      // Set the cube color to red
+      glVertexAttrib4f ( COLOR_LOC, 1.0f, 0.0f, 0.0f, 1.0f );
 
-   glDrawElements ( GL_TRIANGLES, userData->cubeNumIndices, GL_UNSIGNED_INT, (const void*)NULL );
+      glDrawElements ( GL_TRIANGLES, userData->cubeNumIndices, GL_UNSIGNED_INT, (const void*)NULL );
+   }
 }
 
 void Draw ( ESContext *esContext )
@@ -733,6 +845,15 @@ void Draw ( ESContext *esContext )
    // Initialize matrices
    InitMVP ( esContext );
 
+   if ( !UploadTransforms ( esContext ) )
+   {
+      // Release the blocks staged so far, or the ring stays full
+      esUniformRingEndFrame ();
+      return;
+   }
+
+   CullScene ( esContext );
+
    glGetIntegerv ( GL_FRAMEBUFFER_BINDING, &defaultFramebuffer );
 
    // FIRST PASS: Render the scene from light position to generate the shadow map texture
@@ -758,7 +879,9 @@ void Draw ( ESContext *esContext )
    glPolygonOffset( 5.0f, 100.0f );
 
    glUseProgram ( userData->shadowMapProgramObject );
-   DrawScene ( esContext, userData->shadowMapMvpLoc, userData->shadowMapMvpLightLoc );
+   esProfilerBegin ( "ShadowMapPass" );
+   DrawScene ( esContext, SHADOW_PASS );
+   esProfilerEnd ();
 
    glDisable( GL_POLYGON_OFFSET_FILL );
 
@@ -775,6 +898,8 @@ void Draw ( ESContext *esContext )
    // Set the viewport
    glViewport ( 0, 0, esContext->width, esContext->height );
    
+   esProfilerBegin ( "ScenePass" );
+
    // Clear the color and depth buffers
    glClear ( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
    glClearColor ( 1.0f, 1.0f, 1.0f, 0.0f );
@@ -789,7 +914,8 @@ void Draw ( ESContext *esContext )
    // Set the sampler texture unit to 0
    glUniform1i ( userData->shadowMapSamplerLoc, 0 );
 
-   DrawScene ( esContext, userData->sceneMvpLoc, userData->sceneMvpLightLoc );
+   DrawScene ( esContext, SCENE_PASS );
+   esProfilerEnd ();
    InnerCheckGLError(__FILE__, __LINE__);
 
 
@@ -811,12 +937,13 @@ void Draw ( ESContext *esContext )
    InnerCheckGLError(__FILE__, __LINE__);
 
    glViewport(0, 0, w, h);
+   esProfilerBegin ( "ResolvePass" );
    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     glUseProgram(userData->screen_shader_ID_);
-    glUniform1i(glGetUniformLocation(userData->screen_shader_ID_, "screenTexture"), 0);
+    glUniform1i(userData->screenTextureLoc, 0);
 
-      glUniform1i(glGetUniformLocation(userData->screen_shader_ID_, "samples"), userData->msaa_level_);
+      glUniform1i(userData->screenSamplesLoc, userData->msaa_level_);
 
     InnerCheckGLError(__FILE__, __LINE__);
     glBindVertexArray(userData->screen_quadVAO_);
@@ -828,8 +955,11 @@ void Draw ( ESContext *esContext )
     InnerCheckGLError(__FILE__, __LINE__);
     glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
     glBindVertexArray(0);
+    esProfilerEnd ();
     InnerCheckGLError(__FILE__, __LINE__);
 #endif
+
+   esUniformRingEndFrame ();
 }
 
 ///
@@ -853,8 +983,12 @@ void Shutdown ( ESContext *esContext )
    glDeleteTextures ( 1, &userData->shadowMapTextureId );
 
    // Delete program object
-   glDeleteProgram ( userData->sceneProgramObject );
-   glDeleteProgram ( userData->shadowMapProgramObject );
+   esDeleteProgram ( userData->sceneProgramObject );
+   esDeleteProgram ( userData->shadowMapProgramObject );
+   esDeleteProgram ( userData->screen_shader_ID_ );
+
+   esUniformRingShutdown ();
+   esProfilerShutdown ();
 }
 
 int esMain ( ESContext *esContext )
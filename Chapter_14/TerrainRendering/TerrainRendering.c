@@ -61,6 +61,9 @@ typedef struct
    // Number of indices
    int    numIndices;
 
+   // Packed vertex layout and index type of the grid
+   ESPackedMesh grid;
+
    // dimension of grid
    int    gridSize;
 
@@ -76,7 +79,7 @@ GLuint LoadTexture (  void *ioContext, char *fileName )
    int width,
        height;
 
-   char *buffer = esLoadTGA ( ioContext, fileName, &width, &height );
+   const char *buffer = esMapTGA ( ioContext, fileName, &width, &height );
    GLuint texId;
 
    if ( buffer == NULL )
@@ -94,7 +97,7 @@ GLuint LoadTexture (  void *ioContext, char *fileName )
    glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
    glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
 
-   free ( buffer );
+   esReleaseTGA ( buffer );
 
    return texId;
 }
@@ -139,6 +142,7 @@ int Init ( ESContext *esContext )
 {
    GLfloat *positions;
    GLuint *indices;
+   GLboolean packed;
 
    UserData *userData = esContext->userData;
    const char vShaderStr[] =
@@ -204,27 +208,42 @@ int Init ( ESContext *esContext )
       return FALSE;
    }
 
-   // Generate the position and indices of a square grid for the base terrain
+   // Generate the position and indices of a square grid for the base terrain, as
+   // strips already laid out for the vertex cache
    userData->gridSize = 200;
-   userData->numIndices = esGenSquareGrid ( userData->gridSize, &positions, &indices );
+   userData->numIndices = esGenSquareGridStrip ( userData->gridSize, &positions, &indices );
+
+   // Pack to 16-bit positions and indices
+   packed = esPackMesh ( userData->gridSize * userData->gridSize, positions, NULL, NULL,
+                         indices, userData->numIndices, &userData->grid );
+   free ( indices );
+   free ( positions );
+
+   if ( !packed )
+   {
+      return FALSE;
+   }
 
    // Index buffer for base terrain
    glGenBuffers ( 1, &userData->indicesIBO );
    glBindBuffer ( GL_ELEMENT_ARRAY_BUFFER, userData->indicesIBO );
-   glBufferData ( GL_ELEMENT_ARRAY_BUFFER, userData->numIndices * sizeof ( GLuint ),
-                  indices, GL_STATIC_DRAW );
+   glBufferData ( GL_ELEMENT_ARRAY_BUFFER, userData->numIndices *
+                  ( userData->grid.indexType == GL_UNSIGNED_SHORT ? sizeof ( GLushort ) : sizeof ( GLuint ) ),
+                  userData->grid.indices, GL_STATIC_DRAW );
    glBindBuffer ( GL_ELEMENT_ARRAY_BUFFER, 0 );
-   free ( indices );
 
    // Position VBO for base terrain
    glGenBuffers ( 1, &userData->positionVBO );
    glBindBuffer ( GL_ARRAY_BUFFER, userData->positionVBO );
-   glBufferData ( GL_ARRAY_BUFFER,
-                  userData->gridSize * userData->gridSize * sizeof ( GLfloat ) * 3,
-                  positions, GL_STATIC_DRAW );
-   free ( positions );
+   glBufferData ( GL_ARRAY_BUFFER, userData->grid.numVertices * userData->grid.stride,
+                  userData->grid.vertices, GL_STATIC_DRAW );
+   esFreePackedMesh ( &userData->grid );
 
    glClearColor ( 1.0f, 1.0f, 1.0f, 0.0f );
+   glEnable ( GL_DEPTH_TEST );
+
+   // The grid strips are joined by the fixed restart index
+   glEnable ( GL_PRIMITIVE_RESTART_FIXED_INDEX );
 
    return TRUE;
 }
@@ -249,9 +268,7 @@ void Draw ( ESContext *esContext )
 
    // Load the vertex position
    glBindBuffer ( GL_ARRAY_BUFFER, userData->positionVBO );
-   glVertexAttribPointer ( POSITION_LOC, 3, GL_FLOAT,
-                           GL_FALSE, 3 * sizeof ( GLfloat ), ( const void * ) NULL );
-   glEnableVertexAttribArray ( POSITION_LOC );
+   esPackedMeshAttribPointers ( &userData->grid, NULL, POSITION_LOC, -1, -1 );
 
    // Bind the index buffer
    glBindBuffer ( GL_ELEMENT_ARRAY_BUFFER, userData->indicesIBO );
@@ -270,7 +287,7 @@ void Draw ( ESContext *esContext )
    glUniform1i ( userData->samplerLoc, 0 );
 
    // Draw the grid
-   glDrawElements ( GL_TRIANGLES, userData->numIndices, GL_UNSIGNED_INT, ( const void * ) NULL );
+   glDrawElements ( GL_TRIANGLE_STRIP, userData->numIndices, userData->grid.indexType, ( const void * ) NULL );
 }
 
 ///
@@ -284,7 +301,7 @@ void Shutdown ( ESContext *esContext )
    glDeleteBuffers ( 1, &userData->indicesIBO );
 
    // Delete program object
-   glDeleteProgram ( userData->programObject );
+   esDeleteProgram ( userData->programObject );
 }
 
 
@@ -124,7 +124,7 @@ void Shutdown ( ESContext *esContext )
 {
    UserData *userData = esContext->userData;
 
-   glDeleteProgram ( userData->programObject );
+   esDeleteProgram ( userData->programObject );
 }
 
 int esMain ( ESContext *esContext )
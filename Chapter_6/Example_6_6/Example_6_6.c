@@ -191,7 +191,7 @@ void Shutdown ( ESContext *esContext )
 {
    UserData *userData = esContext->userData;
 
-   glDeleteProgram ( userData->programObject );
+   esDeleteProgram ( userData->programObject );
    glDeleteBuffers ( 3, userData->vboIds );
 }
 
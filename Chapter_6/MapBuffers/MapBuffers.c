@@ -224,7 +224,7 @@ void Shutdown ( ESContext *esContext )
 {
    UserData *userData = esContext->userData;
 
-   glDeleteProgram ( userData->programObject );
+   esDeleteProgram ( userData->programObject );
    glDeleteBuffers ( 2, userData->vboIds );
 }
 
@@ -171,7 +171,7 @@ void Shutdown ( ESContext *esContext )
 {
    UserData *userData = esContext->userData;
 
-   glDeleteProgram ( userData->programObject );
+   esDeleteProgram ( userData->programObject );
    glDeleteBuffers ( 2, userData->vboIds );
    glDeleteVertexArrays ( 1, &userData->vaoId );
 }
@@ -35,16 +35,13 @@
 //    geometry instancing
 //
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include "esUtil.h"
 
-#ifdef _WIN32
-#define srandom srand
-#define random rand
-#endif
-
 
 #define NUM_INSTANCES   100
+#define CUBE_SIZE       0.1f
 #define POSITION_LOC    0
 #define COLOR_LOC       1
 #define MVP_LOC         2
@@ -63,9 +60,28 @@ typedef struct
    // Number of indices
    int       numIndices;
 
+   // Per-instance position on the grid
+   GLfloat   translateX[NUM_INSTANCES];
+   GLfloat   translateY[NUM_INSTANCES];
+
    // Rotation angle
    GLfloat   angle[NUM_INSTANCES];
 
+   // Instance color
+   GLubyte   colors[NUM_INSTANCES][4];
+
+   // Bounding sphere of each instance in eye space
+   GLfloat   bounds[NUM_INSTANCES][4];
+
+   // Instances inside the view frustum this frame
+   GLuint    visible[NUM_INSTANCES];
+   int       numVisible;
+
+   // Transforms of the visible instances
+   GLfloat   visibleTranslateX[NUM_INSTANCES];
+   GLfloat   visibleTranslateY[NUM_INSTANCES];
+   GLfloat   visibleAngle[NUM_INSTANCES];
+
 } UserData;
 
 ///
@@ -75,6 +91,7 @@ int Init ( ESContext *esContext )
 {
    GLfloat *positions;
    GLuint *indices;
+   ESRandom rng;
 
    UserData *userData = esContext->userData;
    const char vShaderStr[] =
@@ -103,7 +120,7 @@ int Init ( ESContext *esContext )
    userData->programObject = esLoadProgram ( vShaderStr, fShaderStr );
 
    // Generate the vertex data
-   userData->numIndices = esGenCube ( 0.1f, &positions,
+   userData->numIndices = esGenCube ( CUBE_SIZE, &positions,
                                       NULL, NULL, &indices );
 
    // Index buffer object
@@ -119,39 +136,51 @@ int Init ( ESContext *esContext )
    glBufferData ( GL_ARRAY_BUFFER, 24 * sizeof ( GLfloat ) * 3, positions, GL_STATIC_DRAW );
    free ( positions );
 
-   // Random color for each instance
+   // Random color for each instance, the colors of the visible instances
+   // are written to the buffer every frame
    {
-      GLubyte colors[NUM_INSTANCES][4];
       int instance;
 
-      srandom ( 0 );
+      esRandomSeed ( &rng, 0, 0 );
 
       for ( instance = 0; instance < NUM_INSTANCES; instance++ )
       {
-         colors[instance][0] = random() % 255;
-         colors[instance][1] = random() % 255;
-         colors[instance][2] = random() % 255;
-         colors[instance][3] = 0;
+         userData->colors[instance][0] = esRandomUint ( &rng ) % 255;
+         userData->colors[instance][1] = esRandomUint ( &rng ) % 255;
+         userData->colors[instance][2] = esRandomUint ( &rng ) % 255;
+         userData->colors[instance][3] = 0;
       }
 
       glGenBuffers ( 1, &userData->colorVBO );
       glBindBuffer ( GL_ARRAY_BUFFER, userData->colorVBO );
-      glBufferData ( GL_ARRAY_BUFFER, NUM_INSTANCES * 4, colors, GL_STATIC_DRAW );
+      glBufferData ( GL_ARRAY_BUFFER, NUM_INSTANCES * 4, NULL, GL_DYNAMIC_DRAW );
    }
 
    // Allocate storage to store MVP per instance
    {
       int instance;
+      int numRows = ( int ) sqrtf ( NUM_INSTANCES );
+      int numColumns = numRows;
+
+      // Grid position and random angle for each instance, compute the MVP later
+      esRandomFloats ( &rng, userData->angle, NUM_INSTANCES, 0.0f, 360.0f );
 
-      // Random angle for each instance, compute the MVP later
       for ( instance = 0; instance < NUM_INSTANCES; instance++ )
       {
-         userData->angle[instance] = ( float ) ( random() % 32768 ) / 32767.0f * 360.0f;
+         userData->translateX[instance] = ( ( float ) ( instance % numRows ) / ( float ) numRows ) * 2.0f - 1.0f;
+         userData->translateY[instance] = ( ( float ) ( instance / numColumns ) / ( float ) numColumns ) * 2.0f - 1.0f;
+
+         // The cube rotates about its center, so a sphere through its corners bounds it
+         userData->bounds[instance][0] = userData->translateX[instance];
+         userData->bounds[instance][1] = userData->translateY[instance];
+         userData->bounds[instance][2] = -2.0f;
+         userData->bounds[instance][3] = CUBE_SIZE * 0.8660254f;
       }
 
       glGenBuffers ( 1, &userData->mvpVBO );
       glBindBuffer ( GL_ARRAY_BUFFER, userData->mvpVBO );
       glBufferData ( GL_ARRAY_BUFFER, NUM_INSTANCES * sizeof ( ESMatrix ), NULL, GL_DYNAMIC_DRAW );
+      userData->numVisible = 0;
    }
    glBindBuffer ( GL_ARRAY_BUFFER, 0 );
 
@@ -167,11 +196,13 @@ void Update ( ESContext *esContext, float deltaTime )
 {
    UserData *userData = ( UserData * ) esContext->userData;
    ESMatrix *matrixBuf;
+   GLubyte  ( *colorBuf ) [4];
    ESMatrix perspective;
+   ESTransformBatch batch;
+   GLfloat  planes[6][4];
    float    aspect;
    int      instance = 0;
-   int      numRows;
-   int      numColumns;
+   int      i;
 
 
    // Compute the window aspect ratio
@@ -181,42 +212,61 @@ void Update ( ESContext *esContext, float deltaTime )
    esMatrixLoadIdentity ( &perspective );
    esPerspective ( &perspective, 60.0f, aspect, 1.0f, 20.0f );
 
-   glBindBuffer ( GL_ARRAY_BUFFER, userData->mvpVBO );
-   matrixBuf = ( ESMatrix * ) glMapBufferRange ( GL_ARRAY_BUFFER, 0, sizeof ( ESMatrix ) * NUM_INSTANCES, GL_MAP_WRITE_BIT );
-
-   // Compute a per-instance MVP that translates and rotates each instance differnetly
-   numRows = ( int ) sqrtf ( NUM_INSTANCES );
-   numColumns = numRows;
-
+   // Compute a rotation angle based on time to rotate each cube
    for ( instance = 0; instance < NUM_INSTANCES; instance++ )
    {
-      ESMatrix modelview;
-      float translateX = ( ( float ) ( instance % numRows ) / ( float ) numRows ) * 2.0f - 1.0f;
-      float translateY = ( ( float ) ( instance / numColumns ) / ( float ) numColumns ) * 2.0f - 1.0f;
-
-      // Generate a model view matrix to rotate/translate the cube
-      esMatrixLoadIdentity ( &modelview );
-
-      // Per-instance translation
-      esTranslate ( &modelview, translateX, translateY, -2.0f );
-
-      // Compute a rotation angle based on time to rotate the cube
       userData->angle[instance] += ( deltaTime * 40.0f );
 
       if ( userData->angle[instance] >= 360.0f )
       {
          userData->angle[instance] -= 360.0f;
       }
+   }
+
+   // Cull the instances against the view frustum, there is no view matrix
+   // so the planes of the projection are in eye space
+   esFrustumPlanesFromMatrix ( planes, &perspective );
+   userData->numVisible = esCullSpheres ( planes, userData->bounds[0], NUM_INSTANCES, userData->visible );
 
-      // Rotate the cube
-      esRotate ( &modelview, userData->angle[instance], 1.0, 0.0, 1.0 );
+   if ( userData->numVisible == 0 )
+   {
+      return;
+   }
 
-      // Compute the final MVP by multiplying the
-      // modevleiw and perspective matrices together
-      esMatrixMultiply ( &matrixBuf[instance], &modelview, &perspective );
+   // Gather the visible instances and their colors
+   glBindBuffer ( GL_ARRAY_BUFFER, userData->colorVBO );
+   colorBuf = glMapBufferRange ( GL_ARRAY_BUFFER, 0, 4 * userData->numVisible,
+                                 GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT );
+
+   for ( i = 0; i < userData->numVisible; i++ )
+   {
+      instance = userData->visible[i];
+      userData->visibleTranslateX[i] = userData->translateX[instance];
+      userData->visibleTranslateY[i] = userData->translateY[instance];
+      userData->visibleAngle[i] = userData->angle[instance];
+      memcpy ( colorBuf[i], userData->colors[instance], 4 );
    }
 
    glUnmapBuffer ( GL_ARRAY_BUFFER );
+
+   // Compute a per-instance MVP that translates and rotates each instance differently,
+   // writing all of them straight into the mapped buffer
+   memset ( &batch, 0, sizeof ( ESTransformBatch ) );
+   batch.translate[0] = userData->visibleTranslateX;
+   batch.translate[1] = userData->visibleTranslateY;
+   batch.sharedTranslate[2] = -2.0f;
+   batch.angle = userData->visibleAngle;
+   batch.sharedAxis[0] = 1.0f;
+   batch.sharedAxis[2] = 1.0f;
+   batch.sharedScale[0] = batch.sharedScale[1] = batch.sharedScale[2] = 1.0f;
+
+   glBindBuffer ( GL_ARRAY_BUFFER, userData->mvpVBO );
+   matrixBuf = ( ESMatrix * ) glMapBufferRange ( GL_ARRAY_BUFFER, 0, sizeof ( ESMatrix ) * userData->numVisible,
+                                                 GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT );
+
+   esBatchTransform ( matrixBuf, &perspective, &batch, userData->numVisible );
+
+   glUnmapBuffer ( GL_ARRAY_BUFFER );
 }
 
 ///
@@ -271,8 +321,8 @@ void Draw ( ESContext *esContext )
    // Bind the index buffer
    glBindBuffer ( GL_ELEMENT_ARRAY_BUFFER, userData->indicesIBO );
 
-   // Draw the cubes
-   glDrawElementsInstanced ( GL_TRIANGLES, userData->numIndices, GL_UNSIGNED_INT, ( const void * ) NULL, NUM_INSTANCES );
+   // Draw the visible cubes
+   glDrawElementsInstanced ( GL_TRIANGLES, userData->numIndices, GL_UNSIGNED_INT, ( const void * ) NULL, userData->numVisible );
 }
 
 ///
@@ -288,7 +338,7 @@ void Shutdown ( ESContext *esContext )
    glDeleteBuffers ( 1, &userData->indicesIBO );
 
    // Delete program object
-   glDeleteProgram ( userData->programObject );
+   esDeleteProgram ( userData->programObject );
 }
 
 
@@ -192,7 +192,7 @@ void Shutdown ( ESContext *esContext )
    }
 
    // Delete program object
-   glDeleteProgram ( userData->programObject );
+   esDeleteProgram ( userData->programObject );
 }
 
 
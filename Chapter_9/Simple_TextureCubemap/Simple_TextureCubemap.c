@@ -47,11 +47,9 @@ typedef struct
    // Texture handle
    GLuint textureId;
 
-   // Vertex data
-   int      numIndices;
-   GLfloat *vertices;
-   GLfloat *normals;
-   GLuint  *indices;
+   // Packed vertex data
+   int          numIndices;
+   ESPackedMesh sphere;
 
 } UserData;
 
@@ -123,6 +121,10 @@ GLuint CreateSimpleTextureCubemap( )
 int Init ( ESContext *esContext )
 {
    UserData *userData = esContext->userData;
+   GLfloat *vertices, *normals;
+   GLuint *indices;
+   GLboolean packed;
+   float acmrBefore, acmrAfter;
    char vShaderStr[] =
       "#version 300 es                            \n"
       "layout(location = 0) in vec4 a_position;   \n"
@@ -155,8 +157,24 @@ int Init ( ESContext *esContext )
    userData->textureId = CreateSimpleTextureCubemap ();
 
    // Generate the vertex data
-   userData->numIndices = esGenSphere ( 20, 0.75f, &userData->vertices, &userData->normals,
-                                        NULL, &userData->indices );
+   userData->numIndices = esGenSphere ( 20, 0.75f, &vertices, &normals, NULL, &indices );
+
+   // Reorder the sphere for the vertex cache, 20 slices and 10 parallels
+   esOptimizeMesh ( indices, userData->numIndices, ( 20 / 2 + 1 ) * ( 20 + 1 ),
+                    vertices, normals, NULL, &acmrBefore, &acmrAfter );
+   esLogMessage ( "Sphere: %d triangles, ACMR %.3f -> %.3f\n", userData->numIndices / 3, acmrBefore, acmrAfter );
+
+   // Pack to 16-bit positions and indices with 10-bit normals
+   packed = esPackMesh ( ( 20 / 2 + 1 ) * ( 20 + 1 ), vertices, normals, NULL,
+                         indices, userData->numIndices, &userData->sphere );
+   free ( vertices );
+   free ( normals );
+   free ( indices );
+
+   if ( !packed )
+   {
+      return FALSE;
+   }
 
 
    glClearColor ( 1.0f, 1.0f, 1.0f, 0.0f );
@@ -183,15 +201,8 @@ void Draw ( ESContext *esContext )
    // Use the program object
    glUseProgram ( userData->programObject );
 
-   // Load the vertex position
-   glVertexAttribPointer ( 0, 3, GL_FLOAT,
-                           GL_FALSE, 0, userData->vertices );
-   // Load the normal
-   glVertexAttribPointer ( 1, 3, GL_FLOAT,
-                           GL_FALSE, 0, userData->normals );
-
-   glEnableVertexAttribArray ( 0 );
-   glEnableVertexAttribArray ( 1 );
+   // Load the vertex position and normal
+   esPackedMeshAttribPointers ( &userData->sphere, userData->sphere.vertices, 0, 1, -1 );
 
    // Bind the texture
    glActiveTexture ( GL_TEXTURE0 );
@@ -201,7 +212,7 @@ void Draw ( ESContext *esContext )
    glUniform1i ( userData->samplerLoc, 0 );
 
    glDrawElements ( GL_TRIANGLES, userData->numIndices,
-                    GL_UNSIGNED_INT, userData->indices );
+                    userData->sphere.indexType, userData->sphere.indices );
 }
 
 ///
@@ -215,10 +226,9 @@ void ShutDown ( ESContext *esContext )
    glDeleteTextures ( 1, &userData->textureId );
 
    // Delete program object
-   glDeleteProgram ( userData->programObject );
+   esDeleteProgram ( userData->programObject );
 
-   free ( userData->vertices );
-   free ( userData->normals );
+   esFreePackedMesh ( &userData->sphere );
 }
 
 
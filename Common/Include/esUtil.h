@@ -78,6 +78,26 @@ extern "C" {
 #define ES_WINDOW_STENCIL       4
 /// esCreateWindow flat - multi-sample buffer
 #define ES_WINDOW_MULTISAMPLE   8
+/// esCreateWindow flag - render to an offscreen pbuffer instead of a native window
+#define ES_WINDOW_OFFSCREEN     16
+
+/// esCaptureInit format - 32-bit TGA files
+#define ES_CAPTURE_TGA          0
+/// esCaptureInit format - raw RGBA bytes, bottom row first
+#define ES_CAPTURE_RAW          1
+
+/// esParticleSystemCreate backend - emit with transform feedback, animate in the vertex shader
+#define ES_PARTICLES_TRANSFORM_FEEDBACK   0
+/// esParticleSystemCreate backend - simulate on the CPU and stream the particles to the GPU
+#define ES_PARTICLES_CPU                  1
+
+/// ESParticleDrawOptions blend - add the particles up in emission order
+#define ES_PARTICLES_BLEND_ADDITIVE       0
+/// ESParticleDrawOptions blend - blend the particles over each other back to front
+#define ES_PARTICLES_BLEND_ALPHA          1
+
+/// Most jobs esRunJobs runs at once
+#define ES_MAX_JOBS             8
 
 
 ///
@@ -95,6 +115,142 @@ typedef struct
    GLfloat   m[4][4];
 } ESMatrix;
 
+/// Per-instance transforms for esBatchTransform, as structure of arrays.  Each array holds one
+/// value per instance; when an array is NULL the shared value that follows it is used instead.
+typedef struct
+{
+   /// Translation
+   const GLfloat *translate[3];
+   GLfloat        sharedTranslate[3];
+
+   /// Rotation in degrees about an axis, which does not need to be normalized
+   const GLfloat *angle;
+   GLfloat        sharedAngle;
+   const GLfloat *axis[3];
+   GLfloat        sharedAxis[3];
+
+   /// Scale, remember to set sharedScale to 1 when there are no scale arrays
+   const GLfloat *scale[3];
+   GLfloat        sharedScale[3];
+} ESTransformBatch;
+
+/// Interleaved vertex data built by esPackMesh.  Attribute offsets are -1 when the attribute is
+/// not present and the arrays are NULL once freed with esFreePackedMesh.
+typedef struct
+{
+   /// Vertices, stride bytes each
+   GLvoid   *vertices;
+   GLsizei   stride;
+   int       numVertices;
+
+   /// Byte offsets of the four component position, GL_INT_2_10_10_10_REV normal and texture coordinate
+   GLint     positionOffset;
+   GLint     normalOffset;
+   GLint     texCoordOffset;
+
+   /// GL_UNSIGNED_SHORT or GL_SHORT (both normalized), or GL_HALF_FLOAT
+   GLenum    positionType;
+   GLenum    texCoordType;
+
+   /// Indices, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+   GLvoid   *indices;
+   GLenum    indexType;
+   int       numIndices;
+} ESPackedMesh;
+
+/// Program built by esLoadProgramsAsync
+typedef struct
+{
+   /// Vertex and fragment shader source code
+   const char         *vertShaderSrc;
+   const char         *fragShaderSrc;
+
+   /// Optional transform feedback varyings, set before the program is linked
+   GLsizei             numVaryings;
+   const char *const  *varyings;
+   GLenum              bufferMode;
+
+   /// Linked program object once esFinishPrograms returns, 0 on failure
+   GLuint              programObject;
+
+   /// Build state, managed by esLoadProgramsAsync and esFinishPrograms
+   GLuint              vertexShader;
+   GLuint              fragmentShader;
+   GLboolean           cached;
+   unsigned long long  cacheKey;
+} ESProgram;
+
+/// Emitter added to a particle system with esParticleSystemAddEmitter
+typedef struct
+{
+   /// Particles emitted per second and the seconds each one lives
+   float      rate;
+   float      lifetime;
+
+   /// Particles reserved for the emitter, 0 for rate * lifetime
+   int        capacity;
+
+   /// Emission point, particles start up to positionSpread away from it along each axis
+   GLfloat    position[3];
+   GLfloat    positionSpread[3];
+
+   /// Initial velocity, varied by up to velocitySpread along each axis
+   GLfloat    velocity[3];
+   GLfloat    velocitySpread[3];
+
+   /// Constant acceleration, such as gravity
+   GLfloat    acceleration[3];
+
+   /// Range of point sizes in pixels at emission, particles shrink to nothing over their lifetime
+   GLfloat    minSize;
+   GLfloat    maxSize;
+
+   /// Color the particle texture is multiplied with
+   GLfloat    color[4];
+
+   /// ES_PARTICLES_CPU only: plane (a, b, c, d) with a unit normal that the particles bounce off,
+   /// they stay where a * x + b * y + c * z + d >= 0.  All zero for no collisions.
+   GLfloat    collisionPlane[4];
+
+   /// ES_PARTICLES_CPU only: fraction of the speed towards the plane kept when bouncing
+   GLfloat    restitution;
+} ESParticleEmitter;
+
+typedef struct
+{
+   /// ES_PARTICLES_BLEND_ADDITIVE or ES_PARTICLES_BLEND_ALPHA.  Alpha blended emitters are drawn in
+   /// the depth order of their positions and the particles of each emitter are sorted back to
+   /// front: ES_PARTICLES_CPU radix sorts them on the CPU, ES_PARTICLES_TRANSFORM_FEEDBACK draws
+   /// them in depth slices, far to near.
+   int        blend;
+
+   /// Draw the particles into a target this many times smaller than the viewport in both
+   /// directions and blend it over the framebuffer, which cuts the fill cost of large particles.
+   /// 1 draws straight into the framebuffer.
+   int        downsample;
+
+   /// Depth texture of the opaque scene for soft particles, 0 for none.  It covers the viewport,
+   /// needs GL_NEAREST filtering, must not be attached to the framebuffer being drawn to and is
+   /// rendered with a perspective projection with the given near and far planes.  Particles are
+   /// hidden behind the scene and fade out over softness units in front of it, 0 for a hard edge.
+   GLuint     depthTexture;
+   GLfloat    nearPlane;
+   GLfloat    farPlane;
+   GLfloat    softness;
+} ESParticleDrawOptions;
+
+typedef struct ESParticleSystem ESParticleSystem;
+
+/// Pseudo random number generator for the esRandom functions.  Four xoshiro128** generators
+/// step side by side so esRandomFloats can use SSE or NEON.  Do not share one between threads,
+/// seed one per thread with the same seed and its own stream instead.
+typedef struct
+{
+   GLuint   state[4][4];
+   GLuint   buffer[4];
+   int      next;
+} ESRandom;
+
 typedef struct ESContext ESContext;
 
 struct ESContext
@@ -133,6 +289,15 @@ struct ESContext
    void ( ESCALLBACK *shutdownFunc ) ( ESContext * );
    void ( ESCALLBACK *keyFunc ) ( ESContext *, unsigned char, int, int );
    void ( ESCALLBACK *updateFunc ) ( ESContext *, float deltaTime );
+
+   /// Fixed timestep for updateFunc in seconds, 0 to pass the frame delta instead
+   float       fixedTimestep;
+
+   /// Maximum updates per frame when catching up, 0 for one update every frame
+   int         maxUpdateSteps;
+
+   /// Time not yet consumed by fixed timestep updates
+   float       timeAccumulator;
 };
 
 
@@ -152,6 +317,8 @@ struct ESContext
 ///         ES_WINDOW_DEPTH   - specifies that a depth buffer should be created
 ///         ES_WINDOW_STENCIL - specifies that a stencil buffer should be created
 ///         ES_WINDOW_MULTISAMPLE - specifies that a multi-sample buffer should be created
+///         ES_WINDOW_OFFSCREEN - render to a pbuffer surface without creating a native window.
+///                               Also enabled by setting the ES_OFFSCREEN environment variable.
 /// \return GL_TRUE if window creation is succesful, GL_FALSE otherwise
 GLboolean ESUTIL_API esCreateWindow ( ESContext *esContext, const char *title, GLint width, GLint height, GLuint flags );
 
@@ -176,6 +343,18 @@ void ESUTIL_API esRegisterShutdownFunc ( ESContext *esContext, void ( ESCALLBACK
 //
 void ESUTIL_API esRegisterUpdateFunc ( ESContext *esContext, void ( ESCALLBACK *updateFunc ) ( ESContext *, float ) );
 
+//
+/// \brief Call the update function at a fixed timestep instead of once per frame with the elapsed time.
+///        Elapsed time is accumulated and consumed in steps of timestep, so simulation is independent
+///        of the render rate.  The ES_FIXED_TIMESTEP and ES_FIXED_TIMESTEP_MAX_STEPS environment
+///        variables set the same values for any sample.
+/// \param esContext Application context
+/// \param timestep Time in seconds passed to every update, 0 disables the fixed timestep
+/// \param maxSteps Maximum number of updates per frame, time beyond that is dropped.  0 runs exactly one
+///        update per frame regardless of elapsed time, which makes runs replay frame-for-frame.
+//
+void ESUTIL_API esSetFixedTimestep ( ESContext *esContext, float timestep, int maxSteps );
+
 //
 /// \brief Register a keyboard input processing callback function
 /// \param esContext Application context
@@ -201,13 +380,104 @@ GLuint ESUTIL_API esLoadShader ( GLenum type, const char *shaderSrc );
 //
 ///
 /// \brief Load a vertex and fragment shader, create a program object, link program.
-///        Errors output to log.
+///        Errors output to log.  Delete the program with esDeleteProgram so its lookup tables
+///        are freed too.
 /// \param vertShaderSrc Vertex shader source code
 /// \param fragShaderSrc Fragment shader source code
 /// \return A new program object linked with the vertex/fragment shader pair, 0 on failure
 //
 GLuint ESUTIL_API esLoadProgram ( const char *vertShaderSrc, const char *fragShaderSrc );
 
+//
+///
+/// \brief Load a vertex and fragment shader, create a program object, set the transform feedback
+///        varyings and link program.  Errors output to log.
+/// \param vertShaderSrc Vertex shader source code
+/// \param fragShaderSrc Fragment shader source code
+/// \param numVaryings Number of transform feedback varyings, 0 for none
+/// \param varyings Names of the transform feedback varyings
+/// \param bufferMode GL_INTERLEAVED_ATTRIBS or GL_SEPARATE_ATTRIBS
+/// \return A new program object linked with the vertex/fragment shader pair, 0 on failure
+//
+GLuint ESUTIL_API esLoadProgramFeedback ( const char *vertShaderSrc, const char *fragShaderSrc,
+                                          GLsizei numVaryings, const char *const *varyings, GLenum bufferMode );
+
+//
+///
+/// \brief Set the directory of the program binary cache used by esLoadProgram.  Programs are cached by
+///        a hash of their sources and the GL_RENDERER and GL_VERSION strings.  The cache is disabled,
+///        and nothing is written to disk, unless this or the ES_PROGRAM_CACHE_DIR environment variable
+///        names a directory.  This call overrides the environment variable.
+/// \param directory Cache directory, created if missing.  NULL or empty disables the cache.
+//
+void ESUTIL_API esSetProgramCacheDirectory ( const char *directory );
+
+//
+///
+/// \brief Start building a set of programs without waiting for any of them.  All shaders are submitted
+///        for compilation before any program is linked and no status is queried, so drivers supporting
+///        KHR_parallel_shader_compile build them concurrently on their own threads.  Programs in the
+///        binary cache are restored instead.
+/// \param programs Programs to build, the sources and varyings must stay valid until esFinishPrograms
+/// \param count Number of programs
+//
+void ESUTIL_API esLoadProgramsAsync ( ESProgram *programs, int count );
+
+//
+///
+/// \brief Check, without blocking, whether programs started with esLoadProgramsAsync are built.
+///        Polls GL_COMPLETION_STATUS_KHR, always GL_TRUE without KHR_parallel_shader_compile.
+/// \param programs Programs passed to esLoadProgramsAsync
+/// \param count Number of programs
+//
+GLboolean ESUTIL_API esProgramsReady ( const ESProgram *programs, int count );
+
+//
+///
+/// \brief Wait for programs started with esLoadProgramsAsync, check for errors and store new binaries
+///        in the program binary cache.  Errors output to log.
+/// \param programs Programs passed to esLoadProgramsAsync, programObject is 0 for failed programs
+/// \param count Number of programs
+/// \return GL_TRUE if every program linked
+//
+GLboolean ESUTIL_API esFinishPrograms ( ESProgram *programs, int count );
+
+//
+///
+/// \brief Get the location of a uniform.  Programs loaded with esLoadProgram record their active
+///        uniforms, attributes and uniform blocks once after link, so lookups use a hash table instead
+///        of querying the driver.  Other programs fall back to glGetUniformLocation.
+/// \param programObject Program object
+/// \param name Uniform name
+/// \return Uniform location, -1 if the uniform is not active
+//
+GLint ESUTIL_API esGetUniformLocation ( GLuint programObject, const char *name );
+
+//
+///
+/// \brief Get the location of a vertex attribute, see esGetUniformLocation
+/// \param programObject Program object
+/// \param name Attribute name
+/// \return Attribute location, -1 if the attribute is not active
+//
+GLint ESUTIL_API esGetAttribLocation ( GLuint programObject, const char *name );
+
+//
+///
+/// \brief Get the index of a uniform block, see esGetUniformLocation
+/// \param programObject Program object
+/// \param name Uniform block name
+/// \return Uniform block index, GL_INVALID_INDEX if the block is not active
+//
+GLuint ESUTIL_API esGetUniformBlockIndex ( GLuint programObject, const char *name );
+
+//
+///
+/// \brief Delete a program loaded with esLoadProgram together with its lookup tables
+/// \param programObject Program object
+//
+void ESUTIL_API esDeleteProgram ( GLuint programObject );
+
 
 //
 /// \brief Generates geometry for a sphere.  Allocates memory for the vertex data and stores
@@ -249,7 +519,133 @@ int ESUTIL_API esGenCube ( float scale, GLfloat **vertices, GLfloat **normals,
 int ESUTIL_API esGenSquareGrid ( int size, GLfloat **vertices, GLuint **indices );
 
 //
-/// \brief Loads a 8-bit, 24-bit or 32-bit TGA image from a file
+/// \brief Generates a square grid as triangle strips joined by primitive restart.  Each row of
+///        quads is split into narrow column bands so the row shared with the next strip is still
+///        in the post-transform vertex cache.  Strips are separated by the index 0xFFFFFFFF, draw
+///        them as GL_TRIANGLE_STRIP with GL_PRIMITIVE_RESTART_FIXED_INDEX enabled.
+/// \param size create a grid of size by size (number of triangles = (size-1)*(size-1)*2)
+/// \param vertices If not NULL, will contain array of float3 positions, the same as esGenSquareGrid
+/// \param indices If not NULL, will contain the array of indices for the triangle strips
+/// \return The number of indices required for rendering the buffers (the number of indices stored in the indices array
+///         if it is not NULL ) as a GL_TRIANGLE_STRIP
+//
+int ESUTIL_API esGenSquareGridStrip ( int size, GLfloat **vertices, GLuint **indices );
+
+//
+/// \brief Packs vertex data from the esGen functions into one interleaved buffer.  Positions
+///        and texture coordinates are stored as normalized GL_UNSIGNED_SHORT when they lie in
+///        [0, 1], normalized GL_SHORT in [-1, 1] and GL_HALF_FLOAT otherwise, with w = 1 added
+///        to positions.  Normals are stored as GL_INT_2_10_10_10_REV and indices as GLushort
+///        when the vertex count allows it, primitive restart indices become 0xFFFF.
+/// \param numVertices Number of vertices in the attribute arrays
+/// \param vertices If not NULL, array of float3 positions
+/// \param normals If not NULL, array of float3 normals
+/// \param texCoords If not NULL, array of float2 texCoords
+/// \param indices If not NULL, array of indices
+/// \param numIndices Number of indices in the array
+/// \param mesh Receives the packed data, free it with esFreePackedMesh
+/// \return GL_TRUE on success, GL_FALSE if memory could not be allocated
+//
+GLboolean ESUTIL_API esPackMesh ( int numVertices, const GLfloat *vertices, const GLfloat *normals,
+                                  const GLfloat *texCoords, const GLuint *indices, int numIndices,
+                                  ESPackedMesh *mesh );
+
+//
+/// \brief Frees the arrays of a packed mesh.  The layout is kept so it can still be passed
+///        to esPackedMeshAttribPointers once the data is in buffer objects.
+/// \param mesh Mesh filled in by esPackMesh
+//
+void ESUTIL_API esFreePackedMesh ( ESPackedMesh *mesh );
+
+//
+/// \brief Sets up and enables the vertex attribute arrays of a packed mesh
+/// \param mesh Mesh filled in by esPackMesh
+/// \param base Start of the vertex data, NULL when it is in the bound GL_ARRAY_BUFFER
+/// \param positionLoc Position attribute location, or -1 to skip it
+/// \param normalLoc Normal attribute location, or -1 to skip it
+/// \param texCoordLoc Texture coordinate attribute location, or -1 to skip it
+//
+void ESUTIL_API esPackedMeshAttribPointers ( const ESPackedMesh *mesh, const GLvoid *base,
+                                             GLint positionLoc, GLint normalLoc, GLint texCoordLoc );
+
+//
+/// \brief Generates a sphere like esGenSphere and packs it with esPackMesh
+/// \param numSlices The number of slices in the sphere
+/// \param radius The radius of the sphere
+/// \param mesh Receives the packed positions, normals, texCoords and indices
+/// \return The number of indices to draw as GL_TRIANGLES, 0 on failure
+//
+int ESUTIL_API esGenSpherePacked ( int numSlices, float radius, ESPackedMesh *mesh );
+
+//
+/// \brief Generates a cube like esGenCube and packs it with esPackMesh
+/// \param scale The size of the cube, use 1.0 for a unit cube.
+/// \param mesh Receives the packed positions, normals, texCoords and indices
+/// \return The number of indices to draw as GL_TRIANGLES, 0 on failure
+//
+int ESUTIL_API esGenCubePacked ( float scale, ESPackedMesh *mesh );
+
+//
+/// \brief Generates a square grid like esGenSquareGrid and packs it with esPackMesh
+/// \param size create a grid of size by size (number of triangles = (size-1)*(size-1)*2)
+/// \param mesh Receives the packed positions and indices
+/// \return The number of indices to draw as GL_TRIANGLES, 0 on failure
+//
+int ESUTIL_API esGenSquareGridPacked ( int size, ESPackedMesh *mesh );
+
+//
+/// \brief Simulates a FIFO post-transform vertex cache over a triangle list
+/// \param indices Array of GL_TRIANGLES indices
+/// \param numIndices Number of indices in the array
+/// \param numVertices Number of vertices the indices refer to
+/// \param cacheSize Number of entries in the simulated cache
+/// \return The average cache miss ratio, the vertices transformed per triangle
+//
+float ESUTIL_API esComputeACMR ( const GLuint *indices, int numIndices, int numVertices, int cacheSize );
+
+//
+/// \brief Reorders a triangle list in place for post-transform vertex cache hits
+/// \param indices Array of GL_TRIANGLES indices, reordered in place
+/// \param numIndices Number of indices in the array
+/// \param numVertices Number of vertices the indices refer to
+//
+void ESUTIL_API esOptimizeTriangleOrder ( GLuint *indices, int numIndices, int numVertices );
+
+//
+/// \brief Renumbers vertices in the order the triangle list first uses them so vertex fetch
+///        walks memory sequentially.  The attribute arrays are reordered to match, nothing is
+///        changed if the scratch memory cannot be allocated.
+/// \param indices Array of GL_TRIANGLES indices, rewritten in place
+/// \param numIndices Number of indices in the array
+/// \param numVertices Number of vertices in the attribute arrays
+/// \param vertices If not NULL, array of float3 positions to reorder
+/// \param normals If not NULL, array of float3 normals to reorder
+/// \param texCoords If not NULL, array of float2 texture coordinates to reorder
+//
+void ESUTIL_API esOptimizeVertexOrder ( GLuint *indices, int numIndices, int numVertices,
+                                        GLfloat *vertices, GLfloat *normals, GLfloat *texCoords );
+
+//
+/// \brief Optimizes the output of the esGen functions for the GPU: reorders the triangles for the
+///        vertex cache, draws clusters facing out from the mesh first to reduce overdraw when
+///        positions are given, then reorders the vertices.
+/// \param indices Array of GL_TRIANGLES indices, rewritten in place
+/// \param numIndices Number of indices in the array
+/// \param numVertices Number of vertices in the attribute arrays
+/// \param vertices If not NULL, array of float3 positions to reorder
+/// \param normals If not NULL, array of float3 normals to reorder
+/// \param texCoords If not NULL, array of float2 texture coordinates to reorder
+/// \param acmrBefore If not NULL, receives the ACMR of the triangles as given, for a 16 entry cache
+/// \param acmrAfter If not NULL, receives the ACMR of the optimized triangles
+//
+void ESUTIL_API esOptimizeMesh ( GLuint *indices, int numIndices, int numVertices,
+                                 GLfloat *vertices, GLfloat *normals, GLfloat *texCoords,
+                                 float *acmrBefore, float *acmrAfter );
+
+//
+/// \brief Loads a TGA image from a file.  Uncompressed and RLE compressed color-mapped, true-color and
+///        grayscale images are supported.  The image is returned ready for glTexImage2D: the first row
+///        is the bottom row and pixels are 8-bit luminance, RGB or RGBA depending on the file.
 /// \param ioContext Context related to IO facility on the platform
 /// \param fileName Name of the file on disk
 /// \param width Width of loaded image in pixels
@@ -258,6 +654,362 @@ int ESUTIL_API esGenSquareGrid ( int size, GLfloat **vertices, GLuint **indices
 //
 char *ESUTIL_API esLoadTGA ( void *ioContext, const char *fileName, int *width, int *height );
 
+//
+/// \brief Loads a TGA image like esLoadTGA and reports how many 8-bit channels each pixel has
+/// \param ioContext Context related to IO facility on the platform
+/// \param fileName Name of the file on disk
+/// \param width Width of loaded image in pixels
+/// \param height Height of loaded image in pixels
+/// \param channels Receives 1 for luminance, 3 for RGB or 4 for RGBA images
+/// \return Pointer to loaded image.  NULL on failure.
+//
+char *ESUTIL_API esLoadTGAChannels ( void *ioContext, const char *fileName, int *width, int *height, int *channels );
+
+//
+/// \brief Loads a TGA image like esLoadTGA, avoiding copies of the pixel data where possible.  On Linux
+///        the file is memory mapped and, when its pixels can be uploaded without conversion, a pointer
+///        straight into the mapping is returned.  Otherwise the image is decoded straight out of the
+///        mapping, or read with esLoadTGA on other platforms.
+/// \param ioContext Context related to IO facility on the platform
+/// \param fileName Name of the file on disk
+/// \param width Width of loaded image in pixels
+/// \param height Height of loaded image in pixels
+/// \return Pointer to the read-only image, release it with esReleaseTGA.  NULL on failure.
+//
+const char *ESUTIL_API esMapTGA ( void *ioContext, const char *fileName, int *width, int *height );
+
+//
+/// \brief Release an image returned by esMapTGA or esLoadTGA
+/// \param buffer Image to release
+//
+void ESUTIL_API esReleaseTGA ( const char *buffer );
+
+//
+/// \brief Begin a named profiling scope.  Profiling is off, and the esProfiler functions do
+///        nothing, unless the ES_PROFILE environment variable is set to a value other than 0.
+///        GPU time is measured with EXT_disjoint_timer_query when it is supported, otherwise CPU
+///        time is measured around glFinish, which stalls the pipeline.  Queries are kept in a ring
+///        per scope and read back frames later so timer queries do not stall the pipeline.
+///        Scopes cannot be nested: a scope begun while another is open logs an error once and
+///        is ignored, along with its esProfilerItems and esProfilerEnd, the open scope keeps timing.
+/// \param name Name of the scope, times are averaged per name
+//
+void ESUTIL_API esProfilerBegin ( const char *name );
+
+//
+/// \brief End the scope opened by the last call to esProfilerBegin
+//
+void ESUTIL_API esProfilerEnd ( void );
+
+//
+/// \brief Record how many items, such as particles or instances, the open scope processes.  The
+///        report then also gives the average time per million items.
+/// \param count Number of items processed this time the scope ran
+//
+void ESUTIL_API esProfilerItems ( double count );
+
+//
+/// \brief Log the average time of every profiling scope, when ES_PROFILE is set, and release the query objects.
+///        Must be called while the context is still current, typically from the shutdown callback.
+//
+void ESUTIL_API esProfilerShutdown ( void );
+
+//
+/// \brief Start capturing rendered frames to disk.  Frames are read into a ring of pixel pack
+///        buffers and written by a background thread, so capturing does not stall rendering.
+///        The platform loop does this automatically when the ES_CAPTURE_DIR environment variable
+///        is set, with ES_CAPTURE_INTERVAL and ES_CAPTURE_FORMAT (tga or raw) as options.
+/// \param esContext Application context
+/// \param directory Directory the frame_NNNNN files are written to, created if needed
+/// \param format ES_CAPTURE_TGA or ES_CAPTURE_RAW
+/// \param interval Capture every interval-th frame, so a run of N frames with interval N
+///        captures only the last frame
+/// \return GL_TRUE if capture was started
+//
+GLboolean ESUTIL_API esCaptureInit ( ESContext *esContext, const char *directory, int format, int interval );
+
+//
+/// \brief Queue a readback of the default framebuffer.  Call after drawing and before eglSwapBuffers.
+/// \param esContext Application context
+//
+void ESUTIL_API esCaptureFrame ( ESContext *esContext );
+
+//
+/// \brief Write out all frames still in flight and stop capturing.  The context must be current.
+//
+void ESUTIL_API esCaptureShutdown ( void );
+
+//
+/// \brief Load a TGA file into a new texture in the background.  Files are decoded on worker threads and
+///        uploaded through a second EGL context that shares objects with the application context, which
+///        also sets the filter and wrap modes.  Platforms without threads load synchronously.
+/// \param esContext Application context, its context must be current
+/// \param fileName Name of the file on disk
+/// \param format GL_RGB, GL_RGBA, GL_LUMINANCE or GL_ALPHA matching the channels in the file.  Files
+///        with a different number of channels fail to load.
+/// \param filter GL_NEAREST or GL_LINEAR, for both minification and magnification.  No mipmaps are
+///        generated.
+/// \param wrap GL_REPEAT, GL_MIRRORED_REPEAT or GL_CLAMP_TO_EDGE, for both texture coordinates
+/// \return Texture name, the texture must not be used or have its state changed until it is ready.  0 if
+///         a synchronous load failed.
+//
+GLuint ESUTIL_API esLoadTextureAsync ( ESContext *esContext, const char *fileName, GLenum format,
+                                       GLint filter, GLint wrap );
+
+//
+/// \brief Check, without blocking, whether a texture queued with esLoadTextureAsync can be used
+/// \param texture Texture returned by esLoadTextureAsync
+/// \return GL_TRUE once the upload has completed, or if loading failed
+//
+GLboolean ESUTIL_API esTextureReady ( GLuint texture );
+
+//
+/// \brief Wait until all textures queued with esLoadTextureAsync are loaded.  The CPU blocks until every
+///        file is decoded and its upload is submitted by the upload context, the application context
+///        then waits for the uploads to complete on the GPU with glWaitSync.
+/// \return GL_TRUE if every texture loaded, GL_FALSE if any file could not be loaded
+//
+GLboolean ESUTIL_API esTextureLoaderFinish ( void );
+
+//
+/// \brief Stop the texture loader threads and destroy the upload context
+//
+void ESUTIL_API esTextureLoaderShutdown ( void );
+
+//
+/// \brief Create the uniform ring, one large uniform buffer split into a segment per frame in flight.
+///        Blocks are allocated from the current segment, staged in client memory and sent to the
+///        buffer with a single upload, so many draws cost one buffer update instead of many
+///        glUniform calls.  A segment is reused once the fence of the frame that last used it signals.
+/// \param frameSize Bytes of uniform blocks needed per frame
+/// \return GL_TRUE if the buffer was created
+//
+GLboolean ESUTIL_API esUniformRingInit ( GLsizeiptr frameSize );
+
+//
+/// \brief Allocate a block aligned to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT in this frame's segment
+/// \param size Size of the block in bytes
+/// \param offset Returns the offset of the block in the ring buffer, to pass to esUniformRingBind
+/// \return Pointer the block contents are written to before esUniformRingUpload.  NULL if the
+///         frame is out of space.
+//
+void *ESUTIL_API esUniformRingAlloc ( GLsizeiptr size, GLintptr *offset );
+
+//
+/// \brief Upload every block allocated since the last upload.  Call once the frame's blocks are
+///        written and before the draws that use them.
+//
+void ESUTIL_API esUniformRingUpload ( void );
+
+//
+/// \brief Bind a block to a uniform buffer binding point with glBindBufferRange
+/// \param index Uniform buffer binding point
+/// \param offset Offset returned by esUniformRingAlloc
+/// \param size Size of the block in bytes
+//
+void ESUTIL_API esUniformRingBind ( GLuint index, GLintptr offset, GLsizeiptr size );
+
+//
+/// \brief Fence the blocks used this frame and move to the next segment.  Call after the last
+///        draw of the frame, and also for a frame that is abandoned after a failed allocation.
+//
+void ESUTIL_API esUniformRingEndFrame ( void );
+
+//
+/// \brief Delete the uniform ring buffer.  The context must be current.
+//
+void ESUTIL_API esUniformRingShutdown ( void );
+
+//
+/// \brief Create a particle system.  Each emitter takes a ring of slots in one particle store.  Every
+///        particle of an emitter lives equally long, so particles die in the order they were emitted
+///        and the live particles stay contiguous in the ring.  Only they are updated and drawn, never
+///        the whole store.
+///        ES_PARTICLES_TRANSFORM_FEEDBACK emits new particles with transform feedback and animates
+///        them in closed form in the vertex shader.  ES_PARTICLES_CPU integrates the particles on
+///        the CPU with SSE or NEON, split across threads for large systems, which allows collisions.
+///        The result is streamed through a triple buffered vertex buffer.
+///        The ES_PARTICLE_BACKEND environment variable, "cpu" or "tf", overrides the backend.
+/// \param capacity Total particles for all emitters, up to millions
+/// \param backend ES_PARTICLES_TRANSFORM_FEEDBACK or ES_PARTICLES_CPU
+/// \return The new particle system, NULL on failure
+//
+ESParticleSystem *ESUTIL_API esParticleSystemCreate ( int capacity, int backend );
+
+//
+/// \brief Add an emitter to a particle system
+/// \param system Particle system
+/// \param emitter Emitter parameters, copied
+/// \return Index of the emitter, -1 if the system has no room left for its particles
+//
+int ESUTIL_API esParticleSystemAddEmitter ( ESParticleSystem *system, const ESParticleEmitter *emitter );
+
+//
+/// \brief Change the emission rate of an emitter.  The rate is limited to what the particles reserved
+///        for the emitter can hold.
+/// \param system Particle system
+/// \param emitter Index returned by esParticleSystemAddEmitter
+/// \param rate Particles emitted per second
+//
+void ESUTIL_API esParticleSystemSetRate ( ESParticleSystem *system, int emitter, float rate );
+
+//
+/// \brief Change the parameters of an emitter, except for its capacity.  Live particles keep
+///        their positions and velocities but are drawn with the new lifetime and color.
+/// \param system Particle system
+/// \param emitter Index returned by esParticleSystemAddEmitter
+/// \param params New emitter parameters
+//
+void ESUTIL_API esParticleSystemSetEmitter ( ESParticleSystem *system, int emitter, const ESParticleEmitter *params );
+
+//
+/// \brief Emit particles all at once, in addition to the emitter's rate.  Call before
+///        esParticleSystemUpdate, which moves them on from where they are born.
+/// \param system Particle system
+/// \param emitter Index returned by esParticleSystemAddEmitter
+/// \param count Number of particles, limited to the emitter's free slots
+/// \return Number of particles emitted
+//
+int ESUTIL_API esParticleSystemBurst ( ESParticleSystem *system, int emitter, int count );
+
+//
+/// \brief Advance time, retire dead particles and emit new ones.  Particles emitted during the step
+///        are spread evenly over it.
+/// \param system Particle system
+/// \param deltaTime Seconds since the last update
+//
+void ESUTIL_API esParticleSystemUpdate ( ESParticleSystem *system, float deltaTime );
+
+//
+/// \brief Set how esParticleSystemDraw blends the particles and where it draws them.  The
+///        ES_PARTICLE_DOWNSAMPLE environment variable overrides the downsampling.  Alpha blending
+///        on ES_PARTICLES_CPU applies from the next update.  The default is additive blending at
+///        full resolution.
+/// \param system Particle system
+/// \param options Draw options, copied
+/// \return GL_FALSE if the sort arrays cannot be allocated, the options are then unchanged
+//
+GLboolean ESUTIL_API esParticleSystemSetDrawOptions ( ESParticleSystem *system, const ESParticleDrawOptions *options );
+
+//
+/// \brief Draw the live particles as point sprites into the current viewport, as set by
+///        esParticleSystemSetDrawOptions.
+/// \param system Particle system
+/// \param mvpMatrix Model-view-projection matrix of the particle positions
+/// \param texture 2D texture drawn on each point sprite
+//
+void ESUTIL_API esParticleSystemDraw ( ESParticleSystem *system, const ESMatrix *mvpMatrix, GLuint texture );
+
+//
+/// \brief Number of particles the next esParticleSystemDraw draws
+/// \param system Particle system
+//
+int ESUTIL_API esParticleSystemLiveCount ( const ESParticleSystem *system );
+
+//
+/// \brief Log the average live particle count and delete the particle system.  The context must be
+///        current.  When ES_PROFILE is set, transform feedback emission, CPU simulation, CPU sorting
+///        and drawing are timed in the "ParticleEmit", "ParticleSimulate", "ParticleSort" and
+///        "ParticleDraw" profiler scopes and esProfilerShutdown reports their cost per million
+///        particles.  Scopes do not nest, so do not wrap esParticleSystemUpdate or
+///        esParticleSystemDraw in scopes of your own while profiling.
+/// \param system Particle system
+//
+void ESUTIL_API esParticleSystemDestroy ( ESParticleSystem *system );
+
+//
+/// \brief Set how many threads esNumJobs splits work across.  Defaults to the ES_THREADS environment
+///        variable, or one thread per CPU.
+/// \param numThreads Number of threads, up to ES_MAX_JOBS, or 0 for one per CPU
+//
+void ESUTIL_API esJobsSetThreads ( int numThreads );
+
+//
+/// \brief Number of jobs to split work on count items into, so that each job gets at least minPerJob
+///        items and there are no more jobs than threads
+/// \param count Number of items
+/// \param minPerJob Fewest items worth a job of their own
+/// \return Number of jobs, 1 to ES_MAX_JOBS
+//
+int ESUTIL_API esNumJobs ( int count, int minPerJob );
+
+//
+/// \brief Range of items one of numJobs jobs works on.  Ranges start on multiples of 4, so only the
+///        last job has a partial SIMD step.
+/// \param count Number of items
+/// \param numJobs Number of jobs from esNumJobs
+/// \param job Index of the job
+/// \param first Receives the first item of the job
+/// \param jobCount Receives the number of items of the job, may be 0
+//
+void ESUTIL_API esJobRange ( int count, int numJobs, int job, int *first, int *jobCount );
+
+//
+/// \brief Run worker on every job in parallel and wait for them all.  The calling thread runs jobs
+///        too, the others run on worker threads that are kept between calls.  Calls made while
+///        another esRunJobs is in progress, including from inside a job, run their jobs in turn on
+///        the calling thread.  Platforms without threads always run the jobs in turn.
+/// \param worker Function run on each job
+/// \param jobs Array of numJobs jobs
+/// \param jobSize Size of one job in bytes
+/// \param numJobs Number of jobs, up to ES_MAX_JOBS
+//
+void ESUTIL_API esRunJobs ( void ( *worker ) ( void * ), void *jobs, size_t jobSize, int numJobs );
+
+//
+/// \brief Stop the worker threads of esRunJobs.  The platform main loop calls this on exit.
+//
+void ESUTIL_API esJobsShutdown ( void );
+
+//
+/// \brief Seed a random number generator.  The same seed and stream always give the same sequence.
+/// \param rng Generator to seed
+/// \param seed Seed value
+/// \param stream Index of the stream, streams of one seed never overlap so threads can each use one
+//
+void ESUTIL_API esRandomSeed ( ESRandom *rng, unsigned long long seed, unsigned int stream );
+
+//
+/// \brief Return the next 32 random bits
+/// \param rng Seeded generator
+//
+GLuint ESUTIL_API esRandomUint ( ESRandom *rng );
+
+//
+/// \brief Return a uniform random float in [0, 1)
+/// \param rng Seeded generator
+//
+GLfloat ESUTIL_API esRandomFloat ( ESRandom *rng );
+
+//
+/// \brief Return a uniform random float in [min, max)
+/// \param rng Seeded generator
+/// \param min, max Range of the result
+//
+GLfloat ESUTIL_API esRandomRange ( ESRandom *rng, GLfloat min, GLfloat max );
+
+//
+/// \brief Fill an array with uniform random floats in [min, max), four at a time with SSE or NEON.
+///        The values are the same as from count calls to esRandomRange.
+/// \param rng Seeded generator
+/// \param dst Array of count floats
+/// \param count Number of values
+/// \param min, max Range of the values
+//
+void ESUTIL_API esRandomFloats ( ESRandom *rng, GLfloat *dst, int count, GLfloat min, GLfloat max );
+
+//
+/// \brief Generate a 3D gradient noise texture normalized to [0, 255], for a GL_R8 upload.  Rows are
+///        evaluated eight texels at a time with AVX where the CPU has it, else four with SSE or NEON,
+///        and the slices are split across jobs with esRunJobs.
+/// \param size Width, height and depth of the texture in texels
+/// \param frequency Number of noise lattice cells along each axis
+/// \param seed Seed of the lattice gradients
+/// \param texels If not NULL, will contain the size^3 texels, x varying fastest, free with free()
+/// \return size^3, or 0 if the texels cannot be allocated
+//
+int ESUTIL_API esGenNoise3D ( int size, GLfloat frequency, unsigned int seed, GLubyte **texels );
+
 
 //
 /// \brief Multiply matrix specified by result with a scaling matrix and return new matrix in result
@@ -316,6 +1068,101 @@ void ESUTIL_API esOrtho ( ESMatrix *result, float left, float right, float botto
 //
 void ESUTIL_API esMatrixMultiply ( ESMatrix *result, ESMatrix *srcA, ESMatrix *srcB );
 
+//
+/// \brief Transform an array of vec4s by a matrix, as matrix * v in a shader with the matrix
+///        loaded untransposed.  Uses SSE, AVX or NEON when available.
+/// \param dst Returns count transformed vec4s, may be the same array as src
+/// \param matrix Transformation matrix
+/// \param src Array of count vec4s
+/// \param count Number of vectors
+//
+void ESUTIL_API esMatrixTransformVec4 ( GLfloat *dst, const ESMatrix *matrix, const GLfloat *src, int count );
+
+//
+/// \brief Transpose a matrix
+/// \param result Returns the transposed matrix, may be the same as src
+/// \param src Input matrix
+//
+void ESUTIL_API esMatrixTranspose ( ESMatrix *result, const ESMatrix *src );
+
+//
+/// \brief Invert a matrix.  Uses SSE when available.
+/// \param result Returns the inverse, may be the same as src
+/// \param src Input matrix
+/// \return GL_FALSE, leaving result unchanged, if the matrix is singular
+//
+GLboolean ESUTIL_API esMatrixInverse ( ESMatrix *result, const ESMatrix *src );
+
+//
+/// \brief Compute the normal matrix, the inverse transpose of the upper 3x3 of a model view matrix
+/// \param result Returns the normal matrix, ready for glUniformMatrix3fv without transposing
+/// \param modelview Model view matrix
+/// \return GL_FALSE, leaving result unchanged, if the upper 3x3 is singular
+//
+GLboolean ESUTIL_API esMatrixNormal3x3 ( GLfloat result[3][3], const ESMatrix *modelview );
+
+//
+/// \brief Extract the clipping planes of a projection or model-view-projection matrix.  Each plane
+///        is (a, b, c, d) with a unit normal pointing into the frustum, so a point p is inside
+///        when a * p.x + b * p.y + c * p.z + d >= 0 for all six planes.
+/// \param planes Returns the left, right, bottom, top, near and far planes, in the space the
+///        matrix transforms from
+/// \param matrix Input matrix
+//
+void ESUTIL_API esFrustumPlanesFromMatrix ( GLfloat planes[6][4], const ESMatrix *matrix );
+
+//
+/// \brief Test a bounding sphere against frustum planes from esFrustumPlanesFromMatrix
+/// \param planes Frustum planes
+/// \param center Center of the sphere, in the space of the planes
+/// \param radius Radius of the sphere
+/// \return GL_TRUE if the sphere is at least partly inside the frustum
+//
+GLboolean ESUTIL_API esSphereInFrustum ( const GLfloat planes[6][4], const GLfloat center[3], GLfloat radius );
+
+//
+/// \brief Test an axis aligned bounding box against frustum planes from esFrustumPlanesFromMatrix.
+///        Passing the planes of an object's MVP matrix tests its local space bounds.
+/// \param planes Frustum planes
+/// \param boxMin, boxMax Minimum and maximum corners of the box, in the space of the planes
+/// \return GL_TRUE if the box is at least partly inside the frustum.  Large boxes just outside
+///         a corner of the frustum can be reported as visible.
+//
+GLboolean ESUTIL_API esBoxInFrustum ( const GLfloat planes[6][4], const GLfloat boxMin[3], const GLfloat boxMax[3] );
+
+//
+/// \brief Find the visible spheres in an array.  Four spheres are tested at a time with SSE or NEON.
+/// \param planes Frustum planes
+/// \param spheres count spheres as (x, y, z, radius)
+/// \param count Number of spheres
+/// \param visible Returns the indices of the visible spheres in order, room for count indices
+/// \return Number of visible spheres
+//
+int ESUTIL_API esCullSpheres ( const GLfloat planes[6][4], const GLfloat *spheres, int count, GLuint *visible );
+
+//
+/// \brief Find the visible axis aligned boxes in an array.  Four boxes are tested at a time with
+///        SSE or NEON.
+/// \param planes Frustum planes
+/// \param boxes count boxes as (minX, minY, minZ, maxX, maxY, maxZ)
+/// \param count Number of boxes
+/// \param visible Returns the indices of the visible boxes in order, room for count indices
+/// \return Number of visible boxes
+//
+int ESUTIL_API esCullBoxes ( const GLfloat planes[6][4], const GLfloat *boxes, int count, GLuint *visible );
+
+//
+/// \brief Build the model-view-projection matrices of many instances.  Each model matrix is built
+///        as by esMatrixLoadIdentity, esTranslate, esRotate and esScale and then multiplied with
+///        viewProjection by esMatrixMultiply.  Four instances are built at a time with SSE or NEON
+///        and large batches are split across threads.
+/// \param dst Returns count matrices, may point into a mapped buffer
+/// \param viewProjection Matrix the model matrices are multiplied with
+/// \param batch Per-instance translations, rotations and scales
+/// \param count Number of instances
+//
+void ESUTIL_API esBatchTransform ( ESMatrix *dst, const ESMatrix *viewProjection, const ESTransformBatch *batch, int count );
+
 //
 //// \brief Return an identity matrix
 //// \param result Returns identity matrix
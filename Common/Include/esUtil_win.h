@@ -65,6 +65,14 @@ extern "C" {
 //
 GLboolean WinCreate ( ESContext *esContext, const char *title );
 
+///
+//  esStepUpdate()
+//
+//      Called once per frame by the platform loop with the elapsed time.
+//      Runs the update function, at a fixed timestep if one is set.
+//
+void esStepUpdate ( ESContext *esContext, float deltaTime );
+
 #ifdef __cplusplus
 }
 #endif
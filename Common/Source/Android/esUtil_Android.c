@@ -41,6 +41,7 @@
 #include <android_native_app_glue.h>
 #include <time.h>
 #include "esUtil.h"
+#include "esUtil_win.h"
 
 #define LOGI(...) ((void)__android_log_print(ANDROID_LOG_INFO, "esUtil", __VA_ARGS__))
 
@@ -98,6 +99,8 @@ static void HandleCommand ( struct android_app *pApp, int32_t cmd )
             esContext->shutdownFunc ( esContext );
          }
 
+         esJobsShutdown ();
+
          if ( esContext->userData != NULL )
          {
             free ( esContext->userData );
@@ -146,6 +149,9 @@ void android_main ( struct android_app *pApp )
 
    esContext.platformData = ( void * ) pApp->activity->assetManager;
 
+   // Keep program binaries in the application's private storage
+   esSetProgramCacheDirectory ( pApp->activity->internalDataPath );
+
    pApp->onAppCmd = HandleCommand;
    pApp->userData = &esContext;
 
@@ -178,12 +184,11 @@ void android_main ( struct android_app *pApp )
       }
 
       // Call app update function
-      if ( esContext.updateFunc != NULL )
       {
          float curTime = GetCurrentTime();
          float deltaTime =  ( curTime - lastTime );
          lastTime = curTime;
-         esContext.updateFunc ( &esContext, deltaTime );
+         esStepUpdate ( &esContext, deltaTime );
       }
 
       if ( esContext.drawFunc != NULL )
@@ -20,8 +20,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
-#include <sys/time.h>
+#include <time.h>
 #include "esUtil.h"
+#include "esUtil_win.h"
 
 #include  <X11/Xlib.h>
 #include  <X11/Xatom.h>
@@ -31,12 +32,145 @@
 static Display *x_display = NULL;
 static Atom s_wmDeleteMessage;
 
+// Frame phases timed in benchmark mode
+enum
+{
+    BENCH_UPDATE,
+    BENCH_DRAW,
+    BENCH_SWAP,
+    BENCH_FRAME,
+    BENCH_NUM_PHASES
+};
+
+static const char *s_benchPhaseNames[BENCH_NUM_PHASES] = { "update", "draw", "swap", "frame" };
+
+typedef struct
+{
+    // Number of frames to run, 0 when benchmark mode is off
+    int     numFrames;
+
+    // Per-frame time in seconds for each phase
+    double *times[BENCH_NUM_PHASES];
+
+    // Total wall clock time of the run
+    double  totalTime;
+} BenchStats;
+
 //////////////////////////////////////////////////////////////////
 //
 //  Private Functions
 //
 //
 
+///
+//  GetCurrentTime()
+//
+//      Monotonic time in seconds
+//
+static double GetCurrentTime ( void )
+{
+    struct timespec ts;
+    clock_gettime ( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+///
+//  BenchInit()
+//
+//      Benchmark mode is enabled by setting ES_BENCHMARK_FRAMES to the number of
+//      frames to run.  The loop exits after that many frames and prints a report.
+//
+static void BenchInit ( BenchStats *stats )
+{
+    const char *frames = getenv ( "ES_BENCHMARK_FRAMES" );
+    int i;
+
+    memset ( stats, 0, sizeof ( BenchStats ) );
+
+    if ( frames == NULL || atoi ( frames ) <= 0 )
+        return;
+
+    stats->numFrames = atoi ( frames );
+
+    for ( i = 0; i < BENCH_NUM_PHASES; i++ )
+    {
+        stats->times[i] = calloc ( stats->numFrames, sizeof ( double ) );
+        if ( stats->times[i] == NULL )
+        {
+            esLogMessage ( "Benchmark: out of memory for %d frames\n", stats->numFrames );
+            while ( i-- > 0 )
+            {
+                free ( stats->times[i] );
+                stats->times[i] = NULL;
+            }
+            stats->numFrames = 0;
+            return;
+        }
+    }
+}
+
+static int CompareDouble ( const void *a, const void *b )
+{
+    double da = *( const double * ) a;
+    double db = *( const double * ) b;
+    return ( da > db ) - ( da < db );
+}
+
+///
+//  Percentile()
+//
+//      Nearest-rank percentile of a sorted array
+//
+static double Percentile ( const double *sorted, int count, double p )
+{
+    int rank = ( int ) ( p * count + 0.999999 ) - 1;
+
+    if ( rank < 0 )
+        rank = 0;
+    if ( rank >= count )
+        rank = count - 1;
+    return sorted[rank];
+}
+
+///
+//  BenchReport()
+//
+//      Print min/median/p95/p99 per phase for the frames that ran and free the stats
+//
+static void BenchReport ( BenchStats *stats, int framesRun )
+{
+    int i;
+
+    if ( stats->numFrames == 0 )
+        return;
+
+    if ( framesRun > 0 )
+    {
+        esLogMessage ( "Benchmark: %d frames in %.3f s, %.1f FPS\n",
+                       framesRun, stats->totalTime, framesRun / stats->totalTime );
+        esLogMessage ( "  %-8s %10s %10s %10s %10s %10s\n",
+                       "phase", "min ms", "median ms", "p95 ms", "p99 ms", "FPS" );
+
+        for ( i = 0; i < BENCH_NUM_PHASES; i++ )
+        {
+            double *t = stats->times[i];
+            double median;
+
+            qsort ( t, framesRun, sizeof ( double ), CompareDouble );
+            median = Percentile ( t, framesRun, 0.5 );
+
+            esLogMessage ( "  %-8s %10.3f %10.3f %10.3f %10.3f %10.1f\n",
+                           s_benchPhaseNames[i], t[0] * 1000.0, median * 1000.0,
+                           Percentile ( t, framesRun, 0.95 ) * 1000.0,
+                           Percentile ( t, framesRun, 0.99 ) * 1000.0,
+                           median > 0.0 ? 1.0 / median : 0.0 );
+        }
+    }
+
+    for ( i = 0; i < BENCH_NUM_PHASES; i++ )
+        free ( stats->times[i] );
+}
+
 
 //////////////////////////////////////////////////////////////////
 //
@@ -49,7 +183,7 @@ static Atom s_wmDeleteMessage;
 //
 //      This function initialized the native X11 display and window for EGL
 //
-EGLBoolean WinCreate(ESContext *esContext, const char *title)
+GLboolean WinCreate(ESContext *esContext, const char *title)
 {
     Window root;
     XSetWindowAttributes swa;
@@ -129,6 +263,10 @@ GLboolean userInterrupt(ESContext *esContext)
     GLboolean userinterrupt = GL_FALSE;
     char text;
 
+    // No X display when rendering offscreen, only an external signal can stop us
+    if ( x_display == NULL )
+        return GL_FALSE;
+
     // Pump all messages from X server. Keypresses are directed to keyfunc (if defined)
     while ( XPending ( x_display ) )
     {
@@ -152,6 +290,25 @@ GLboolean userInterrupt(ESContext *esContext)
     return userinterrupt;
 }
 
+///
+//  CaptureInit()
+//
+//      Start frame capture if ES_CAPTURE_DIR is set
+//
+static void CaptureInit ( ESContext *esContext )
+{
+    const char *dir = getenv ( "ES_CAPTURE_DIR" );
+    const char *interval = getenv ( "ES_CAPTURE_INTERVAL" );
+    const char *format = getenv ( "ES_CAPTURE_FORMAT" );
+
+    if ( dir == NULL )
+        return;
+
+    esCaptureInit ( esContext, dir,
+                    format != NULL && strcmp ( format, "raw" ) == 0 ? ES_CAPTURE_RAW : ES_CAPTURE_TGA,
+                    interval != NULL ? atoi ( interval ) : 1 );
+}
+
 ///
 //  WinLoop()
 //
@@ -159,25 +316,52 @@ GLboolean userInterrupt(ESContext *esContext)
 //
 void WinLoop ( ESContext *esContext )
 {
-    struct timeval t1, t2;
-    struct timezone tz;
+    double t1, t2, start;
     float deltatime;
+    BenchStats stats;
+    int frame = 0;
+
+    BenchInit ( &stats );
+    CaptureInit ( esContext );
 
-    gettimeofday ( &t1 , &tz );
+    t1 = start = GetCurrentTime ();
 
     while(userInterrupt(esContext) == GL_FALSE)
     {
-        gettimeofday(&t2, &tz);
-        deltatime = (float)(t2.tv_sec - t1.tv_sec + (t2.tv_usec - t1.tv_usec) * 1e-6);
+        double tUpdate, tDraw, tSwap;
+
+        if ( stats.numFrames > 0 && frame >= stats.numFrames )
+            break;
+
+        t2 = GetCurrentTime ();
+        deltatime = (float)(t2 - t1);
         t1 = t2;
 
-        if (esContext->updateFunc != NULL)
-            esContext->updateFunc(esContext, deltatime);
+        esStepUpdate(esContext, deltatime);
+        tUpdate = GetCurrentTime ();
+
         if (esContext->drawFunc != NULL)
             esContext->drawFunc(esContext);
+        tDraw = GetCurrentTime ();
 
+        esCaptureFrame ( esContext );
         eglSwapBuffers(esContext->eglDisplay, esContext->eglSurface);        
+        tSwap = GetCurrentTime ();
+
+        if ( stats.numFrames > 0 )
+        {
+            stats.times[BENCH_UPDATE][frame] = tUpdate - t2;
+            stats.times[BENCH_DRAW][frame] = tDraw - tUpdate;
+            stats.times[BENCH_SWAP][frame] = tSwap - tDraw;
+            stats.times[BENCH_FRAME][frame] = tSwap - t2;
+        }
+        frame++;
     }
+
+    stats.totalTime = GetCurrentTime () - start;
+    BenchReport ( &stats, frame );
+
+    esCaptureShutdown ();
 }
 
 ///
@@ -206,6 +390,8 @@ int main ( int argc, char *argv[] )
    if ( esContext.shutdownFunc != NULL )
 	   esContext.shutdownFunc ( &esContext );
 
+   esJobsShutdown ();
+
    if ( esContext.userData != NULL )
 	   free ( esContext.userData );
 
@@ -41,6 +41,7 @@
 #include <windows.h>
 #include <stdlib.h>
 #include "esUtil.h"
+#include "esUtil_win.h"
 
 #ifdef _WIN64
 #define GWL_USERDATA GWLP_USERDATA
@@ -214,16 +215,22 @@ void WinLoop ( ESContext *esContext )
             DispatchMessage ( &msg );
          }
       }
+      else if ( esContext->eglNativeWindow == NULL )
+      {
+         // Offscreen rendering, there is no window to deliver WM_PAINT to
+         if ( esContext->drawFunc != NULL )
+         {
+            esContext->drawFunc ( esContext );
+            eglSwapBuffers ( esContext->eglDisplay, esContext->eglSurface );
+         }
+      }
       else
       {
          SendMessage ( esContext->eglNativeWindow, WM_PAINT, 0, 0 );
       }
 
       // Call update function if registered
-      if ( esContext->updateFunc != NULL )
-      {
-         esContext->updateFunc ( esContext, deltaTime );
-      }
+      esStepUpdate ( esContext, deltaTime );
    }
 }
 
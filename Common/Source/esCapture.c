@@ -0,0 +1,428 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// ESCapture.c
+//
+//    Asynchronous capture of rendered frames to disk.  Frames are read into
+//    a ring of pixel pack buffers, mapped a couple of frames later once the
+//    GPU is done with them and written out as TGA or raw RGBA files on a
+//    writer thread.
+//
+
+///
+//  Includes
+//
+#include "esUtil.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#define ES_CAPTURE_THREADED
+#endif
+
+///
+// Defines
+//
+
+// Pixel pack buffers in the ring, a frame is mapped this many frames after it was read
+#define PBO_RING_SIZE      3
+
+// Frames waiting for the writer thread before the render thread blocks
+#define MAX_QUEUED_FRAMES  8
+
+#define MAX_PATH_LENGTH    512
+
+///
+// Types
+//
+typedef struct
+{
+   unsigned char *pixels;
+   int            width;
+   int            height;
+   int            frameIndex;
+} CaptureJob;
+
+typedef struct
+{
+   GLboolean   initialized;
+   char        directory[MAX_PATH_LENGTH];
+   int         format;
+   int         interval;
+   int         frameCount;
+
+   // PBO ring, frameIndex is -1 for a slot that holds no frame
+   GLuint      pbos[PBO_RING_SIZE];
+   int         pboFrame[PBO_RING_SIZE];
+   int         pboWidth[PBO_RING_SIZE];
+   int         pboHeight[PBO_RING_SIZE];
+   int         nextPbo;
+
+   // Frames waiting to be written
+   CaptureJob  queue[MAX_QUEUED_FRAMES];
+   int         queueHead;
+   int         queueCount;
+   GLboolean   quit;
+
+#ifdef ES_CAPTURE_THREADED
+   pthread_t       thread;
+   pthread_mutex_t mutex;
+   pthread_cond_t  notEmpty;
+   pthread_cond_t  notFull;
+#endif
+} Capture;
+
+static Capture s_capture;
+
+//////////////////////////////////////////////////////////////////
+//
+//  Private Functions
+//
+//
+
+///
+// WriteFrame()
+//
+//    Write one frame to disk.  Pixels are RGBA with the bottom row first,
+//    which is also the default TGA origin, so only a BGRA swizzle is needed.
+//
+static void WriteFrame ( const CaptureJob *job )
+{
+   char fileName[MAX_PATH_LENGTH + 32];
+   size_t numBytes = ( size_t ) job->width * job->height * 4;
+   FILE *fp;
+
+   snprintf ( fileName, sizeof ( fileName ), "%s/frame_%05d.%s", s_capture.directory,
+              job->frameIndex, s_capture.format == ES_CAPTURE_RAW ? "rgba" : "tga" );
+
+   fp = fopen ( fileName, "wb" );
+
+   if ( fp == NULL )
+   {
+      esLogMessage ( "esCapture FAILED to open : { %s }\n", fileName );
+      return;
+   }
+
+   if ( s_capture.format == ES_CAPTURE_TGA )
+   {
+      unsigned char header[18];
+      size_t i;
+
+      memset ( header, 0, sizeof ( header ) );
+      header[2] = 2;                               // uncompressed true color
+      header[12] = job->width & 0xFF;
+      header[13] = ( job->width >> 8 ) & 0xFF;
+      header[14] = job->height & 0xFF;
+      header[15] = ( job->height >> 8 ) & 0xFF;
+      header[16] = 32;                             // bits per pixel
+      header[17] = 8;                              // alpha bits, bottom-left origin
+      fwrite ( header, sizeof ( header ), 1, fp );
+
+      for ( i = 0; i < numBytes; i += 4 )
+      {
+         unsigned char r = job->pixels[i];
+         job->pixels[i] = job->pixels[i + 2];
+         job->pixels[i + 2] = r;
+      }
+   }
+
+   fwrite ( job->pixels, numBytes, 1, fp );
+   fclose ( fp );
+}
+
+///
+// EnqueueFrame()
+//
+//    Hand a frame to the writer.  Blocks while the queue is full so that
+//    frames are never dropped and memory use stays bounded.
+//
+static void EnqueueFrame ( const CaptureJob *job )
+{
+#ifdef ES_CAPTURE_THREADED
+   pthread_mutex_lock ( &s_capture.mutex );
+
+   while ( s_capture.queueCount == MAX_QUEUED_FRAMES )
+   {
+      pthread_cond_wait ( &s_capture.notFull, &s_capture.mutex );
+   }
+
+   s_capture.queue[ ( s_capture.queueHead + s_capture.queueCount ) % MAX_QUEUED_FRAMES ] = *job;
+   s_capture.queueCount++;
+
+   pthread_cond_signal ( &s_capture.notEmpty );
+   pthread_mutex_unlock ( &s_capture.mutex );
+#else
+   WriteFrame ( job );
+   free ( job->pixels );
+#endif
+}
+
+#ifdef ES_CAPTURE_THREADED
+///
+// WriterThread()
+//
+//    Writes queued frames until shutdown is requested and the queue is empty
+//
+static void *WriterThread ( void *arg )
+{
+   ( void ) arg;
+
+   for ( ;; )
+   {
+      CaptureJob job;
+
+      pthread_mutex_lock ( &s_capture.mutex );
+
+      while ( s_capture.queueCount == 0 && !s_capture.quit )
+      {
+         pthread_cond_wait ( &s_capture.notEmpty, &s_capture.mutex );
+      }
+
+      if ( s_capture.queueCount == 0 )
+      {
+         pthread_mutex_unlock ( &s_capture.mutex );
+         break;
+      }
+
+      job = s_capture.queue[s_capture.queueHead];
+      s_capture.queueHead = ( s_capture.queueHead + 1 ) % MAX_QUEUED_FRAMES;
+      s_capture.queueCount--;
+
+      pthread_cond_signal ( &s_capture.notFull );
+      pthread_mutex_unlock ( &s_capture.mutex );
+
+      WriteFrame ( &job );
+      free ( job.pixels );
+   }
+
+   return NULL;
+}
+#endif
+
+///
+// RetirePbo()
+//
+//    Map a PBO filled in an earlier frame, copy it out and queue it for writing
+//
+static void RetirePbo ( int slot )
+{
+   CaptureJob job;
+   size_t numBytes;
+   void *data;
+
+   if ( s_capture.pboFrame[slot] < 0 )
+   {
+      return;
+   }
+
+   job.width = s_capture.pboWidth[slot];
+   job.height = s_capture.pboHeight[slot];
+   job.frameIndex = s_capture.pboFrame[slot];
+   numBytes = ( size_t ) job.width * job.height * 4;
+   s_capture.pboFrame[slot] = -1;
+
+   glBindBuffer ( GL_PIXEL_PACK_BUFFER, s_capture.pbos[slot] );
+   data = glMapBufferRange ( GL_PIXEL_PACK_BUFFER, 0, numBytes, GL_MAP_READ_BIT );
+
+   if ( data == NULL )
+   {
+      return;
+   }
+
+   job.pixels = malloc ( numBytes );
+
+   if ( job.pixels != NULL )
+   {
+      memcpy ( job.pixels, data, numBytes );
+   }
+
+   glUnmapBuffer ( GL_PIXEL_PACK_BUFFER );
+
+   if ( job.pixels != NULL )
+   {
+      EnqueueFrame ( &job );
+   }
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//  Public Functions
+//
+//
+
+//
+/// \brief Start capturing frames to disk
+/// \param esContext Application context
+/// \param directory Directory the frames are written to, created if it does not exist
+/// \param format ES_CAPTURE_TGA or ES_CAPTURE_RAW
+/// \param interval Capture every interval-th frame
+/// \return GL_TRUE on success
+//
+GLboolean ESUTIL_API esCaptureInit ( ESContext *esContext, const char *directory, int format, int interval )
+{
+   int i;
+
+   // Kept for symmetry with esCaptureFrame, the size is read per frame
+   ( void ) esContext;
+
+   if ( s_capture.initialized || directory == NULL )
+   {
+      return GL_FALSE;
+   }
+
+   memset ( &s_capture, 0, sizeof ( Capture ) );
+   strncpy ( s_capture.directory, directory, MAX_PATH_LENGTH - 1 );
+   s_capture.format = format;
+   s_capture.interval = interval > 0 ? interval : 1;
+
+#ifdef _WIN32
+   _mkdir ( directory );
+#else
+   mkdir ( directory, 0755 );
+#endif
+
+   glGenBuffers ( PBO_RING_SIZE, s_capture.pbos );
+
+   for ( i = 0; i < PBO_RING_SIZE; i++ )
+   {
+      s_capture.pboFrame[i] = -1;
+   }
+
+#ifdef ES_CAPTURE_THREADED
+   pthread_mutex_init ( &s_capture.mutex, NULL );
+   pthread_cond_init ( &s_capture.notEmpty, NULL );
+   pthread_cond_init ( &s_capture.notFull, NULL );
+
+   if ( pthread_create ( &s_capture.thread, NULL, WriterThread, NULL ) != 0 )
+   {
+      glDeleteBuffers ( PBO_RING_SIZE, s_capture.pbos );
+      return GL_FALSE;
+   }
+#endif
+
+   s_capture.initialized = GL_TRUE;
+   return GL_TRUE;
+}
+
+//
+/// \brief Queue a readback of the default framebuffer.  Call after drawing and before
+///        eglSwapBuffers.  The frame is written out a few frames later.
+/// \param esContext Application context
+//
+void ESUTIL_API esCaptureFrame ( ESContext *esContext )
+{
+   GLint readFramebuffer, readBuffer, packBuffer;
+   int frameIndex;
+   int slot;
+
+   if ( !s_capture.initialized )
+   {
+      return;
+   }
+
+   frameIndex = s_capture.frameCount++;
+
+   if ( ( frameIndex + 1 ) % s_capture.interval != 0 )
+   {
+      return;
+   }
+
+   glGetIntegerv ( GL_READ_FRAMEBUFFER_BINDING, &readFramebuffer );
+   glGetIntegerv ( GL_READ_BUFFER, &readBuffer );
+   glGetIntegerv ( GL_PIXEL_PACK_BUFFER_BINDING, &packBuffer );
+
+   // The slot about to be reused holds the oldest frame, retire it first
+   slot = s_capture.nextPbo;
+   RetirePbo ( slot );
+
+   glBindFramebuffer ( GL_READ_FRAMEBUFFER, 0 );
+   glReadBuffer ( GL_BACK );
+
+   glBindBuffer ( GL_PIXEL_PACK_BUFFER, s_capture.pbos[slot] );
+
+   if ( s_capture.pboWidth[slot] != esContext->width || s_capture.pboHeight[slot] != esContext->height )
+   {
+      glBufferData ( GL_PIXEL_PACK_BUFFER, esContext->width * esContext->height * 4, NULL, GL_STREAM_READ );
+      s_capture.pboWidth[slot] = esContext->width;
+      s_capture.pboHeight[slot] = esContext->height;
+   }
+
+   glReadPixels ( 0, 0, esContext->width, esContext->height, GL_RGBA, GL_UNSIGNED_BYTE, NULL );
+   s_capture.pboFrame[slot] = frameIndex;
+   s_capture.nextPbo = ( slot + 1 ) % PBO_RING_SIZE;
+
+   glBindBuffer ( GL_PIXEL_PACK_BUFFER, packBuffer );
+   glBindFramebuffer ( GL_READ_FRAMEBUFFER, readFramebuffer );
+   glReadBuffer ( readBuffer );
+}
+
+//
+/// \brief Write out the frames still in flight, stop the writer thread and free the buffers
+//
+void ESUTIL_API esCaptureShutdown ( void )
+{
+   int i;
+
+   if ( !s_capture.initialized )
+   {
+      return;
+   }
+
+   // Retire the remaining frames oldest first
+   for ( i = 0; i < PBO_RING_SIZE; i++ )
+   {
+      RetirePbo ( ( s_capture.nextPbo + i ) % PBO_RING_SIZE );
+   }
+
+   glBindBuffer ( GL_PIXEL_PACK_BUFFER, 0 );
+   glDeleteBuffers ( PBO_RING_SIZE, s_capture.pbos );
+
+#ifdef ES_CAPTURE_THREADED
+   pthread_mutex_lock ( &s_capture.mutex );
+   s_capture.quit = GL_TRUE;
+   pthread_cond_signal ( &s_capture.notEmpty );
+   pthread_mutex_unlock ( &s_capture.mutex );
+
+   pthread_join ( s_capture.thread, NULL );
+
+   pthread_mutex_destroy ( &s_capture.mutex );
+   pthread_cond_destroy ( &s_capture.notEmpty );
+   pthread_cond_destroy ( &s_capture.notFull );
+#endif
+
+   s_capture.initialized = GL_FALSE;
+}
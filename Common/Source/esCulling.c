@@ -0,0 +1,291 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// ESCulling.c
+//
+//    Bounding sphere and box tests against the planes returned by
+//    esFrustumPlanesFromMatrix.  The batch tests check four volumes at a
+//    time with SSE or NEON and compact the visible ones into an index list.
+//
+
+///
+//  Includes
+//
+#include "esUtil.h"
+#include <math.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define CULL_NEON
+#include <arm_neon.h>
+#elif defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+#define CULL_SSE
+#include <emmintrin.h>
+#endif
+
+///
+// Defines
+//
+#define NUM_PLANES   6
+
+//////////////////////////////////////////////////////////////////
+//
+//  Private Functions
+//
+//
+
+#if defined(CULL_SSE) || defined(CULL_NEON)
+///
+// CullLanes()
+//
+//    Test four spheres, or four boxes reduced to a center and the
+//    distance their extents reach along each plane normal, against the
+//    frustum.  Returns a bit per lane that is set when the lane is visible.
+//
+static int CullLanes ( const GLfloat planes[6][4], const GLfloat x[4], const GLfloat y[4], const GLfloat z[4],
+                       const GLfloat extent[3][4], const GLfloat radius[4] )
+{
+   int i;
+#if defined(CULL_SSE)
+   const __m128 signMask = _mm_set1_ps ( -0.0f );
+   __m128 cx = _mm_loadu_ps ( x );
+   __m128 cy = _mm_loadu_ps ( y );
+   __m128 cz = _mm_loadu_ps ( z );
+   __m128 visible = _mm_castsi128_ps ( _mm_set1_epi32 ( -1 ) );
+
+   for ( i = 0; i < NUM_PLANES; i++ )
+   {
+      __m128 nx = _mm_set1_ps ( planes[i][0] );
+      __m128 ny = _mm_set1_ps ( planes[i][1] );
+      __m128 nz = _mm_set1_ps ( planes[i][2] );
+      __m128 dist = _mm_add_ps ( _mm_add_ps ( _mm_mul_ps ( nx, cx ), _mm_mul_ps ( ny, cy ) ),
+                                 _mm_add_ps ( _mm_mul_ps ( nz, cz ), _mm_set1_ps ( planes[i][3] ) ) );
+      __m128 reach;
+
+      if ( extent != NULL )
+      {
+         reach = _mm_add_ps ( _mm_add_ps ( _mm_mul_ps ( _mm_andnot_ps ( signMask, nx ), _mm_loadu_ps ( extent[0] ) ),
+                                           _mm_mul_ps ( _mm_andnot_ps ( signMask, ny ), _mm_loadu_ps ( extent[1] ) ) ),
+                              _mm_mul_ps ( _mm_andnot_ps ( signMask, nz ), _mm_loadu_ps ( extent[2] ) ) );
+      }
+      else
+      {
+         reach = _mm_loadu_ps ( radius );
+      }
+
+      visible = _mm_and_ps ( visible, _mm_cmpge_ps ( _mm_add_ps ( dist, reach ), _mm_setzero_ps () ) );
+   }
+
+   return _mm_movemask_ps ( visible );
+#else
+   float32x4_t cx = vld1q_f32 ( x );
+   float32x4_t cy = vld1q_f32 ( y );
+   float32x4_t cz = vld1q_f32 ( z );
+   uint32x4_t  visible = vdupq_n_u32 ( 0xFFFFFFFF );
+
+   for ( i = 0; i < NUM_PLANES; i++ )
+   {
+      float32x4_t dist = vaddq_f32 ( vaddq_f32 ( vmulq_n_f32 ( cx, planes[i][0] ), vmulq_n_f32 ( cy, planes[i][1] ) ),
+                                     vaddq_f32 ( vmulq_n_f32 ( cz, planes[i][2] ), vdupq_n_f32 ( planes[i][3] ) ) );
+      float32x4_t reach;
+
+      if ( extent != NULL )
+      {
+         reach = vaddq_f32 ( vaddq_f32 ( vmulq_n_f32 ( vld1q_f32 ( extent[0] ), fabsf ( planes[i][0] ) ),
+                                         vmulq_n_f32 ( vld1q_f32 ( extent[1] ), fabsf ( planes[i][1] ) ) ),
+                             vmulq_n_f32 ( vld1q_f32 ( extent[2] ), fabsf ( planes[i][2] ) ) );
+      }
+      else
+      {
+         reach = vld1q_f32 ( radius );
+      }
+
+      visible = vandq_u32 ( visible, vcgeq_f32 ( vaddq_f32 ( dist, reach ), vdupq_n_f32 ( 0.0f ) ) );
+   }
+
+   return ( vgetq_lane_u32 ( visible, 0 ) & 1 ) | ( vgetq_lane_u32 ( visible, 1 ) & 2 ) |
+          ( vgetq_lane_u32 ( visible, 2 ) & 4 ) | ( vgetq_lane_u32 ( visible, 3 ) & 8 );
+#endif
+}
+
+///
+// AppendVisible()
+//
+//    Append the visible lanes of the group starting at first to the index
+//    list.  Every lane is written and only visible ones are kept, which
+//    avoids a branch per volume.
+//
+static int AppendVisible ( GLuint *visible, int numVisible, int first, int mask )
+{
+   int lane;
+
+   for ( lane = 0; lane < 4; lane++ )
+   {
+      visible[numVisible] = first + lane;
+      numVisible += ( mask >> lane ) & 1;
+   }
+
+   return numVisible;
+}
+#endif
+
+//////////////////////////////////////////////////////////////////
+//
+//  Public Functions
+//
+//
+
+///
+// esSphereInFrustum()
+//
+//    Test a bounding sphere against the frustum planes
+//
+GLboolean ESUTIL_API esSphereInFrustum ( const GLfloat planes[6][4], const GLfloat center[3], GLfloat radius )
+{
+   int i;
+
+   for ( i = 0; i < NUM_PLANES; i++ )
+   {
+      GLfloat dist = planes[i][0] * center[0] + planes[i][1] * center[1] + planes[i][2] * center[2] + planes[i][3];
+
+      if ( dist < -radius )
+      {
+         return GL_FALSE;
+      }
+   }
+
+   return GL_TRUE;
+}
+
+///
+// esBoxInFrustum()
+//
+//    Test an axis aligned bounding box against the frustum planes using the
+//    corner furthest along each plane normal
+//
+GLboolean ESUTIL_API esBoxInFrustum ( const GLfloat planes[6][4], const GLfloat boxMin[3], const GLfloat boxMax[3] )
+{
+   int i;
+
+   for ( i = 0; i < NUM_PLANES; i++ )
+   {
+      GLfloat x = planes[i][0] >= 0.0f ? boxMax[0] : boxMin[0];
+      GLfloat y = planes[i][1] >= 0.0f ? boxMax[1] : boxMin[1];
+      GLfloat z = planes[i][2] >= 0.0f ? boxMax[2] : boxMin[2];
+
+      if ( planes[i][0] * x + planes[i][1] * y + planes[i][2] * z + planes[i][3] < 0.0f )
+      {
+         return GL_FALSE;
+      }
+   }
+
+   return GL_TRUE;
+}
+
+///
+// esCullSpheres()
+//
+//    Write the indices of the spheres inside the frustum to visible
+//
+int ESUTIL_API esCullSpheres ( const GLfloat planes[6][4], const GLfloat *spheres, int count, GLuint *visible )
+{
+   int numVisible = 0;
+   int i = 0;
+
+#if defined(CULL_SSE) || defined(CULL_NEON)
+
+   for ( ; i + 4 <= count; i += 4 )
+   {
+      const GLfloat *s = spheres + i * 4;
+      GLfloat x[4] = { s[0], s[4], s[8], s[12] };
+      GLfloat y[4] = { s[1], s[5], s[9], s[13] };
+      GLfloat z[4] = { s[2], s[6], s[10], s[14] };
+      GLfloat r[4] = { s[3], s[7], s[11], s[15] };
+
+      numVisible = AppendVisible ( visible, numVisible, i, CullLanes ( planes, x, y, z, NULL, r ) );
+   }
+
+#endif
+
+   for ( ; i < count; i++ )
+   {
+      if ( esSphereInFrustum ( planes, spheres + i * 4, spheres[i * 4 + 3] ) )
+      {
+         visible[numVisible++] = i;
+      }
+   }
+
+   return numVisible;
+}
+
+///
+// esCullBoxes()
+//
+//    Write the indices of the boxes inside the frustum to visible
+//
+int ESUTIL_API esCullBoxes ( const GLfloat planes[6][4], const GLfloat *boxes, int count, GLuint *visible )
+{
+   int numVisible = 0;
+   int i = 0;
+
+#if defined(CULL_SSE) || defined(CULL_NEON)
+
+   for ( ; i + 4 <= count; i += 4 )
+   {
+      GLfloat x[4], y[4], z[4], extent[3][4];
+      int     lane;
+
+      for ( lane = 0; lane < 4; lane++ )
+      {
+         const GLfloat *b = boxes + ( i + lane ) * 6;
+
+         x[lane] = ( b[0] + b[3] ) * 0.5f;
+         y[lane] = ( b[1] + b[4] ) * 0.5f;
+         z[lane] = ( b[2] + b[5] ) * 0.5f;
+         extent[0][lane] = ( b[3] - b[0] ) * 0.5f;
+         extent[1][lane] = ( b[4] - b[1] ) * 0.5f;
+         extent[2][lane] = ( b[5] - b[2] ) * 0.5f;
+      }
+
+      numVisible = AppendVisible ( visible, numVisible, i, CullLanes ( planes, x, y, z, extent, NULL ) );
+   }
+
+#endif
+
+   for ( ; i < count; i++ )
+   {
+      if ( esBoxInFrustum ( planes, boxes + i * 6, boxes + i * 6 + 3 ) )
+      {
+         visible[numVisible++] = i;
+      }
+   }
+
+   return numVisible;
+}
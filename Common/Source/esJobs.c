@@ -0,0 +1,315 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// ESJobs.c
+//
+//    Fork-join job runner shared by the batch transforms, the particle
+//    system and the noise generator.  The worker threads are started the
+//    first time they are needed and then sleep between calls, so a caller
+//    can split every phase of its work across the CPUs without paying for
+//    a thread create and join each time.
+//
+
+///
+//  Includes
+//
+#include "esUtil.h"
+#include <stdlib.h>
+
+#if !defined(_WIN32) && !defined(__APPLE__)
+#include <pthread.h>
+#include <unistd.h>
+#define JOBS_THREADED
+#endif
+
+///
+// Types
+//
+typedef struct
+{
+   // Threads esNumJobs splits work across, 0 for one per CPU
+   int             numThreads;
+   GLboolean       threadsRead;
+
+#ifdef JOBS_THREADED
+   pthread_t       workers[ES_MAX_JOBS - 1];
+   int             numWorkers;
+   GLboolean       quit;
+
+   // Jobs of the esRunJobs call in progress
+   GLboolean       busy;
+   void ( *worker ) ( void * );
+   char           *jobs;
+   size_t          jobSize;
+   int             numJobs;
+   int             nextJob;
+   int             numDone;
+#endif
+} JobPool;
+
+static JobPool s_pool;
+
+#ifdef JOBS_THREADED
+static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
+// Signalled when jobs are posted or the workers should quit
+static pthread_cond_t  s_posted = PTHREAD_COND_INITIALIZER;
+// Signalled when the last posted job is done
+static pthread_cond_t  s_finished = PTHREAD_COND_INITIALIZER;
+#endif
+
+//////////////////////////////////////////////////////////////////
+//
+//  Private Functions
+//
+//
+
+///
+// NumThreads()
+//
+//    Threads to split work across, from esJobsSetThreads, ES_THREADS or
+//    the number of CPUs
+//
+static int NumThreads ( void )
+{
+   int numThreads = 1;
+
+#ifdef JOBS_THREADED
+   pthread_mutex_lock ( &s_mutex );
+#endif
+
+   if ( !s_pool.threadsRead )
+   {
+      const char *threads = getenv ( "ES_THREADS" );
+
+      s_pool.numThreads = threads != NULL ? atoi ( threads ) : 0;
+      s_pool.threadsRead = GL_TRUE;
+   }
+
+#ifdef JOBS_THREADED
+   numThreads = s_pool.numThreads > 0 ? s_pool.numThreads : ( int ) sysconf ( _SC_NPROCESSORS_ONLN );
+   pthread_mutex_unlock ( &s_mutex );
+#endif
+
+   return numThreads < 1 ? 1 : numThreads > ES_MAX_JOBS ? ES_MAX_JOBS : numThreads;
+}
+
+#ifdef JOBS_THREADED
+///
+// TakeJobs()
+//
+//    Run posted jobs until none are left to start, the caller holds the
+//    mutex
+//
+static void TakeJobs ( void )
+{
+   while ( s_pool.nextJob < s_pool.numJobs )
+   {
+      int job = s_pool.nextJob++;
+
+      pthread_mutex_unlock ( &s_mutex );
+      s_pool.worker ( s_pool.jobs + job * s_pool.jobSize );
+      pthread_mutex_lock ( &s_mutex );
+
+      if ( ++s_pool.numDone == s_pool.numJobs )
+      {
+         pthread_cond_signal ( &s_finished );
+      }
+   }
+}
+
+///
+// WorkerThread()
+//
+//    Sleep until jobs are posted and help run them
+//
+static void *WorkerThread ( void *arg )
+{
+   ( void ) arg;
+
+   pthread_mutex_lock ( &s_mutex );
+
+   while ( !s_pool.quit )
+   {
+      if ( s_pool.nextJob < s_pool.numJobs )
+      {
+         TakeJobs ();
+      }
+      else
+      {
+         pthread_cond_wait ( &s_posted, &s_mutex );
+      }
+   }
+
+   pthread_mutex_unlock ( &s_mutex );
+   return NULL;
+}
+#endif
+
+//////////////////////////////////////////////////////////////////
+//
+//  Public Functions
+//
+//
+
+///
+// esJobsSetThreads()
+//
+//    Override the number of threads work is split across
+//
+void ESUTIL_API esJobsSetThreads ( int numThreads )
+{
+#ifdef JOBS_THREADED
+   pthread_mutex_lock ( &s_mutex );
+#endif
+   s_pool.numThreads = numThreads;
+   s_pool.threadsRead = GL_TRUE;
+#ifdef JOBS_THREADED
+   pthread_mutex_unlock ( &s_mutex );
+#endif
+}
+
+///
+// esNumJobs()
+//
+//    Number of jobs to split count items across
+//
+int ESUTIL_API esNumJobs ( int count, int minPerJob )
+{
+   int numJobs = minPerJob > 0 ? count / minPerJob : count;
+   int numThreads = NumThreads ();
+
+   if ( numJobs > numThreads )
+   {
+      numJobs = numThreads;
+   }
+
+   return numJobs < 1 ? 1 : numJobs;
+}
+
+///
+// esJobRange()
+//
+//    Range of count items the given job of numJobs gets, starting on a
+//    multiple of 4
+//
+void ESUTIL_API esJobRange ( int count, int numJobs, int job, int *first, int *jobCount )
+{
+   int perJob = ( ( count + numJobs - 1 ) / numJobs + 3 ) & ~3;
+
+   *first = job * perJob < count ? job * perJob : count;
+   *jobCount = count - *first < perJob ? count - *first : perJob;
+}
+
+///
+// esRunJobs()
+//
+//    Run worker on each job and wait for all of them
+//
+void ESUTIL_API esRunJobs ( void ( *worker ) ( void * ), void *jobs, size_t jobSize, int numJobs )
+{
+   char *job = jobs;
+   int   i;
+
+#ifdef JOBS_THREADED
+
+   if ( numJobs > 1 )
+   {
+      pthread_mutex_lock ( &s_mutex );
+
+      // Calls from several threads at once, or from inside a job, run inline
+      if ( !s_pool.busy )
+      {
+         while ( s_pool.numWorkers < numJobs - 1 && s_pool.numWorkers < ES_MAX_JOBS - 1 &&
+                 pthread_create ( &s_pool.workers[s_pool.numWorkers], NULL, WorkerThread, NULL ) == 0 )
+         {
+            s_pool.numWorkers++;
+         }
+
+         s_pool.busy = GL_TRUE;
+         s_pool.worker = worker;
+         s_pool.jobs = job;
+         s_pool.jobSize = jobSize;
+         s_pool.numJobs = numJobs;
+         s_pool.nextJob = 0;
+         s_pool.numDone = 0;
+         pthread_cond_broadcast ( &s_posted );
+
+         // The calling thread runs jobs too, so the jobs finish even if no
+         // worker could be started
+         TakeJobs ();
+
+         while ( s_pool.numDone < s_pool.numJobs )
+         {
+            pthread_cond_wait ( &s_finished, &s_mutex );
+         }
+
+         s_pool.numJobs = 0;
+         s_pool.nextJob = 0;
+         s_pool.busy = GL_FALSE;
+         pthread_mutex_unlock ( &s_mutex );
+         return;
+      }
+
+      pthread_mutex_unlock ( &s_mutex );
+   }
+
+#endif
+
+   for ( i = 0; i < numJobs; i++ )
+   {
+      worker ( job + i * jobSize );
+   }
+}
+
+///
+// esJobsShutdown()
+//
+//    Stop the worker threads
+//
+void ESUTIL_API esJobsShutdown ( void )
+{
+#ifdef JOBS_THREADED
+   int i;
+
+   pthread_mutex_lock ( &s_mutex );
+   s_pool.quit = GL_TRUE;
+   pthread_cond_broadcast ( &s_posted );
+   pthread_mutex_unlock ( &s_mutex );
+
+   for ( i = 0; i < s_pool.numWorkers; i++ )
+   {
+      pthread_join ( s_pool.workers[i], NULL );
+   }
+
+   s_pool.numWorkers = 0;
+   s_pool.quit = GL_FALSE;
+#endif
+}
@@ -0,0 +1,574 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// ESMeshOptimizer.c
+//
+//    Reorders indexed triangle lists for the GPU.  Triangles are sorted for
+//    post-transform vertex cache hits with Forsyth's linear-speed algorithm,
+//    then grouped into clusters that are drawn outside in to cut overdraw,
+//    as in Tipsify, and finally vertices are renumbered in the order they
+//    are first used so attribute fetches walk memory sequentially.
+//
+
+///
+//  Includes
+//
+#include "esUtil.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+///
+// Defines
+//
+
+// Size of the LRU cache modelled by the triangle ordering
+#define CACHE_SIZE              32
+
+// Forsyth's scoring parameters
+#define CACHE_DECAY_POWER       1.5f
+#define LAST_TRIANGLE_SCORE     0.75f
+#define VALENCE_BOOST_SCALE     2.0f
+#define VALENCE_BOOST_POWER     0.5f
+#define MAX_VALENCE_SCORE       32
+
+// FIFO cache size used to report ACMR and to find overdraw clusters, a
+// common size for post-transform caches
+#define FIFO_CACHE_SIZE         16
+
+///
+// Types
+//
+typedef struct
+{
+   int   first;
+   int   numTriangles;
+   float sortKey;
+} Cluster;
+
+//////////////////////////////////////////////////////////////////
+//
+//  Private Functions
+//
+//
+
+///
+// VertexScore()
+//
+//    Forsyth's score for a vertex at a position in the LRU cache, -1 when
+//    not cached, with numTriangles triangles left to draw
+//
+static float VertexScore ( int cachePosition, int numTriangles )
+{
+   float score = 0.0f;
+
+   if ( numTriangles == 0 )
+   {
+      return -1.0f;
+   }
+
+   if ( cachePosition >= 0 )
+   {
+      if ( cachePosition < 3 )
+      {
+         // The last triangle's vertices get a fixed score so the next
+         // triangle does not just reuse its edge
+         score = LAST_TRIANGLE_SCORE;
+      }
+      else
+      {
+         score = 1.0f - ( float ) ( cachePosition - 3 ) / ( float ) ( CACHE_SIZE - 3 );
+         score = powf ( score, CACHE_DECAY_POWER );
+      }
+   }
+
+   // Prefer vertices with few triangles left so they are finished off
+   score += VALENCE_BOOST_SCALE * powf ( ( float ) numTriangles, -VALENCE_BOOST_POWER );
+   return score;
+}
+
+///
+// SortClusters()
+//
+//    qsort callback, largest key first, ties keep their order
+//
+static int SortClusters ( const void *a, const void *b )
+{
+   const Cluster *clusterA = ( const Cluster * ) a;
+   const Cluster *clusterB = ( const Cluster * ) b;
+
+   if ( clusterA->sortKey != clusterB->sortKey )
+   {
+      return clusterA->sortKey > clusterB->sortKey ? -1 : 1;
+   }
+
+   return clusterA->first - clusterB->first;
+}
+
+///
+// OptimizeOverdraw()
+//
+//    Split the triangles where the vertex cache starts over, since moving
+//    those runs costs almost no cache hits, and draw the runs that face
+//    away from the center of the mesh first so they occlude the others
+//
+static void OptimizeOverdraw ( GLuint *indices, int numIndices, int numVertices, const GLfloat *vertices )
+{
+   int      numTriangles = numIndices / 3;
+   int      *cacheTime = malloc ( sizeof ( int ) * numVertices );
+   Cluster  *clusters = malloc ( sizeof ( Cluster ) * numTriangles );
+   GLuint   *sorted = malloc ( sizeof ( GLuint ) * numIndices );
+   float    center[3] = { 0.0f, 0.0f, 0.0f };
+   int      numClusters = 0;
+   int      misses = 0;
+   int      i, j, t;
+
+   if ( cacheTime == NULL || clusters == NULL || sorted == NULL )
+   {
+      free ( cacheTime );
+      free ( clusters );
+      free ( sorted );
+      return;
+   }
+
+   for ( i = 0; i < numVertices; i++ )
+   {
+      cacheTime[i] = -FIFO_CACHE_SIZE - 1;
+   }
+
+   for ( t = 0; t < numTriangles; t++ )
+   {
+      int triangleMisses = 0;
+
+      for ( j = 0; j < 3; j++ )
+      {
+         GLuint v = indices[t * 3 + j];
+
+         if ( misses - cacheTime[v] > FIFO_CACHE_SIZE )
+         {
+            cacheTime[v] = misses++;
+            triangleMisses++;
+         }
+      }
+
+      if ( t == 0 || triangleMisses == 3 )
+      {
+         clusters[numClusters].first = t;
+         clusters[numClusters].numTriangles = 0;
+         numClusters++;
+      }
+
+      clusters[numClusters - 1].numTriangles++;
+   }
+
+   for ( i = 0; i < numIndices; i++ )
+   {
+      for ( j = 0; j < 3; j++ )
+      {
+         center[j] += vertices[indices[i] * 3 + j];
+      }
+   }
+
+   for ( j = 0; j < 3; j++ )
+   {
+      center[j] /= ( float ) numIndices;
+   }
+
+   // Key each cluster by how far its centroid lies along its area weighted normal
+   for ( i = 0; i < numClusters; i++ )
+   {
+      float centroid[3] = { 0.0f, 0.0f, 0.0f };
+      float normal[3] = { 0.0f, 0.0f, 0.0f };
+      float length;
+
+      for ( t = clusters[i].first; t < clusters[i].first + clusters[i].numTriangles; t++ )
+      {
+         const GLfloat *p0 = vertices + indices[t * 3 + 0] * 3;
+         const GLfloat *p1 = vertices + indices[t * 3 + 1] * 3;
+         const GLfloat *p2 = vertices + indices[t * 3 + 2] * 3;
+         float e0[3], e1[3];
+
+         for ( j = 0; j < 3; j++ )
+         {
+            centroid[j] += p0[j] + p1[j] + p2[j];
+            e0[j] = p1[j] - p0[j];
+            e1[j] = p2[j] - p0[j];
+         }
+
+         normal[0] += e0[1] * e1[2] - e0[2] * e1[1];
+         normal[1] += e0[2] * e1[0] - e0[0] * e1[2];
+         normal[2] += e0[0] * e1[1] - e0[1] * e1[0];
+      }
+
+      length = sqrtf ( normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2] );
+      clusters[i].sortKey = 0.0f;
+
+      if ( length > 0.0f )
+      {
+         for ( j = 0; j < 3; j++ )
+         {
+            centroid[j] = centroid[j] / ( 3.0f * clusters[i].numTriangles ) - center[j];
+            clusters[i].sortKey += centroid[j] * normal[j] / length;
+         }
+      }
+   }
+
+   qsort ( clusters, numClusters, sizeof ( Cluster ), SortClusters );
+
+   for ( i = 0, t = 0; i < numClusters; i++ )
+   {
+      memcpy ( sorted + t * 3, indices + clusters[i].first * 3, sizeof ( GLuint ) * 3 * clusters[i].numTriangles );
+      t += clusters[i].numTriangles;
+   }
+
+   memcpy ( indices, sorted, sizeof ( GLuint ) * numIndices );
+
+   free ( cacheTime );
+   free ( clusters );
+   free ( sorted );
+}
+
+///
+// RemapAttrib()
+//
+//    Move each vertex of an attribute array to its new index, copy has
+//    room for the whole array
+//
+static void RemapAttrib ( GLfloat *attrib, int numComponents, int numVertices, const GLuint *remap, GLfloat *copy )
+{
+   int i;
+
+   if ( attrib == NULL )
+   {
+      return;
+   }
+
+   memcpy ( copy, attrib, sizeof ( GLfloat ) * numComponents * numVertices );
+
+   for ( i = 0; i < numVertices; i++ )
+   {
+      memcpy ( attrib + remap[i] * numComponents, copy + i * numComponents, sizeof ( GLfloat ) * numComponents );
+   }
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//  Public Functions
+//
+//
+
+///
+// esComputeACMR()
+//
+//    Average vertices transformed per triangle with a FIFO cache
+//
+float ESUTIL_API esComputeACMR ( const GLuint *indices, int numIndices, int numVertices, int cacheSize )
+{
+   int *cacheTime;
+   int misses = 0;
+   int i;
+
+   if ( numIndices < 3 )
+   {
+      return 0.0f;
+   }
+
+   cacheTime = malloc ( sizeof ( int ) * numVertices );
+
+   if ( cacheTime == NULL )
+   {
+      return 0.0f;
+   }
+
+   for ( i = 0; i < numVertices; i++ )
+   {
+      cacheTime[i] = -cacheSize - 1;
+   }
+
+   // A vertex is cached while fewer than cacheSize misses followed its own
+   for ( i = 0; i < numIndices; i++ )
+   {
+      if ( misses - cacheTime[indices[i]] > cacheSize )
+      {
+         cacheTime[indices[i]] = misses++;
+      }
+   }
+
+   free ( cacheTime );
+   return ( float ) misses / ( float ) ( numIndices / 3 );
+}
+
+///
+// esOptimizeTriangleOrder()
+//
+//    Forsyth's greedy ordering: always draw the triangle with the best sum
+//    of vertex scores, only rescoring the triangles touching the cache
+//
+void ESUTIL_API esOptimizeTriangleOrder ( GLuint *indices, int numIndices, int numVertices )
+{
+   int       numTriangles = numIndices / 3;
+   int       *valence = calloc ( numVertices, sizeof ( int ) );
+   int       *adjacencyStart = malloc ( sizeof ( int ) * ( numVertices + 1 ) );
+   int       *adjacency = malloc ( sizeof ( int ) * numIndices );
+   int       *cachePosition = malloc ( sizeof ( int ) * numVertices );
+   float     *vertexScore = malloc ( sizeof ( float ) * numVertices );
+   float     *triangleScore = malloc ( sizeof ( float ) * numTriangles );
+   GLboolean *drawn = calloc ( numTriangles, sizeof ( GLboolean ) );
+   GLuint    *output = malloc ( sizeof ( GLuint ) * numIndices );
+   int       cache[CACHE_SIZE + 3];
+   int       cacheCount = 0;
+   int       nextUndrawn = 0;
+   int       best = -1;
+   int       i, j, k, t;
+
+   if ( valence == NULL || adjacencyStart == NULL || adjacency == NULL || cachePosition == NULL ||
+         vertexScore == NULL || triangleScore == NULL || drawn == NULL || output == NULL )
+   {
+      goto done;
+   }
+
+   // Triangles using each vertex
+   for ( i = 0; i < numTriangles * 3; i++ )
+   {
+      valence[indices[i]]++;
+   }
+
+   adjacencyStart[0] = 0;
+
+   for ( i = 0; i < numVertices; i++ )
+   {
+      adjacencyStart[i + 1] = adjacencyStart[i] + valence[i];
+      valence[i] = 0;
+   }
+
+   for ( i = 0; i < numTriangles * 3; i++ )
+   {
+      GLuint v = indices[i];
+      adjacency[adjacencyStart[v] + valence[v]++] = i / 3;
+   }
+
+   for ( i = 0; i < numVertices; i++ )
+   {
+      cachePosition[i] = -1;
+      vertexScore[i] = VertexScore ( -1, valence[i] );
+   }
+
+   for ( t = 0; t < numTriangles; t++ )
+   {
+      triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+
+      if ( best < 0 || triangleScore[t] > triangleScore[best] )
+      {
+         best = t;
+      }
+   }
+
+   for ( i = 0; i < numTriangles; i++ )
+   {
+      int newCache[CACHE_SIZE + 3];
+      int newCount = 0;
+      float bestScore = -1.0f;
+
+      // Nothing in the cache can be continued, start from the first
+      // triangle left in input order
+      if ( best < 0 )
+      {
+         while ( drawn[nextUndrawn] )
+         {
+            nextUndrawn++;
+         }
+
+         best = nextUndrawn;
+      }
+
+      drawn[best] = GL_TRUE;
+      memcpy ( output + i * 3, indices + best * 3, sizeof ( GLuint ) * 3 );
+
+      // Remove the triangle from its vertices' lists and put them at the
+      // front of the cache
+      for ( j = 0; j < 3; j++ )
+      {
+         GLuint v = indices[best * 3 + j];
+         int    *list = adjacency + adjacencyStart[v];
+
+         for ( k = 0; k < valence[v]; k++ )
+         {
+            if ( list[k] == best )
+            {
+               list[k] = list[--valence[v]];
+               break;
+            }
+         }
+
+         newCache[newCount++] = v;
+      }
+
+      for ( j = 0; j < cacheCount; j++ )
+      {
+         int v = cache[j];
+
+         if ( v != ( int ) newCache[0] && v != ( int ) newCache[1] && v != ( int ) newCache[2] )
+         {
+            newCache[newCount++] = v;
+         }
+      }
+
+      // Rescore every vertex that was or is now in the cache, and the
+      // triangles left around them
+      best = -1;
+
+      for ( j = 0; j < newCount; j++ )
+      {
+         int   v = newCache[j];
+         int   position = j < CACHE_SIZE ? j : -1;
+         float score = VertexScore ( position, valence[v] );
+         float delta = score - vertexScore[v];
+         int   *list = adjacency + adjacencyStart[v];
+
+         cachePosition[v] = position;
+         vertexScore[v] = score;
+
+         for ( k = 0; k < valence[v]; k++ )
+         {
+            t = list[k];
+            triangleScore[t] += delta;
+
+            if ( triangleScore[t] > bestScore )
+            {
+               bestScore = triangleScore[t];
+               best = t;
+            }
+         }
+      }
+
+      cacheCount = newCount < CACHE_SIZE ? newCount : CACHE_SIZE;
+      memcpy ( cache, newCache, sizeof ( int ) * cacheCount );
+   }
+
+   memcpy ( indices, output, sizeof ( GLuint ) * numTriangles * 3 );
+
+done:
+   free ( valence );
+   free ( adjacencyStart );
+   free ( adjacency );
+   free ( cachePosition );
+   free ( vertexScore );
+   free ( triangleScore );
+   free ( drawn );
+   free ( output );
+}
+
+///
+// esOptimizeVertexOrder()
+//
+//    Renumber the vertices in the order the indices first use them
+//
+void ESUTIL_API esOptimizeVertexOrder ( GLuint *indices, int numIndices, int numVertices,
+                                        GLfloat *vertices, GLfloat *normals, GLfloat *texCoords )
+{
+   GLboolean hasAttribs = vertices != NULL || normals != NULL || texCoords != NULL;
+   GLuint    *remap = malloc ( sizeof ( GLuint ) * numVertices );
+   GLfloat   *copy = hasAttribs ? malloc ( sizeof ( GLfloat ) * 3 * numVertices ) : NULL;
+   GLuint    next = 0;
+   int       i;
+
+   // The indices must not be renumbered unless the attributes can be
+   // reordered to match, so allocate everything up front
+   if ( remap == NULL || ( hasAttribs && copy == NULL ) )
+   {
+      free ( remap );
+      free ( copy );
+      return;
+   }
+
+   for ( i = 0; i < numVertices; i++ )
+   {
+      remap[i] = ( GLuint ) -1;
+   }
+
+   for ( i = 0; i < numIndices; i++ )
+   {
+      if ( remap[indices[i]] == ( GLuint ) -1 )
+      {
+         remap[indices[i]] = next++;
+      }
+   }
+
+   // Unused vertices go at the end
+   for ( i = 0; i < numVertices; i++ )
+   {
+      if ( remap[i] == ( GLuint ) -1 )
+      {
+         remap[i] = next++;
+      }
+   }
+
+   for ( i = 0; i < numIndices; i++ )
+   {
+      indices[i] = remap[indices[i]];
+   }
+
+   RemapAttrib ( vertices, 3, numVertices, remap, copy );
+   RemapAttrib ( normals, 3, numVertices, remap, copy );
+   RemapAttrib ( texCoords, 2, numVertices, remap, copy );
+
+   free ( remap );
+   free ( copy );
+}
+
+///
+// esOptimizeMesh()
+//
+//    Run the whole pipeline on the output of the esGen functions
+//
+void ESUTIL_API esOptimizeMesh ( GLuint *indices, int numIndices, int numVertices,
+                                 GLfloat *vertices, GLfloat *normals, GLfloat *texCoords,
+                                 float *acmrBefore, float *acmrAfter )
+{
+   if ( acmrBefore != NULL )
+   {
+      *acmrBefore = esComputeACMR ( indices, numIndices, numVertices, FIFO_CACHE_SIZE );
+   }
+
+   esOptimizeTriangleOrder ( indices, numIndices, numVertices );
+
+   if ( vertices != NULL )
+   {
+      OptimizeOverdraw ( indices, numIndices, numVertices, vertices );
+   }
+
+   esOptimizeVertexOrder ( indices, numIndices, numVertices, vertices, normals, texCoords );
+
+   if ( acmrAfter != NULL )
+   {
+      *acmrAfter = esComputeACMR ( indices, numIndices, numVertices, FIFO_CACHE_SIZE );
+   }
+}
@@ -0,0 +1,563 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// ESNoise.c
+//
+//    3D gradient noise texture generation.  Along a row of the texture the
+//    y and z interpolation weights are constant, so within each lattice
+//    cell the noise reduces to a blend of two lines in x.  The rows are
+//    evaluated eight texels at a time with AVX where the CPU has it, else
+//    four with SSE or NEON, from those per cell coefficients.  The slices
+//    are split across the shared job runner.  The first pass writes 16-bit
+//    values quantized against the largest value gradient noise can take,
+//    the second quantizes them to bytes over the range actually reached so
+//    the texture uses all 256 levels.
+//
+
+///
+//  Includes
+//
+#include "esUtil.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define NOISE_NEON
+#include <arm_neon.h>
+#elif defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+#define NOISE_SSE
+#include <emmintrin.h>
+#if defined(__AVX__) || defined(__GNUC__)
+#define NOISE_AVX
+#include <immintrin.h>
+#endif
+#endif
+
+///
+// Defines
+//
+#define NOISE_TABLE_MASK   255
+#define NOISE_MIN(a, b)    ( ( a ) < ( b ) ? ( a ) : ( b ) )
+#define NOISE_MAX(a, b)    ( ( a ) > ( b ) ? ( a ) : ( b ) )
+
+// Largest magnitude of 3D gradient noise with unit gradients, sqrt(3) / 2
+#define NOISE_BOUND        0.8660254f
+
+// First pass quantization, NOISE_BOUND to 32767.  The bias keeps the
+// scaled values positive so truncation rounds them to nearest on every
+// path, and is taken off again in integers.
+#define LEVEL_SCALE        ( 32767.0f / NOISE_BOUND )
+#define LEVEL_BIAS         32768
+
+// Each job generates at least this many texels
+#define JOB_MIN_TEXELS     65536
+
+///
+// Types
+//
+typedef struct
+{
+   // Lattice gradients, x, y and z per entry
+   GLfloat  gradients[256 * 3];
+
+   // Texture size and, per coordinate along any axis, its lattice cell,
+   // offset into the cell and smoothstep weight
+   int      size;
+   int     *cell;
+   GLfloat *offset;
+   GLfloat *weight;
+
+   // Runs of x coordinates in the same cell, numSpans + 1 starts
+   int     *spanStart;
+   int      numSpans;
+
+   // First pass values and texel bytes, size^3 with x fastest
+   GLshort *levels;
+   GLubyte *texels;
+
+   // Whether the CPU runs the AVX kernel
+   GLboolean avx;
+} NoiseVolume;
+
+// One thread's slices
+typedef struct
+{
+   const NoiseVolume *volume;
+   int                firstSlice;
+   int                numSlices;
+
+   // Range of the noise values of the slices
+   GLfloat            minValue;
+   GLfloat            maxValue;
+
+   // Level of the smallest value of all slices and the scale from levels
+   // above it to bytes
+   int                minLevel;
+   GLfloat            byteScale;
+} NoiseJob;
+
+// permTable describes a random permutation of 8-bit values from 0 to 255.
+static const unsigned char s_permTable[256] =
+{
+   0xE1, 0x9B, 0xD2, 0x6C, 0xAF, 0xC7, 0xDD, 0x90, 0xCB, 0x74, 0x46, 0xD5, 0x45, 0x9E, 0x21, 0xFC,
+   0x05, 0x52, 0xAD, 0x85, 0xDE, 0x8B, 0xAE, 0x1B, 0x09, 0x47, 0x5A, 0xF6, 0x4B, 0x82, 0x5B, 0xBF,
+   0xA9, 0x8A, 0x02, 0x97, 0xC2, 0xEB, 0x51, 0x07, 0x19, 0x71, 0xE4, 0x9F, 0xCD, 0xFD, 0x86, 0x8E,
+   0xF8, 0x41, 0xE0, 0xD9, 0x16, 0x79, 0xE5, 0x3F, 0x59, 0x67, 0x60, 0x68, 0x9C, 0x11, 0xC9, 0x81,
+   0x24, 0x08, 0xA5, 0x6E, 0xED, 0x75, 0xE7, 0x38, 0x84, 0xD3, 0x98, 0x14, 0xB5, 0x6F, 0xEF, 0xDA,
+   0xAA, 0xA3, 0x33, 0xAC, 0x9D, 0x2F, 0x50, 0xD4, 0xB0, 0xFA, 0x57, 0x31, 0x63, 0xF2, 0x88, 0xBD,
+   0xA2, 0x73, 0x2C, 0x2B, 0x7C, 0x5E, 0x96, 0x10, 0x8D, 0xF7, 0x20, 0x0A, 0xC6, 0xDF, 0xFF, 0x48,
+   0x35, 0x83, 0x54, 0x39, 0xDC, 0xC5, 0x3A, 0x32, 0xD0, 0x0B, 0xF1, 0x1C, 0x03, 0xC0, 0x3E, 0xCA,
+   0x12, 0xD7, 0x99, 0x18, 0x4C, 0x29, 0x0F, 0xB3, 0x27, 0x2E, 0x37, 0x06, 0x80, 0xA7, 0x17, 0xBC,
+   0x6A, 0x22, 0xBB, 0x8C, 0xA4, 0x49, 0x70, 0xB6, 0xF4, 0xC3, 0xE3, 0x0D, 0x23, 0x4D, 0xC4, 0xB9,
+   0x1A, 0xC8, 0xE2, 0x77, 0x1F, 0x7B, 0xA8, 0x7D, 0xF9, 0x44, 0xB7, 0xE6, 0xB1, 0x87, 0xA0, 0xB4,
+   0x0C, 0x01, 0xF3, 0x94, 0x66, 0xA6, 0x26, 0xEE, 0xFB, 0x25, 0xF0, 0x7E, 0x40, 0x4A, 0xA1, 0x28,
+   0xB8, 0x95, 0xAB, 0xB2, 0x65, 0x42, 0x1D, 0x3B, 0x92, 0x3D, 0xFE, 0x6B, 0x2A, 0x56, 0x9A, 0x04,
+   0xEC, 0xE8, 0x78, 0x15, 0xE9, 0xD1, 0x2D, 0x62, 0xC1, 0x72, 0x4E, 0x13, 0xCE, 0x0E, 0x76, 0x7F,
+   0x30, 0x4F, 0x93, 0x55, 0x1E, 0xCF, 0xDB, 0x36, 0x58, 0xEA, 0xBE, 0x7A, 0x5F, 0x43, 0x8F, 0x6D,
+   0x89, 0xD6, 0x91, 0x5D, 0x5C, 0x64, 0xF5, 0x00, 0xD8, 0xBA, 0x3C, 0x53, 0x69, 0x61, 0xCC, 0x34,
+};
+
+//////////////////////////////////////////////////////////////////
+//
+//  Private Functions
+//
+//
+
+///
+// InitGradients()
+//
+//    Random unit gradients, stored in the order of the permutation table
+//
+static void InitGradients ( NoiseVolume *volume, unsigned int seed )
+{
+   GLfloat  gradients[256 * 3];
+   ESRandom rng;
+   int      i;
+
+   esRandomSeed ( &rng, seed, 0 );
+
+   for ( i = 0; i < 256; i++ )
+   {
+      GLfloat z = 1.0f - 2.0f * esRandomFloat ( &rng );
+      GLfloat r = sqrtf ( 1.0f - z * z );
+      GLfloat theta = 2.0f * 3.14159265f * esRandomFloat ( &rng );
+
+      gradients[i * 3] = r * cosf ( theta );
+      gradients[i * 3 + 1] = r * sinf ( theta );
+      gradients[i * 3 + 2] = z;
+   }
+
+   for ( i = 0; i < 256; i++ )
+   {
+      memcpy ( &volume->gradients[i * 3], &gradients[s_permTable[i] * 3], 3 * sizeof ( GLfloat ) );
+   }
+}
+
+///
+// Quantize()
+//
+//    Noise value to a 16-bit level, as the SIMD kernels do
+//
+static GLshort Quantize ( GLfloat value )
+{
+   return ( GLshort ) ( ( int ) ( value * LEVEL_SCALE + ( LEVEL_BIAS + 0.5f ) ) - LEVEL_BIAS );
+}
+
+#ifdef NOISE_AVX
+///
+// GenerateSpan_AVX()
+//
+//    AVX kernel for GenerateRow, eight texels of a cell per step from the
+//    cell's coefficients a0, a1, b0 and b1.  Returns the first x it did
+//    not generate.
+//
+#ifndef __AVX__
+__attribute__ ( ( target ( "avx" ) ) )
+#endif
+static int GenerateSpan_AVX ( const NoiseVolume *volume, int x, int last, const GLfloat coef[4],
+                              GLshort *dst, GLfloat *minValue, GLfloat *maxValue )
+{
+   __m256 va0 = _mm256_set1_ps ( coef[0] ), va1 = _mm256_set1_ps ( coef[1] );
+   __m256 vb0 = _mm256_set1_ps ( coef[2] ), vb1 = _mm256_set1_ps ( coef[3] );
+   __m256 vmin = _mm256_set1_ps ( *minValue ), vmax = _mm256_set1_ps ( *maxValue );
+   __m256 scale = _mm256_set1_ps ( LEVEL_SCALE ), bias = _mm256_set1_ps ( LEVEL_BIAS + 0.5f );
+   __m256 one = _mm256_set1_ps ( 1.0f );
+   __m128i ibias = _mm_set1_epi32 ( LEVEL_BIAS );
+   GLfloat lanes[8];
+   int     i;
+
+   for ( ; x + 8 <= last; x += 8 )
+   {
+      __m256  fx = _mm256_loadu_ps ( volume->offset + x );
+      __m256  wx = _mm256_loadu_ps ( volume->weight + x );
+      __m256  a = _mm256_add_ps ( _mm256_mul_ps ( va1, fx ), va0 );
+      __m256  b = _mm256_add_ps ( _mm256_mul_ps ( vb1, _mm256_sub_ps ( fx, one ) ), vb0 );
+      __m256  value = _mm256_add_ps ( a, _mm256_mul_ps ( wx, _mm256_sub_ps ( b, a ) ) );
+      __m256i q = _mm256_cvttps_epi32 ( _mm256_add_ps ( _mm256_mul_ps ( value, scale ), bias ) );
+
+      vmin = _mm256_min_ps ( vmin, value );
+      vmax = _mm256_max_ps ( vmax, value );
+
+      // AVX has no 256-bit integer arithmetic, unbias and pack each half
+      _mm_storeu_si128 ( ( __m128i * ) ( dst + x ),
+                         _mm_packs_epi32 ( _mm_sub_epi32 ( _mm256_castsi256_si128 ( q ), ibias ),
+                                           _mm_sub_epi32 ( _mm256_extractf128_si256 ( q, 1 ), ibias ) ) );
+   }
+
+   _mm256_storeu_ps ( lanes, vmin );
+
+   for ( i = 0; i < 8; i++ )
+   {
+      *minValue = NOISE_MIN ( *minValue, lanes[i] );
+   }
+
+   _mm256_storeu_ps ( lanes, vmax );
+
+   for ( i = 0; i < 8; i++ )
+   {
+      *maxValue = NOISE_MAX ( *maxValue, lanes[i] );
+   }
+
+   return x;
+}
+#endif
+
+///
+// GenerateRow()
+//
+//    Noise of one row of the texture.  The per cell coefficients make the
+//    value in a cell A + wx * ( B - A ) with A and B linear in the x
+//    offset.
+//
+static void GenerateRow ( const NoiseVolume *volume, int y, int z, GLshort *dst, GLfloat *minValue, GLfloat *maxValue )
+{
+   const GLfloat *g = volume->gradients;
+   GLfloat minV = *minValue;
+   GLfloat maxV = *maxValue;
+   GLfloat wy = volume->weight[y];
+   GLfloat wz = volume->weight[z];
+   GLfloat cornerWeight[4];
+   GLfloat cornerY[4];
+   GLfloat cornerZ[4];
+   int     hash[4];
+   int     corner, span;
+
+   // Hash, weight and offsets of the four (y, z) lattice corners
+   for ( corner = 0; corner < 4; corner++ )
+   {
+      int dy = corner & 1;
+      int dz = corner >> 1;
+      int iz = volume->cell[z] + dz;
+
+      hash[corner] = s_permTable[( volume->cell[y] + dy + s_permTable[iz & NOISE_TABLE_MASK] ) & NOISE_TABLE_MASK];
+      cornerWeight[corner] = ( dy ? wy : 1.0f - wy ) * ( dz ? wz : 1.0f - wz );
+      cornerY[corner] = volume->offset[y] - dy;
+      cornerZ[corner] = volume->offset[z] - dz;
+   }
+
+   for ( span = 0; span < volume->numSpans; span++ )
+   {
+      int     first = volume->spanStart[span];
+      int     last = volume->spanStart[span + 1];
+      int     ix = volume->cell[first];
+      GLfloat a0 = 0.0f, a1 = 0.0f, b0 = 0.0f, b1 = 0.0f;
+      int     x = first;
+
+      for ( corner = 0; corner < 4; corner++ )
+      {
+         const GLfloat *g0 = &g[( ( ix + hash[corner] ) & NOISE_TABLE_MASK ) * 3];
+         const GLfloat *g1 = &g[( ( ix + 1 + hash[corner] ) & NOISE_TABLE_MASK ) * 3];
+         GLfloat w = cornerWeight[corner];
+
+         a1 += w * g0[0];
+         a0 += w * ( g0[1] * cornerY[corner] + g0[2] * cornerZ[corner] );
+         b1 += w * g1[0];
+         b0 += w * ( g1[1] * cornerY[corner] + g1[2] * cornerZ[corner] );
+      }
+
+#if defined(NOISE_SSE)
+#ifdef NOISE_AVX
+      if ( volume->avx && last - x >= 8 )
+      {
+         GLfloat coef[4] = { a0, a1, b0, b1 };
+
+         x = GenerateSpan_AVX ( volume, x, last, coef, dst, &minV, &maxV );
+      }
+
+#endif
+
+      if ( last - x >= 4 )
+      {
+         __m128 va0 = _mm_set1_ps ( a0 ), va1 = _mm_set1_ps ( a1 );
+         __m128 vb0 = _mm_set1_ps ( b0 ), vb1 = _mm_set1_ps ( b1 );
+         __m128 vmin = _mm_set1_ps ( minV ), vmax = _mm_set1_ps ( maxV );
+         __m128 scale = _mm_set1_ps ( LEVEL_SCALE ), bias = _mm_set1_ps ( LEVEL_BIAS + 0.5f );
+         __m128 one = _mm_set1_ps ( 1.0f );
+         __m128i ibias = _mm_set1_epi32 ( LEVEL_BIAS );
+         GLfloat lanes[4];
+
+         for ( ; x + 4 <= last; x += 4 )
+         {
+            __m128  fx = _mm_loadu_ps ( volume->offset + x );
+            __m128  wx = _mm_loadu_ps ( volume->weight + x );
+            __m128  a = _mm_add_ps ( _mm_mul_ps ( va1, fx ), va0 );
+            __m128  b = _mm_add_ps ( _mm_mul_ps ( vb1, _mm_sub_ps ( fx, one ) ), vb0 );
+            __m128  value = _mm_add_ps ( a, _mm_mul_ps ( wx, _mm_sub_ps ( b, a ) ) );
+            __m128i q = _mm_cvttps_epi32 ( _mm_add_ps ( _mm_mul_ps ( value, scale ), bias ) );
+
+            vmin = _mm_min_ps ( vmin, value );
+            vmax = _mm_max_ps ( vmax, value );
+
+            q = _mm_sub_epi32 ( q, ibias );
+            _mm_storel_epi64 ( ( __m128i * ) ( dst + x ), _mm_packs_epi32 ( q, q ) );
+         }
+
+         _mm_storeu_ps ( lanes, vmin );
+         minV = NOISE_MIN ( NOISE_MIN ( lanes[0], lanes[1] ), NOISE_MIN ( lanes[2], lanes[3] ) );
+         _mm_storeu_ps ( lanes, vmax );
+         maxV = NOISE_MAX ( NOISE_MAX ( lanes[0], lanes[1] ), NOISE_MAX ( lanes[2], lanes[3] ) );
+      }
+#elif defined(NOISE_NEON)
+      if ( last - x >= 4 )
+      {
+         float32x4_t va0 = vdupq_n_f32 ( a0 ), va1 = vdupq_n_f32 ( a1 );
+         float32x4_t vb0 = vdupq_n_f32 ( b0 ), vb1 = vdupq_n_f32 ( b1 );
+         float32x4_t vmin = vdupq_n_f32 ( minV ), vmax = vdupq_n_f32 ( maxV );
+         float32x4_t scale = vdupq_n_f32 ( LEVEL_SCALE ), bias = vdupq_n_f32 ( LEVEL_BIAS + 0.5f );
+         float32x4_t one = vdupq_n_f32 ( 1.0f );
+         int32x4_t   ibias = vdupq_n_s32 ( LEVEL_BIAS );
+         GLfloat     lanes[4];
+
+         for ( ; x + 4 <= last; x += 4 )
+         {
+            float32x4_t fx = vld1q_f32 ( volume->offset + x );
+            float32x4_t wx = vld1q_f32 ( volume->weight + x );
+            float32x4_t a = vaddq_f32 ( vmulq_f32 ( va1, fx ), va0 );
+            float32x4_t b = vaddq_f32 ( vmulq_f32 ( vb1, vsubq_f32 ( fx, one ) ), vb0 );
+            float32x4_t value = vaddq_f32 ( a, vmulq_f32 ( wx, vsubq_f32 ( b, a ) ) );
+            int32x4_t   q = vcvtq_s32_f32 ( vaddq_f32 ( vmulq_f32 ( value, scale ), bias ) );
+
+            vmin = vminq_f32 ( vmin, value );
+            vmax = vmaxq_f32 ( vmax, value );
+
+            vst1_s16 ( dst + x, vqmovn_s32 ( vsubq_s32 ( q, ibias ) ) );
+         }
+
+         vst1q_f32 ( lanes, vmin );
+         minV = NOISE_MIN ( NOISE_MIN ( lanes[0], lanes[1] ), NOISE_MIN ( lanes[2], lanes[3] ) );
+         vst1q_f32 ( lanes, vmax );
+         maxV = NOISE_MAX ( NOISE_MAX ( lanes[0], lanes[1] ), NOISE_MAX ( lanes[2], lanes[3] ) );
+      }
+#endif
+
+      for ( ; x < last; x++ )
+      {
+         GLfloat fx = volume->offset[x];
+         GLfloat a = a1 * fx + a0;
+         GLfloat b = b1 * ( fx - 1.0f ) + b0;
+         GLfloat value = a + volume->weight[x] * ( b - a );
+
+         minV = NOISE_MIN ( minV, value );
+         maxV = NOISE_MAX ( maxV, value );
+         dst[x] = Quantize ( value );
+      }
+   }
+
+   *minValue = minV;
+   *maxValue = maxV;
+}
+
+///
+// GenerateWorker()
+//
+//    Generate the levels of the job's slices and track their range
+//
+static void GenerateWorker ( void *arg )
+{
+   NoiseJob          *job = arg;
+   const NoiseVolume *volume = job->volume;
+   int                size = volume->size;
+   int                y, z;
+
+   job->minValue = 1.0e30f;
+   job->maxValue = -1.0e30f;
+
+   for ( z = job->firstSlice; z < job->firstSlice + job->numSlices; z++ )
+   {
+      for ( y = 0; y < size; y++ )
+      {
+         GLshort *row = volume->levels + ( ( size_t ) z * size + y ) * size;
+
+         GenerateRow ( volume, y, z, row, &job->minValue, &job->maxValue );
+      }
+   }
+}
+
+///
+// QuantizeWorker()
+//
+//    Quantize the levels of the job's slices to bytes over the range of
+//    all slices
+//
+static void QuantizeWorker ( void *arg )
+{
+   NoiseJob          *job = arg;
+   const NoiseVolume *volume = job->volume;
+   size_t             sliceSize = ( size_t ) volume->size * volume->size;
+   const GLshort     *level = volume->levels + job->firstSlice * sliceSize;
+   GLubyte           *texel = volume->texels + job->firstSlice * sliceSize;
+   GLubyte           *end = texel + job->numSlices * sliceSize;
+
+   for ( ; texel < end; texel++, level++ )
+   {
+      *texel = ( GLubyte ) ( ( GLfloat ) ( *level - job->minLevel ) * job->byteScale + 0.5f );
+   }
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//  Public Functions
+//
+//
+
+//
+/// \brief Generate a 3D gradient noise texture normalized to [0, 255]
+/// \param size Width, height and depth of the texture in texels
+/// \param frequency Number of noise lattice cells along each axis
+/// \param seed Seed of the lattice gradients
+/// \param texels If not NULL, will contain the size^3 texels, x varying fastest
+/// \return size^3, or 0 if the texels cannot be allocated
+//
+int ESUTIL_API esGenNoise3D ( int size, GLfloat frequency, unsigned int seed, GLubyte **texels )
+{
+   NoiseVolume volume;
+   NoiseJob    jobs[ES_MAX_JOBS];
+   GLfloat     minValue = 1.0e30f;
+   GLfloat     maxValue = -1.0e30f;
+   int         minLevel, maxLevel;
+   size_t      numTexels = ( size_t ) size * size * size;
+   size_t      sliceSize = ( size_t ) size * size;
+   int         numJobs;
+   int         perJob;
+   int         i;
+
+   if ( texels == NULL || size <= 0 || frequency <= 0.0f )
+   {
+      return 0;
+   }
+
+   memset ( &volume, 0, sizeof ( NoiseVolume ) );
+   volume.size = size;
+   volume.levels = malloc ( numTexels * sizeof ( GLshort ) );
+   volume.texels = malloc ( numTexels );
+   volume.cell = malloc ( ( size_t ) ( 2 * size + 1 ) * sizeof ( int ) );
+   volume.offset = malloc ( ( size_t ) size * 2 * sizeof ( GLfloat ) );
+
+   if ( volume.levels == NULL || volume.texels == NULL || volume.cell == NULL || volume.offset == NULL )
+   {
+      free ( volume.levels );
+      free ( volume.texels );
+      free ( volume.cell );
+      free ( volume.offset );
+      return 0;
+   }
+
+   volume.spanStart = volume.cell + size;
+   volume.weight = volume.offset + size;
+
+   InitGradients ( &volume, seed );
+
+#ifdef NOISE_AVX
+#ifdef __AVX__
+   volume.avx = GL_TRUE;
+#else
+   volume.avx = __builtin_cpu_supports ( "avx" ) != 0;
+#endif
+#endif
+
+   // The lattice is the same along every axis
+   for ( i = 0; i < size; i++ )
+   {
+      GLfloat p = ( GLfloat ) i / ( GLfloat ) size * frequency;
+      GLfloat t;
+
+      volume.cell[i] = ( int ) p;
+      volume.offset[i] = t = p - volume.cell[i];
+      volume.weight[i] = t * t * t * ( t * ( t * 6.0f - 15.0f ) + 10.0f );
+
+      if ( i == 0 || volume.cell[i] != volume.cell[i - 1] )
+      {
+         volume.spanStart[volume.numSpans++] = i;
+      }
+   }
+
+   volume.spanStart[volume.numSpans] = size;
+
+   // Jobs take whole slices
+   numJobs = esNumJobs ( size, ( int ) ( ( JOB_MIN_TEXELS + sliceSize - 1 ) / sliceSize ) );
+   perJob = ( size + numJobs - 1 ) / numJobs;
+
+   for ( i = 0; i < numJobs; i++ )
+   {
+      jobs[i].volume = &volume;
+      jobs[i].firstSlice = i * perJob < size ? i * perJob : size;
+      jobs[i].numSlices = size - jobs[i].firstSlice < perJob ? size - jobs[i].firstSlice : perJob;
+   }
+
+   esRunJobs ( GenerateWorker, jobs, sizeof ( NoiseJob ), numJobs );
+
+   for ( i = 0; i < numJobs; i++ )
+   {
+      minValue = NOISE_MIN ( minValue, jobs[i].minValue );
+      maxValue = NOISE_MAX ( maxValue, jobs[i].maxValue );
+   }
+
+   // Normalize to the [0, 255] range, the extremes quantize to the
+   // smallest and largest level written
+   minLevel = Quantize ( minValue );
+   maxLevel = Quantize ( maxValue );
+
+   for ( i = 0; i < numJobs; i++ )
+   {
+      jobs[i].minLevel = minLevel;
+      jobs[i].byteScale = maxLevel > minLevel ? 255.0f / ( GLfloat ) ( maxLevel - minLevel ) : 0.0f;
+   }
+
+   esRunJobs ( QuantizeWorker, jobs, sizeof ( NoiseJob ), numJobs );
+
+   free ( volume.levels );
+   free ( volume.cell );
+   free ( volume.offset );
+
+   *texels = volume.texels;
+   return ( int ) numTexels;
+}
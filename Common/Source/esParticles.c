@@ -0,0 +1,2018 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// ESParticles.c
+//
+//    Particle system.  Each emitter owns a ring of slots in the particle
+//    store.  All particles of an emitter live equally long, so they die in
+//    emission order and the live ones are always one contiguous run of the
+//    ring: emission touches only the new slots and the update and draw only
+//    the live run.
+//
+//    The transform feedback backend writes new particles into a buffer with
+//    the emit shader and animates them in closed form in the draw shader.
+//    The CPU backend keeps the particles in arrays per component, integrates
+//    four at a time with SSE or NEON and streams the positions into one
+//    third of a vertex buffer per frame.
+//
+//    Alpha blended particles are drawn back to front.  The emitters are
+//    ordered by the depth of their positions and each emitter's particles
+//    are sorted: with a parallel radix sort of the streamed particles on the
+//    CPU backend, and in depth slices drawn far to near on the transform
+//    feedback backend, which keeps the particles on the GPU.  Particles can
+//    be drawn into a smaller offscreen target that is composited over the
+//    framebuffer, and faded where they meet the opaque scene.
+//
+//    The update and draw are bracketed by profiler scopes, which do nothing
+//    unless ES_PROFILE is set.  Without timer queries the scopes finish the
+//    GPU, so they must not be active in normal runs: the streamed vertex
+//    buffer relies on the GPU still working on earlier segments.
+//
+
+///
+//  Includes
+//
+#include "esUtil.h"
+#include <math.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PARTICLES_NEON
+#include <arm_neon.h>
+#elif defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+#define PARTICLES_SSE
+#include <emmintrin.h>
+#endif
+
+///
+// Defines
+//
+#define MAX_EMITTERS          16
+
+// Emission batches remembered per emitter.  When they run out the newest
+// batch is extended, which only delays retiring its particles.
+#define MAX_BATCHES           256
+
+#define ATTRIBUTE_POSITION_SIZE    0
+#define ATTRIBUTE_VELOCITY_BIRTH   1
+
+// Thirds of the CPU backend's stream buffer.  A third is only rewritten
+// once the fence of the frame that last drew from it has signalled.
+#define STREAM_SEGMENTS       3
+
+// Nanoseconds to wait per glClientWaitSync call for a segment to retire
+#define FENCE_WAIT_TIMEOUT    100000000
+
+// The CPU backend gives each job at least this many particles
+#define JOB_MIN_PARTICLES     16384
+
+// Depth slices the transform feedback backend draws alpha blended
+// emitters in, far to near
+#define SORT_SLICES           16
+
+// The CPU sort keys are the emitter's draw rank above a 16-bit depth,
+// sorted in two passes of RADIX_BITS bits
+#define DEPTH_BITS            16
+#define RADIX_BITS            10
+#define RADIX_BUCKETS         ( 1 << RADIX_BITS )
+
+// Soft particle fade scale used for hard intersections
+#define HARD_FADE_SCALE       1.0e6f
+
+///
+// Types
+//
+
+// Layout of one particle in the transform feedback buffer
+typedef struct
+{
+   GLfloat positionSize[4];
+   GLfloat velocityBirth[4];
+} Particle;
+
+// Particle store of the CPU backend, one array per component
+typedef struct
+{
+   GLfloat  *x, *y, *z;
+   GLfloat  *vx, *vy, *vz;
+   GLfloat  *size;
+   GLfloat  *birth;
+} ParticleArrays;
+
+typedef struct
+{
+   ESParticleEmitter params;
+
+   // Slots of the emitter in the particle store
+   int       first;
+   int       capacity;
+
+   // Ring slot the next particle is written to and number of live particles
+   // before it
+   int       head;
+   int       live;
+
+   // Fraction of a particle carried over to the next update
+   double    pending;
+
+   // Ring of emission batches, their particle counts and the birth time of
+   // their last particle
+   int       batchCount[MAX_BATCHES];
+   double    batchLastBirth[MAX_BATCHES];
+   int       firstBatch;
+   int       numBatches;
+
+   // Seed of the next batch
+   GLuint    seed;
+
+   // CPU backend: the particles streamed by the last update, as a range of
+   // the simulated particles, and where the draw finds them in the stream
+   // segment, which differs once they are sorted
+   int       streamFirst;
+   int       streamCount;
+   int       drawFirst;
+
+   // Position in the back to front order of the emitters
+   int       rank;
+} Emitter;
+
+struct ESParticleSystem
+{
+   int       backend;
+   int       capacity;
+   int       used;
+
+   Emitter   emitters[MAX_EMITTERS];
+   int       numEmitters;
+
+   // Emitter indices in draw order
+   int       drawOrder[MAX_EMITTERS];
+
+   ESParticleDrawOptions options;
+
+   double    time;
+
+   // Transform feedback backend: particle buffer and the vertex array for
+   // the emit pass, which reads no attributes
+   GLuint    buffer;
+   GLuint    emitVertexArray;
+
+   GLuint    emitProgram;
+   GLint     emitSeedLoc;
+   GLint     emitPositionLoc;
+   GLint     emitPositionSpreadLoc;
+   GLint     emitVelocityLoc;
+   GLint     emitVelocitySpreadLoc;
+   GLint     emitSizeLoc;
+   GLint     emitBirthLoc;
+
+   // CPU backend: particle store and the stream buffer, STREAM_SEGMENTS
+   // segments of streamSize positions each
+   ParticleArrays particles;
+   GLuint    streamBuffer;
+   int       streamSize;
+   int       streamTotal;
+   int       segment;
+   GLsync    fences[STREAM_SEGMENTS];
+
+   // CPU backend with alpha blending: the update simulates into the
+   // staging array and the draw sorts it into the stream buffer.  The sort
+   // keys and particle indices ping-pong between two arrays each.
+   GLfloat  *sortMemory;
+   GLfloat  *staging;
+   GLfloat  *depths;
+   GLuint   *keys[2];
+   GLuint   *indices[2];
+   GLboolean staged;
+
+   // Vertex array and program of the draw pass
+   GLuint    drawVertexArray;
+   GLuint    drawProgram;
+   GLint     drawMvpLoc;
+   GLint     drawTimeLoc;
+   GLint     drawLifetimeLoc;
+   GLint     drawAccelerationLoc;
+   GLint     drawColorLoc;
+   GLint     drawSamplerLoc;
+   GLint     drawPointScaleLoc;
+   GLint     drawDepthRangeLoc;
+   GLint     drawDepthSamplerLoc;
+   GLint     drawDepthParamsLoc;
+   GLint     drawDepthCoordLoc;
+   GLint     drawSoftScaleLoc;
+
+   // Reduced resolution target and the program compositing it over the
+   // framebuffer
+   GLuint    offscreenFramebuffer;
+   GLuint    offscreenTexture;
+   int       offscreenWidth;
+   int       offscreenHeight;
+   GLuint    compositeVertexArray;
+   GLuint    compositeProgram;
+   GLint     compositeSamplerLoc;
+   GLint     compositeScaleLoc;
+
+   // Statistics for esParticleSystemDestroy
+   double    totalLive;
+   double    totalEmitted;
+   int       numFrames;
+};
+
+// One job's share of the CPU update, a range of the streamed particles
+typedef struct
+{
+   ESParticleSystem *system;
+   GLfloat          *dst;
+   float             deltaTime;
+   int               first;
+   int               count;
+} SimulateJob;
+
+// One job's share of the CPU sort, a range of the streamed particles in
+// each phase
+typedef struct
+{
+   ESParticleSystem *system;
+   const ESMatrix   *mvpMatrix;
+   int               first;
+   int               count;
+
+   // Depth range of the range, then of all particles and the scale to 16 bits
+   GLfloat           minDepth;
+   GLfloat           maxDepth;
+   GLfloat           depthScale;
+
+   // Radix pass: digit counts of the range, turned into the slots its
+   // particles are scattered to
+   const GLuint     *srcKeys;
+   const GLuint     *srcIndices;
+   GLuint           *dstKeys;
+   GLuint           *dstIndices;
+   int               shift;
+   GLuint            offsets[RADIX_BUCKETS];
+
+   // Mapped stream segment the sorted particles are gathered into
+   GLfloat          *dst;
+} SortJob;
+
+static const char s_emitVertexShader[] =
+   "#version 300 es                                                        \n"
+   "uniform uint u_seed;                                                   \n"
+   "uniform vec3 u_position;                                               \n"
+   "uniform vec3 u_positionSpread;                                         \n"
+   "uniform vec3 u_velocity;                                               \n"
+   "uniform vec3 u_velocitySpread;                                         \n"
+   "uniform vec2 u_size;                                                   \n"
+   "uniform vec2 u_birth;                                                  \n"
+   "                                                                       \n"
+   "out vec4 v_positionSize;                                               \n"
+   "out vec4 v_velocityBirth;                                              \n"
+   "                                                                       \n"
+   "uint hash( uint x )                                                    \n"
+   "{                                                                      \n"
+   "   x ^= x >> 16u;                                                      \n"
+   "   x *= 0x7feb352du;                                                   \n"
+   "   x ^= x >> 15u;                                                      \n"
+   "   x *= 0x846ca68bu;                                                   \n"
+   "   x ^= x >> 16u;                                                      \n"
+   "   return x;                                                           \n"
+   "}                                                                      \n"
+   "                                                                       \n"
+   "// Uniform random value in [-1, 1]                                     \n"
+   "float randomValue( inout uint state )                                  \n"
+   "{                                                                      \n"
+   "   state = hash( state );                                              \n"
+   "   return float( state >> 8u ) * ( 2.0 / 16777215.0 ) - 1.0;           \n"
+   "}                                                                      \n"
+   "                                                                       \n"
+   "vec3 randomVector( inout uint state )                                  \n"
+   "{                                                                      \n"
+   "   float x = randomValue( state );                                     \n"
+   "   float y = randomValue( state );                                     \n"
+   "   return vec3( x, y, randomValue( state ) );                          \n"
+   "}                                                                      \n"
+   "                                                                       \n"
+   "void main()                                                            \n"
+   "{                                                                      \n"
+   "   uint state = hash( u_seed ^ hash( uint( gl_VertexID ) ) );          \n"
+   "   vec3 position = u_position + randomVector( state ) * u_positionSpread;\n"
+   "   vec3 velocity = u_velocity + randomVector( state ) * u_velocitySpread;\n"
+   "   float size = mix( u_size.x, u_size.y, randomValue( state ) * 0.5 + 0.5 );\n"
+   "   float birth = u_birth.x + float( gl_VertexID ) * u_birth.y;         \n"
+   "   v_positionSize = vec4( position, size );                            \n"
+   "   v_velocityBirth = vec4( velocity, birth );                          \n"
+   "   gl_Position = vec4( 0.0 );                                          \n"
+   "}                                                                      \n";
+
+static const char s_emitFragmentShader[] =
+   "#version 300 es                                      \n"
+   "precision mediump float;                             \n"
+   "layout(location = 0) out vec4 fragColor;             \n"
+   "void main()                                          \n"
+   "{                                                    \n"
+   "  fragColor = vec4(1.0);                             \n"
+   "}                                                    \n";
+
+static const char s_drawVertexShader[] =
+   "#version 300 es                                                     \n"
+   "layout(location = 0) in vec4 a_positionSize;                        \n"
+   "layout(location = 1) in vec4 a_velocityBirth;                       \n"
+   "                                                                    \n"
+   "uniform mat4 u_mvpMatrix;                                           \n"
+   "uniform float u_time;                                               \n"
+   "uniform float u_lifetime;                                           \n"
+   "uniform vec3 u_acceleration;                                        \n"
+   "uniform float u_pointScale;                                         \n"
+   "uniform vec2 u_depthRange;                                          \n"
+   "                                                                    \n"
+   "out float v_depth;                                                  \n"
+   "                                                                    \n"
+   "void main()                                                         \n"
+   "{                                                                   \n"
+   "  float age = u_time - a_velocityBirth.w;                           \n"
+   "  gl_Position = vec4( -1000, -1000, 0, 0 );                         \n"
+   "  gl_PointSize = 0.0;                                               \n"
+   "  v_depth = 0.0;                                                    \n"
+   "  if ( age >= 0.0 && age < u_lifetime )                             \n"
+   "  {                                                                 \n"
+   "     vec3 position = a_positionSize.xyz + age * a_velocityBirth.xyz \n"
+   "                   + ( 0.5 * age * age ) * u_acceleration;          \n"
+   "     vec4 clipPosition = u_mvpMatrix * vec4( position, 1.0 );       \n"
+   "     // Only the particles in the depth slice being drawn           \n"
+   "     if ( clipPosition.z >= u_depthRange.x &&                       \n"
+   "          clipPosition.z < u_depthRange.y )                         \n"
+   "     {                                                              \n"
+   "        gl_Position = clipPosition;                                 \n"
+   "        gl_PointSize = a_positionSize.w * ( 1.0 - age / u_lifetime )\n"
+   "                     * u_pointScale;                                \n"
+   "        v_depth = clipPosition.w;                                   \n"
+   "     }                                                              \n"
+   "  }                                                                 \n"
+   "}                                                                   \n";
+
+// Soft particles fade out in front of the opaque scene.  u_depthParams
+// turns its depth buffer values back into eye distances, which for a
+// perspective projection is clip w like v_depth.
+static const char s_drawFragmentShader[] =
+   "#version 300 es                                                     \n"
+   "precision mediump float;                                            \n"
+   "layout(location = 0) out vec4 fragColor;                            \n"
+   "uniform vec4 u_color;                                               \n"
+   "uniform sampler2D s_texture;                                        \n"
+   "uniform highp sampler2D s_depth;                                    \n"
+   "uniform highp vec3 u_depthParams;                                   \n"
+   "uniform highp vec3 u_depthCoord;                                    \n"
+   "uniform highp float u_softScale;                                    \n"
+   "in highp float v_depth;                                             \n"
+   "void main()                                                         \n"
+   "{                                                                   \n"
+   "  fragColor = texture( s_texture, gl_PointCoord ) * u_color;        \n"
+   "  if ( u_softScale > 0.0 )                                          \n"
+   "  {                                                                 \n"
+   "     highp vec2 coord = gl_FragCoord.xy * u_depthCoord.x + u_depthCoord.yz;\n"
+   "     ivec2 texel = min( ivec2( coord ), textureSize( s_depth, 0 ) - 1 );\n"
+   "     highp float z = texelFetch( s_depth, texel, 0 ).r * 2.0 - 1.0; \n"
+   "     highp float sceneDepth = u_depthParams.x /                     \n"
+   "                              ( u_depthParams.y - z * u_depthParams.z );\n"
+   "     fragColor.a *= clamp( ( sceneDepth - v_depth ) * u_softScale, 0.0, 1.0 );\n"
+   "  }                                                                 \n"
+   "}                                                                   \n";
+
+
+static const char s_streamVertexShader[] =
+   "#version 300 es                                                     \n"
+   "layout(location = 0) in vec4 a_positionSize;                        \n"
+   "                                                                    \n"
+   "uniform mat4 u_mvpMatrix;                                           \n"
+   "uniform float u_pointScale;                                         \n"
+   "                                                                    \n"
+   "out float v_depth;                                                  \n"
+   "                                                                    \n"
+   "void main()                                                         \n"
+   "{                                                                   \n"
+   "  if ( a_positionSize.w > 0.0 )                                     \n"
+   "  {                                                                 \n"
+   "     gl_Position = u_mvpMatrix * vec4( a_positionSize.xyz, 1.0 );   \n"
+   "     gl_PointSize = a_positionSize.w * u_pointScale;                \n"
+   "     v_depth = gl_Position.w;                                       \n"
+   "  }                                                                 \n"
+   "  else                                                              \n"
+   "  {                                                                 \n"
+   "     gl_Position = vec4( -1000, -1000, 0, 0 );                      \n"
+   "     gl_PointSize = 0.0;                                            \n"
+   "     v_depth = 0.0;                                                 \n"
+   "  }                                                                 \n"
+   "}                                                                   \n";
+
+// Composite of the offscreen target, one triangle covering the viewport
+static const char s_compositeVertexShader[] =
+   "#version 300 es                                                     \n"
+   "uniform vec2 u_texCoordScale;                                       \n"
+   "out vec2 v_texCoord;                                                \n"
+   "void main()                                                         \n"
+   "{                                                                   \n"
+   "  vec2 position = vec2( gl_VertexID == 1 ? 3.0 : -1.0,              \n"
+   "                        gl_VertexID == 2 ? 3.0 : -1.0 );            \n"
+   "  v_texCoord = ( position * 0.5 + 0.5 ) * u_texCoordScale;          \n"
+   "  gl_Position = vec4( position, 0.0, 1.0 );                         \n"
+   "}                                                                   \n";
+
+static const char s_compositeFragmentShader[] =
+   "#version 300 es                                      \n"
+   "precision mediump float;                             \n"
+   "layout(location = 0) out vec4 fragColor;             \n"
+   "in vec2 v_texCoord;                                  \n"
+   "uniform sampler2D s_particles;                       \n"
+   "void main()                                          \n"
+   "{                                                    \n"
+   "  fragColor = texture( s_particles, v_texCoord );    \n"
+   "}                                                    \n";
+
+#if defined(PARTICLES_SSE) || defined(PARTICLES_NEON)
+#define PARTICLES_SIMD
+
+#if defined(PARTICLES_SSE)
+typedef __m128 Vec4f;
+typedef __m128 Vec4Mask;
+
+#define VSet1( a )                  _mm_set1_ps ( a )
+#define VLoad( p )                  _mm_loadu_ps ( p )
+#define VStore( p, a )              _mm_storeu_ps ( p, a )
+#define VAdd( a, b )                _mm_add_ps ( a, b )
+#define VSub( a, b )                _mm_sub_ps ( a, b )
+#define VMul( a, b )                _mm_mul_ps ( a, b )
+#define VMin( a, b )                _mm_min_ps ( a, b )
+#define VLess( a, b )               _mm_cmplt_ps ( a, b )
+#define VSelect( m, a, b )          _mm_or_ps ( _mm_and_ps ( m, a ), _mm_andnot_ps ( m, b ) )
+#define VStoreInterleaved( p, r0, r1, r2, r3 ) \
+   do                                          \
+   {                                           \
+      _MM_TRANSPOSE4_PS ( r0, r1, r2, r3 );    \
+      _mm_storeu_ps ( ( p ), r0 );             \
+      _mm_storeu_ps ( ( p ) + 4, r1 );         \
+      _mm_storeu_ps ( ( p ) + 8, r2 );         \
+      _mm_storeu_ps ( ( p ) + 12, r3 );        \
+   } while ( 0 )
+#else
+typedef float32x4_t Vec4f;
+typedef uint32x4_t  Vec4Mask;
+
+#define VSet1( a )                  vdupq_n_f32 ( a )
+#define VLoad( p )                  vld1q_f32 ( p )
+#define VStore( p, a )              vst1q_f32 ( p, a )
+#define VAdd( a, b )                vaddq_f32 ( a, b )
+#define VSub( a, b )                vsubq_f32 ( a, b )
+#define VMul( a, b )                vmulq_f32 ( a, b )
+#define VMin( a, b )                vminq_f32 ( a, b )
+#define VLess( a, b )               vcltq_f32 ( a, b )
+#define VSelect( m, a, b )          vbslq_f32 ( m, a, b )
+#define VStoreInterleaved( p, r0, r1, r2, r3 ) \
+   do                                          \
+   {                                           \
+      float32x4x4_t rows;                      \
+      rows.val[0] = r0;                        \
+      rows.val[1] = r1;                        \
+      rows.val[2] = r2;                        \
+      rows.val[3] = r3;                        \
+      vst4q_f32 ( p, rows );                   \
+   } while ( 0 )
+#endif
+#endif
+
+//////////////////////////////////////////////////////////////////
+//
+//  Private Functions
+//
+//
+
+///
+// Hash()
+//
+//    Integer hash, the same as hash() in the emit shader so both backends
+//    emit the same particles
+//
+static GLuint Hash ( GLuint x )
+{
+   x ^= x >> 16;
+   x *= 0x7feb352du;
+   x ^= x >> 15;
+   x *= 0x846ca68bu;
+   x ^= x >> 16;
+   return x;
+}
+
+///
+// RandomValue()
+//
+//    Uniform random value in [-1, 1], as randomValue() in the emit shader
+//
+static GLfloat RandomValue ( GLuint *state )
+{
+   *state = Hash ( *state );
+   return ( GLfloat ) ( *state >> 8 ) * ( 2.0f / 16777215.0f ) - 1.0f;
+}
+
+///
+// EmitRange()
+//
+//    Write count new particles to consecutive slots starting at slot.  The
+//    particles are numbered from 0 like gl_VertexID, so birthStart and
+//    seed are those of the first one.
+//
+static void EmitRange ( ESParticleSystem *system, const ESParticleEmitter *params, int slot, int count,
+                        double birthStart, double birthStep, GLuint seed )
+{
+   ParticleArrays *p = &system->particles;
+   int i;
+
+   if ( system->backend == ES_PARTICLES_TRANSFORM_FEEDBACK )
+   {
+      glUniform1ui ( system->emitSeedLoc, seed );
+      glUniform2f ( system->emitBirthLoc, ( GLfloat ) birthStart, ( GLfloat ) birthStep );
+
+      glBindBufferRange ( GL_TRANSFORM_FEEDBACK_BUFFER, 0, system->buffer,
+                          ( GLintptr ) slot * sizeof ( Particle ), ( GLsizeiptr ) count * sizeof ( Particle ) );
+
+      glBeginTransformFeedback ( GL_POINTS );
+      glDrawArrays ( GL_POINTS, 0, count );
+      glEndTransformFeedback ();
+      return;
+   }
+
+   for ( i = 0; i < count; i++ )
+   {
+      GLuint state = Hash ( seed ^ Hash ( ( GLuint ) i ) );
+      int    s = slot + i;
+
+      p->x[s] = params->position[0] + RandomValue ( &state ) * params->positionSpread[0];
+      p->y[s] = params->position[1] + RandomValue ( &state ) * params->positionSpread[1];
+      p->z[s] = params->position[2] + RandomValue ( &state ) * params->positionSpread[2];
+      p->vx[s] = params->velocity[0] + RandomValue ( &state ) * params->velocitySpread[0];
+      p->vy[s] = params->velocity[1] + RandomValue ( &state ) * params->velocitySpread[1];
+      p->vz[s] = params->velocity[2] + RandomValue ( &state ) * params->velocitySpread[2];
+      p->size[s] = params->minSize + ( params->maxSize - params->minSize ) * ( RandomValue ( &state ) * 0.5f + 0.5f );
+      p->birth[s] = ( GLfloat ) ( birthStart + i * birthStep );
+   }
+}
+
+///
+// EmitBatch()
+//
+//    Emit count particles at the emitter's head, wrapping around the end
+//    of its ring with a second range, and record them as one batch
+//
+static void EmitBatch ( ESParticleSystem *system, Emitter *emitter, int count, double birthStart, double birthStep )
+{
+   const ESParticleEmitter *params = &emitter->params;
+   int split = emitter->capacity - emitter->head;
+   int batch;
+
+   if ( system->backend == ES_PARTICLES_TRANSFORM_FEEDBACK )
+   {
+      glUseProgram ( system->emitProgram );
+      glBindVertexArray ( system->emitVertexArray );
+
+      // Turn off rasterization - we are not drawing
+      glEnable ( GL_RASTERIZER_DISCARD );
+
+      glUniform3fv ( system->emitPositionLoc, 1, params->position );
+      glUniform3fv ( system->emitPositionSpreadLoc, 1, params->positionSpread );
+      glUniform3fv ( system->emitVelocityLoc, 1, params->velocity );
+      glUniform3fv ( system->emitVelocitySpreadLoc, 1, params->velocitySpread );
+      glUniform2f ( system->emitSizeLoc, params->minSize, params->maxSize );
+   }
+
+   if ( split >= count )
+   {
+      EmitRange ( system, params, emitter->first + emitter->head, count, birthStart, birthStep, emitter->seed );
+   }
+   else
+   {
+      EmitRange ( system, params, emitter->first + emitter->head, split, birthStart, birthStep, emitter->seed );
+      EmitRange ( system, params, emitter->first, count - split, birthStart + split * birthStep, birthStep,
+                  emitter->seed + 0x9e3779b9u );
+   }
+
+   if ( system->backend == ES_PARTICLES_TRANSFORM_FEEDBACK )
+   {
+      // Restore state
+      glDisable ( GL_RASTERIZER_DISCARD );
+      glBindBufferBase ( GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0 );
+      glBindVertexArray ( 0 );
+      glUseProgram ( 0 );
+   }
+
+   emitter->seed = emitter->seed * 747796405u + 2891336453u;
+   emitter->head = ( emitter->head + count ) % emitter->capacity;
+   emitter->live += count;
+
+   if ( emitter->numBatches == MAX_BATCHES )
+   {
+      batch = ( emitter->firstBatch + MAX_BATCHES - 1 ) % MAX_BATCHES;
+      emitter->batchCount[batch] += count;
+   }
+   else
+   {
+      batch = ( emitter->firstBatch + emitter->numBatches ) % MAX_BATCHES;
+      emitter->batchCount[batch] = count;
+      emitter->numBatches++;
+   }
+
+   emitter->batchLastBirth[batch] = birthStart + ( count - 1 ) * birthStep;
+}
+
+///
+// RetireParticles()
+//
+//    Drop the batches whose last particle has outlived the emitter's
+//    lifetime.  The particles of the oldest remaining batch may already be
+//    partly dead, the draw shaders hide those.
+//
+static void RetireParticles ( Emitter *emitter, double time )
+{
+   while ( emitter->numBatches > 0 &&
+           time - emitter->batchLastBirth[emitter->firstBatch] >= emitter->params.lifetime )
+   {
+      emitter->live -= emitter->batchCount[emitter->firstBatch];
+      emitter->firstBatch = ( emitter->firstBatch + 1 ) % MAX_BATCHES;
+      emitter->numBatches--;
+   }
+}
+
+///
+// EmitParticles()
+//
+//    Emit the particles due in the step ending at time, limited to the
+//    slots not holding live particles.  The births are spread over the
+//    step, the last particle is born at time.
+//
+static int EmitParticles ( ESParticleSystem *system, Emitter *emitter, double time, float deltaTime )
+{
+   int count;
+
+   emitter->pending += emitter->params.rate * deltaTime;
+   count = ( int ) emitter->pending;
+   emitter->pending -= count;
+
+   if ( count > emitter->capacity - emitter->live )
+   {
+      count = emitter->capacity - emitter->live;
+   }
+
+   if ( count <= 0 )
+   {
+      return 0;
+   }
+
+   EmitBatch ( system, emitter, count, time - ( count - 1 ) * ( double ) deltaTime / count,
+               ( double ) deltaTime / count );
+
+   return count;
+}
+
+///
+// SimulateRun()
+//
+//    Integrate count consecutive particles of an emitter starting at slot
+//    and write their positions and current sizes to dst.  The step is exact
+//    for constant acceleration, so without collisions the particles follow
+//    the same paths as on the transform feedback backend.  Particles born
+//    during the step only move for the part of it they were alive.
+//
+static void SimulateRun ( ESParticleSystem *system, const Emitter *emitter, int slot, int count, GLfloat *dst,
+                          float deltaTime )
+{
+   const ESParticleEmitter *params = &emitter->params;
+   ParticleArrays *p = &system->particles;
+   const GLfloat  *a = params->acceleration;
+   const GLfloat  *n = params->collisionPlane;
+   GLfloat time = ( GLfloat ) system->time;
+   GLfloat invLifetime = 1.0f / params->lifetime;
+   GLfloat bounce = 1.0f + params->restitution;
+   int i = 0;
+
+#ifdef PARTICLES_SIMD
+   const Vec4f zero = VSet1 ( 0.0f );
+   const Vec4f one = VSet1 ( 1.0f );
+
+   for ( ; i + 4 <= count; i += 4 )
+   {
+      int      s = slot + i;
+      Vec4f    age = VSub ( VSet1 ( time ), VLoad ( p->birth + s ) );
+      Vec4f    h = VMin ( age, VSet1 ( deltaTime ) );
+      Vec4f    halfH = VMul ( h, VSet1 ( 0.5f ) );
+      Vec4f    vx = VLoad ( p->vx + s );
+      Vec4f    vy = VLoad ( p->vy + s );
+      Vec4f    vz = VLoad ( p->vz + s );
+      Vec4f    x = VAdd ( VLoad ( p->x + s ), VMul ( VAdd ( vx, VMul ( VSet1 ( a[0] ), halfH ) ), h ) );
+      Vec4f    y = VAdd ( VLoad ( p->y + s ), VMul ( VAdd ( vy, VMul ( VSet1 ( a[1] ), halfH ) ), h ) );
+      Vec4f    z = VAdd ( VLoad ( p->z + s ), VMul ( VAdd ( vz, VMul ( VSet1 ( a[2] ), halfH ) ), h ) );
+      Vec4f    distance, speed, push, life, size;
+      Vec4Mask hit;
+
+      vx = VAdd ( vx, VMul ( VSet1 ( a[0] ), h ) );
+      vy = VAdd ( vy, VMul ( VSet1 ( a[1] ), h ) );
+      vz = VAdd ( vz, VMul ( VSet1 ( a[2] ), h ) );
+
+      // Reflect the particles that crossed the plane back above it and
+      // their velocity towards it, scaled by the restitution
+      distance = VAdd ( VAdd ( VMul ( VSet1 ( n[0] ), x ), VMul ( VSet1 ( n[1] ), y ) ),
+                        VAdd ( VMul ( VSet1 ( n[2] ), z ), VSet1 ( n[3] ) ) );
+      hit = VLess ( distance, zero );
+      push = VSelect ( hit, VMul ( distance, VSet1 ( bounce ) ), zero );
+      x = VSub ( x, VMul ( VSet1 ( n[0] ), push ) );
+      y = VSub ( y, VMul ( VSet1 ( n[1] ), push ) );
+      z = VSub ( z, VMul ( VSet1 ( n[2] ), push ) );
+
+      speed = VAdd ( VMul ( VSet1 ( n[0] ), vx ), VAdd ( VMul ( VSet1 ( n[1] ), vy ), VMul ( VSet1 ( n[2] ), vz ) ) );
+      push = VSelect ( hit, VMul ( VMin ( speed, zero ), VSet1 ( bounce ) ), zero );
+      vx = VSub ( vx, VMul ( VSet1 ( n[0] ), push ) );
+      vy = VSub ( vy, VMul ( VSet1 ( n[1] ), push ) );
+      vz = VSub ( vz, VMul ( VSet1 ( n[2] ), push ) );
+
+      VStore ( p->x + s, x );
+      VStore ( p->y + s, y );
+      VStore ( p->z + s, z );
+      VStore ( p->vx + s, vx );
+      VStore ( p->vy + s, vy );
+      VStore ( p->vz + s, vz );
+
+      // Shrink to nothing over the lifetime, 0 hides dead particles
+      life = VSub ( one, VMul ( age, VSet1 ( invLifetime ) ) );
+      size = VSelect ( VLess ( zero, life ), VMul ( VLoad ( p->size + s ), life ), zero );
+
+      VStoreInterleaved ( dst + i * 4, x, y, z, size );
+   }
+#endif
+
+   for ( ; i < count; i++ )
+   {
+      int     s = slot + i;
+      GLfloat age = time - p->birth[s];
+      GLfloat h = age < deltaTime ? age : deltaTime;
+      GLfloat halfH = h * 0.5f;
+      GLfloat distance, speed, life;
+
+      p->x[s] += ( p->vx[s] + a[0] * halfH ) * h;
+      p->y[s] += ( p->vy[s] + a[1] * halfH ) * h;
+      p->z[s] += ( p->vz[s] + a[2] * halfH ) * h;
+      p->vx[s] += a[0] * h;
+      p->vy[s] += a[1] * h;
+      p->vz[s] += a[2] * h;
+
+      distance = n[0] * p->x[s] + n[1] * p->y[s] + ( n[2] * p->z[s] + n[3] );
+
+      if ( distance < 0.0f )
+      {
+         GLfloat push = distance * bounce;
+
+         p->x[s] -= n[0] * push;
+         p->y[s] -= n[1] * push;
+         p->z[s] -= n[2] * push;
+
+         speed = n[0] * p->vx[s] + ( n[1] * p->vy[s] + n[2] * p->vz[s] );
+         push = ( speed < 0.0f ? speed : 0.0f ) * bounce;
+
+         p->vx[s] -= n[0] * push;
+         p->vy[s] -= n[1] * push;
+         p->vz[s] -= n[2] * push;
+      }
+
+      life = 1.0f - age * invLifetime;
+
+      dst[i * 4 + 0] = p->x[s];
+      dst[i * 4 + 1] = p->y[s];
+      dst[i * 4 + 2] = p->z[s];
+      dst[i * 4 + 3] = life > 0.0f ? p->size[s] * life : 0.0f;
+   }
+}
+
+///
+// SimulateRange()
+//
+//    Simulate one job's range of the streamed particles, which can span
+//    several emitters and the wrap of their rings
+//
+static void SimulateRange ( const SimulateJob *job )
+{
+   ESParticleSystem *system = job->system;
+   int i;
+
+   for ( i = 0; i < system->numEmitters; i++ )
+   {
+      const Emitter *emitter = &system->emitters[i];
+      int first = job->first > emitter->streamFirst ? job->first : emitter->streamFirst;
+      int last = job->first + job->count < emitter->streamFirst + emitter->streamCount ?
+                 job->first + job->count : emitter->streamFirst + emitter->streamCount;
+      int slot, count, run;
+
+      if ( first >= last )
+      {
+         continue;
+      }
+
+      // Ring slot of the first particle, counting from the oldest live one
+      slot = ( emitter->head - emitter->live + emitter->capacity + first - emitter->streamFirst ) % emitter->capacity;
+      count = last - first;
+      run = emitter->capacity - slot < count ? emitter->capacity - slot : count;
+
+      SimulateRun ( system, emitter, emitter->first + slot, run, job->dst + first * 4, job->deltaTime );
+
+      if ( run < count )
+      {
+         SimulateRun ( system, emitter, emitter->first, count - run, job->dst + ( first + run ) * 4, job->deltaTime );
+      }
+   }
+}
+
+///
+// SimulateWorker()
+//
+//    Job entry point for StreamParticles
+//
+static void SimulateWorker ( void *arg )
+{
+   SimulateRange ( ( const SimulateJob * ) arg );
+}
+
+///
+// MapSegment()
+//
+//    Map the next segment of the stream buffer for total particles,
+//    unsynchronized once the GPU is done drawing from it
+//
+static GLfloat *MapSegment ( ESParticleSystem *system, int total )
+{
+   GLfloat *dst;
+   GLsync   fence;
+
+   system->segment = ( system->segment + 1 ) % STREAM_SEGMENTS;
+   fence = system->fences[system->segment];
+
+   if ( fence != NULL )
+   {
+      while ( glClientWaitSync ( fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_WAIT_TIMEOUT ) == GL_TIMEOUT_EXPIRED )
+      {
+      }
+
+      glDeleteSync ( fence );
+      system->fences[system->segment] = NULL;
+   }
+
+   glBindBuffer ( GL_ARRAY_BUFFER, system->streamBuffer );
+   dst = glMapBufferRange ( GL_ARRAY_BUFFER,
+                            ( GLintptr ) system->segment * system->streamSize * 4 * sizeof ( GLfloat ),
+                            ( GLsizeiptr ) total * 4 * sizeof ( GLfloat ),
+                            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT );
+
+   if ( dst == NULL )
+   {
+      int i;
+
+      esLogMessage ( "esParticleSystem: glMapBufferRange failed\n" );
+
+      for ( i = 0; i < system->numEmitters; i++ )
+      {
+         system->emitters[i].streamCount = 0;
+      }
+
+      glBindBuffer ( GL_ARRAY_BUFFER, 0 );
+   }
+
+   return dst;
+}
+
+///
+// StreamParticles()
+//
+//    CPU backend update.  Simulate the live particles straight into the
+//    next segment of the stream buffer, split across threads for large
+//    systems.  Alpha blended particles go to the staging array instead,
+//    the draw sorts them into the stream buffer.
+//
+static int StreamParticles ( ESParticleSystem *system, float deltaTime )
+{
+   SimulateJob jobs[ES_MAX_JOBS];
+   GLfloat    *dst;
+   int         numJobs;
+   int         total = 0;
+   int         i;
+
+   for ( i = 0; i < system->numEmitters; i++ )
+   {
+      system->emitters[i].streamFirst = total;
+      system->emitters[i].streamCount = system->emitters[i].live;
+      system->emitters[i].drawFirst = total;
+      total += system->emitters[i].live;
+   }
+
+   system->streamTotal = total;
+   system->staged = system->options.blend == ES_PARTICLES_BLEND_ALPHA && system->sortMemory != NULL;
+
+   // Grow the segments when emitters were added
+   if ( system->used > system->streamSize )
+   {
+      for ( i = 0; i < STREAM_SEGMENTS; i++ )
+      {
+         if ( system->fences[i] != NULL )
+         {
+            glDeleteSync ( system->fences[i] );
+            system->fences[i] = NULL;
+         }
+      }
+
+      system->streamSize = system->used;
+      glBindBuffer ( GL_ARRAY_BUFFER, system->streamBuffer );
+      glBufferData ( GL_ARRAY_BUFFER, ( GLsizeiptr ) STREAM_SEGMENTS * system->streamSize * 4 * sizeof ( GLfloat ),
+                     NULL, GL_STREAM_DRAW );
+   }
+
+   if ( total == 0 )
+   {
+      return 0;
+   }
+
+   dst = system->staged ? system->staging : MapSegment ( system, total );
+
+   if ( dst == NULL )
+   {
+      return 0;
+   }
+
+   numJobs = esNumJobs ( total, JOB_MIN_PARTICLES );
+
+   for ( i = 0; i < numJobs; i++ )
+   {
+      jobs[i].system = system;
+      jobs[i].dst = dst;
+      jobs[i].deltaTime = deltaTime;
+      esJobRange ( total, numJobs, i, &jobs[i].first, &jobs[i].count );
+   }
+
+   esRunJobs ( SimulateWorker, jobs, sizeof ( SimulateJob ), numJobs );
+
+   if ( !system->staged )
+   {
+      glUnmapBuffer ( GL_ARRAY_BUFFER );
+      glBindBuffer ( GL_ARRAY_BUFFER, 0 );
+   }
+
+   return total;
+}
+
+///
+// ClipDepth()
+//
+//    Clip space z of a point, which grows with the distance from the eye
+//    for perspective and orthographic projections
+//
+static GLfloat ClipDepth ( const ESMatrix *m, GLfloat x, GLfloat y, GLfloat z )
+{
+   return m->m[0][2] * x + m->m[1][2] * y + m->m[2][2] * z + m->m[3][2];
+}
+
+///
+// Length()
+//
+static GLfloat Length ( const GLfloat *v )
+{
+   return sqrtf ( v[0] * v[0] + v[1] * v[1] + v[2] * v[2] );
+}
+
+///
+// OrderEmitters()
+//
+//    Sort the emitters back to front by the depth of their positions
+//
+static void OrderEmitters ( ESParticleSystem *system, const ESMatrix *mvpMatrix )
+{
+   GLfloat depth[MAX_EMITTERS];
+   int     i, j;
+
+   for ( i = 0; i < system->numEmitters; i++ )
+   {
+      const GLfloat *position = system->emitters[i].params.position;
+      int emitter = i;
+
+      depth[i] = ClipDepth ( mvpMatrix, position[0], position[1], position[2] );
+
+      for ( j = i; j > 0 && depth[system->drawOrder[j - 1]] < depth[emitter]; j-- )
+      {
+         system->drawOrder[j] = system->drawOrder[j - 1];
+      }
+
+      system->drawOrder[j] = emitter;
+   }
+
+   for ( i = 0; i < system->numEmitters; i++ )
+   {
+      system->emitters[system->drawOrder[i]].rank = i;
+   }
+}
+
+///
+// EmitterDepthRange()
+//
+//    Conservative clip space depth range of an emitter's particles, from
+//    the farthest they can get from its position within their lifetime
+//
+static void EmitterDepthRange ( const Emitter *emitter, const ESMatrix *m, GLfloat *nearDepth, GLfloat *farDepth )
+{
+   const ESParticleEmitter *params = &emitter->params;
+   GLfloat t = params->lifetime;
+   GLfloat radius = Length ( params->positionSpread ) +
+                    ( Length ( params->velocity ) + Length ( params->velocitySpread ) ) * t +
+                    0.5f * Length ( params->acceleration ) * t * t;
+   GLfloat axis[3];
+   GLfloat center, extent;
+
+   axis[0] = m->m[0][2];
+   axis[1] = m->m[1][2];
+   axis[2] = m->m[2][2];
+
+   center = ClipDepth ( m, params->position[0], params->position[1], params->position[2] );
+   extent = radius * Length ( axis );
+
+   *nearDepth = center - extent;
+   *farDepth = center + extent;
+}
+
+///
+// DepthWorker()
+//
+//    Sort phase 1: depth of each staged particle and their range
+//
+static void DepthWorker ( void *arg )
+{
+   SortJob          *job = arg;
+   ESParticleSystem *system = job->system;
+   const ESMatrix   *m = job->mvpMatrix;
+   GLfloat minDepth = 1.0e30f;
+   GLfloat maxDepth = -1.0e30f;
+   int     i;
+
+   for ( i = job->first; i < job->first + job->count; i++ )
+   {
+      const GLfloat *particle = system->staging + i * 4;
+      GLfloat depth = ClipDepth ( m, particle[0], particle[1], particle[2] );
+
+      system->depths[i] = depth;
+      minDepth = depth < minDepth ? depth : minDepth;
+      maxDepth = depth > maxDepth ? depth : maxDepth;
+   }
+
+   job->minDepth = minDepth;
+   job->maxDepth = maxDepth;
+}
+
+///
+// KeyWorker()
+//
+//    Sort phase 2: key of each particle, its emitter's rank above its
+//    depth quantized and inverted so the far particles come first, and the
+//    counts of the first radix digit
+//
+static void KeyWorker ( void *arg )
+{
+   SortJob          *job = arg;
+   ESParticleSystem *system = job->system;
+   int i;
+
+   for ( i = 0; i < system->numEmitters; i++ )
+   {
+      const Emitter *emitter = &system->emitters[i];
+      int first = job->first > emitter->streamFirst ? job->first : emitter->streamFirst;
+      int last = job->first + job->count < emitter->streamFirst + emitter->streamCount ?
+                 job->first + job->count : emitter->streamFirst + emitter->streamCount;
+      GLuint rank = ( GLuint ) emitter->rank << DEPTH_BITS;
+      int j;
+
+      for ( j = first; j < last; j++ )
+      {
+         GLfloat depth = ( system->depths[j] - job->minDepth ) * job->depthScale;
+         GLuint  q = depth <= 0.0f ? 0 : depth >= 65535.0f ? 65535 : ( GLuint ) depth;
+         GLuint  key = rank | ( 65535 - q );
+
+         system->keys[0][j] = key;
+         system->indices[0][j] = ( GLuint ) j;
+         job->offsets[key & ( RADIX_BUCKETS - 1 )]++;
+      }
+   }
+}
+
+///
+// HistogramWorker()
+//
+//    Count the radix digits of the job's range of keys
+//
+static void HistogramWorker ( void *arg )
+{
+   SortJob *job = arg;
+   int i;
+
+   for ( i = job->first; i < job->first + job->count; i++ )
+   {
+      job->offsets[( job->srcKeys[i] >> job->shift ) & ( RADIX_BUCKETS - 1 )]++;
+   }
+}
+
+///
+// ScatterWorker()
+//
+//    Move the job's range of keys and indices to their slots for the
+//    current digit.  Each job owns its own slots, so the passes are stable.
+//
+static void ScatterWorker ( void *arg )
+{
+   SortJob *job = arg;
+   int i;
+
+   for ( i = job->first; i < job->first + job->count; i++ )
+   {
+      GLuint key = job->srcKeys[i];
+      GLuint slot = job->offsets[( key >> job->shift ) & ( RADIX_BUCKETS - 1 )]++;
+
+      job->dstKeys[slot] = key;
+      job->dstIndices[slot] = job->srcIndices[i];
+   }
+}
+
+///
+// GatherWorker()
+//
+//    Copy the staged particles to the stream segment in sorted order
+//
+static void GatherWorker ( void *arg )
+{
+   SortJob          *job = arg;
+   ESParticleSystem *system = job->system;
+   int i;
+
+   for ( i = job->first; i < job->first + job->count; i++ )
+   {
+      memcpy ( job->dst + i * 4, system->staging + system->indices[0][i] * 4, 4 * sizeof ( GLfloat ) );
+   }
+}
+
+///
+// PrefixOffsets()
+//
+//    Turn the digit counts of every job into the first slot of each job's
+//    particles with that digit
+//
+static void PrefixOffsets ( SortJob *jobs, int numJobs )
+{
+   GLuint slot = 0;
+   int    digit, i;
+
+   for ( digit = 0; digit < RADIX_BUCKETS; digit++ )
+   {
+      for ( i = 0; i < numJobs; i++ )
+      {
+         GLuint count = jobs[i].offsets[digit];
+
+         jobs[i].offsets[digit] = slot;
+         slot += count;
+      }
+   }
+}
+
+///
+// SortParticles()
+//
+//    CPU backend draw with alpha blending.  Radix sort the staged
+//    particles by emitter rank and depth, back to front, and gather them
+//    into the next stream segment so each emitter's are one range.
+//
+static int SortParticles ( ESParticleSystem *system, const ESMatrix *mvpMatrix )
+{
+   SortJob  jobs[ES_MAX_JOBS];
+   GLfloat  minDepth = 1.0e30f;
+   GLfloat  maxDepth = -1.0e30f;
+   GLfloat *dst;
+   int      total = system->streamTotal;
+   int      numJobs = esNumJobs ( total, JOB_MIN_PARTICLES );
+   int      drawFirst = 0;
+   int      pass, i;
+
+   if ( total == 0 )
+   {
+      return 0;
+   }
+
+   for ( i = 0; i < numJobs; i++ )
+   {
+      jobs[i].system = system;
+      jobs[i].mvpMatrix = mvpMatrix;
+      esJobRange ( total, numJobs, i, &jobs[i].first, &jobs[i].count );
+   }
+
+   esRunJobs ( DepthWorker, jobs, sizeof ( SortJob ), numJobs );
+
+   for ( i = 0; i < numJobs; i++ )
+   {
+      minDepth = jobs[i].count > 0 && jobs[i].minDepth < minDepth ? jobs[i].minDepth : minDepth;
+      maxDepth = jobs[i].count > 0 && jobs[i].maxDepth > maxDepth ? jobs[i].maxDepth : maxDepth;
+   }
+
+   for ( i = 0; i < numJobs; i++ )
+   {
+      jobs[i].minDepth = minDepth;
+      jobs[i].depthScale = maxDepth > minDepth ? 65535.0f / ( maxDepth - minDepth ) : 0.0f;
+      memset ( jobs[i].offsets, 0, sizeof ( jobs[i].offsets ) );
+   }
+
+   esRunJobs ( KeyWorker, jobs, sizeof ( SortJob ), numJobs );
+
+   // Keys hold MAX_EMITTERS ranks above DEPTH_BITS, two passes cover them
+   for ( pass = 0; pass < 2; pass++ )
+   {
+      for ( i = 0; i < numJobs; i++ )
+      {
+         jobs[i].srcKeys = system->keys[pass];
+         jobs[i].srcIndices = system->indices[pass];
+         jobs[i].dstKeys = system->keys[1 - pass];
+         jobs[i].dstIndices = system->indices[1 - pass];
+         jobs[i].shift = pass * RADIX_BITS;
+
+         if ( pass > 0 )
+         {
+            memset ( jobs[i].offsets, 0, sizeof ( jobs[i].offsets ) );
+         }
+      }
+
+      if ( pass > 0 )
+      {
+         esRunJobs ( HistogramWorker, jobs, sizeof ( SortJob ), numJobs );
+      }
+
+      PrefixOffsets ( jobs, numJobs );
+      esRunJobs ( ScatterWorker, jobs, sizeof ( SortJob ), numJobs );
+   }
+
+   for ( i = 0; i < system->numEmitters; i++ )
+   {
+      Emitter *emitter = &system->emitters[system->drawOrder[i]];
+
+      emitter->drawFirst = drawFirst;
+      drawFirst += emitter->streamCount;
+   }
+
+   dst = MapSegment ( system, total );
+
+   if ( dst == NULL )
+   {
+      return 0;
+   }
+
+   for ( i = 0; i < numJobs; i++ )
+   {
+      jobs[i].dst = dst;
+   }
+
+   esRunJobs ( GatherWorker, jobs, sizeof ( SortJob ), numJobs );
+
+   glUnmapBuffer ( GL_ARRAY_BUFFER );
+   glBindBuffer ( GL_ARRAY_BUFFER, 0 );
+
+   return total;
+}
+
+///
+// DrawLive()
+//
+//    Draw an emitter's particles.  On the transform feedback backend this
+//    is the live run of the ring, in two parts when it wraps, on the CPU
+//    backend its range of the stream segment.
+//
+static void DrawLive ( ESParticleSystem *system, const Emitter *emitter )
+{
+   int tail = ( emitter->head - emitter->live + emitter->capacity ) % emitter->capacity;
+
+   if ( system->backend == ES_PARTICLES_CPU )
+   {
+      glDrawArrays ( GL_POINTS, system->segment * system->streamSize + emitter->drawFirst, emitter->streamCount );
+   }
+   else if ( tail + emitter->live <= emitter->capacity )
+   {
+      glDrawArrays ( GL_POINTS, emitter->first + tail, emitter->live );
+   }
+   else
+   {
+      glDrawArrays ( GL_POINTS, emitter->first + tail, emitter->capacity - tail );
+      glDrawArrays ( GL_POINTS, emitter->first, emitter->live - ( emitter->capacity - tail ) );
+   }
+}
+
+///
+// BeginOffscreen()
+//
+//    Bind and clear the reduced resolution target, created or resized to
+//    the viewport.  Returns GL_FALSE and turns downsampling off when the
+//    target cannot be created.
+//
+static GLboolean BeginOffscreen ( ESParticleSystem *system, const GLint viewport[4], GLint *framebuffer )
+{
+   int     downsample = system->options.downsample;
+   int     width = ( viewport[2] + downsample - 1 ) / downsample;
+   int     height = ( viewport[3] + downsample - 1 ) / downsample;
+   GLfloat clearColor[4];
+
+   glGetIntegerv ( GL_DRAW_FRAMEBUFFER_BINDING, framebuffer );
+   glBindFramebuffer ( GL_DRAW_FRAMEBUFFER, system->offscreenFramebuffer );
+
+   if ( width != system->offscreenWidth || height != system->offscreenHeight )
+   {
+      glBindTexture ( GL_TEXTURE_2D, system->offscreenTexture );
+      glTexImage2D ( GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL );
+      glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+      glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+      glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+      glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+
+      glFramebufferTexture2D ( GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, system->offscreenTexture, 0 );
+
+      if ( glCheckFramebufferStatus ( GL_DRAW_FRAMEBUFFER ) != GL_FRAMEBUFFER_COMPLETE )
+      {
+         esLogMessage ( "esParticleSystemDraw: offscreen target incomplete, drawing at full resolution\n" );
+         glBindFramebuffer ( GL_DRAW_FRAMEBUFFER, *framebuffer );
+         system->options.downsample = 1;
+         return GL_FALSE;
+      }
+
+      system->offscreenWidth = width;
+      system->offscreenHeight = height;
+   }
+
+   glViewport ( 0, 0, width, height );
+
+   glGetFloatv ( GL_COLOR_CLEAR_VALUE, clearColor );
+   glClearColor ( 0.0f, 0.0f, 0.0f, 0.0f );
+   glClear ( GL_COLOR_BUFFER_BIT );
+   glClearColor ( clearColor[0], clearColor[1], clearColor[2], clearColor[3] );
+
+   return GL_TRUE;
+}
+
+///
+// CompositeOffscreen()
+//
+//    Blend the offscreen target, which holds premultiplied colors, over the
+//    viewport of the framebuffer the particles were meant for
+//
+static void CompositeOffscreen ( ESParticleSystem *system, const GLint viewport[4], GLint framebuffer )
+{
+   int downsample = system->options.downsample;
+
+   glBindFramebuffer ( GL_DRAW_FRAMEBUFFER, framebuffer );
+   glViewport ( viewport[0], viewport[1], viewport[2], viewport[3] );
+
+   glUseProgram ( system->compositeProgram );
+   glBindVertexArray ( system->compositeVertexArray );
+
+   glActiveTexture ( GL_TEXTURE0 );
+   glBindTexture ( GL_TEXTURE_2D, system->offscreenTexture );
+   glUniform1i ( system->compositeSamplerLoc, 0 );
+
+   // The target can be a little larger than the viewport scaled down
+   glUniform2f ( system->compositeScaleLoc,
+                 ( GLfloat ) viewport[2] / ( system->offscreenWidth * downsample ),
+                 ( GLfloat ) viewport[3] / ( system->offscreenHeight * downsample ) );
+
+   glBlendFunc ( GL_ONE, GL_ONE_MINUS_SRC_ALPHA );
+   glDrawArrays ( GL_TRIANGLES, 0, 3 );
+}
+
+///
+// ApplyDrawOptions()
+//
+//    Take over draw options, ES_PARTICLE_DOWNSAMPLE overrides the
+//    downsampling for benchmarking.  The CPU backend needs the sort arrays
+//    for alpha blending, downsampling the composite program, which is
+//    compiled here rather than on the first draw.
+//
+static GLboolean ApplyDrawOptions ( ESParticleSystem *system, const ESParticleDrawOptions *options )
+{
+   const char *downsample = getenv ( "ES_PARTICLE_DOWNSAMPLE" );
+
+   if ( system->backend == ES_PARTICLES_CPU && options->blend == ES_PARTICLES_BLEND_ALPHA &&
+        system->sortMemory == NULL )
+   {
+      int capacity = system->capacity;
+
+      // Staging positions and sizes, depths, and two arrays each of keys and indices
+      system->sortMemory = malloc ( ( size_t ) capacity * 9 * sizeof ( GLfloat ) );
+
+      if ( system->sortMemory == NULL )
+      {
+         esLogMessage ( "esParticleSystemSetDrawOptions: out of memory for sorting %d particles\n", capacity );
+         return GL_FALSE;
+      }
+
+      system->staging = system->sortMemory;
+      system->depths = system->staging + capacity * 4;
+      system->keys[0] = ( GLuint * ) ( system->depths + capacity );
+      system->keys[1] = system->keys[0] + capacity;
+      system->indices[0] = system->keys[1] + capacity;
+      system->indices[1] = system->indices[0] + capacity;
+   }
+
+   system->options = *options;
+
+   if ( downsample != NULL )
+   {
+      system->options.downsample = atoi ( downsample );
+   }
+
+   if ( system->options.downsample < 1 )
+   {
+      system->options.downsample = 1;
+   }
+
+   if ( system->options.downsample > 1 && system->compositeProgram == 0 )
+   {
+      system->compositeProgram = esLoadProgram ( s_compositeVertexShader, s_compositeFragmentShader );
+
+      if ( system->compositeProgram == 0 )
+      {
+         system->options.downsample = 1;
+         return GL_TRUE;
+      }
+
+      system->compositeSamplerLoc = esGetUniformLocation ( system->compositeProgram, "s_particles" );
+      system->compositeScaleLoc = esGetUniformLocation ( system->compositeProgram, "u_texCoordScale" );
+
+      glGenVertexArrays ( 1, &system->compositeVertexArray );
+      glGenFramebuffers ( 1, &system->offscreenFramebuffer );
+      glGenTextures ( 1, &system->offscreenTexture );
+   }
+
+   return GL_TRUE;
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//  Public Functions
+//
+//
+
+///
+// esParticleSystemCreate()
+//
+//    Create the particle store, vertex arrays and programs of a backend
+//
+ESParticleSystem *ESUTIL_API esParticleSystemCreate ( int capacity, int backend )
+{
+   static const char *feedbackVaryings[2] =
+   {
+      "v_positionSize",
+      "v_velocityBirth"
+   };
+   const char *override = getenv ( "ES_PARTICLE_BACKEND" );
+   ESParticleDrawOptions options;
+   ESParticleSystem *system;
+
+   if ( capacity <= 0 )
+   {
+      return NULL;
+   }
+
+   system = calloc ( 1, sizeof ( ESParticleSystem ) );
+
+   if ( system == NULL )
+   {
+      return NULL;
+   }
+
+   if ( override != NULL && strcmp ( override, "cpu" ) == 0 )
+   {
+      backend = ES_PARTICLES_CPU;
+   }
+   else if ( override != NULL && strcmp ( override, "tf" ) == 0 )
+   {
+      backend = ES_PARTICLES_TRANSFORM_FEEDBACK;
+   }
+
+   system->backend = backend;
+   system->capacity = capacity;
+
+   if ( backend == ES_PARTICLES_CPU )
+   {
+      ParticleArrays *p = &system->particles;
+
+      p->x = malloc ( ( size_t ) capacity * 8 * sizeof ( GLfloat ) );
+
+      if ( p->x == NULL )
+      {
+         free ( system );
+         return NULL;
+      }
+
+      p->y = p->x + capacity;
+      p->z = p->y + capacity;
+      p->vx = p->z + capacity;
+      p->vy = p->vx + capacity;
+      p->vz = p->vy + capacity;
+      p->size = p->vz + capacity;
+      p->birth = p->size + capacity;
+
+      system->drawProgram = esLoadProgram ( s_streamVertexShader, s_drawFragmentShader );
+   }
+   else
+   {
+      system->emitProgram = esLoadProgramFeedback ( s_emitVertexShader, s_emitFragmentShader, 2, feedbackVaryings,
+                                                    GL_INTERLEAVED_ATTRIBS );
+      system->drawProgram = esLoadProgram ( s_drawVertexShader, s_drawFragmentShader );
+   }
+
+   if ( system->drawProgram == 0 || ( backend != ES_PARTICLES_CPU && system->emitProgram == 0 ) )
+   {
+      esParticleSystemDestroy ( system );
+      return NULL;
+   }
+
+   // Uniforms the stream shader does not have are -1 and ignored
+   system->drawMvpLoc = esGetUniformLocation ( system->drawProgram, "u_mvpMatrix" );
+   system->drawTimeLoc = esGetUniformLocation ( system->drawProgram, "u_time" );
+   system->drawLifetimeLoc = esGetUniformLocation ( system->drawProgram, "u_lifetime" );
+   system->drawAccelerationLoc = esGetUniformLocation ( system->drawProgram, "u_acceleration" );
+   system->drawColorLoc = esGetUniformLocation ( system->drawProgram, "u_color" );
+   system->drawSamplerLoc = esGetUniformLocation ( system->drawProgram, "s_texture" );
+   system->drawPointScaleLoc = esGetUniformLocation ( system->drawProgram, "u_pointScale" );
+   system->drawDepthRangeLoc = esGetUniformLocation ( system->drawProgram, "u_depthRange" );
+   system->drawDepthSamplerLoc = esGetUniformLocation ( system->drawProgram, "s_depth" );
+   system->drawDepthParamsLoc = esGetUniformLocation ( system->drawProgram, "u_depthParams" );
+   system->drawDepthCoordLoc = esGetUniformLocation ( system->drawProgram, "u_depthCoord" );
+   system->drawSoftScaleLoc = esGetUniformLocation ( system->drawProgram, "u_softScale" );
+
+   memset ( &options, 0, sizeof ( ESParticleDrawOptions ) );
+   options.blend = ES_PARTICLES_BLEND_ADDITIVE;
+   options.downsample = 1;
+   ApplyDrawOptions ( system, &options );
+
+   glGenVertexArrays ( 1, &system->drawVertexArray );
+
+   if ( backend == ES_PARTICLES_CPU )
+   {
+      // The stream buffer is sized once the emitters are known
+      glGenBuffers ( 1, &system->streamBuffer );
+      glBindBuffer ( GL_ARRAY_BUFFER, system->streamBuffer );
+
+      glBindVertexArray ( system->drawVertexArray );
+      glVertexAttribPointer ( ATTRIBUTE_POSITION_SIZE, 4, GL_FLOAT, GL_FALSE, 4 * sizeof ( GLfloat ), NULL );
+      glEnableVertexAttribArray ( ATTRIBUTE_POSITION_SIZE );
+   }
+   else
+   {
+      system->emitSeedLoc = esGetUniformLocation ( system->emitProgram, "u_seed" );
+      system->emitPositionLoc = esGetUniformLocation ( system->emitProgram, "u_position" );
+      system->emitPositionSpreadLoc = esGetUniformLocation ( system->emitProgram, "u_positionSpread" );
+      system->emitVelocityLoc = esGetUniformLocation ( system->emitProgram, "u_velocity" );
+      system->emitVelocitySpreadLoc = esGetUniformLocation ( system->emitProgram, "u_velocitySpread" );
+      system->emitSizeLoc = esGetUniformLocation ( system->emitProgram, "u_size" );
+      system->emitBirthLoc = esGetUniformLocation ( system->emitProgram, "u_birth" );
+
+      // Particles are written before they are read, so the buffer starts
+      // uninitialized
+      glGenBuffers ( 1, &system->buffer );
+      glBindBuffer ( GL_ARRAY_BUFFER, system->buffer );
+      glBufferData ( GL_ARRAY_BUFFER, ( GLsizeiptr ) capacity * sizeof ( Particle ), NULL, GL_DYNAMIC_COPY );
+
+      glGenVertexArrays ( 1, &system->emitVertexArray );
+      glBindVertexArray ( system->drawVertexArray );
+
+      glVertexAttribPointer ( ATTRIBUTE_POSITION_SIZE, 4, GL_FLOAT, GL_FALSE, sizeof ( Particle ),
+                              ( const void * ) offsetof ( Particle, positionSize ) );
+      glVertexAttribPointer ( ATTRIBUTE_VELOCITY_BIRTH, 4, GL_FLOAT, GL_FALSE, sizeof ( Particle ),
+                              ( const void * ) offsetof ( Particle, velocityBirth ) );
+      glEnableVertexAttribArray ( ATTRIBUTE_POSITION_SIZE );
+      glEnableVertexAttribArray ( ATTRIBUTE_VELOCITY_BIRTH );
+   }
+
+   glBindVertexArray ( 0 );
+   glBindBuffer ( GL_ARRAY_BUFFER, 0 );
+
+   return system;
+}
+
+///
+// esParticleSystemAddEmitter()
+//
+//    Reserve the emitter's slots at the end of the used part of the store
+//
+int ESUTIL_API esParticleSystemAddEmitter ( ESParticleSystem *system, const ESParticleEmitter *emitter )
+{
+   Emitter *state;
+   int      capacity = emitter->capacity;
+
+   if ( capacity <= 0 )
+   {
+      capacity = ( int ) ceil ( emitter->rate * emitter->lifetime );
+   }
+
+   if ( system->numEmitters == MAX_EMITTERS || capacity <= 0 || emitter->lifetime <= 0.0f ||
+        capacity > system->capacity - system->used )
+   {
+      esLogMessage ( "esParticleSystemAddEmitter: no room for %d particles\n", capacity );
+      return -1;
+   }
+
+   state = &system->emitters[system->numEmitters];
+   memset ( state, 0, sizeof ( Emitter ) );
+   state->first = system->used;
+   state->capacity = capacity;
+   state->seed = 0x3c6ef372u + 0x9e3779b9u * ( GLuint ) system->numEmitters;
+
+   system->used += capacity;
+   system->drawOrder[system->numEmitters] = system->numEmitters;
+   system->numEmitters++;
+
+   esParticleSystemSetEmitter ( system, system->numEmitters - 1, emitter );
+
+   return system->numEmitters - 1;
+}
+
+///
+// esParticleSystemSetRate()
+//
+//    Change an emitter's rate, limited to its reserved slots
+//
+void ESUTIL_API esParticleSystemSetRate ( ESParticleSystem *system, int emitter, float rate )
+{
+   Emitter *state;
+   float    maxRate;
+
+   if ( emitter < 0 || emitter >= system->numEmitters )
+   {
+      return;
+   }
+
+   state = &system->emitters[emitter];
+   maxRate = state->capacity / state->params.lifetime;
+   state->params.rate = rate < 0.0f ? 0.0f : rate > maxRate ? maxRate : rate;
+}
+
+///
+// esParticleSystemSetEmitter()
+//
+//    Replace an emitter's parameters, keeping its reserved slots
+//
+void ESUTIL_API esParticleSystemSetEmitter ( ESParticleSystem *system, int emitter, const ESParticleEmitter *params )
+{
+   Emitter *state;
+
+   if ( emitter < 0 || emitter >= system->numEmitters ||
+        params->lifetime <= 0.0f )
+   {
+      return;
+   }
+
+   state = &system->emitters[emitter];
+   state->params = *params;
+   state->params.capacity = state->capacity;
+
+   esParticleSystemSetRate ( system, emitter, params->rate );
+}
+
+///
+// esParticleSystemBurst()
+//
+//    Emit count particles born now
+//
+int ESUTIL_API esParticleSystemBurst ( ESParticleSystem *system, int emitter, int count )
+{
+   Emitter *state;
+
+   if ( emitter < 0 || emitter >= system->numEmitters )
+   {
+      return 0;
+   }
+
+   state = &system->emitters[emitter];
+
+   if ( count > state->capacity - state->live )
+   {
+      count = state->capacity - state->live;
+   }
+
+   if ( count <= 0 )
+   {
+      return 0;
+   }
+
+   EmitBatch ( system, state, count, system->time, 0.0 );
+   system->totalEmitted += count;
+
+   return count;
+}
+
+///
+// esParticleSystemUpdate()
+//
+//    Retire dead particles, emit new ones for every emitter and, on the
+//    CPU backend, simulate and stream the live particles
+//
+void ESUTIL_API esParticleSystemUpdate ( ESParticleSystem *system, float deltaTime )
+{
+   int emitted = 0;
+   int i;
+
+   system->time += deltaTime;
+
+   for ( i = 0; i < system->numEmitters; i++ )
+   {
+      RetireParticles ( &system->emitters[i], system->time );
+   }
+
+   if ( system->backend == ES_PARTICLES_CPU )
+   {
+      esProfilerBegin ( "ParticleSimulate" );
+
+      for ( i = 0; i < system->numEmitters; i++ )
+      {
+         emitted += EmitParticles ( system, &system->emitters[i], system->time, deltaTime );
+      }
+
+      esProfilerItems ( StreamParticles ( system, deltaTime ) );
+      esProfilerEnd ();
+   }
+   else
+   {
+      esProfilerBegin ( "ParticleEmit" );
+
+      for ( i = 0; i < system->numEmitters; i++ )
+      {
+         emitted += EmitParticles ( system, &system->emitters[i], system->time, deltaTime );
+      }
+
+      esProfilerItems ( emitted );
+      esProfilerEnd ();
+   }
+
+   system->totalEmitted += emitted;
+}
+
+///
+// esParticleSystemSetDrawOptions()
+//
+//    Change how the particles are blended and where they are drawn
+//
+GLboolean ESUTIL_API esParticleSystemSetDrawOptions ( ESParticleSystem *system, const ESParticleDrawOptions *options )
+{
+   return ApplyDrawOptions ( system, options );
+}
+
+///
+// esParticleSystemDraw()
+//
+//    Draw the live particles of every emitter, back to front when alpha
+//    blended, into the offscreen target when downsampling
+//
+void ESUTIL_API esParticleSystemDraw ( ESParticleSystem *system, const ESMatrix *mvpMatrix, GLuint texture )
+{
+   const ESParticleDrawOptions *options = &system->options;
+   GLboolean alpha = options->blend == ES_PARTICLES_BLEND_ALPHA;
+   GLboolean offscreen = GL_FALSE;
+   GLint     framebuffer = 0;
+   GLint     viewport[4];
+   int       drawn = 0;
+   int       i;
+
+   if ( alpha )
+   {
+      OrderEmitters ( system, mvpMatrix );
+   }
+
+   if ( system->backend == ES_PARTICLES_CPU && system->staged )
+   {
+      esProfilerBegin ( "ParticleSort" );
+      esProfilerItems ( SortParticles ( system, mvpMatrix ) );
+      esProfilerEnd ();
+   }
+
+   esProfilerBegin ( "ParticleDraw" );
+
+   glGetIntegerv ( GL_VIEWPORT, viewport );
+
+   if ( options->downsample > 1 )
+   {
+      offscreen = BeginOffscreen ( system, viewport, &framebuffer );
+   }
+
+   glUseProgram ( system->drawProgram );
+   glBindVertexArray ( system->drawVertexArray );
+
+   glUniformMatrix4fv ( system->drawMvpLoc, 1, GL_FALSE, ( const GLfloat * ) mvpMatrix->m );
+   glUniform1f ( system->drawTimeLoc, ( GLfloat ) system->time );
+   glUniform1f ( system->drawPointScaleLoc, offscreen ? 1.0f / options->downsample : 1.0f );
+
+   glActiveTexture ( GL_TEXTURE0 );
+   glBindTexture ( GL_TEXTURE_2D, texture );
+   glUniform1i ( system->drawSamplerLoc, 0 );
+   glUniform1i ( system->drawDepthSamplerLoc, 1 );
+
+   // Soft particles, the depth texture covers the full resolution viewport
+   if ( options->depthTexture != 0 )
+   {
+      GLfloat n = options->nearPlane;
+      GLfloat f = options->farPlane;
+
+      glActiveTexture ( GL_TEXTURE1 );
+      glBindTexture ( GL_TEXTURE_2D, options->depthTexture );
+      glActiveTexture ( GL_TEXTURE0 );
+
+      glUniform3f ( system->drawDepthParamsLoc, 2.0f * n * f, f + n, f - n );
+
+      if ( offscreen )
+      {
+         glUniform3f ( system->drawDepthCoordLoc, ( GLfloat ) options->downsample, 0.0f, 0.0f );
+      }
+      else
+      {
+         glUniform3f ( system->drawDepthCoordLoc, 1.0f, ( GLfloat ) -viewport[0], ( GLfloat ) -viewport[1] );
+      }
+
+      glUniform1f ( system->drawSoftScaleLoc, options->softness > 0.0f ? 1.0f / options->softness : HARD_FADE_SCALE );
+   }
+   else
+   {
+      glUniform1f ( system->drawSoftScaleLoc, 0.0f );
+   }
+
+   // Blend particles.  Offscreen the destination alpha collects coverage
+   // for the composite: none for additive particles, which only add light.
+   glEnable ( GL_BLEND );
+
+   if ( alpha )
+   {
+      glBlendFuncSeparate ( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA );
+   }
+   else if ( offscreen )
+   {
+      glBlendFuncSeparate ( GL_SRC_ALPHA, GL_ONE, GL_ZERO, GL_ONE );
+   }
+   else
+   {
+      glBlendFunc ( GL_SRC_ALPHA, GL_ONE );
+   }
+
+   for ( i = 0; i < system->numEmitters; i++ )
+   {
+      const Emitter *emitter = &system->emitters[system->drawOrder[i]];
+      int count = system->backend == ES_PARTICLES_CPU ? emitter->streamCount : emitter->live;
+
+      if ( count == 0 )
+      {
+         continue;
+      }
+
+      glUniform1f ( system->drawLifetimeLoc, emitter->params.lifetime );
+      glUniform3fv ( system->drawAccelerationLoc, 1, emitter->params.acceleration );
+      glUniform4fv ( system->drawColorLoc, 1, emitter->params.color );
+
+      if ( system->backend == ES_PARTICLES_TRANSFORM_FEEDBACK && alpha )
+      {
+         GLfloat nearDepth, farDepth, step;
+         int     slice;
+
+         // The particles stay on the GPU, so draw the emitter once per depth
+         // slice, far to near.  The outermost slices are open ended.
+         EmitterDepthRange ( emitter, mvpMatrix, &nearDepth, &farDepth );
+         step = ( farDepth - nearDepth ) / SORT_SLICES;
+
+         for ( slice = SORT_SLICES - 1; slice >= 0; slice-- )
+         {
+            glUniform2f ( system->drawDepthRangeLoc,
+                          slice == 0 ? -1.0e30f : nearDepth + slice * step,
+                          slice == SORT_SLICES - 1 ? 1.0e30f : nearDepth + ( slice + 1 ) * step );
+            DrawLive ( system, emitter );
+         }
+      }
+      else
+      {
+         glUniform2f ( system->drawDepthRangeLoc, -1.0e30f, 1.0e30f );
+         DrawLive ( system, emitter );
+      }
+
+      drawn += count;
+   }
+
+   if ( offscreen )
+   {
+      CompositeOffscreen ( system, viewport, framebuffer );
+   }
+
+   glDisable ( GL_BLEND );
+   glBindVertexArray ( 0 );
+
+   // The next update does not overwrite this segment until the GPU is done with it
+   if ( system->backend == ES_PARTICLES_CPU && drawn > 0 )
+   {
+      if ( system->fences[system->segment] != NULL )
+      {
+         glDeleteSync ( system->fences[system->segment] );
+      }
+
+      system->fences[system->segment] = glFenceSync ( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+   }
+
+   esProfilerItems ( drawn );
+   esProfilerEnd ();
+
+   system->totalLive += drawn;
+   system->numFrames++;
+}
+
+///
+// esParticleSystemLiveCount()
+//
+//    Total live particles of all emitters
+//
+int ESUTIL_API esParticleSystemLiveCount ( const ESParticleSystem *system )
+{
+   int live = 0;
+   int i;
+
+   for ( i = 0; i < system->numEmitters; i++ )
+   {
+      live += system->emitters[i].live;
+   }
+
+   return live;
+}
+
+///
+// esParticleSystemDestroy()
+//
+//    Log the statistics and delete the GL objects
+//
+void ESUTIL_API esParticleSystemDestroy ( ESParticleSystem *system )
+{
+   int i;
+
+   if ( system == NULL )
+   {
+      return;
+   }
+
+   if ( system->numFrames > 0 )
+   {
+      esLogMessage ( "Particles (%s): %d of %d slots reserved, %.0f live and %.1f emitted per frame over %d frames\n",
+                     system->backend == ES_PARTICLES_CPU ? "CPU" : "transform feedback",
+                     system->used, system->capacity, system->totalLive / system->numFrames,
+                     system->totalEmitted / system->numFrames, system->numFrames );
+   }
+
+   for ( i = 0; i < STREAM_SEGMENTS; i++ )
+   {
+      if ( system->fences[i] != NULL )
+      {
+         glDeleteSync ( system->fences[i] );
+      }
+   }
+
+   glDeleteBuffers ( 1, &system->buffer );
+   glDeleteBuffers ( 1, &system->streamBuffer );
+   glDeleteVertexArrays ( 1, &system->emitVertexArray );
+   glDeleteVertexArrays ( 1, &system->drawVertexArray );
+   glDeleteVertexArrays ( 1, &system->compositeVertexArray );
+   glDeleteFramebuffers ( 1, &system->offscreenFramebuffer );
+   glDeleteTextures ( 1, &system->offscreenTexture );
+   esDeleteProgram ( system->emitProgram );
+   esDeleteProgram ( system->drawProgram );
+   esDeleteProgram ( system->compositeProgram );
+
+   free ( system->particles.x );
+   free ( system->sortMemory );
+   free ( system );
+}
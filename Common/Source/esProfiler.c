@@ -0,0 +1,463 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// ESProfiler.c
+//
+//    Named GPU timing scopes.  Uses EXT_disjoint_timer_query when it is
+//    available and falls back to CPU timing around glFinish otherwise.
+//    Profiling is off unless the ES_PROFILE environment variable is set,
+//    the scopes are then no-ops so they cost nothing in normal runs.
+//
+
+///
+//  Includes
+//
+#include "esUtil.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#ifndef __APPLE__
+#include <GLES2/gl2ext.h>
+#endif
+
+///
+// Defines
+//
+#define MAX_SCOPES        32
+#define MAX_NAME_LENGTH   64
+
+// Queries in flight per scope.  Results are read a few frames after they
+// were issued so the readback never waits on the GPU.
+#define QUERY_RING_SIZE   8
+
+///
+// Types
+//
+typedef struct
+{
+   char     name[MAX_NAME_LENGTH];
+
+   // Ring of timer queries and whether each one is waiting for its result
+   GLuint   queries[QUERY_RING_SIZE];
+   GLboolean pending[QUERY_RING_SIZE];
+   int      nextQuery;
+
+   // Query issued by the open scope, -1 if none
+   int      activeQuery;
+
+   // Accumulated GPU (or glFinish bracketed) time in ms
+   double   totalTime;
+   int      numSamples;
+
+   // Accumulated CPU submission time in ms
+   double   totalCpuTime;
+   int      numCpuSamples;
+   double   cpuStart;
+
+   // Samples skipped because every query in the ring was still in flight
+   int      numDropped;
+
+   // Items processed, set with esProfilerItems, and the samples that set them
+   double   totalItems;
+   int      numItemSamples;
+} ProfileScope;
+
+typedef struct
+{
+   GLboolean    initialized;
+   GLboolean    enabled;
+   GLboolean    useTimerQuery;
+   ProfileScope scopes[MAX_SCOPES];
+   int          numScopes;
+   ProfileScope *current;
+
+   // esProfilerBegin calls not yet ended.  Only the outermost one is timed
+   // since timer queries cannot be nested, the others are rejected.
+   int          depth;
+   GLboolean    nestingReported;
+
+#ifdef GL_EXT_disjoint_timer_query
+   PFNGLGENQUERIESEXTPROC          genQueries;
+   PFNGLDELETEQUERIESEXTPROC       deleteQueries;
+   PFNGLBEGINQUERYEXTPROC          beginQuery;
+   PFNGLENDQUERYEXTPROC            endQuery;
+   PFNGLGETQUERYOBJECTUIVEXTPROC   getQueryObjectuiv;
+   PFNGLGETQUERYOBJECTUI64VEXTPROC getQueryObjectui64v;
+#endif
+} Profiler;
+
+static Profiler s_profiler;
+
+//////////////////////////////////////////////////////////////////
+//
+//  Private Functions
+//
+//
+
+///
+// GetTime()
+//
+//    Monotonic time in milliseconds
+//
+static double GetTime ( void )
+{
+#ifdef _WIN32
+   LARGE_INTEGER frequency, counter;
+   QueryPerformanceFrequency ( &frequency );
+   QueryPerformanceCounter ( &counter );
+   return ( double ) counter.QuadPart * 1000.0 / ( double ) frequency.QuadPart;
+#else
+   struct timespec ts;
+   clock_gettime ( CLOCK_MONOTONIC, &ts );
+   return ts.tv_sec * 1000.0 + ts.tv_nsec * 1e-6;
+#endif
+}
+
+///
+// ProfilerInit()
+//
+//    Check for ES_PROFILE and EXT_disjoint_timer_query on first use and
+//    load the extension entry points
+//
+static void ProfilerInit ( void )
+{
+   const char *profile = getenv ( "ES_PROFILE" );
+
+   memset ( &s_profiler, 0, sizeof ( Profiler ) );
+   s_profiler.initialized = GL_TRUE;
+   s_profiler.enabled = profile != NULL && strcmp ( profile, "0" ) != 0;
+
+   if ( !s_profiler.enabled )
+   {
+      return;
+   }
+
+#if defined ( GL_EXT_disjoint_timer_query ) && !defined ( __APPLE__ )
+   {
+      const char *extensions = ( const char * ) glGetString ( GL_EXTENSIONS );
+
+      if ( extensions == NULL || strstr ( extensions, "GL_EXT_disjoint_timer_query" ) == NULL )
+      {
+         return;
+      }
+
+      s_profiler.genQueries = ( PFNGLGENQUERIESEXTPROC ) eglGetProcAddress ( "glGenQueriesEXT" );
+      s_profiler.deleteQueries = ( PFNGLDELETEQUERIESEXTPROC ) eglGetProcAddress ( "glDeleteQueriesEXT" );
+      s_profiler.beginQuery = ( PFNGLBEGINQUERYEXTPROC ) eglGetProcAddress ( "glBeginQueryEXT" );
+      s_profiler.endQuery = ( PFNGLENDQUERYEXTPROC ) eglGetProcAddress ( "glEndQueryEXT" );
+      s_profiler.getQueryObjectuiv = ( PFNGLGETQUERYOBJECTUIVEXTPROC ) eglGetProcAddress ( "glGetQueryObjectuivEXT" );
+      s_profiler.getQueryObjectui64v = ( PFNGLGETQUERYOBJECTUI64VEXTPROC ) eglGetProcAddress ( "glGetQueryObjectui64vEXT" );
+
+      s_profiler.useTimerQuery = s_profiler.genQueries != NULL && s_profiler.deleteQueries != NULL &&
+                                 s_profiler.beginQuery != NULL && s_profiler.endQuery != NULL &&
+                                 s_profiler.getQueryObjectuiv != NULL && s_profiler.getQueryObjectui64v != NULL;
+   }
+#endif
+}
+
+///
+// FindScope()
+//
+//    Look up a scope by name, creating it on first use
+//
+static ProfileScope *FindScope ( const char *name )
+{
+   ProfileScope *scope;
+   int i;
+
+   for ( i = 0; i < s_profiler.numScopes; i++ )
+   {
+      if ( strcmp ( s_profiler.scopes[i].name, name ) == 0 )
+      {
+         return &s_profiler.scopes[i];
+      }
+   }
+
+   if ( s_profiler.numScopes == MAX_SCOPES )
+   {
+      return NULL;
+   }
+
+   scope = &s_profiler.scopes[s_profiler.numScopes++];
+   strncpy ( scope->name, name, MAX_NAME_LENGTH - 1 );
+   scope->activeQuery = -1;
+
+#ifdef GL_EXT_disjoint_timer_query
+   if ( s_profiler.useTimerQuery )
+   {
+      s_profiler.genQueries ( QUERY_RING_SIZE, scope->queries );
+   }
+#endif
+
+   return scope;
+}
+
+///
+// CollectResults()
+//
+//    Read back every query whose result is available.  If wait is set, block
+//    until all pending results are in.  Results are thrown away when the GPU
+//    reports a disjoint event since they are not meaningful.
+//
+static void CollectResults ( GLboolean wait )
+{
+#ifdef GL_EXT_disjoint_timer_query
+   GLint disjoint = 0;
+   int i, j;
+
+   glGetIntegerv ( GL_GPU_DISJOINT_EXT, &disjoint );
+
+   for ( i = 0; i < s_profiler.numScopes; i++ )
+   {
+      ProfileScope *scope = &s_profiler.scopes[i];
+
+      for ( j = 0; j < QUERY_RING_SIZE; j++ )
+      {
+         GLuint available = GL_FALSE;
+         GLuint64 elapsed = 0;
+
+         if ( !scope->pending[j] )
+         {
+            continue;
+         }
+
+         if ( !wait )
+         {
+            s_profiler.getQueryObjectuiv ( scope->queries[j], GL_QUERY_RESULT_AVAILABLE_EXT, &available );
+
+            if ( !available )
+            {
+               continue;
+            }
+         }
+
+         s_profiler.getQueryObjectui64v ( scope->queries[j], GL_QUERY_RESULT_EXT, &elapsed );
+         scope->pending[j] = GL_FALSE;
+
+         if ( !disjoint )
+         {
+            scope->totalTime += ( double ) elapsed * 1e-6;
+            scope->numSamples++;
+         }
+      }
+   }
+#endif
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//  Public Functions
+//
+//
+
+//
+/// \brief Begin a named profiling scope
+/// \param name Name of the scope, times are accumulated per name
+//
+void ESUTIL_API esProfilerBegin ( const char *name )
+{
+   ProfileScope *scope;
+
+   if ( !s_profiler.initialized )
+   {
+      ProfilerInit ();
+   }
+
+   if ( !s_profiler.enabled )
+   {
+      return;
+   }
+
+   if ( s_profiler.depth++ > 0 )
+   {
+      if ( !s_profiler.nestingReported )
+      {
+         esLogMessage ( "Profiler: scope \"%s\" nested in \"%s\" is ignored, scopes cannot be nested\n", name,
+                        s_profiler.current != NULL ? s_profiler.current->name : "?" );
+         s_profiler.nestingReported = GL_TRUE;
+      }
+
+      return;
+   }
+
+   scope = FindScope ( name );
+   s_profiler.current = scope;
+
+   if ( scope == NULL )
+   {
+      return;
+   }
+
+   if ( s_profiler.useTimerQuery )
+   {
+#ifdef GL_EXT_disjoint_timer_query
+      CollectResults ( GL_FALSE );
+
+      // Skip this sample rather than stall if the ring is still in flight
+      if ( scope->pending[scope->nextQuery] )
+      {
+         scope->activeQuery = -1;
+         scope->numDropped++;
+      }
+      else
+      {
+         scope->activeQuery = scope->nextQuery;
+         scope->nextQuery = ( scope->nextQuery + 1 ) % QUERY_RING_SIZE;
+         s_profiler.beginQuery ( GL_TIME_ELAPSED_EXT, scope->queries[scope->activeQuery] );
+      }
+#endif
+   }
+   else
+   {
+      glFinish ();
+   }
+
+   scope->cpuStart = GetTime ();
+}
+
+//
+/// \brief End the scope opened by the last esProfilerBegin
+//
+void ESUTIL_API esProfilerEnd ( void )
+{
+   ProfileScope *scope = s_profiler.current;
+   double cpuTime;
+
+   // Unbalanced, or the end of a rejected nested scope
+   if ( s_profiler.depth == 0 || --s_profiler.depth > 0 || scope == NULL )
+   {
+      return;
+   }
+
+   s_profiler.current = NULL;
+
+   if ( s_profiler.useTimerQuery )
+   {
+      cpuTime = GetTime () - scope->cpuStart;
+
+#ifdef GL_EXT_disjoint_timer_query
+      if ( scope->activeQuery >= 0 )
+      {
+         s_profiler.endQuery ( GL_TIME_ELAPSED_EXT );
+         scope->pending[scope->activeQuery] = GL_TRUE;
+         scope->activeQuery = -1;
+      }
+#endif
+   }
+   else
+   {
+      cpuTime = GetTime () - scope->cpuStart;
+      glFinish ();
+      scope->totalTime += GetTime () - scope->cpuStart;
+      scope->numSamples++;
+   }
+
+   scope->totalCpuTime += cpuTime;
+   scope->numCpuSamples++;
+}
+
+//
+/// \brief Record the number of items processed by the open scope
+/// \param count Number of items
+//
+void ESUTIL_API esProfilerItems ( double count )
+{
+   ProfileScope *scope = s_profiler.current;
+
+   // Items counted inside a rejected nested scope do not belong to the open one
+   if ( scope == NULL || s_profiler.depth != 1 )
+   {
+      return;
+   }
+
+   scope->totalItems += count;
+   scope->numItemSamples++;
+}
+
+//
+/// \brief Log the average time of every scope and delete the query objects
+//
+void ESUTIL_API esProfilerShutdown ( void )
+{
+   int i;
+
+   if ( !s_profiler.enabled )
+   {
+      memset ( &s_profiler, 0, sizeof ( Profiler ) );
+      return;
+   }
+
+   if ( s_profiler.useTimerQuery )
+   {
+      CollectResults ( GL_TRUE );
+   }
+
+   esLogMessage ( "Profiler (%s):\n", s_profiler.useTimerQuery ?
+                  "EXT_disjoint_timer_query" : "CPU timing with glFinish" );
+   esLogMessage ( "  %-24s %12s %12s %8s %8s %12s %12s\n", "scope", "gpu avg ms", "cpu avg ms", "samples", "dropped",
+                  "gpu ms / M", "cpu ms / M" );
+
+   for ( i = 0; i < s_profiler.numScopes; i++ )
+   {
+      ProfileScope *scope = &s_profiler.scopes[i];
+      double gpuTime = scope->numSamples > 0 ? scope->totalTime / scope->numSamples : 0.0;
+      double cpuTime = scope->numCpuSamples > 0 ? scope->totalCpuTime / scope->numCpuSamples : 0.0;
+      double items = scope->numItemSamples > 0 ? scope->totalItems / scope->numItemSamples : 0.0;
+
+      // Time per million items, for scopes that recorded them with esProfilerItems
+      if ( items > 0.0 )
+      {
+         esLogMessage ( "  %-24s %12.3f %12.3f %8d %8d %12.3f %12.3f\n", scope->name, gpuTime, cpuTime,
+                        scope->numSamples, scope->numDropped, gpuTime * 1e6 / items, cpuTime * 1e6 / items );
+      }
+      else
+      {
+         esLogMessage ( "  %-24s %12.3f %12.3f %8d %8d %12s %12s\n", scope->name, gpuTime, cpuTime,
+                        scope->numSamples, scope->numDropped, "-", "-" );
+      }
+
+#ifdef GL_EXT_disjoint_timer_query
+      if ( s_profiler.useTimerQuery )
+      {
+         s_profiler.deleteQueries ( QUERY_RING_SIZE, scope->queries );
+      }
+#endif
+   }
+
+   memset ( &s_profiler, 0, sizeof ( Profiler ) );
+}
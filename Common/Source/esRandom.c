@@ -0,0 +1,329 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// ESRandom.c
+//
+//    Seeded pseudo random numbers.  Four xoshiro128** generators run side
+//    by side, stepped together with SSE or NEON, and their outputs are
+//    handed out in order.  Each generator state belongs to one thread, so
+//    there is no shared state to contend for and a seed always gives the
+//    same sequence, unlike rand().
+//
+
+///
+//  Includes
+//
+#include "esUtil.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define RANDOM_NEON
+#include <arm_neon.h>
+#elif defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+#define RANDOM_SSE
+#include <emmintrin.h>
+#endif
+
+///
+// Defines
+//
+#define NUM_LANES   4
+
+// 2^-24, turns the top 24 bits of an output into a float in [0, 1)
+#define FLOAT_SCALE   5.9604644775390625e-8f
+
+//////////////////////////////////////////////////////////////////
+//
+//  Private Functions
+//
+//
+
+#if !defined(RANDOM_SSE) && !defined(RANDOM_NEON)
+///
+// RotateLeft()
+//
+static GLuint RotateLeft ( GLuint x, int bits )
+{
+   return ( x << bits ) | ( x >> ( 32 - bits ) );
+}
+#endif
+
+///
+// SplitMix64()
+//
+//    Seed expansion recommended for xoshiro, so nearby seeds give
+//    unrelated states
+//
+static unsigned long long SplitMix64 ( unsigned long long *x )
+{
+   unsigned long long z = ( *x += 0x9e3779b97f4a7c15ULL );
+
+   z = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9ULL;
+   z = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111ebULL;
+   return z ^ ( z >> 31 );
+}
+
+///
+// StepLanes()
+//
+//    Advance all four generators by one step and return their outputs
+//
+static void StepLanes ( ESRandom *rng, GLuint out[NUM_LANES] )
+{
+#if defined(RANDOM_SSE)
+   __m128i s0 = _mm_loadu_si128 ( ( const __m128i * ) rng->state[0] );
+   __m128i s1 = _mm_loadu_si128 ( ( const __m128i * ) rng->state[1] );
+   __m128i s2 = _mm_loadu_si128 ( ( const __m128i * ) rng->state[2] );
+   __m128i s3 = _mm_loadu_si128 ( ( const __m128i * ) rng->state[3] );
+   __m128i result, t;
+
+   // rotl ( s1 * 5, 7 ) * 9, the multiplies as shifts and adds for SSE2
+   result = _mm_add_epi32 ( _mm_slli_epi32 ( s1, 2 ), s1 );
+   result = _mm_or_si128 ( _mm_slli_epi32 ( result, 7 ), _mm_srli_epi32 ( result, 25 ) );
+   result = _mm_add_epi32 ( _mm_slli_epi32 ( result, 3 ), result );
+
+   t = _mm_slli_epi32 ( s1, 9 );
+   s2 = _mm_xor_si128 ( s2, s0 );
+   s3 = _mm_xor_si128 ( s3, s1 );
+   s1 = _mm_xor_si128 ( s1, s2 );
+   s0 = _mm_xor_si128 ( s0, s3 );
+   s2 = _mm_xor_si128 ( s2, t );
+   s3 = _mm_or_si128 ( _mm_slli_epi32 ( s3, 11 ), _mm_srli_epi32 ( s3, 21 ) );
+
+   _mm_storeu_si128 ( ( __m128i * ) rng->state[0], s0 );
+   _mm_storeu_si128 ( ( __m128i * ) rng->state[1], s1 );
+   _mm_storeu_si128 ( ( __m128i * ) rng->state[2], s2 );
+   _mm_storeu_si128 ( ( __m128i * ) rng->state[3], s3 );
+   _mm_storeu_si128 ( ( __m128i * ) out, result );
+#elif defined(RANDOM_NEON)
+   uint32x4_t s0 = vld1q_u32 ( rng->state[0] );
+   uint32x4_t s1 = vld1q_u32 ( rng->state[1] );
+   uint32x4_t s2 = vld1q_u32 ( rng->state[2] );
+   uint32x4_t s3 = vld1q_u32 ( rng->state[3] );
+   uint32x4_t result, t;
+
+   result = vmulq_n_u32 ( s1, 5 );
+   result = vorrq_u32 ( vshlq_n_u32 ( result, 7 ), vshrq_n_u32 ( result, 25 ) );
+   result = vmulq_n_u32 ( result, 9 );
+
+   t = vshlq_n_u32 ( s1, 9 );
+   s2 = veorq_u32 ( s2, s0 );
+   s3 = veorq_u32 ( s3, s1 );
+   s1 = veorq_u32 ( s1, s2 );
+   s0 = veorq_u32 ( s0, s3 );
+   s2 = veorq_u32 ( s2, t );
+   s3 = vorrq_u32 ( vshlq_n_u32 ( s3, 11 ), vshrq_n_u32 ( s3, 21 ) );
+
+   vst1q_u32 ( rng->state[0], s0 );
+   vst1q_u32 ( rng->state[1], s1 );
+   vst1q_u32 ( rng->state[2], s2 );
+   vst1q_u32 ( rng->state[3], s3 );
+   vst1q_u32 ( out, result );
+#else
+   int lane;
+
+   for ( lane = 0; lane < NUM_LANES; lane++ )
+   {
+      GLuint *s0 = &rng->state[0][lane];
+      GLuint *s1 = &rng->state[1][lane];
+      GLuint *s2 = &rng->state[2][lane];
+      GLuint *s3 = &rng->state[3][lane];
+      GLuint  t = *s1 << 9;
+
+      out[lane] = RotateLeft ( *s1 * 5, 7 ) * 9;
+
+      *s2 ^= *s0;
+      *s3 ^= *s1;
+      *s1 ^= *s2;
+      *s0 ^= *s3;
+      *s2 ^= t;
+      *s3 = RotateLeft ( *s3, 11 );
+   }
+#endif
+}
+
+///
+// JumpLanes()
+//
+//    Advance every generator by 2^64 steps, so up to 2^64 streams of 2^64
+//    numbers never overlap
+//
+static void JumpLanes ( ESRandom *rng )
+{
+   static const GLuint jump[4] = { 0x8764000b, 0xf542d2d3, 0x6fa035c3, 0x77f2db5b };
+   GLuint acc[4][NUM_LANES] = { { 0 } };
+   GLuint unused[NUM_LANES];
+   int    i, b, w, lane;
+
+   for ( i = 0; i < 4; i++ )
+   {
+      for ( b = 0; b < 32; b++ )
+      {
+         for ( lane = 0; lane < NUM_LANES; lane++ )
+         {
+            if ( jump[i] & ( 1u << b ) )
+            {
+               for ( w = 0; w < 4; w++ )
+               {
+                  acc[w][lane] ^= rng->state[w][lane];
+               }
+            }
+         }
+
+         StepLanes ( rng, unused );
+      }
+   }
+
+   for ( w = 0; w < 4; w++ )
+   {
+      for ( lane = 0; lane < NUM_LANES; lane++ )
+      {
+         rng->state[w][lane] = acc[w][lane];
+      }
+   }
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//  Public Functions
+//
+//
+
+///
+// esRandomSeed()
+//
+//    Expand the seed into the four generator states, then jump them to the
+//    requested stream
+//
+void ESUTIL_API esRandomSeed ( ESRandom *rng, unsigned long long seed, unsigned int stream )
+{
+   int w, lane;
+
+   for ( lane = 0; lane < NUM_LANES; lane++ )
+   {
+      for ( w = 0; w < 4; w += 2 )
+      {
+         unsigned long long value = SplitMix64 ( &seed );
+
+         rng->state[w][lane] = ( GLuint ) value;
+         rng->state[w + 1][lane] = ( GLuint ) ( value >> 32 );
+      }
+   }
+
+   while ( stream-- > 0 )
+   {
+      JumpLanes ( rng );
+   }
+
+   rng->next = NUM_LANES;
+}
+
+///
+// esRandomUint()
+//
+//    Next 32-bit output, stepping the generators every fourth call
+//
+GLuint ESUTIL_API esRandomUint ( ESRandom *rng )
+{
+   if ( rng->next == NUM_LANES )
+   {
+      StepLanes ( rng, rng->buffer );
+      rng->next = 0;
+   }
+
+   return rng->buffer[rng->next++];
+}
+
+///
+// esRandomFloat()
+//
+//    Uniform float in [0, 1) from the top 24 bits of the next output
+//
+GLfloat ESUTIL_API esRandomFloat ( ESRandom *rng )
+{
+   return ( GLfloat ) ( esRandomUint ( rng ) >> 8 ) * FLOAT_SCALE;
+}
+
+///
+// esRandomRange()
+//
+//    Uniform float in [min, max)
+//
+GLfloat ESUTIL_API esRandomRange ( ESRandom *rng, GLfloat min, GLfloat max )
+{
+   return min + esRandomFloat ( rng ) * ( max - min );
+}
+
+///
+// esRandomFloats()
+//
+//    Fill an array with uniform floats in [min, max), four per step.  Gives
+//    the same values as calling esRandomRange count times.
+//
+void ESUTIL_API esRandomFloats ( ESRandom *rng, GLfloat *dst, int count, GLfloat min, GLfloat max )
+{
+   GLfloat range = max - min;
+   int     i = 0;
+
+   // Outputs left over from esRandomUint come first
+   while ( i < count && rng->next < NUM_LANES )
+   {
+      dst[i++] = esRandomRange ( rng, min, max );
+   }
+
+#if defined(RANDOM_SSE) || defined(RANDOM_NEON)
+
+   for ( ; i + NUM_LANES <= count; i += NUM_LANES )
+   {
+      GLuint bits[NUM_LANES];
+#if defined(RANDOM_SSE)
+      __m128 value;
+
+      StepLanes ( rng, bits );
+      value = _mm_cvtepi32_ps ( _mm_srli_epi32 ( _mm_loadu_si128 ( ( const __m128i * ) bits ), 8 ) );
+      value = _mm_mul_ps ( value, _mm_set1_ps ( FLOAT_SCALE ) );
+      _mm_storeu_ps ( dst + i, _mm_add_ps ( _mm_set1_ps ( min ), _mm_mul_ps ( value, _mm_set1_ps ( range ) ) ) );
+#else
+      float32x4_t value;
+
+      StepLanes ( rng, bits );
+      value = vcvtq_f32_u32 ( vshrq_n_u32 ( vld1q_u32 ( bits ), 8 ) );
+      value = vmulq_f32 ( value, vdupq_n_f32 ( FLOAT_SCALE ) );
+      vst1q_f32 ( dst + i, vaddq_f32 ( vdupq_n_f32 ( min ), vmulq_f32 ( value, vdupq_n_f32 ( range ) ) ) );
+#endif
+   }
+
+#endif
+
+   for ( ; i < count; i++ )
+   {
+      dst[i] = min + esRandomFloat ( rng ) * range;
+   }
+}
@@ -38,7 +38,100 @@
 //  Includes
 //
 #include "esUtil.h"
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#define mkdir( path, mode ) _mkdir ( path )
+#define getpid _getpid
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+#ifndef __APPLE__
+#include <GLES2/gl2ext.h>
+#endif
+
+// KHR_parallel_shader_compile is newer than the bundled gl2ext.h
+#ifndef GL_KHR_parallel_shader_compile
+#define GL_COMPLETION_STATUS_KHR          0x91B1
+#ifndef __APPLE__
+typedef void ( GL_APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC ) ( GLuint count );
+#endif
+#endif
+
+///
+// Defines
+//
+#define MAX_PATH_LENGTH          512
+
+#define FNV_OFFSET_BASIS         0xCBF29CE484222325ULL
+
+// "ESPB" followed by the cache file version
+#define PROGRAM_CACHE_MAGIC      0x42505345
+#define PROGRAM_CACHE_VERSION    1
+
+///
+// Types
+//
+typedef struct
+{
+   GLuint      magic;
+   GLuint      version;
+   GLenum      binaryFormat;
+   GLint       binaryLength;
+} ProgramCacheHeader;
+
+typedef struct
+{
+   GLboolean   initialized;
+
+   // Empty when the cache is disabled
+   char        directory[MAX_PATH_LENGTH];
+} ProgramCache;
+
+typedef struct
+{
+   GLboolean   initialized;
+
+   // KHR_parallel_shader_compile is supported
+   GLboolean   supported;
+} ParallelCompile;
+
+// Entry in a name lookup table, name is NULL for an empty slot
+typedef struct
+{
+   unsigned int   hash;
+   GLint          value;
+   char          *name;
+} ProgramSymbol;
+
+// Open addressing hash table, capacity is a power of two
+typedef struct
+{
+   ProgramSymbol *symbols;
+   int            capacity;
+   int            count;
+} SymbolTable;
+
+// Names of the active resources of a program
+typedef struct ProgramInfo
+{
+   GLuint               programObject;
+   SymbolTable          uniforms;
+   SymbolTable          attributes;
+   SymbolTable          uniformBlocks;
+   struct ProgramInfo  *next;
+} ProgramInfo;
+
+static ProgramCache    s_programCache;
+static ParallelCompile s_parallelCompile;
+static ProgramInfo    *s_programInfos;
 
 //////////////////////////////////////////////////////////////////
 //
@@ -46,41 +139,298 @@
 //
 //
 
+///
+// HashString()
+//
+//    64-bit FNV-1a hash, including the terminating null so that
+//    consecutive strings cannot run into each other
+//
+static unsigned long long HashString ( unsigned long long hash, const char *str )
+{
+   if ( str == NULL )
+   {
+      str = "";
+   }
 
+   do
+   {
+      hash ^= ( unsigned char ) *str;
+      hash *= 0x100000001B3ULL;
+   }
+   while ( *str++ != '\0' );
 
-//////////////////////////////////////////////////////////////////
+   return hash;
+}
+
+///
+// MakeDirectory()
 //
-//  Public Functions
+//    Create a directory and any missing parents
 //
+static void MakeDirectory ( const char *directory )
+{
+   char path[MAX_PATH_LENGTH];
+   char *p;
+
+   strncpy ( path, directory, MAX_PATH_LENGTH - 1 );
+   path[MAX_PATH_LENGTH - 1] = '\0';
+
+   for ( p = path + 1; *p != '\0'; p++ )
+   {
+      if ( *p == '/' || *p == '\\' )
+      {
+         *p = '\0';
+         mkdir ( path, 0755 );
+         *p = '/';
+      }
+   }
+
+   mkdir ( path, 0755 );
+}
+
+///
+// GetProgramCacheDirectory()
 //
+//    Returns the cache directory, NULL if the cache is disabled.  The cache
+//    is off unless ES_PROGRAM_CACHE_DIR names a directory or the application
+//    sets one, so nothing is written to disk by default.
+//
+static const char *GetProgramCacheDirectory ( void )
+{
+   if ( !s_programCache.initialized )
+   {
+      const char *directory = getenv ( "ES_PROGRAM_CACHE_DIR" );
 
+      s_programCache.initialized = GL_TRUE;
+
+      if ( directory != NULL )
+      {
+         strncpy ( s_programCache.directory, directory, MAX_PATH_LENGTH - 1 );
+      }
+
+      if ( s_programCache.directory[0] != '\0' )
+      {
+         MakeDirectory ( s_programCache.directory );
+      }
+   }
+
+   return s_programCache.directory[0] != '\0' ? s_programCache.directory : NULL;
+}
+
+///
+// GetProgramCacheKey()
 //
+//    Hash everything that affects the binary of a program.  Returns GL_FALSE
+//    if the cache is disabled.
+//
+static GLboolean GetProgramCacheKey ( const ESProgram *program, unsigned long long *key )
+{
+   unsigned long long hash = FNV_OFFSET_BASIS;
+   GLint numFormats = 0;
+   char mode[16];
+   GLsizei i;
+
+   if ( GetProgramCacheDirectory() == NULL )
+   {
+      return GL_FALSE;
+   }
+
+   // The driver has to support at least one binary format
+   glGetIntegerv ( GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats );
+
+   if ( numFormats == 0 )
+   {
+      return GL_FALSE;
+   }
+
+   hash = HashString ( hash, program->vertShaderSrc );
+   hash = HashString ( hash, program->fragShaderSrc );
+
+   for ( i = 0; i < program->numVaryings; i++ )
+   {
+      hash = HashString ( hash, program->varyings[i] );
+   }
+
+   snprintf ( mode, sizeof ( mode ), "%d:%x", ( int ) program->numVaryings, ( unsigned int ) program->bufferMode );
+   hash = HashString ( hash, mode );
+
+   // Binaries are only valid for the driver that produced them
+   hash = HashString ( hash, ( const char * ) glGetString ( GL_RENDERER ) );
+   hash = HashString ( hash, ( const char * ) glGetString ( GL_VERSION ) );
+
+   *key = hash;
+   return GL_TRUE;
+}
+
 ///
-/// \brief Load a shader, check for compile errors, print error messages to output log
-/// \param type Type of shader (GL_VERTEX_SHADER or GL_FRAGMENT_SHADER)
-/// \param shaderSrc Shader source string
-/// \return A new shader object on success, 0 on failure
+// GetProgramCacheFileName()
 //
-GLuint ESUTIL_API esLoadShader ( GLenum type, const char *shaderSrc )
+static void GetProgramCacheFileName ( char *fileName, unsigned long long key )
 {
-   GLuint shader;
-   GLint compiled;
+   snprintf ( fileName, MAX_PATH_LENGTH, "%s/%016llx.bin", GetProgramCacheDirectory(), key );
+}
+
+///
+// LoadProgramBinary()
+//
+//    Create a program from a cached binary, 0 on a miss or if the driver
+//    rejects the binary
+//
+static GLuint LoadProgramBinary ( unsigned long long key )
+{
+   ProgramCacheHeader header;
+   char fileName[MAX_PATH_LENGTH];
+   GLuint programObject = 0;
+   GLint linked = 0;
+   void *binary;
+   FILE *fp;
 
-   // Create the shader object
-   shader = glCreateShader ( type );
+   GetProgramCacheFileName ( fileName, key );
+   fp = fopen ( fileName, "rb" );
 
-   if ( shader == 0 )
+   if ( fp == NULL )
    {
       return 0;
    }
 
-   // Load the shader source
-   glShaderSource ( shader, 1, &shaderSrc, NULL );
+   if ( fread ( &header, sizeof ( header ), 1, fp ) != 1 ||
+         header.magic != PROGRAM_CACHE_MAGIC || header.version != PROGRAM_CACHE_VERSION ||
+         header.binaryLength <= 0 )
+   {
+      fclose ( fp );
+      return 0;
+   }
 
-   // Compile the shader
-   glCompileShader ( shader );
+   binary = malloc ( header.binaryLength );
+
+   if ( binary != NULL && fread ( binary, header.binaryLength, 1, fp ) == 1 )
+   {
+      programObject = glCreateProgram ( );
+      glProgramBinary ( programObject, header.binaryFormat, binary, header.binaryLength );
+      glGetProgramiv ( programObject, GL_LINK_STATUS, &linked );
+
+      if ( !linked )
+      {
+         glDeleteProgram ( programObject );
+         programObject = 0;
+      }
+   }
+
+   free ( binary );
+   fclose ( fp );
+
+   return programObject;
+}
+
+///
+// SaveProgramBinary()
+//
+//    Store the binary of a linked program in the cache.  The file is written
+//    under a temporary name and renamed so readers never see a partial file.
+//
+static void SaveProgramBinary ( unsigned long long key, GLuint programObject )
+{
+   ProgramCacheHeader header;
+   char fileName[MAX_PATH_LENGTH];
+   char tempName[MAX_PATH_LENGTH + 32];
+   void *binary;
+   FILE *fp;
+
+   header.magic = PROGRAM_CACHE_MAGIC;
+   header.version = PROGRAM_CACHE_VERSION;
+   header.binaryLength = 0;
+   glGetProgramiv ( programObject, GL_PROGRAM_BINARY_LENGTH, &header.binaryLength );
+
+   if ( header.binaryLength <= 0 || ( binary = malloc ( header.binaryLength ) ) == NULL )
+   {
+      return;
+   }
+
+   glGetProgramBinary ( programObject, header.binaryLength, NULL, &header.binaryFormat, binary );
+
+   GetProgramCacheFileName ( fileName, key );
+   snprintf ( tempName, sizeof ( tempName ), "%s.%d.tmp", fileName, ( int ) getpid () );
+   fp = fopen ( tempName, "wb" );
+
+   if ( fp != NULL )
+   {
+      int written = fwrite ( &header, sizeof ( header ), 1, fp ) == 1 &&
+                    fwrite ( binary, header.binaryLength, 1, fp ) == 1;
+
+      if ( fclose ( fp ) != 0 || !written || rename ( tempName, fileName ) != 0 )
+      {
+         remove ( tempName );
+      }
+   }
+
+   free ( binary );
+}
+
+///
+// InitParallelCompile()
+//
+//    Check for KHR_parallel_shader_compile on first use and let the driver
+//    compile on as many threads as it wants
+//
+static void InitParallelCompile ( void )
+{
+   if ( s_parallelCompile.initialized )
+   {
+      return;
+   }
+
+   s_parallelCompile.initialized = GL_TRUE;
+
+#ifndef __APPLE__
+   {
+      const char *extensions = ( const char * ) glGetString ( GL_EXTENSIONS );
+      PFNGLMAXSHADERCOMPILERTHREADSKHRPROC maxShaderCompilerThreads;
+
+      if ( extensions == NULL || strstr ( extensions, "GL_KHR_parallel_shader_compile" ) == NULL )
+      {
+         return;
+      }
+
+      maxShaderCompilerThreads =
+         ( PFNGLMAXSHADERCOMPILERTHREADSKHRPROC ) eglGetProcAddress ( "glMaxShaderCompilerThreadsKHR" );
+
+      if ( maxShaderCompilerThreads != NULL )
+      {
+         maxShaderCompilerThreads ( 0xFFFFFFFF );
+      }
+
+      s_parallelCompile.supported = GL_TRUE;
+   }
+#endif
+}
+
+///
+// CompileShader()
+//
+//    Create a shader and start compiling it without waiting for the result
+//
+static GLuint CompileShader ( GLenum type, const char *shaderSrc )
+{
+   GLuint shader = glCreateShader ( type );
+
+   if ( shader != 0 )
+   {
+      glShaderSource ( shader, 1, &shaderSrc, NULL );
+      glCompileShader ( shader );
+   }
+
+   return shader;
+}
+
+///
+// CheckShaderCompiled()
+//
+//    Wait for a shader to compile, print error messages to output log
+//
+static GLboolean CheckShaderCompiled ( GLuint shader )
+{
+   GLint compiled;
 
-   // Check the compile status
    glGetShaderiv ( shader, GL_COMPILE_STATUS, &compiled );
 
    if ( !compiled )
@@ -98,87 +448,632 @@ GLuint ESUTIL_API esLoadShader ( GLenum type, const char *shaderSrc )
 
          free ( infoLog );
       }
+   }
+
+   return compiled ? GL_TRUE : GL_FALSE;
+}
+
+///
+// CheckProgramLinked()
+//
+//    Wait for a program to link, print error messages to output log
+//
+static GLboolean CheckProgramLinked ( GLuint programObject )
+{
+   GLint linked;
+
+   glGetProgramiv ( programObject, GL_LINK_STATUS, &linked );
 
+   if ( !linked )
+   {
+      GLint infoLen = 0;
+
+      glGetProgramiv ( programObject, GL_INFO_LOG_LENGTH, &infoLen );
+
+      if ( infoLen > 1 )
+      {
+         char *infoLog = malloc ( sizeof ( char ) * infoLen );
+
+         glGetProgramInfoLog ( programObject, infoLen, NULL, infoLog );
+         esLogMessage ( "Error linking program:\n%s\n", infoLog );
+
+         free ( infoLog );
+      }
+   }
+
+   return linked ? GL_TRUE : GL_FALSE;
+}
+
+///
+// InitSymbolTable()
+//
+//    Size the table for numSymbols names, leaving room for names looked up
+//    later that are not active
+//
+static void InitSymbolTable ( SymbolTable *table, int numSymbols )
+{
+   table->capacity = 16;
+
+   while ( table->capacity < numSymbols * 4 )
+   {
+      table->capacity *= 2;
+   }
+
+   table->count = 0;
+   table->symbols = ( ProgramSymbol * ) calloc ( table->capacity, sizeof ( ProgramSymbol ) );
+
+   if ( table->symbols == NULL )
+   {
+      table->capacity = 0;
+   }
+}
+
+///
+// FreeSymbolTable()
+//
+static void FreeSymbolTable ( SymbolTable *table )
+{
+   int i;
+
+   for ( i = 0; i < table->capacity; i++ )
+   {
+      free ( table->symbols[i].name );
+   }
+
+   free ( table->symbols );
+   memset ( table, 0, sizeof ( SymbolTable ) );
+}
+
+///
+// FindSymbol()
+//
+//    Returns the slot holding name, or the empty slot it would go in.  NULL
+//    if the table is full.
+//
+static ProgramSymbol *FindSymbol ( const SymbolTable *table, const char *name, unsigned int hash )
+{
+   int mask = table->capacity - 1;
+   int i;
+
+   for ( i = 0; i < table->capacity; i++ )
+   {
+      ProgramSymbol *symbol = &table->symbols[ ( hash + i ) & mask ];
+
+      if ( symbol->name == NULL || ( symbol->hash == hash && strcmp ( symbol->name, name ) == 0 ) )
+      {
+         return symbol;
+      }
+   }
+
+   return NULL;
+}
+
+///
+// AddSymbol()
+//
+//    Add a name to the table, keeping it at most half full
+//
+static void AddSymbol ( SymbolTable *table, const char *name, GLint value )
+{
+   unsigned int hash = ( unsigned int ) HashString ( FNV_OFFSET_BASIS, name );
+   ProgramSymbol *symbol;
+   size_t length = strlen ( name ) + 1;
+
+   if ( ( table->count + 1 ) * 2 > table->capacity ||
+         ( symbol = FindSymbol ( table, name, hash ) ) == NULL || symbol->name != NULL ||
+         ( symbol->name = ( char * ) malloc ( length ) ) == NULL )
+   {
+      return;
+   }
+
+   memcpy ( symbol->name, name, length );
+   symbol->hash = hash;
+   symbol->value = value;
+   table->count++;
+}
+
+///
+// LookupSymbol()
+//
+//    Find a name in the table, returns GL_FALSE if it is not there
+//
+static GLboolean LookupSymbol ( const SymbolTable *table, const char *name, GLint *value )
+{
+   ProgramSymbol *symbol;
+
+   if ( table->capacity == 0 )
+   {
+      return GL_FALSE;
+   }
+
+   symbol = FindSymbol ( table, name, ( unsigned int ) HashString ( FNV_OFFSET_BASIS, name ) );
+
+   if ( symbol == NULL || symbol->name == NULL )
+   {
+      return GL_FALSE;
+   }
+
+   *value = symbol->value;
+   return GL_TRUE;
+}
+
+///
+// FindProgramInfo()
+//
+//    Find the reflection data of a program, moving it to the front of the
+//    list so the program in use is found first
+//
+static ProgramInfo *FindProgramInfo ( GLuint programObject )
+{
+   ProgramInfo **link;
+
+   for ( link = &s_programInfos; *link != NULL; link = &( *link )->next )
+   {
+      ProgramInfo *info = *link;
+
+      if ( info->programObject == programObject )
+      {
+         *link = info->next;
+         info->next = s_programInfos;
+         s_programInfos = info;
+         return info;
+      }
+   }
+
+   return NULL;
+}
+
+///
+// FreeProgramInfo()
+//
+static void FreeProgramInfo ( GLuint programObject )
+{
+   ProgramInfo *info = FindProgramInfo ( programObject );
+
+   if ( info != NULL )
+   {
+      // FindProgramInfo moved it to the front of the list
+      s_programInfos = info->next;
+
+      FreeSymbolTable ( &info->uniforms );
+      FreeSymbolTable ( &info->attributes );
+      FreeSymbolTable ( &info->uniformBlocks );
+      free ( info );
+   }
+}
+
+///
+// ReflectProgram()
+//
+//    Record the locations of all active uniforms and attributes and the
+//    indices of all uniform blocks of a linked program
+//
+static void ReflectProgram ( GLuint programObject )
+{
+   GLint numUniforms = 0, numAttributes = 0, numBlocks = 0;
+   GLint maxUniformLength = 0, maxAttributeLength = 0, maxBlockLength = 0;
+   GLint maxLength, i;
+   ProgramInfo *info;
+   char *name;
+
+   // Program names are reused once deleted
+   FreeProgramInfo ( programObject );
+
+   glGetProgramiv ( programObject, GL_ACTIVE_UNIFORMS, &numUniforms );
+   glGetProgramiv ( programObject, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxUniformLength );
+   glGetProgramiv ( programObject, GL_ACTIVE_ATTRIBUTES, &numAttributes );
+   glGetProgramiv ( programObject, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxAttributeLength );
+   glGetProgramiv ( programObject, GL_ACTIVE_UNIFORM_BLOCKS, &numBlocks );
+   glGetProgramiv ( programObject, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxBlockLength );
+
+   maxLength = maxUniformLength > maxAttributeLength ? maxUniformLength : maxAttributeLength;
+   maxLength = ( maxLength > maxBlockLength ? maxLength : maxBlockLength ) + 1;
+
+   info = ( ProgramInfo * ) calloc ( 1, sizeof ( ProgramInfo ) );
+   name = ( char * ) malloc ( maxLength );
+
+   if ( info == NULL || name == NULL )
+   {
+      free ( info );
+      free ( name );
+      return;
+   }
+
+   info->programObject = programObject;
+
+   // Arrays are added under both "name[0]" and "name"
+   InitSymbolTable ( &info->uniforms, numUniforms * 2 );
+
+   for ( i = 0; i < numUniforms; i++ )
+   {
+      GLsizei length = 0;
+      GLint   size;
+      GLenum  type;
+      GLint   location;
+
+      glGetActiveUniform ( programObject, i, maxLength, &length, &size, &type, name );
+      location = glGetUniformLocation ( programObject, name );
+      AddSymbol ( &info->uniforms, name, location );
+
+      if ( length > 3 && strcmp ( name + length - 3, "[0]" ) == 0 )
+      {
+         name[length - 3] = '\0';
+         AddSymbol ( &info->uniforms, name, location );
+      }
+   }
+
+   InitSymbolTable ( &info->attributes, numAttributes );
+
+   for ( i = 0; i < numAttributes; i++ )
+   {
+      GLint  size;
+      GLenum type;
+
+      glGetActiveAttrib ( programObject, i, maxLength, NULL, &size, &type, name );
+      AddSymbol ( &info->attributes, name, glGetAttribLocation ( programObject, name ) );
+   }
+
+   InitSymbolTable ( &info->uniformBlocks, numBlocks );
+
+   for ( i = 0; i < numBlocks; i++ )
+   {
+      glGetActiveUniformBlockName ( programObject, i, maxLength, NULL, name );
+      AddSymbol ( &info->uniformBlocks, name, i );
+   }
+
+   free ( name );
+
+   info->next = s_programInfos;
+   s_programInfos = info;
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//  Public Functions
+//
+//
+
+//
+///
+/// \brief Load a shader, check for compile errors, print error messages to output log
+/// \param type Type of shader (GL_VERTEX_SHADER or GL_FRAGMENT_SHADER)
+/// \param shaderSrc Shader source string
+/// \return A new shader object on success, 0 on failure
+//
+GLuint ESUTIL_API esLoadShader ( GLenum type, const char *shaderSrc )
+{
+   GLuint shader;
+
+   // Create the shader object and compile it
+   shader = CompileShader ( type, shaderSrc );
+
+   if ( shader == 0 )
+   {
+      return 0;
+   }
+
+   // Check the compile status
+   if ( !CheckShaderCompiled ( shader ) )
+   {
       glDeleteShader ( shader );
       return 0;
    }
 
    return shader;
-
 }
 
 
 //
 ///
 /// \brief Load a vertex and fragment shader, create a program object, link program.
-//         Errors output to log.
+//         Errors output to log.  Linked programs are kept in the program binary cache.
 /// \param vertShaderSrc Vertex shader source code
 /// \param fragShaderSrc Fragment shader source code
 /// \return A new program object linked with the vertex/fragment shader pair, 0 on failure
 //
 GLuint ESUTIL_API esLoadProgram ( const char *vertShaderSrc, const char *fragShaderSrc )
 {
-   GLuint vertexShader;
-   GLuint fragmentShader;
-   GLuint programObject;
-   GLint linked;
+   return esLoadProgramFeedback ( vertShaderSrc, fragShaderSrc, 0, NULL, GL_INTERLEAVED_ATTRIBS );
+}
 
-   // Load the vertex/fragment shaders
-   vertexShader = esLoadShader ( GL_VERTEX_SHADER, vertShaderSrc );
+//
+///
+/// \brief Load a vertex and fragment shader, create a program object, set the transform feedback
+//         varyings and link program.  Errors output to log.  Programs are restored from the program
+//         binary cache when possible, otherwise compiled and stored in it.
+/// \param vertShaderSrc Vertex shader source code
+/// \param fragShaderSrc Fragment shader source code
+/// \param numVaryings Number of transform feedback varyings, 0 for none
+/// \param varyings Names of the transform feedback varyings
+/// \param bufferMode GL_INTERLEAVED_ATTRIBS or GL_SEPARATE_ATTRIBS
+/// \return A new program object linked with the vertex/fragment shader pair, 0 on failure
+//
+GLuint ESUTIL_API esLoadProgramFeedback ( const char *vertShaderSrc, const char *fragShaderSrc,
+                                          GLsizei numVaryings, const char *const *varyings, GLenum bufferMode )
+{
+   ESProgram program;
 
-   if ( vertexShader == 0 )
+   memset ( &program, 0, sizeof ( ESProgram ) );
+   program.vertShaderSrc = vertShaderSrc;
+   program.fragShaderSrc = fragShaderSrc;
+   program.numVaryings = numVaryings;
+   program.varyings = varyings;
+   program.bufferMode = bufferMode;
+
+   esLoadProgramsAsync ( &program, 1 );
+   esFinishPrograms ( &program, 1 );
+
+   return program.programObject;
+}
+
+//
+///
+/// \brief Start building a set of programs without waiting for any of them.  All shaders are
+//         submitted for compilation before any program is linked, so drivers supporting
+//         KHR_parallel_shader_compile can build them concurrently.  Programs in the binary cache
+//         are restored instead.
+/// \param programs Programs to build
+/// \param count Number of programs
+//
+void ESUTIL_API esLoadProgramsAsync ( ESProgram *programs, int count )
+{
+   int i;
+
+   InitParallelCompile();
+
+   // Restore cached programs and submit every compile
+   for ( i = 0; i < count; i++ )
    {
-      return 0;
-   }
+      ESProgram *program = &programs[i];
+
+      program->programObject = 0;
+      program->vertexShader = 0;
+      program->fragmentShader = 0;
+      program->cached = GetProgramCacheKey ( program, &program->cacheKey );
 
-   fragmentShader = esLoadShader ( GL_FRAGMENT_SHADER, fragShaderSrc );
+      if ( program->cached )
+      {
+         program->programObject = LoadProgramBinary ( program->cacheKey );
 
-   if ( fragmentShader == 0 )
+         if ( program->programObject != 0 )
+         {
+            continue;
+         }
+      }
+
+      program->vertexShader = CompileShader ( GL_VERTEX_SHADER, program->vertShaderSrc );
+      program->fragmentShader = CompileShader ( GL_FRAGMENT_SHADER, program->fragShaderSrc );
+   }
+
+   // Submit the links
+   for ( i = 0; i < count; i++ )
    {
-      glDeleteShader ( vertexShader );
-      return 0;
+      ESProgram *program = &programs[i];
+
+      if ( program->vertexShader == 0 || program->fragmentShader == 0 )
+      {
+         continue;
+      }
+
+      program->programObject = glCreateProgram ( );
+
+      if ( program->programObject == 0 )
+      {
+         continue;
+      }
+
+      glAttachShader ( program->programObject, program->vertexShader );
+      glAttachShader ( program->programObject, program->fragmentShader );
+
+      if ( program->numVaryings > 0 )
+      {
+         glTransformFeedbackVaryings ( program->programObject, program->numVaryings,
+                                       program->varyings, program->bufferMode );
+      }
+
+      if ( program->cached )
+      {
+         glProgramParameteri ( program->programObject, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE );
+      }
+
+      glLinkProgram ( program->programObject );
    }
+}
 
-   // Create the program object
-   programObject = glCreateProgram ( );
+//
+///
+/// \brief Check, without blocking, whether programs started with esLoadProgramsAsync are built.
+//         Always GL_TRUE without KHR_parallel_shader_compile.
+/// \param programs Programs passed to esLoadProgramsAsync
+/// \param count Number of programs
+//
+GLboolean ESUTIL_API esProgramsReady ( const ESProgram *programs, int count )
+{
+   int i;
 
-   if ( programObject == 0 )
+   if ( !s_parallelCompile.supported )
    {
-      return 0;
+      return GL_TRUE;
    }
 
-   glAttachShader ( programObject, vertexShader );
-   glAttachShader ( programObject, fragmentShader );
+   for ( i = 0; i < count; i++ )
+   {
+      GLint completed = GL_TRUE;
 
-   // Link the program
-   glLinkProgram ( programObject );
+      if ( programs[i].vertexShader != 0 && programs[i].fragmentShader != 0 && programs[i].programObject != 0 )
+      {
+         glGetProgramiv ( programs[i].programObject, GL_COMPLETION_STATUS_KHR, &completed );
+      }
 
-   // Check the link status
-   glGetProgramiv ( programObject, GL_LINK_STATUS, &linked );
+      if ( !completed )
+      {
+         return GL_FALSE;
+      }
+   }
 
-   if ( !linked )
-   {
-      GLint infoLen = 0;
+   return GL_TRUE;
+}
 
-      glGetProgramiv ( programObject, GL_INFO_LOG_LENGTH, &infoLen );
+//
+///
+/// \brief Wait for programs started with esLoadProgramsAsync, check for errors and store new
+//         binaries in the cache.  Errors output to log.
+/// \param programs Programs passed to esLoadProgramsAsync, programObject is 0 for failed programs
+/// \param count Number of programs
+/// \return GL_TRUE if every program linked
+//
+GLboolean ESUTIL_API esFinishPrograms ( ESProgram *programs, int count )
+{
+   GLboolean allLinked = GL_TRUE;
+   int i;
 
-      if ( infoLen > 1 )
+   for ( i = 0; i < count; i++ )
+   {
+      ESProgram *program = &programs[i];
+
+      if ( program->vertexShader != 0 || program->fragmentShader != 0 )
       {
-         char *infoLog = malloc ( sizeof ( char ) * infoLen );
+         GLboolean linked = program->vertexShader != 0 && program->fragmentShader != 0 &&
+                            program->programObject != 0;
 
-         glGetProgramInfoLog ( programObject, infoLen, NULL, infoLog );
-         esLogMessage ( "Error linking program:\n%s\n", infoLog );
+         // Report compile errors rather than the link error they cause
+         linked = linked && CheckShaderCompiled ( program->vertexShader );
+         linked = linked && CheckShaderCompiled ( program->fragmentShader );
+         linked = linked && CheckProgramLinked ( program->programObject );
 
-         free ( infoLog );
+         // Free up no longer needed shader resources
+         glDeleteShader ( program->vertexShader );
+         glDeleteShader ( program->fragmentShader );
+         program->vertexShader = 0;
+         program->fragmentShader = 0;
+
+         if ( !linked )
+         {
+            glDeleteProgram ( program->programObject );
+            program->programObject = 0;
+         }
+         else if ( program->cached )
+         {
+            SaveProgramBinary ( program->cacheKey, program->programObject );
+         }
       }
 
-      glDeleteProgram ( programObject );
-      return 0;
+      if ( program->programObject == 0 )
+      {
+         allLinked = GL_FALSE;
+      }
+      else
+      {
+         ReflectProgram ( program->programObject );
+      }
    }
 
-   // Free up no longer needed shader resources
-   glDeleteShader ( vertexShader );
-   glDeleteShader ( fragmentShader );
+   return allLinked;
+}
 
-   return programObject;
+//
+///
+/// \brief Get the location of a uniform of a program loaded with esLoadProgram from the table
+//         built after link, without querying the driver.  Names that are not in the table, such as
+//         array elements other than the first, are queried once and added.
+/// \param programObject Program object
+/// \param name Uniform name
+/// \return Uniform location, -1 if the uniform is not active
+//
+GLint ESUTIL_API esGetUniformLocation ( GLuint programObject, const char *name )
+{
+   ProgramInfo *info = FindProgramInfo ( programObject );
+   GLint location;
+
+   if ( info == NULL )
+   {
+      return glGetUniformLocation ( programObject, name );
+   }
+
+   if ( !LookupSymbol ( &info->uniforms, name, &location ) )
+   {
+      location = glGetUniformLocation ( programObject, name );
+      AddSymbol ( &info->uniforms, name, location );
+   }
+
+   return location;
+}
+
+//
+///
+/// \brief Get the location of a vertex attribute of a program loaded with esLoadProgram
+/// \param programObject Program object
+/// \param name Attribute name
+/// \return Attribute location, -1 if the attribute is not active
+//
+GLint ESUTIL_API esGetAttribLocation ( GLuint programObject, const char *name )
+{
+   ProgramInfo *info = FindProgramInfo ( programObject );
+   GLint location;
+
+   if ( info == NULL )
+   {
+      return glGetAttribLocation ( programObject, name );
+   }
+
+   if ( !LookupSymbol ( &info->attributes, name, &location ) )
+   {
+      location = -1;
+   }
+
+   return location;
+}
+
+//
+///
+/// \brief Get the index of a uniform block of a program loaded with esLoadProgram
+/// \param programObject Program object
+/// \param name Uniform block name
+/// \return Uniform block index, GL_INVALID_INDEX if the block is not active
+//
+GLuint ESUTIL_API esGetUniformBlockIndex ( GLuint programObject, const char *name )
+{
+   ProgramInfo *info = FindProgramInfo ( programObject );
+   GLint index;
+
+   if ( info == NULL )
+   {
+      return glGetUniformBlockIndex ( programObject, name );
+   }
+
+   if ( !LookupSymbol ( &info->uniformBlocks, name, &index ) )
+   {
+      return GL_INVALID_INDEX;
+   }
+
+   return ( GLuint ) index;
+}
+
+//
+///
+/// \brief Delete a program loaded with esLoadProgram together with its lookup tables
+/// \param programObject Program object
+//
+void ESUTIL_API esDeleteProgram ( GLuint programObject )
+{
+   FreeProgramInfo ( programObject );
+   glDeleteProgram ( programObject );
+}
+
+//
+///
+/// \brief Set the directory of the program binary cache, overriding ES_PROGRAM_CACHE_DIR.  The
+//         cache is disabled unless one of them is set.
+/// \param directory Cache directory, created if missing.  NULL or empty disables the cache.
+//
+void ESUTIL_API esSetProgramCacheDirectory ( const char *directory )
+{
+   s_programCache.initialized = GL_TRUE;
+   s_programCache.directory[0] = '\0';
+
+   if ( directory != NULL && directory[0] != '\0' )
+   {
+      strncpy ( s_programCache.directory, directory, MAX_PATH_LENGTH - 1 );
+      MakeDirectory ( s_programCache.directory );
+   }
 }
\ No newline at end of file
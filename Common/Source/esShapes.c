@@ -47,12 +47,172 @@
 //
 #define ES_PI  (3.14159265f)
 
+// Largest vertex count drawn with GLushort indices, 0xFFFF is kept free
+// for primitive restart
+#define MAX_SHORT_INDEX_VERTICES   0xFFFF
+
+// Bytes per packed attribute: four 16-bit position components, 2_10_10_10
+// normal and two 16-bit texture coordinates
+#define PACKED_POSITION_SIZE       8
+#define PACKED_NORMAL_SIZE         4
+#define PACKED_TEXCOORD_SIZE       4
+
+// Columns of quads in each grid strip.  Between using a vertex as the
+// bottom of one strip and the top of the next, two vertices per column go
+// through the cache, so this keeps the shared row in a 16 entry FIFO.
+#define GRID_STRIP_BAND            6
+
+// Index that restarts a strip with GL_PRIMITIVE_RESTART_FIXED_INDEX
+#define RESTART_INDEX              0xFFFFFFFF
+
 //////////////////////////////////////////////////////////////////
 //
 //  Private Functions
 //
 //
 
+///
+// FloatToHalf()
+//
+//    Convert to an IEEE half float, rounding to nearest even
+//
+static GLushort FloatToHalf ( GLfloat value )
+{
+   union
+   {
+      GLfloat f;
+      GLuint  u;
+   } bits;
+   GLuint sign, mantissa, half, remainder, halfway;
+   int    exponent;
+   int    shift;
+
+   bits.f = value;
+   sign = ( bits.u >> 16 ) & 0x8000;
+   exponent = ( int ) ( ( bits.u >> 23 ) & 0xff );
+   mantissa = bits.u & 0x7fffff;
+
+   // Infinity and NaN
+   if ( exponent == 0xff )
+   {
+      return ( GLushort ) ( sign | 0x7c00 | ( mantissa ? 0x200 : 0 ) );
+   }
+
+   exponent = exponent - 127 + 15;
+
+   if ( exponent >= 0x1f )
+   {
+      return ( GLushort ) ( sign | 0x7c00 );
+   }
+
+   // Too small for a normalized half, shift in the implicit one
+   if ( exponent <= 0 )
+   {
+      if ( exponent < -10 )
+      {
+         return ( GLushort ) sign;
+      }
+
+      mantissa |= 0x800000;
+      shift = 14 - exponent;
+      half = mantissa >> shift;
+      remainder = mantissa & ( ( 1u << shift ) - 1 );
+      halfway = 1u << ( shift - 1 );
+   }
+   else
+   {
+      half = ( ( GLuint ) exponent << 10 ) | ( mantissa >> 13 );
+      remainder = mantissa & 0x1fff;
+      halfway = 0x1000;
+   }
+
+   // A carry out of the mantissa correctly bumps the exponent
+   if ( remainder > halfway || ( remainder == halfway && ( half & 1 ) ) )
+   {
+      half++;
+   }
+
+   return ( GLushort ) ( sign | half );
+}
+
+///
+// PackSnorm()
+//
+//    Convert [-1, 1] to a signed normalized integer with maxValue steps
+//
+static int PackSnorm ( GLfloat value, int maxValue )
+{
+   value = value < -1.0f ? -1.0f : ( value > 1.0f ? 1.0f : value );
+   return ( int ) floorf ( value * maxValue + 0.5f );
+}
+
+///
+// ChooseType()
+//
+//    Normalized shorts are far more precise than half floats for values in
+//    [-1, 1], which covers the esGen shapes at their usual sizes.  Values that
+//    are never negative, such as grid positions used to address textures,
+//    spend the sign bit on precision instead.
+//
+static GLenum ChooseType ( const GLfloat *values, int count )
+{
+   GLenum type = GL_UNSIGNED_SHORT;
+   int    i;
+
+   for ( i = 0; i < count; i++ )
+   {
+      if ( values[i] < -1.0f || values[i] > 1.0f )
+      {
+         return GL_HALF_FLOAT;
+      }
+
+      if ( values[i] < 0.0f )
+      {
+         type = GL_SHORT;
+      }
+   }
+
+   return type;
+}
+
+///
+// Pack2x16()
+//
+//    Store count components as normalized shorts or half floats
+//
+static void Pack2x16 ( GLushort *dst, const GLfloat *src, int count, GLenum type )
+{
+   int i;
+
+   for ( i = 0; i < count; i++ )
+   {
+      if ( type == GL_UNSIGNED_SHORT )
+      {
+         dst[i] = ( GLushort ) floorf ( src[i] * 65535.0f + 0.5f );
+      }
+      else if ( type == GL_SHORT )
+      {
+         dst[i] = ( GLushort ) PackSnorm ( src[i], 32767 );
+      }
+      else
+      {
+         dst[i] = FloatToHalf ( src[i] );
+      }
+   }
+}
+
+///
+// PackNormal()
+//
+//    Pack a float3 normal as GL_INT_2_10_10_10_REV with w = 0
+//
+static GLuint PackNormal ( const GLfloat *normal )
+{
+   return ( ( GLuint ) PackSnorm ( normal[0], 511 ) & 0x3ff ) |
+          ( ( ( GLuint ) PackSnorm ( normal[1], 511 ) & 0x3ff ) << 10 ) |
+          ( ( ( GLuint ) PackSnorm ( normal[2], 511 ) & 0x3ff ) << 20 );
+}
+
 
 
 //////////////////////////////////////////////////////////////////
@@ -365,3 +525,295 @@ int ESUTIL_API esGenSquareGrid ( int size, GLfloat **vertices, GLuint **indices
 
    return numIndices;
 }
+
+//
+/// \brief Generates a square grid as triangle strips joined by primitive restart.  Each row of
+///        quads is split into narrow column bands so the row shared with the next strip is still
+///        in the post-transform vertex cache.  Strips are separated by the index 0xFFFFFFFF, draw
+///        them as GL_TRIANGLE_STRIP with GL_PRIMITIVE_RESTART_FIXED_INDEX enabled.
+/// \param size create a grid of size by size (number of triangles = (size-1)*(size-1)*2)
+/// \param vertices If not NULL, will contain array of float3 positions, the same as esGenSquareGrid
+/// \param indices If not NULL, will contain the array of indices for the triangle strips
+/// \return The number of indices required for rendering the buffers (the number of indices stored in the indices array
+///         if it is not NULL ) as a GL_TRIANGLE_STRIP
+//
+int ESUTIL_API esGenSquareGridStrip ( int size, GLfloat **vertices, GLuint **indices )
+{
+   int numBands = ( size - 1 + GRID_STRIP_BAND - 1 ) / GRID_STRIP_BAND;
+   int numStrips = numBands * ( size - 1 );
+   int numIndices = 0;
+   int band, i, j;
+
+   // Each band row has two indices per column of vertices, and a restart
+   // index between strips
+   if ( size > 1 )
+   {
+      numIndices = ( size - 1 ) * 2 * ( size - 1 + numBands ) + numStrips - 1;
+   }
+
+   // The vertices are the same as for the triangle list
+   if ( vertices != NULL )
+   {
+      esGenSquareGrid ( size, vertices, NULL );
+   }
+
+   if ( indices != NULL && numIndices > 0 )
+   {
+      GLuint *index = malloc ( sizeof ( GLuint ) * numIndices );
+
+      *indices = index;
+
+      for ( band = 0; band < size - 1; band += GRID_STRIP_BAND )
+      {
+         int lastColumn = band + GRID_STRIP_BAND < size - 1 ? band + GRID_STRIP_BAND : size - 1;
+
+         for ( i = 0; i < size - 1; ++i )
+         {
+            if ( index != *indices )
+            {
+               *index++ = RESTART_INDEX;
+            }
+
+            // Same triangles and winding as esGenSquareGrid
+            for ( j = band; j <= lastColumn; ++j )
+            {
+               *index++ = j + ( i + 1 ) * size;
+               *index++ = j + i * size;
+            }
+         }
+      }
+   }
+
+   return numIndices;
+}
+
+//
+/// \brief Packs vertex data from the esGen functions into one interleaved buffer.  Positions
+///        and texture coordinates are stored as normalized GL_UNSIGNED_SHORT when they lie in
+///        [0, 1], normalized GL_SHORT in [-1, 1] and GL_HALF_FLOAT otherwise, with w = 1 added
+///        to positions.  Normals are stored as GL_INT_2_10_10_10_REV and indices as GLushort
+///        when the vertex count allows it, primitive restart indices become 0xFFFF.
+/// \param numVertices Number of vertices in the attribute arrays
+/// \param vertices If not NULL, array of float3 positions
+/// \param normals If not NULL, array of float3 normals
+/// \param texCoords If not NULL, array of float2 texCoords
+/// \param indices If not NULL, array of indices
+/// \param numIndices Number of indices in the array
+/// \param mesh Receives the packed data, free it with esFreePackedMesh
+/// \return GL_TRUE on success, GL_FALSE if memory could not be allocated
+//
+GLboolean ESUTIL_API esPackMesh ( int numVertices, const GLfloat *vertices, const GLfloat *normals,
+                                  const GLfloat *texCoords, const GLuint *indices, int numIndices,
+                                  ESPackedMesh *mesh )
+{
+   int i;
+
+   memset ( mesh, 0, sizeof ( ESPackedMesh ) );
+   mesh->numVertices = numVertices;
+   mesh->numIndices = indices != NULL ? numIndices : 0;
+   mesh->positionOffset = -1;
+   mesh->normalOffset = -1;
+   mesh->texCoordOffset = -1;
+   mesh->positionType = GL_UNSIGNED_SHORT;
+   mesh->texCoordType = GL_UNSIGNED_SHORT;
+   mesh->indexType = numVertices <= MAX_SHORT_INDEX_VERTICES ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+   // Lay out the attributes, every size is a multiple of 4 bytes so they
+   // all stay aligned
+   if ( vertices != NULL )
+   {
+      mesh->positionOffset = mesh->stride;
+      mesh->stride += PACKED_POSITION_SIZE;
+      mesh->positionType = ChooseType ( vertices, numVertices * 3 );
+   }
+
+   if ( normals != NULL )
+   {
+      mesh->normalOffset = mesh->stride;
+      mesh->stride += PACKED_NORMAL_SIZE;
+   }
+
+   if ( texCoords != NULL )
+   {
+      mesh->texCoordOffset = mesh->stride;
+      mesh->stride += PACKED_TEXCOORD_SIZE;
+      mesh->texCoordType = ChooseType ( texCoords, numVertices * 2 );
+   }
+
+   if ( mesh->stride > 0 )
+   {
+      mesh->vertices = malloc ( mesh->stride * numVertices );
+
+      if ( mesh->vertices == NULL )
+      {
+         return GL_FALSE;
+      }
+   }
+
+   for ( i = 0; i < numVertices && mesh->stride > 0; i++ )
+   {
+      GLubyte *vertex = ( GLubyte * ) mesh->vertices + i * mesh->stride;
+
+      if ( vertices != NULL )
+      {
+         GLfloat w = 1.0f;
+
+         Pack2x16 ( ( GLushort * ) ( vertex + mesh->positionOffset ), &vertices[i * 3], 3, mesh->positionType );
+         Pack2x16 ( ( GLushort * ) ( vertex + mesh->positionOffset ) + 3, &w, 1, mesh->positionType );
+      }
+
+      if ( normals != NULL )
+      {
+         * ( GLuint * ) ( vertex + mesh->normalOffset ) = PackNormal ( &normals[i * 3] );
+      }
+
+      if ( texCoords != NULL )
+      {
+         Pack2x16 ( ( GLushort * ) ( vertex + mesh->texCoordOffset ), &texCoords[i * 2], 2, mesh->texCoordType );
+      }
+   }
+
+   if ( mesh->numIndices > 0 )
+   {
+      if ( mesh->indexType == GL_UNSIGNED_SHORT )
+      {
+         GLushort *shortIndices = malloc ( sizeof ( GLushort ) * numIndices );
+
+         for ( i = 0; shortIndices != NULL && i < numIndices; i++ )
+         {
+            // Also turns RESTART_INDEX into the 16-bit restart index
+            shortIndices[i] = ( GLushort ) indices[i];
+         }
+
+         mesh->indices = shortIndices;
+      }
+      else
+      {
+         mesh->indices = malloc ( sizeof ( GLuint ) * numIndices );
+
+         if ( mesh->indices != NULL )
+         {
+            memcpy ( mesh->indices, indices, sizeof ( GLuint ) * numIndices );
+         }
+      }
+
+      if ( mesh->indices == NULL )
+      {
+         esFreePackedMesh ( mesh );
+         return GL_FALSE;
+      }
+   }
+
+   return GL_TRUE;
+}
+
+//
+/// \brief Frees the arrays of a packed mesh.  The layout is kept so it can still be passed
+///        to esPackedMeshAttribPointers once the data is in buffer objects.
+/// \param mesh Mesh filled in by esPackMesh
+//
+void ESUTIL_API esFreePackedMesh ( ESPackedMesh *mesh )
+{
+   free ( mesh->vertices );
+   free ( mesh->indices );
+   mesh->vertices = NULL;
+   mesh->indices = NULL;
+}
+
+//
+/// \brief Sets up and enables the vertex attribute arrays of a packed mesh
+/// \param mesh Mesh filled in by esPackMesh
+/// \param base Start of the vertex data, NULL when it is in the bound GL_ARRAY_BUFFER
+/// \param positionLoc Position attribute location, or -1 to skip it
+/// \param normalLoc Normal attribute location, or -1 to skip it
+/// \param texCoordLoc Texture coordinate attribute location, or -1 to skip it
+//
+void ESUTIL_API esPackedMeshAttribPointers ( const ESPackedMesh *mesh, const GLvoid *base,
+                                             GLint positionLoc, GLint normalLoc, GLint texCoordLoc )
+{
+   const GLubyte *data = ( const GLubyte * ) base;
+
+   if ( positionLoc >= 0 && mesh->positionOffset >= 0 )
+   {
+      glVertexAttribPointer ( positionLoc, 4, mesh->positionType, mesh->positionType != GL_HALF_FLOAT,
+                              mesh->stride, data + mesh->positionOffset );
+      glEnableVertexAttribArray ( positionLoc );
+   }
+
+   if ( normalLoc >= 0 && mesh->normalOffset >= 0 )
+   {
+      glVertexAttribPointer ( normalLoc, 4, GL_INT_2_10_10_10_REV, GL_TRUE, mesh->stride,
+                              data + mesh->normalOffset );
+      glEnableVertexAttribArray ( normalLoc );
+   }
+
+   if ( texCoordLoc >= 0 && mesh->texCoordOffset >= 0 )
+   {
+      glVertexAttribPointer ( texCoordLoc, 2, mesh->texCoordType, mesh->texCoordType != GL_HALF_FLOAT,
+                              mesh->stride, data + mesh->texCoordOffset );
+      glEnableVertexAttribArray ( texCoordLoc );
+   }
+}
+
+//
+/// \brief Generates a sphere like esGenSphere and packs it with esPackMesh
+/// \param numSlices The number of slices in the sphere
+/// \param radius The radius of the sphere
+/// \param mesh Receives the packed positions, normals, texCoords and indices
+/// \return The number of indices to draw as GL_TRIANGLES, 0 on failure
+//
+int ESUTIL_API esGenSpherePacked ( int numSlices, float radius, ESPackedMesh *mesh )
+{
+   GLfloat *vertices, *normals, *texCoords;
+   GLuint  *indices;
+   int     numVertices = ( numSlices / 2 + 1 ) * ( numSlices + 1 );
+   int     numIndices = esGenSphere ( numSlices, radius, &vertices, &normals, &texCoords, &indices );
+   GLboolean packed = esPackMesh ( numVertices, vertices, normals, texCoords, indices, numIndices, mesh );
+
+   free ( vertices );
+   free ( normals );
+   free ( texCoords );
+   free ( indices );
+
+   return packed ? numIndices : 0;
+}
+
+//
+/// \brief Generates a cube like esGenCube and packs it with esPackMesh
+/// \param scale The size of the cube, use 1.0 for a unit cube.
+/// \param mesh Receives the packed positions, normals, texCoords and indices
+/// \return The number of indices to draw as GL_TRIANGLES, 0 on failure
+//
+int ESUTIL_API esGenCubePacked ( float scale, ESPackedMesh *mesh )
+{
+   GLfloat *vertices, *normals, *texCoords;
+   GLuint  *indices;
+   int     numIndices = esGenCube ( scale, &vertices, &normals, &texCoords, &indices );
+   GLboolean packed = esPackMesh ( 24, vertices, normals, texCoords, indices, numIndices, mesh );
+
+   free ( vertices );
+   free ( normals );
+   free ( texCoords );
+   free ( indices );
+
+   return packed ? numIndices : 0;
+}
+
+//
+/// \brief Generates a square grid like esGenSquareGrid and packs it with esPackMesh
+/// \param size create a grid of size by size (number of triangles = (size-1)*(size-1)*2)
+/// \param mesh Receives the packed positions and indices
+/// \return The number of indices to draw as GL_TRIANGLES, 0 on failure
+//
+int ESUTIL_API esGenSquareGridPacked ( int size, ESPackedMesh *mesh )
+{
+   GLfloat *vertices;
+   GLuint  *indices;
+   int     numIndices = esGenSquareGrid ( size, &vertices, &indices );
+   GLboolean packed = esPackMesh ( size * size, vertices, NULL, NULL, indices, numIndices, mesh );
+
+   free ( vertices );
+   free ( indices );
+
+   return packed ? numIndices : 0;
+}
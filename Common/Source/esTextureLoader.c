@@ -0,0 +1,696 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// ESTextureLoader.c
+//
+//    Asynchronous texture loading.  TGA files are decoded on a pool of
+//    worker threads and uploaded by a thread that owns a second EGL context
+//    sharing objects with the application context.  Each upload is followed
+//    by a fence that the application context waits on before the texture is
+//    used, so file I/O, decoding and uploads overlap the rest of start up.
+//
+
+///
+//  Includes
+//
+#include "esUtil.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(_WIN32) && !defined(__APPLE__)
+#include <pthread.h>
+#include <unistd.h>
+#define ES_TEXTURE_LOADER_THREADED
+#endif
+
+///
+// Defines
+//
+
+// Textures that can be in flight at once, further requests load synchronously
+#define MAX_TEXTURE_JOBS     64
+
+// Upper limit on decode worker threads
+#define MAX_LOADER_THREADS   4
+
+#define MAX_PATH_LENGTH      512
+
+///
+// Types
+//
+typedef enum
+{
+   JOB_FREE,
+   JOB_QUEUED,
+   JOB_DECODING,
+   JOB_DECODED,
+   JOB_UPLOADING,
+   JOB_UPLOADED,
+   JOB_FAILED
+} JobState;
+
+typedef struct
+{
+   JobState    state;
+   char        fileName[MAX_PATH_LENGTH];
+   void       *ioContext;
+   GLenum      format;
+   GLint       filter;
+   GLint       wrap;
+   GLuint      texture;
+
+   // Decoded image waiting for upload
+   char       *pixels;
+   int         width;
+   int         height;
+
+   // Signalled once the upload context has finished the upload
+   GLsync      fence;
+} TextureJob;
+
+typedef struct
+{
+   GLboolean   initialized;
+   TextureJob  jobs[MAX_TEXTURE_JOBS];
+
+#ifdef ES_TEXTURE_LOADER_THREADED
+   EGLDisplay  display;
+   EGLContext  uploadContext;
+   GLboolean   uploaderStarted;
+   GLboolean   uploaderRunning;
+   GLboolean   quit;
+
+   pthread_t   workers[MAX_LOADER_THREADS];
+   int         numWorkers;
+   pthread_t   uploader;
+
+   pthread_mutex_t mutex;
+   // Signalled when a job is queued for decoding
+   pthread_cond_t  queued;
+   // Signalled when a job is decoded and waiting for upload
+   pthread_cond_t  decoded;
+   // Signalled when a job is uploaded or failed
+   pthread_cond_t  finished;
+#endif
+} TextureLoader;
+
+static TextureLoader s_loader;
+
+//////////////////////////////////////////////////////////////////
+//
+//  Private Functions
+//
+//
+
+///
+// UploadTexture()
+//
+//    Upload a decoded image into its texture on the current context and
+//    set its filter and wrap modes
+//
+static void UploadTexture ( const TextureJob *job )
+{
+   GLint binding, alignment;
+
+   glGetIntegerv ( GL_TEXTURE_BINDING_2D, &binding );
+   glGetIntegerv ( GL_UNPACK_ALIGNMENT, &alignment );
+
+   // Decoded rows are tightly packed
+   glPixelStorei ( GL_UNPACK_ALIGNMENT, 1 );
+
+   glBindTexture ( GL_TEXTURE_2D, job->texture );
+   glTexImage2D ( GL_TEXTURE_2D, 0, job->format, job->width, job->height, 0,
+                  job->format, GL_UNSIGNED_BYTE, job->pixels );
+   glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, job->filter );
+   glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, job->filter );
+   glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, job->wrap );
+   glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, job->wrap );
+
+   glBindTexture ( GL_TEXTURE_2D, binding );
+   glPixelStorei ( GL_UNPACK_ALIGNMENT, alignment );
+}
+
+///
+// FormatChannels()
+//
+//    Bytes per pixel of an unsigned byte upload format, 0 if unsupported
+//
+static int FormatChannels ( GLenum format )
+{
+   switch ( format )
+   {
+      case GL_LUMINANCE:
+      case GL_ALPHA:
+         return 1;
+
+      case GL_RGB:
+         return 3;
+
+      case GL_RGBA:
+         return 4;
+
+      default:
+         return 0;
+   }
+}
+
+///
+// DecodeImage()
+//
+//    Load the job's file, NULL if it cannot be loaded or its channels do
+//    not match the upload format
+//
+static char *DecodeImage ( TextureJob *job )
+{
+   int   channels;
+   char *pixels = esLoadTGAChannels ( job->ioContext, job->fileName, &job->width, &job->height, &channels );
+
+   if ( pixels != NULL && channels != FormatChannels ( job->format ) )
+   {
+      esLogMessage ( "esLoadTextureAsync: %s has %d channels, format 0x%04x expects %d\n",
+                     job->fileName, channels, job->format, FormatChannels ( job->format ) );
+      free ( pixels );
+      pixels = NULL;
+   }
+
+   return pixels;
+}
+
+///
+// LoadTextureSync()
+//
+//    Load and upload a texture on the calling thread
+//
+static GLboolean LoadTextureSync ( TextureJob *job )
+{
+   job->pixels = DecodeImage ( job );
+
+   if ( job->pixels == NULL )
+   {
+      return GL_FALSE;
+   }
+
+   UploadTexture ( job );
+   free ( job->pixels );
+   job->pixels = NULL;
+
+   return GL_TRUE;
+}
+
+///
+// FreeJob()
+//
+//    Return a finished job to the pool
+//
+static void FreeJob ( TextureJob *job )
+{
+   if ( job->fence != NULL )
+   {
+      glDeleteSync ( job->fence );
+   }
+
+   free ( job->pixels );
+   memset ( job, 0, sizeof ( TextureJob ) );
+}
+
+#ifdef ES_TEXTURE_LOADER_THREADED
+///
+// FindJob()
+//
+//    Find the first job in the given state, the caller holds the mutex
+//
+static TextureJob *FindJob ( JobState state )
+{
+   int i;
+
+   for ( i = 0; i < MAX_TEXTURE_JOBS; i++ )
+   {
+      if ( s_loader.jobs[i].state == state )
+      {
+         return &s_loader.jobs[i];
+      }
+   }
+
+   return NULL;
+}
+
+///
+// DecodeThread()
+//
+//    Worker thread, loads and decodes queued files
+//
+static void *DecodeThread ( void *arg )
+{
+   ( void ) arg;
+
+   pthread_mutex_lock ( &s_loader.mutex );
+
+   for ( ;; )
+   {
+      TextureJob *job;
+      char       *pixels;
+
+      while ( !s_loader.quit && ( job = FindJob ( JOB_QUEUED ) ) == NULL )
+      {
+         pthread_cond_wait ( &s_loader.queued, &s_loader.mutex );
+      }
+
+      if ( s_loader.quit )
+      {
+         break;
+      }
+
+      job->state = JOB_DECODING;
+      pthread_mutex_unlock ( &s_loader.mutex );
+
+      pixels = DecodeImage ( job );
+
+      pthread_mutex_lock ( &s_loader.mutex );
+      job->pixels = pixels;
+
+      if ( pixels != NULL )
+      {
+         job->state = JOB_DECODED;
+         pthread_cond_signal ( &s_loader.decoded );
+      }
+      else
+      {
+         job->state = JOB_FAILED;
+      }
+
+      pthread_cond_broadcast ( &s_loader.finished );
+   }
+
+   pthread_mutex_unlock ( &s_loader.mutex );
+   return NULL;
+}
+
+///
+// UploadThread()
+//
+//    Owns the shared upload context and uploads decoded images
+//
+static void *UploadThread ( void *arg )
+{
+   ( void ) arg;
+
+   if ( !eglMakeCurrent ( s_loader.display, EGL_NO_SURFACE, EGL_NO_SURFACE, s_loader.uploadContext ) )
+   {
+      // Without a surfaceless context the application thread does the uploads
+      esLogMessage ( "esTextureLoader: cannot bind upload context, uploading on the main thread\n" );
+
+      pthread_mutex_lock ( &s_loader.mutex );
+      s_loader.uploaderRunning = GL_FALSE;
+      pthread_cond_broadcast ( &s_loader.finished );
+      pthread_mutex_unlock ( &s_loader.mutex );
+      return NULL;
+   }
+
+   pthread_mutex_lock ( &s_loader.mutex );
+
+   for ( ;; )
+   {
+      TextureJob *job;
+
+      while ( !s_loader.quit && ( job = FindJob ( JOB_DECODED ) ) == NULL )
+      {
+         pthread_cond_wait ( &s_loader.decoded, &s_loader.mutex );
+      }
+
+      if ( s_loader.quit )
+      {
+         break;
+      }
+
+      job->state = JOB_UPLOADING;
+      pthread_mutex_unlock ( &s_loader.mutex );
+
+      UploadTexture ( job );
+      job->fence = glFenceSync ( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+
+      // Make sure the fence reaches the GPU so other contexts can wait on it
+      glFlush();
+
+      pthread_mutex_lock ( &s_loader.mutex );
+      free ( job->pixels );
+      job->pixels = NULL;
+      job->state = JOB_UPLOADED;
+      pthread_cond_broadcast ( &s_loader.finished );
+   }
+
+   pthread_mutex_unlock ( &s_loader.mutex );
+
+   eglMakeCurrent ( s_loader.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT );
+   eglReleaseThread();
+   return NULL;
+}
+
+///
+// CreateUploadContext()
+//
+//    Create a context with the same config as the application context that
+//    shares its objects
+//
+static EGLContext CreateUploadContext ( ESContext *esContext )
+{
+   EGLint configAttribs[] = { EGL_CONFIG_ID, 0, EGL_NONE };
+   EGLint contextAttribs[] = { EGL_CONTEXT_CLIENT_VERSION, 3, EGL_NONE };
+   EGLConfig config;
+   EGLint numConfigs = 0;
+
+   if ( !eglQueryContext ( esContext->eglDisplay, esContext->eglContext, EGL_CONFIG_ID, &configAttribs[1] ) ||
+         !eglChooseConfig ( esContext->eglDisplay, configAttribs, &config, 1, &numConfigs ) ||
+         numConfigs != 1 )
+   {
+      return EGL_NO_CONTEXT;
+   }
+
+   return eglCreateContext ( esContext->eglDisplay, config, esContext->eglContext, contextAttribs );
+}
+#endif
+
+///
+// InitLoader()
+//
+//    Start the worker threads and the upload thread
+//
+static void InitLoader ( ESContext *esContext )
+{
+   memset ( &s_loader, 0, sizeof ( TextureLoader ) );
+   s_loader.initialized = GL_TRUE;
+
+#ifdef ES_TEXTURE_LOADER_THREADED
+   {
+      long numCpus = sysconf ( _SC_NPROCESSORS_ONLN );
+      int i;
+
+      pthread_mutex_init ( &s_loader.mutex, NULL );
+      pthread_cond_init ( &s_loader.queued, NULL );
+      pthread_cond_init ( &s_loader.decoded, NULL );
+      pthread_cond_init ( &s_loader.finished, NULL );
+
+      s_loader.display = esContext->eglDisplay;
+      s_loader.uploadContext = CreateUploadContext ( esContext );
+
+      if ( s_loader.uploadContext != EGL_NO_CONTEXT )
+      {
+         s_loader.uploaderStarted = pthread_create ( &s_loader.uploader, NULL, UploadThread, NULL ) == 0;
+         s_loader.uploaderRunning = s_loader.uploaderStarted;
+      }
+
+      if ( !s_loader.uploaderRunning )
+      {
+         esLogMessage ( "esTextureLoader: no shared upload context, uploading on the main thread\n" );
+      }
+
+      for ( i = 0; i < MAX_LOADER_THREADS && i < numCpus; i++ )
+      {
+         if ( pthread_create ( &s_loader.workers[i], NULL, DecodeThread, NULL ) != 0 )
+         {
+            break;
+         }
+
+         s_loader.numWorkers++;
+      }
+   }
+#endif
+}
+
+#ifdef ES_TEXTURE_LOADER_THREADED
+///
+// CompleteJob()
+//
+//    Finish a job on the application thread, the caller holds the mutex.
+//    Returns GL_FALSE if the job is still in progress.
+//
+static GLboolean CompleteJob ( TextureJob *job, GLboolean wait, GLboolean *loaded )
+{
+   while ( wait && ( job->state == JOB_QUEUED || job->state == JOB_DECODING || job->state == JOB_UPLOADING ||
+                     ( job->state == JOB_DECODED && s_loader.uploaderRunning ) ) )
+   {
+      pthread_cond_wait ( &s_loader.finished, &s_loader.mutex );
+   }
+
+   if ( job->state == JOB_DECODED && !s_loader.uploaderRunning )
+   {
+      UploadTexture ( job );
+      job->state = JOB_UPLOADED;
+   }
+
+   if ( job->state == JOB_UPLOADED )
+   {
+      if ( job->fence != NULL )
+      {
+         if ( wait )
+         {
+            // Order the application context after the upload without blocking the CPU
+            glWaitSync ( job->fence, 0, GL_TIMEOUT_IGNORED );
+         }
+         else if ( glClientWaitSync ( job->fence, 0, 0 ) == GL_TIMEOUT_EXPIRED )
+         {
+            return GL_FALSE;
+         }
+      }
+
+      *loaded = GL_TRUE;
+   }
+   else if ( job->state == JOB_FAILED )
+   {
+      *loaded = GL_FALSE;
+   }
+   else
+   {
+      return GL_FALSE;
+   }
+
+   FreeJob ( job );
+   return GL_TRUE;
+}
+#endif
+
+//////////////////////////////////////////////////////////////////
+//
+//  Public Functions
+//
+//
+
+///
+// esLoadTextureAsync()
+//
+//    Queue a TGA file to be loaded into a new texture
+//
+GLuint ESUTIL_API esLoadTextureAsync ( ESContext *esContext, const char *fileName, GLenum format,
+                                       GLint filter, GLint wrap )
+{
+   TextureJob  syncJob;
+   TextureJob *job = NULL;
+
+   if ( !s_loader.initialized )
+   {
+      InitLoader ( esContext );
+   }
+
+#ifdef ES_TEXTURE_LOADER_THREADED
+
+   if ( s_loader.numWorkers > 0 )
+   {
+      int i;
+
+      pthread_mutex_lock ( &s_loader.mutex );
+
+      for ( i = 0; i < MAX_TEXTURE_JOBS && job == NULL; i++ )
+      {
+         if ( s_loader.jobs[i].state == JOB_FREE )
+         {
+            job = &s_loader.jobs[i];
+         }
+      }
+
+      if ( job == NULL )
+      {
+         pthread_mutex_unlock ( &s_loader.mutex );
+      }
+   }
+
+#endif
+
+   if ( job == NULL )
+   {
+      memset ( &syncJob, 0, sizeof ( TextureJob ) );
+      job = &syncJob;
+   }
+
+   strncpy ( job->fileName, fileName, MAX_PATH_LENGTH - 1 );
+   job->ioContext = esContext->platformData;
+   job->format = format;
+   job->filter = filter;
+   job->wrap = wrap;
+   glGenTextures ( 1, &job->texture );
+
+   if ( job == &syncJob )
+   {
+      if ( !LoadTextureSync ( job ) )
+      {
+         glDeleteTextures ( 1, &job->texture );
+         return 0;
+      }
+
+      return job->texture;
+   }
+
+#ifdef ES_TEXTURE_LOADER_THREADED
+   job->state = JOB_QUEUED;
+   pthread_cond_signal ( &s_loader.queued );
+   pthread_mutex_unlock ( &s_loader.mutex );
+#endif
+
+   return job->texture;
+}
+
+///
+// esTextureReady()
+//
+//    Check whether a texture queued with esLoadTextureAsync is ready to use
+//
+GLboolean ESUTIL_API esTextureReady ( GLuint texture )
+{
+   GLboolean ready = GL_TRUE;
+#ifdef ES_TEXTURE_LOADER_THREADED
+   int i;
+
+   if ( !s_loader.initialized || s_loader.numWorkers == 0 )
+   {
+      return GL_TRUE;
+   }
+
+   pthread_mutex_lock ( &s_loader.mutex );
+
+   for ( i = 0; i < MAX_TEXTURE_JOBS; i++ )
+   {
+      TextureJob *job = &s_loader.jobs[i];
+      GLboolean loaded;
+
+      if ( job->state != JOB_FREE && job->texture == texture )
+      {
+         ready = CompleteJob ( job, GL_FALSE, &loaded );
+         break;
+      }
+   }
+
+   pthread_mutex_unlock ( &s_loader.mutex );
+#endif
+   return ready;
+}
+
+///
+// esTextureLoaderFinish()
+//
+//    Wait for all queued textures to be decoded and uploaded
+//
+GLboolean ESUTIL_API esTextureLoaderFinish ( void )
+{
+   GLboolean allLoaded = GL_TRUE;
+#ifdef ES_TEXTURE_LOADER_THREADED
+   int i;
+
+   if ( !s_loader.initialized || s_loader.numWorkers == 0 )
+   {
+      return GL_TRUE;
+   }
+
+   pthread_mutex_lock ( &s_loader.mutex );
+
+   for ( i = 0; i < MAX_TEXTURE_JOBS; i++ )
+   {
+      TextureJob *job = &s_loader.jobs[i];
+      GLboolean loaded;
+
+      if ( job->state != JOB_FREE )
+      {
+         CompleteJob ( job, GL_TRUE, &loaded );
+         allLoaded = allLoaded && loaded;
+      }
+   }
+
+   pthread_mutex_unlock ( &s_loader.mutex );
+#endif
+   return allLoaded;
+}
+
+///
+// esTextureLoaderShutdown()
+//
+//    Stop the loader threads and release their resources
+//
+void ESUTIL_API esTextureLoaderShutdown ( void )
+{
+   int i;
+
+   if ( !s_loader.initialized )
+   {
+      return;
+   }
+
+#ifdef ES_TEXTURE_LOADER_THREADED
+   pthread_mutex_lock ( &s_loader.mutex );
+   s_loader.quit = GL_TRUE;
+   pthread_cond_broadcast ( &s_loader.queued );
+   pthread_cond_broadcast ( &s_loader.decoded );
+   pthread_mutex_unlock ( &s_loader.mutex );
+
+   for ( i = 0; i < s_loader.numWorkers; i++ )
+   {
+      pthread_join ( s_loader.workers[i], NULL );
+   }
+
+   if ( s_loader.uploadContext != EGL_NO_CONTEXT )
+   {
+      if ( s_loader.uploaderStarted )
+      {
+         pthread_join ( s_loader.uploader, NULL );
+      }
+
+      eglDestroyContext ( s_loader.display, s_loader.uploadContext );
+   }
+
+   pthread_cond_destroy ( &s_loader.finished );
+   pthread_cond_destroy ( &s_loader.decoded );
+   pthread_cond_destroy ( &s_loader.queued );
+   pthread_mutex_destroy ( &s_loader.mutex );
+#endif
+
+   for ( i = 0; i < MAX_TEXTURE_JOBS; i++ )
+   {
+      FreeJob ( &s_loader.jobs[i] );
+   }
+
+   s_loader.initialized = GL_FALSE;
+}
@@ -43,8 +43,582 @@
 #include <math.h>
 #include <string.h>
 
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define TRANSFORM_NEON
+#include <arm_neon.h>
+#elif defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+#define TRANSFORM_SSE
+#include <emmintrin.h>
+#if defined(__AVX__) || defined(__GNUC__)
+#define TRANSFORM_AVX
+#include <immintrin.h>
+#endif
+#endif
+
+// The batch kernels need vector divide and square root, which 32-bit NEON lacks
+#if defined(TRANSFORM_SSE) || ( defined(TRANSFORM_NEON) && defined(__aarch64__) )
+#define TRANSFORM_BATCH_SIMD
+#endif
+
+///
+// Defines
+//
 #define PI 3.1415926535897932384626433832795f
 
+// esBatchTransform gives each job at least this many instances
+#define BATCH_JOB_MIN_INSTANCES   16384
+
+///
+// Types
+//
+typedef struct
+{
+   ESMatrix               *dst;
+   const ESMatrix         *viewProjection;
+   const ESTransformBatch *batch;
+   int                     first;
+   int                     count;
+} BatchJob;
+
+//////////////////////////////////////////////////////////////////
+//
+//  Private Functions
+//
+//
+
+#ifdef TRANSFORM_AVX
+///
+// TransformVec4_AVX()
+//
+//    AVX kernel for TransformVec4, two vectors per step.  Returns the
+//    number of vectors transformed.
+//
+#ifndef __AVX__
+__attribute__ ( ( target ( "avx" ) ) )
+#endif
+static int TransformVec4_AVX ( GLfloat *dst, const ESMatrix *matrix, const GLfloat *src, int count )
+{
+   const __m256 row0 = _mm256_broadcast_ps ( ( const __m128 * ) matrix->m[0] );
+   const __m256 row1 = _mm256_broadcast_ps ( ( const __m128 * ) matrix->m[1] );
+   const __m256 row2 = _mm256_broadcast_ps ( ( const __m128 * ) matrix->m[2] );
+   const __m256 row3 = _mm256_broadcast_ps ( ( const __m128 * ) matrix->m[3] );
+   int i;
+
+   for ( i = 0; i + 2 <= count; i += 2 )
+   {
+      __m256 v = _mm256_loadu_ps ( src + i * 4 );
+      __m256 r = _mm256_mul_ps ( _mm256_permute_ps ( v, 0x00 ), row0 );
+
+      r = _mm256_add_ps ( r, _mm256_mul_ps ( _mm256_permute_ps ( v, 0x55 ), row1 ) );
+      r = _mm256_add_ps ( r, _mm256_mul_ps ( _mm256_permute_ps ( v, 0xAA ), row2 ) );
+      r = _mm256_add_ps ( r, _mm256_mul_ps ( _mm256_permute_ps ( v, 0xFF ), row3 ) );
+      _mm256_storeu_ps ( dst + i * 4, r );
+   }
+
+   return i;
+}
+#endif
+
+///
+// TransformVec4()
+//
+//    dst[i] = src[i].x * m[0] + src[i].y * m[1] + src[i].z * m[2] + src[i].w * m[3]
+//
+//    This is the row vector convention of the rest of this file, so
+//    esMatrixMultiply is the transform of the rows of srcA by srcB.  The
+//    sums are evaluated in the same order on every path so the SIMD
+//    kernels give bit identical results.  dst may equal src but must not
+//    overlap matrix.
+//
+static void TransformVec4 ( GLfloat *dst, const ESMatrix *matrix, const GLfloat *src, int count )
+{
+   int i = 0;
+
+#if defined(TRANSFORM_NEON)
+   const float32x4_t row0 = vld1q_f32 ( matrix->m[0] );
+   const float32x4_t row1 = vld1q_f32 ( matrix->m[1] );
+   const float32x4_t row2 = vld1q_f32 ( matrix->m[2] );
+   const float32x4_t row3 = vld1q_f32 ( matrix->m[3] );
+
+   for ( ; i < count; i++ )
+   {
+      float32x4_t v = vld1q_f32 ( src + i * 4 );
+      float32x4_t r = vmulq_n_f32 ( row0, vgetq_lane_f32 ( v, 0 ) );
+
+      r = vaddq_f32 ( r, vmulq_n_f32 ( row1, vgetq_lane_f32 ( v, 1 ) ) );
+      r = vaddq_f32 ( r, vmulq_n_f32 ( row2, vgetq_lane_f32 ( v, 2 ) ) );
+      r = vaddq_f32 ( r, vmulq_n_f32 ( row3, vgetq_lane_f32 ( v, 3 ) ) );
+      vst1q_f32 ( dst + i * 4, r );
+   }
+
+#elif defined(TRANSFORM_SSE)
+   const __m128 row0 = _mm_loadu_ps ( matrix->m[0] );
+   const __m128 row1 = _mm_loadu_ps ( matrix->m[1] );
+   const __m128 row2 = _mm_loadu_ps ( matrix->m[2] );
+   const __m128 row3 = _mm_loadu_ps ( matrix->m[3] );
+
+#ifdef TRANSFORM_AVX
+#ifndef __AVX__
+
+   if ( count >= 2 && __builtin_cpu_supports ( "avx" ) )
+#endif
+   {
+      i = TransformVec4_AVX ( dst, matrix, src, count );
+   }
+
+#endif
+
+   for ( ; i < count; i++ )
+   {
+      __m128 v = _mm_loadu_ps ( src + i * 4 );
+      __m128 r = _mm_mul_ps ( _mm_shuffle_ps ( v, v, 0x00 ), row0 );
+
+      r = _mm_add_ps ( r, _mm_mul_ps ( _mm_shuffle_ps ( v, v, 0x55 ), row1 ) );
+      r = _mm_add_ps ( r, _mm_mul_ps ( _mm_shuffle_ps ( v, v, 0xAA ), row2 ) );
+      r = _mm_add_ps ( r, _mm_mul_ps ( _mm_shuffle_ps ( v, v, 0xFF ), row3 ) );
+      _mm_storeu_ps ( dst + i * 4, r );
+   }
+
+#else
+
+   for ( ; i < count; i++ )
+   {
+      GLfloat x = src[i * 4 + 0];
+      GLfloat y = src[i * 4 + 1];
+      GLfloat z = src[i * 4 + 2];
+      GLfloat w = src[i * 4 + 3];
+      int     j;
+
+      for ( j = 0; j < 4; j++ )
+      {
+         dst[i * 4 + j] = ( x * matrix->m[0][j] ) +
+                          ( y * matrix->m[1][j] ) +
+                          ( z * matrix->m[2][j] ) +
+                          ( w * matrix->m[3][j] ) ;
+      }
+   }
+
+#endif
+}
+
+#ifdef TRANSFORM_SSE
+#define SHUFFLE_MASK( x, y, z, w )    ( ( x ) | ( ( y ) << 2 ) | ( ( z ) << 4 ) | ( ( w ) << 6 ) )
+#define SWIZZLE( v, x, y, z, w )      _mm_shuffle_ps ( v, v, SHUFFLE_MASK ( x, y, z, w ) )
+#define SHUFFLE( a, b, x, y, z, w )   _mm_shuffle_ps ( a, b, SHUFFLE_MASK ( x, y, z, w ) )
+
+///
+// Mat2Mul(), Mat2AdjMul(), Mat2MulAdj()
+//
+//    A * B, adj(A) * B and A * adj(B) for 2x2 matrices stored row by row
+//    in one register
+//
+static __m128 Mat2Mul ( __m128 a, __m128 b )
+{
+   return _mm_add_ps ( _mm_mul_ps ( a, SWIZZLE ( b, 0, 3, 0, 3 ) ),
+                       _mm_mul_ps ( SWIZZLE ( a, 1, 0, 3, 2 ), SWIZZLE ( b, 2, 1, 2, 1 ) ) );
+}
+
+static __m128 Mat2AdjMul ( __m128 a, __m128 b )
+{
+   return _mm_sub_ps ( _mm_mul_ps ( SWIZZLE ( a, 3, 3, 0, 0 ), b ),
+                       _mm_mul_ps ( SWIZZLE ( a, 1, 1, 2, 2 ), SWIZZLE ( b, 2, 3, 0, 1 ) ) );
+}
+
+static __m128 Mat2MulAdj ( __m128 a, __m128 b )
+{
+   return _mm_sub_ps ( _mm_mul_ps ( a, SWIZZLE ( b, 3, 0, 3, 0 ) ),
+                       _mm_mul_ps ( SWIZZLE ( a, 1, 0, 3, 2 ), SWIZZLE ( b, 2, 1, 2, 1 ) ) );
+}
+
+///
+// MatrixInverse_SSE()
+//
+//    Inverse by 2x2 blocks.  With M = | A B |, the inverse is
+//                                     | C D |
+//    1/|M| * | X Y | where the adjugates X#, Y#, Z#, W# are built from
+//            | Z W |
+//    products of A#B and D#C, and |M| = |A||D| + |B||C| - tr(A#B D#C).
+//
+static GLboolean MatrixInverse_SSE ( ESMatrix *result, const ESMatrix *src )
+{
+   __m128 row0 = _mm_loadu_ps ( src->m[0] );
+   __m128 row1 = _mm_loadu_ps ( src->m[1] );
+   __m128 row2 = _mm_loadu_ps ( src->m[2] );
+   __m128 row3 = _mm_loadu_ps ( src->m[3] );
+   __m128 a = _mm_movelh_ps ( row0, row1 );
+   __m128 b = _mm_movehl_ps ( row1, row0 );
+   __m128 c = _mm_movelh_ps ( row2, row3 );
+   __m128 d = _mm_movehl_ps ( row3, row2 );
+   __m128 detSub, detA, detB, detC, detD, detM, trace;
+   __m128 ab, dc, x, y, z, w;
+   float  det;
+
+   // ( |A|, |B|, |C|, |D| )
+   detSub = _mm_sub_ps ( _mm_mul_ps ( SHUFFLE ( row0, row2, 0, 2, 0, 2 ), SHUFFLE ( row1, row3, 1, 3, 1, 3 ) ),
+                         _mm_mul_ps ( SHUFFLE ( row0, row2, 1, 3, 1, 3 ), SHUFFLE ( row1, row3, 0, 2, 0, 2 ) ) );
+   detA = SWIZZLE ( detSub, 0, 0, 0, 0 );
+   detB = SWIZZLE ( detSub, 1, 1, 1, 1 );
+   detC = SWIZZLE ( detSub, 2, 2, 2, 2 );
+   detD = SWIZZLE ( detSub, 3, 3, 3, 3 );
+
+   dc = Mat2AdjMul ( d, c );
+   ab = Mat2AdjMul ( a, b );
+
+   x = _mm_sub_ps ( _mm_mul_ps ( detD, a ), Mat2Mul ( b, dc ) );
+   w = _mm_sub_ps ( _mm_mul_ps ( detA, d ), Mat2Mul ( c, ab ) );
+   y = _mm_sub_ps ( _mm_mul_ps ( detB, c ), Mat2MulAdj ( d, ab ) );
+   z = _mm_sub_ps ( _mm_mul_ps ( detC, b ), Mat2MulAdj ( a, dc ) );
+
+   trace = _mm_mul_ps ( ab, SWIZZLE ( dc, 0, 2, 1, 3 ) );
+   trace = _mm_add_ps ( trace, SWIZZLE ( trace, 2, 3, 0, 1 ) );
+   trace = _mm_add_ps ( trace, SWIZZLE ( trace, 1, 0, 3, 2 ) );
+
+   detM = _mm_sub_ps ( _mm_add_ps ( _mm_mul_ps ( detA, detD ), _mm_mul_ps ( detB, detC ) ), trace );
+   det = _mm_cvtss_f32 ( detM );
+
+   if ( det == 0.0f )
+   {
+      return GL_FALSE;
+   }
+
+   // The signs turn the adjugates back into the blocks
+   detM = _mm_div_ps ( _mm_setr_ps ( 1.0f, -1.0f, -1.0f, 1.0f ), detM );
+   x = _mm_mul_ps ( x, detM );
+   y = _mm_mul_ps ( y, detM );
+   z = _mm_mul_ps ( z, detM );
+   w = _mm_mul_ps ( w, detM );
+
+   _mm_storeu_ps ( result->m[0], SHUFFLE ( x, y, 3, 1, 3, 1 ) );
+   _mm_storeu_ps ( result->m[1], SHUFFLE ( x, y, 2, 0, 2, 0 ) );
+   _mm_storeu_ps ( result->m[2], SHUFFLE ( z, w, 3, 1, 3, 1 ) );
+   _mm_storeu_ps ( result->m[3], SHUFFLE ( z, w, 2, 0, 2, 0 ) );
+   return GL_TRUE;
+}
+#endif
+
+#ifdef TRANSFORM_BATCH_SIMD
+#if defined(TRANSFORM_SSE)
+typedef __m128 Vec4f;
+typedef __m128 Vec4Mask;
+
+///
+// Trunc_SSE()
+//
+//    Round toward zero.  cvttps overflows to INT_MIN from 2^31, floats from
+//    2^23 have no fraction and are kept as they are.
+//
+static __m128 Trunc_SSE ( __m128 a )
+{
+   __m128 exact = _mm_cmpge_ps ( _mm_andnot_ps ( _mm_set1_ps ( -0.0f ), a ), _mm_set1_ps ( 8388608.0f ) );
+
+   return _mm_or_ps ( _mm_and_ps ( exact, a ), _mm_andnot_ps ( exact, _mm_cvtepi32_ps ( _mm_cvttps_epi32 ( a ) ) ) );
+}
+
+#define VSet1( a )                  _mm_set1_ps ( a )
+#define VLoad( p )                  _mm_loadu_ps ( p )
+#define VStore( p, a )              _mm_storeu_ps ( p, a )
+#define VAdd( a, b )                _mm_add_ps ( a, b )
+#define VSub( a, b )                _mm_sub_ps ( a, b )
+#define VMul( a, b )                _mm_mul_ps ( a, b )
+#define VDiv( a, b )                _mm_div_ps ( a, b )
+#define VSqrt( a )                  _mm_sqrt_ps ( a )
+#define VAbs( a )                   _mm_andnot_ps ( _mm_set1_ps ( -0.0f ), a )
+#define VMin( a, b )                _mm_min_ps ( a, b )
+#define VTrunc( a )                 Trunc_SSE ( a )
+#define VGreater( a, b )            _mm_cmpgt_ps ( a, b )
+#define VGreaterEqual( a, b )       _mm_cmpge_ps ( a, b )
+#define VSelect( m, a, b )          _mm_or_ps ( _mm_and_ps ( m, a ), _mm_andnot_ps ( m, b ) )
+#define VTranspose( r0, r1, r2, r3 ) _MM_TRANSPOSE4_PS ( r0, r1, r2, r3 )
+#else
+typedef float32x4_t Vec4f;
+typedef uint32x4_t  Vec4Mask;
+
+#define VSet1( a )                  vdupq_n_f32 ( a )
+#define VLoad( p )                  vld1q_f32 ( p )
+#define VStore( p, a )              vst1q_f32 ( p, a )
+#define VAdd( a, b )                vaddq_f32 ( a, b )
+#define VSub( a, b )                vsubq_f32 ( a, b )
+#define VMul( a, b )                vmulq_f32 ( a, b )
+#define VDiv( a, b )                vdivq_f32 ( a, b )
+#define VSqrt( a )                  vsqrtq_f32 ( a )
+#define VAbs( a )                   vabsq_f32 ( a )
+#define VMin( a, b )                vminq_f32 ( a, b )
+#define VTrunc( a )                 vrndq_f32 ( a )
+#define VGreater( a, b )            vcgtq_f32 ( a, b )
+#define VGreaterEqual( a, b )       vcgeq_f32 ( a, b )
+#define VSelect( m, a, b )          vbslq_f32 ( m, a, b )
+#define VTranspose( r0, r1, r2, r3 )                                                    \
+   do                                                                                   \
+   {                                                                                    \
+      float32x4x2_t t01 = vtrnq_f32 ( r0, r1 );                                         \
+      float32x4x2_t t23 = vtrnq_f32 ( r2, r3 );                                         \
+      r0 = vcombine_f32 ( vget_low_f32 ( t01.val[0] ), vget_low_f32 ( t23.val[0] ) );   \
+      r1 = vcombine_f32 ( vget_low_f32 ( t01.val[1] ), vget_low_f32 ( t23.val[1] ) );   \
+      r2 = vcombine_f32 ( vget_high_f32 ( t01.val[0] ), vget_high_f32 ( t23.val[0] ) ); \
+      r3 = vcombine_f32 ( vget_high_f32 ( t01.val[1] ), vget_high_f32 ( t23.val[1] ) ); \
+   } while ( 0 )
+#endif
+
+///
+// SinCos4()
+//
+//    Sine and cosine of four angles in radians.  The argument is reduced to
+//    [-pi/4, pi/4] and evaluated with the single precision Cephes
+//    polynomials, which is within a few ulp of sinf and cosf for the angle
+//    range of a transform.  Like Cephes, arguments are limited to 8192, past
+//    which the reduction loses its precision.
+//
+static void SinCos4 ( Vec4f angle, Vec4f *sine, Vec4f *cosine )
+{
+   const Vec4f one = VSet1 ( 1.0f );
+   const Vec4f minusOne = VSet1 ( -1.0f );
+   Vec4f x = VMin ( VAbs ( angle ), VSet1 ( 8192.0f ) );
+   Vec4f octant, quadrant, z, sinPoly, cosPoly, sinSign, cosSign;
+   Vec4Mask upperHalf, swap;
+
+   // Even octant j nearest to x / (pi / 4) and j mod 8
+   octant = VTrunc ( VMul ( x, VSet1 ( 1.27323954473516f ) ) );
+   octant = VMul ( VTrunc ( VMul ( VAdd ( octant, one ), VSet1 ( 0.5f ) ) ), VSet1 ( 2.0f ) );
+   quadrant = VSub ( octant, VMul ( VTrunc ( VMul ( octant, VSet1 ( 0.125f ) ) ), VSet1 ( 8.0f ) ) );
+
+   // Extended precision x - j * pi / 4
+   x = VSub ( x, VMul ( octant, VSet1 ( 0.78515625f ) ) );
+   x = VSub ( x, VMul ( octant, VSet1 ( 2.4187564849853515625e-4f ) ) );
+   x = VSub ( x, VMul ( octant, VSet1 ( 3.77489497744594108e-8f ) ) );
+   z = VMul ( x, x );
+
+   cosPoly = VAdd ( VMul ( VSet1 ( 2.443315711809948e-5f ), z ), VSet1 ( -1.388731625493765e-3f ) );
+   cosPoly = VAdd ( VMul ( cosPoly, z ), VSet1 ( 4.166664568298827e-2f ) );
+   cosPoly = VMul ( VMul ( cosPoly, z ), z );
+   cosPoly = VAdd ( VSub ( cosPoly, VMul ( z, VSet1 ( 0.5f ) ) ), one );
+
+   sinPoly = VAdd ( VMul ( VSet1 ( -1.9515295891e-4f ), z ), VSet1 ( 8.3321608736e-3f ) );
+   sinPoly = VAdd ( VMul ( sinPoly, z ), VSet1 ( -1.6666654611e-1f ) );
+   sinPoly = VAdd ( VMul ( VMul ( sinPoly, z ), x ), x );
+
+   // Octants 2 and 6 swap the polynomials, sine is negative in octants 4
+   // and 6 and cosine in octants 2 and 4
+   upperHalf = VGreaterEqual ( quadrant, VSet1 ( 4.0f ) );
+   swap = VGreaterEqual ( VSelect ( upperHalf, VSub ( quadrant, VSet1 ( 4.0f ) ), quadrant ), one );
+   sinSign = VMul ( VSelect ( upperHalf, minusOne, one ),
+                    VSelect ( VGreater ( VSet1 ( 0.0f ), angle ), minusOne, one ) );
+   cosSign = VSelect ( VGreater ( VSet1 ( 2.0f ), VAbs ( VSub ( quadrant, VSet1 ( 3.0f ) ) ) ), minusOne, one );
+
+   *sine = VMul ( VSelect ( swap, cosPoly, sinPoly ), sinSign );
+   *cosine = VMul ( VSelect ( swap, sinPoly, cosPoly ), cosSign );
+}
+
+///
+// LoadLanes()
+//
+//    Load count <= 4 per-instance values starting at first, or broadcast
+//    the shared value when there is no array
+//
+static Vec4f LoadLanes ( const GLfloat *values, GLfloat shared, int first, int count )
+{
+   GLfloat lanes[4];
+   int     i;
+
+   if ( values == NULL )
+   {
+      return VSet1 ( shared );
+   }
+
+   if ( count == 4 )
+   {
+      return VLoad ( values + first );
+   }
+
+   for ( i = 0; i < 4; i++ )
+   {
+      lanes[i] = i < count ? values[first + i] : shared;
+   }
+
+   return VLoad ( lanes );
+}
+
+///
+// BatchTransform4()
+//
+//    Build the matrices of count <= 4 instances starting at first, one
+//    instance per SIMD lane.  Follows esTranslate, esRotate, esScale and
+//    esMatrixMultiply step for step, skipping the products with zero.
+//
+static void BatchTransform4 ( ESMatrix *dst, const ESMatrix *viewProjection, const ESTransformBatch *batch,
+                              int first, int count )
+{
+   const Vec4f zero = VSet1 ( 0.0f );
+   const Vec4f one = VSet1 ( 1.0f );
+   Vec4f translate[3], scale[3], axis[3], model[3][3], result[4][4];
+   Vec4f angle, mag, sine, cosine, oneMinusCos;
+   Vec4f xx, yy, zz, xy, yz, zx, xs, ys, zs;
+   Vec4Mask valid;
+   ESMatrix tmp[4];
+   int i, j;
+
+   for ( i = 0; i < 3; i++ )
+   {
+      translate[i] = LoadLanes ( batch->translate[i], batch->sharedTranslate[i], first, count );
+      scale[i] = LoadLanes ( batch->scale[i], batch->sharedScale[i], first, count );
+      axis[i] = LoadLanes ( batch->axis[i], batch->sharedAxis[i], first, count );
+   }
+
+   angle = LoadLanes ( batch->angle, batch->sharedAngle, first, count );
+
+   // A zero axis leaves the rotation out
+   mag = VSqrt ( VAdd ( VAdd ( VMul ( axis[0], axis[0] ), VMul ( axis[1], axis[1] ) ), VMul ( axis[2], axis[2] ) ) );
+   valid = VGreater ( mag, zero );
+   mag = VSelect ( valid, mag, one );
+   angle = VSelect ( valid, angle, zero );
+
+   for ( i = 0; i < 3; i++ )
+   {
+      axis[i] = VDiv ( axis[i], mag );
+   }
+
+   // Reduce to less than a turn first, exactly for angles below 2^24
+   // degrees, so that large angles stay within the range of SinCos4
+   angle = VSub ( angle, VMul ( VTrunc ( VMul ( angle, VSet1 ( 1.0f / 360.0f ) ) ), VSet1 ( 360.0f ) ) );
+   SinCos4 ( VDiv ( VMul ( angle, VSet1 ( PI ) ), VSet1 ( 180.0f ) ), &sine, &cosine );
+
+   xx = VMul ( axis[0], axis[0] );
+   yy = VMul ( axis[1], axis[1] );
+   zz = VMul ( axis[2], axis[2] );
+   xy = VMul ( axis[0], axis[1] );
+   yz = VMul ( axis[1], axis[2] );
+   zx = VMul ( axis[2], axis[0] );
+   xs = VMul ( axis[0], sine );
+   ys = VMul ( axis[1], sine );
+   zs = VMul ( axis[2], sine );
+   oneMinusCos = VSub ( one, cosine );
+
+   model[0][0] = VAdd ( VMul ( oneMinusCos, xx ), cosine );
+   model[0][1] = VSub ( VMul ( oneMinusCos, xy ), zs );
+   model[0][2] = VAdd ( VMul ( oneMinusCos, zx ), ys );
+
+   model[1][0] = VAdd ( VMul ( oneMinusCos, xy ), zs );
+   model[1][1] = VAdd ( VMul ( oneMinusCos, yy ), cosine );
+   model[1][2] = VSub ( VMul ( oneMinusCos, yz ), xs );
+
+   model[2][0] = VSub ( VMul ( oneMinusCos, zx ), ys );
+   model[2][1] = VAdd ( VMul ( oneMinusCos, yz ), xs );
+   model[2][2] = VAdd ( VMul ( oneMinusCos, zz ), cosine );
+
+   // The scale applies to the rotation rows, the translation row is
+   // (tx, ty, tz, 1) and the last column is zero
+   for ( i = 0; i < 3; i++ )
+   {
+      for ( j = 0; j < 3; j++ )
+      {
+         model[i][j] = VMul ( model[i][j], scale[i] );
+      }
+   }
+
+   for ( j = 0; j < 4; j++ )
+   {
+      Vec4f vp0 = VSet1 ( viewProjection->m[0][j] );
+      Vec4f vp1 = VSet1 ( viewProjection->m[1][j] );
+      Vec4f vp2 = VSet1 ( viewProjection->m[2][j] );
+
+      for ( i = 0; i < 3; i++ )
+      {
+         result[i][j] = VAdd ( VAdd ( VMul ( model[i][0], vp0 ), VMul ( model[i][1], vp1 ) ), VMul ( model[i][2], vp2 ) );
+      }
+
+      result[3][j] = VAdd ( VAdd ( VAdd ( VMul ( translate[0], vp0 ), VMul ( translate[1], vp1 ) ),
+                                   VMul ( translate[2], vp2 ) ), VSet1 ( viewProjection->m[3][j] ) );
+   }
+
+   // Rotate the lanes back into one matrix per instance
+   for ( i = 0; i < 4; i++ )
+   {
+      VTranspose ( result[i][0], result[i][1], result[i][2], result[i][3] );
+
+      if ( count == 4 )
+      {
+         for ( j = 0; j < 4; j++ )
+         {
+            VStore ( dst[j].m[i], result[i][j] );
+         }
+      }
+      else
+      {
+         for ( j = 0; j < 4; j++ )
+         {
+            VStore ( tmp[j].m[i], result[i][j] );
+         }
+      }
+   }
+
+   if ( count < 4 )
+   {
+      memcpy ( dst, tmp, count * sizeof ( ESMatrix ) );
+   }
+}
+#endif
+
+///
+// BatchTransformRange()
+//
+//    Build the matrices of one job's share of the instances
+//
+static void BatchTransformRange ( const BatchJob *job )
+{
+   int i;
+
+#ifdef TRANSFORM_BATCH_SIMD
+
+   for ( i = 0; i < job->count; i += 4 )
+   {
+      int count = job->count - i < 4 ? job->count - i : 4;
+
+      BatchTransform4 ( job->dst + job->first + i, job->viewProjection, job->batch, job->first + i, count );
+   }
+
+#else
+   const ESTransformBatch *batch = job->batch;
+
+   for ( i = job->first; i < job->first + job->count; i++ )
+   {
+      GLfloat  value[10];
+      ESMatrix model;
+      int      c;
+
+      for ( c = 0; c < 3; c++ )
+      {
+         value[c] = batch->translate[c] != NULL ? batch->translate[c][i] : batch->sharedTranslate[c];
+         value[c + 4] = batch->axis[c] != NULL ? batch->axis[c][i] : batch->sharedAxis[c];
+         value[c + 7] = batch->scale[c] != NULL ? batch->scale[c][i] : batch->sharedScale[c];
+      }
+
+      value[3] = batch->angle != NULL ? batch->angle[i] : batch->sharedAngle;
+
+      esMatrixLoadIdentity ( &model );
+      esTranslate ( &model, value[0], value[1], value[2] );
+      esRotate ( &model, value[3], value[4], value[5], value[6] );
+      esScale ( &model, value[7], value[8], value[9] );
+      esMatrixMultiply ( &job->dst[i], &model, ( ESMatrix * ) job->viewProjection );
+   }
+
+#endif
+}
+
+///
+// BatchWorker()
+//
+//    Job entry point for esBatchTransform
+//
+static void BatchWorker ( void *arg )
+{
+   BatchTransformRange ( ( const BatchJob * ) arg );
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//  Public Functions
+//
+//
+
 void ESUTIL_API
 esScale ( ESMatrix *result, GLfloat sx, GLfloat sy, GLfloat sz )
 {
@@ -199,34 +773,214 @@ void ESUTIL_API
 esMatrixMultiply ( ESMatrix *result, ESMatrix *srcA, ESMatrix *srcB )
 {
    ESMatrix    tmp;
-   int         i;
 
-   for ( i = 0; i < 4; i++ )
+   // Rows of the result are written as they are computed, which is only
+   // safe to do in place over srcA
+   if ( result == srcB )
    {
-      tmp.m[i][0] =  ( srcA->m[i][0] * srcB->m[0][0] ) +
-                     ( srcA->m[i][1] * srcB->m[1][0] ) +
-                     ( srcA->m[i][2] * srcB->m[2][0] ) +
-                     ( srcA->m[i][3] * srcB->m[3][0] ) ;
+      tmp = *srcB;
+      srcB = &tmp;
+   }
+
+   TransformVec4 ( result->m[0], srcB, srcA->m[0], 4 );
+}
+
+void ESUTIL_API
+esMatrixTransformVec4 ( GLfloat *dst, const ESMatrix *matrix, const GLfloat *src, int count )
+{
+   // A private copy lets dst overlap the matrix
+   ESMatrix tmp = *matrix;
+
+   TransformVec4 ( dst, &tmp, src, count );
+}
+
+void ESUTIL_API
+esMatrixTranspose ( ESMatrix *result, const ESMatrix *src )
+{
+#if defined(TRANSFORM_NEON)
+   float32x4x4_t columns = vld4q_f32 ( src->m[0] );
 
-      tmp.m[i][1] =  ( srcA->m[i][0] * srcB->m[0][1] ) +
-                     ( srcA->m[i][1] * srcB->m[1][1] ) +
-                     ( srcA->m[i][2] * srcB->m[2][1] ) +
-                     ( srcA->m[i][3] * srcB->m[3][1] ) ;
+   vst1q_f32 ( result->m[0], columns.val[0] );
+   vst1q_f32 ( result->m[1], columns.val[1] );
+   vst1q_f32 ( result->m[2], columns.val[2] );
+   vst1q_f32 ( result->m[3], columns.val[3] );
+#elif defined(TRANSFORM_SSE)
+   __m128 row0 = _mm_loadu_ps ( src->m[0] );
+   __m128 row1 = _mm_loadu_ps ( src->m[1] );
+   __m128 row2 = _mm_loadu_ps ( src->m[2] );
+   __m128 row3 = _mm_loadu_ps ( src->m[3] );
 
-      tmp.m[i][2] =  ( srcA->m[i][0] * srcB->m[0][2] ) +
-                     ( srcA->m[i][1] * srcB->m[1][2] ) +
-                     ( srcA->m[i][2] * srcB->m[2][2] ) +
-                     ( srcA->m[i][3] * srcB->m[3][2] ) ;
+   _MM_TRANSPOSE4_PS ( row0, row1, row2, row3 );
+   _mm_storeu_ps ( result->m[0], row0 );
+   _mm_storeu_ps ( result->m[1], row1 );
+   _mm_storeu_ps ( result->m[2], row2 );
+   _mm_storeu_ps ( result->m[3], row3 );
+#else
+   ESMatrix tmp;
+   int      i, j;
 
-      tmp.m[i][3] =  ( srcA->m[i][0] * srcB->m[0][3] ) +
-                     ( srcA->m[i][1] * srcB->m[1][3] ) +
-                     ( srcA->m[i][2] * srcB->m[2][3] ) +
-                     ( srcA->m[i][3] * srcB->m[3][3] ) ;
+   for ( i = 0; i < 4; i++ )
+   {
+      for ( j = 0; j < 4; j++ )
+      {
+         tmp.m[i][j] = src->m[j][i];
+      }
    }
 
    memcpy ( result, &tmp, sizeof ( ESMatrix ) );
+#endif
+}
+
+
+GLboolean ESUTIL_API
+esMatrixInverse ( ESMatrix *result, const ESMatrix *src )
+{
+#ifdef TRANSFORM_SSE
+   return MatrixInverse_SSE ( result, src );
+#else
+   const GLfloat ( *m ) [4] = src->m;
+   GLfloat s0, s1, s2, s3, s4, s5, c0, c1, c2, c3, c4, c5;
+   GLfloat det;
+   ESMatrix inv;
+
+   // 2x2 minors of the first two and last two rows
+   s0 = m[0][0] * m[1][1] - m[1][0] * m[0][1];
+   s1 = m[0][0] * m[1][2] - m[1][0] * m[0][2];
+   s2 = m[0][0] * m[1][3] - m[1][0] * m[0][3];
+   s3 = m[0][1] * m[1][2] - m[1][1] * m[0][2];
+   s4 = m[0][1] * m[1][3] - m[1][1] * m[0][3];
+   s5 = m[0][2] * m[1][3] - m[1][2] * m[0][3];
+
+   c0 = m[2][0] * m[3][1] - m[3][0] * m[2][1];
+   c1 = m[2][0] * m[3][2] - m[3][0] * m[2][2];
+   c2 = m[2][0] * m[3][3] - m[3][0] * m[2][3];
+   c3 = m[2][1] * m[3][2] - m[3][1] * m[2][2];
+   c4 = m[2][1] * m[3][3] - m[3][1] * m[2][3];
+   c5 = m[2][2] * m[3][3] - m[3][2] * m[2][3];
+
+   det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+
+   if ( det == 0.0f )
+   {
+      return GL_FALSE;
+   }
+
+   det = 1.0f / det;
+
+   inv.m[0][0] = (  m[1][1] * c5 - m[1][2] * c4 + m[1][3] * c3 ) * det;
+   inv.m[0][1] = ( -m[0][1] * c5 + m[0][2] * c4 - m[0][3] * c3 ) * det;
+   inv.m[0][2] = (  m[3][1] * s5 - m[3][2] * s4 + m[3][3] * s3 ) * det;
+   inv.m[0][3] = ( -m[2][1] * s5 + m[2][2] * s4 - m[2][3] * s3 ) * det;
+
+   inv.m[1][0] = ( -m[1][0] * c5 + m[1][2] * c2 - m[1][3] * c1 ) * det;
+   inv.m[1][1] = (  m[0][0] * c5 - m[0][2] * c2 + m[0][3] * c1 ) * det;
+   inv.m[1][2] = ( -m[3][0] * s5 + m[3][2] * s2 - m[3][3] * s1 ) * det;
+   inv.m[1][3] = (  m[2][0] * s5 - m[2][2] * s2 + m[2][3] * s1 ) * det;
+
+   inv.m[2][0] = (  m[1][0] * c4 - m[1][1] * c2 + m[1][3] * c0 ) * det;
+   inv.m[2][1] = ( -m[0][0] * c4 + m[0][1] * c2 - m[0][3] * c0 ) * det;
+   inv.m[2][2] = (  m[3][0] * s4 - m[3][1] * s2 + m[3][3] * s0 ) * det;
+   inv.m[2][3] = ( -m[2][0] * s4 + m[2][1] * s2 - m[2][3] * s0 ) * det;
+
+   inv.m[3][0] = ( -m[1][0] * c3 + m[1][1] * c1 - m[1][2] * c0 ) * det;
+   inv.m[3][1] = (  m[0][0] * c3 - m[0][1] * c1 + m[0][2] * c0 ) * det;
+   inv.m[3][2] = ( -m[3][0] * s3 + m[3][1] * s1 - m[3][2] * s0 ) * det;
+   inv.m[3][3] = (  m[2][0] * s3 - m[2][1] * s1 + m[2][2] * s0 ) * det;
+
+   memcpy ( result, &inv, sizeof ( ESMatrix ) );
+   return GL_TRUE;
+#endif
+}
+
+GLboolean ESUTIL_API
+esMatrixNormal3x3 ( GLfloat result[3][3], const ESMatrix *modelview )
+{
+   // The inverse transpose of the upper 3x3 is its cofactor matrix over the
+   // determinant, and the cofactor rows are cross products of the other rows
+   const GLfloat ( *m ) [4] = modelview->m;
+   GLfloat cofactor[3][3];
+   GLfloat det;
+   int     i, j;
+
+   for ( i = 0; i < 3; i++ )
+   {
+      const GLfloat *a = m[( i + 1 ) % 3];
+      const GLfloat *b = m[( i + 2 ) % 3];
+
+      cofactor[i][0] = a[1] * b[2] - a[2] * b[1];
+      cofactor[i][1] = a[2] * b[0] - a[0] * b[2];
+      cofactor[i][2] = a[0] * b[1] - a[1] * b[0];
+   }
+
+   det = m[0][0] * cofactor[0][0] + m[0][1] * cofactor[0][1] + m[0][2] * cofactor[0][2];
+
+   if ( det == 0.0f )
+   {
+      return GL_FALSE;
+   }
+
+   det = 1.0f / det;
+
+   for ( i = 0; i < 3; i++ )
+   {
+      for ( j = 0; j < 3; j++ )
+      {
+         result[i][j] = cofactor[i][j] * det;
+      }
+   }
+
+   return GL_TRUE;
 }
 
+void ESUTIL_API
+esFrustumPlanesFromMatrix ( GLfloat planes[6][4], const ESMatrix *matrix )
+{
+   ESMatrix rows;
+   int      i, j;
+
+   // The rows of the matrix as the shader applies it are the columns of m
+   esMatrixTranspose ( &rows, matrix );
+
+   for ( i = 0; i < 3; i++ )
+   {
+      for ( j = 0; j < 4; j++ )
+      {
+         planes[i * 2 + 0][j] = rows.m[3][j] + rows.m[i][j];
+         planes[i * 2 + 1][j] = rows.m[3][j] - rows.m[i][j];
+      }
+   }
+
+   for ( i = 0; i < 6; i++ )
+   {
+      GLfloat length = sqrtf ( planes[i][0] * planes[i][0] + planes[i][1] * planes[i][1] + planes[i][2] * planes[i][2] );
+
+      if ( length > 0.0f )
+      {
+         for ( j = 0; j < 4; j++ )
+         {
+            planes[i][j] /= length;
+         }
+      }
+   }
+}
+
+void ESUTIL_API
+esBatchTransform ( ESMatrix *dst, const ESMatrix *viewProjection, const ESTransformBatch *batch, int count )
+{
+   BatchJob jobs[ES_MAX_JOBS];
+   int      numJobs = esNumJobs ( count, BATCH_JOB_MIN_INSTANCES );
+   int      i;
+
+   for ( i = 0; i < numJobs; i++ )
+   {
+      jobs[i].dst = dst;
+      jobs[i].viewProjection = viewProjection;
+      jobs[i].batch = batch;
+      esJobRange ( count, numJobs, i, &jobs[i].first, &jobs[i].count );
+   }
+
+   esRunJobs ( BatchWorker, jobs, sizeof ( BatchJob ), numJobs );
+}
 
 void ESUTIL_API
 esMatrixLoadIdentity ( ESMatrix *result )
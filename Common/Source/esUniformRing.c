@@ -0,0 +1,314 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// ESUniformRing.c
+//
+//    Per-frame ring allocator for uniform buffer blocks.  Blocks for a
+//    frame are staged in client memory and sent to one large, reused
+//    uniform buffer with a single upload, then bound with
+//    glBindBufferRange.
+//
+
+///
+//  Includes
+//
+#include "esUtil.h"
+#include <stdlib.h>
+#include <string.h>
+
+///
+// Defines
+//
+
+// Frames the ring holds.  A segment is only rewritten once the GPU has
+// signalled the fence of the frame that last used it.
+#define UNIFORM_RING_FRAMES   3
+
+// Nanoseconds to wait per glClientWaitSync call for a segment to retire
+#define FENCE_WAIT_TIMEOUT    100000000
+
+///
+// Types
+//
+typedef struct
+{
+   GLboolean     initialized;
+   GLuint        buffer;
+
+   // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+   GLint         alignment;
+
+   // Bytes per frame segment, a multiple of the alignment
+   GLsizeiptr    frameSize;
+
+   // Segment written this frame, its staged and already uploaded bytes
+   int           frame;
+   GLsizeiptr    used;
+   GLsizeiptr    uploaded;
+
+   // Fence of the last frame that used each segment
+   GLsync        fences[UNIFORM_RING_FRAMES];
+
+   // Client copy of the whole ring
+   unsigned char *staging;
+
+   GLboolean     overflowLogged;
+} UniformRing;
+
+static UniformRing s_ring;
+
+//////////////////////////////////////////////////////////////////
+//
+//  Private Functions
+//
+//
+
+///
+// AlignUp()
+//
+//    Round value up to a multiple of alignment
+//
+static GLsizeiptr AlignUp ( GLsizeiptr value, GLsizeiptr alignment )
+{
+   return ( value + alignment - 1 ) / alignment * alignment;
+}
+
+///
+// WaitForSegment()
+//
+//    Block until the GPU has finished with the current segment
+//
+static void WaitForSegment ( void )
+{
+   GLsync fence = s_ring.fences[s_ring.frame];
+
+   if ( fence == NULL )
+   {
+      return;
+   }
+
+   while ( glClientWaitSync ( fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_WAIT_TIMEOUT ) == GL_TIMEOUT_EXPIRED )
+   {
+   }
+
+   glDeleteSync ( fence );
+   s_ring.fences[s_ring.frame] = NULL;
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//  Public Functions
+//
+//
+
+///
+// esUniformRingInit()
+//
+//    Create the ring buffer with room for frameSize bytes of blocks per frame
+//
+GLboolean ESUTIL_API esUniformRingInit ( GLsizeiptr frameSize )
+{
+   GLint alignment = 0;
+
+   if ( s_ring.initialized )
+   {
+      esUniformRingShutdown ();
+   }
+
+   glGetIntegerv ( GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment );
+
+   if ( alignment <= 0 )
+   {
+      alignment = 256;
+   }
+
+   s_ring.alignment = alignment;
+   s_ring.frameSize = AlignUp ( frameSize, alignment );
+   s_ring.staging = malloc ( s_ring.frameSize * UNIFORM_RING_FRAMES );
+
+   if ( s_ring.staging == NULL )
+   {
+      return GL_FALSE;
+   }
+
+   glGenBuffers ( 1, &s_ring.buffer );
+   glBindBuffer ( GL_UNIFORM_BUFFER, s_ring.buffer );
+   glBufferData ( GL_UNIFORM_BUFFER, s_ring.frameSize * UNIFORM_RING_FRAMES, NULL, GL_DYNAMIC_DRAW );
+   glBindBuffer ( GL_UNIFORM_BUFFER, 0 );
+
+   s_ring.initialized = GL_TRUE;
+   return GL_TRUE;
+}
+
+///
+// esUniformRingAlloc()
+//
+//    Reserve an aligned block in this frame's segment
+//
+void *ESUTIL_API esUniformRingAlloc ( GLsizeiptr size, GLintptr *offset )
+{
+   GLsizeiptr start;
+
+   if ( !s_ring.initialized )
+   {
+      return NULL;
+   }
+
+   start = AlignUp ( s_ring.used, s_ring.alignment );
+
+   if ( start + size > s_ring.frameSize )
+   {
+      if ( !s_ring.overflowLogged )
+      {
+         esLogMessage ( "esUniformRing: %ld bytes per frame is not enough\n", ( long ) s_ring.frameSize );
+         s_ring.overflowLogged = GL_TRUE;
+      }
+
+      return NULL;
+   }
+
+   s_ring.used = start + size;
+   start += s_ring.frame * s_ring.frameSize;
+
+   if ( offset != NULL )
+   {
+      *offset = ( GLintptr ) start;
+   }
+
+   return s_ring.staging + start;
+}
+
+///
+// esUniformRingUpload()
+//
+//    Send every block allocated since the last upload to the buffer
+//
+void ESUTIL_API esUniformRingUpload ( void )
+{
+   GLintptr   start;
+   GLsizeiptr size;
+   void       *dst;
+
+   if ( !s_ring.initialized || s_ring.used == s_ring.uploaded )
+   {
+      return;
+   }
+
+   WaitForSegment ();
+
+   start = s_ring.frame * s_ring.frameSize + s_ring.uploaded;
+   size = s_ring.used - s_ring.uploaded;
+
+   // The fence guarantees the GPU is done with this range, so the map
+   // does not need to synchronize
+   glBindBuffer ( GL_UNIFORM_BUFFER, s_ring.buffer );
+   dst = glMapBufferRange ( GL_UNIFORM_BUFFER, start, size,
+                            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT );
+
+   if ( dst != NULL )
+   {
+      memcpy ( dst, s_ring.staging + start, size );
+      glUnmapBuffer ( GL_UNIFORM_BUFFER );
+   }
+   else
+   {
+      glBufferSubData ( GL_UNIFORM_BUFFER, start, size, s_ring.staging + start );
+   }
+
+   glBindBuffer ( GL_UNIFORM_BUFFER, 0 );
+   s_ring.uploaded = s_ring.used;
+}
+
+///
+// esUniformRingBind()
+//
+//    Bind a block returned by esUniformRingAlloc to a uniform buffer binding point
+//
+void ESUTIL_API esUniformRingBind ( GLuint index, GLintptr offset, GLsizeiptr size )
+{
+   glBindBufferRange ( GL_UNIFORM_BUFFER, index, s_ring.buffer, offset, size );
+}
+
+///
+// esUniformRingEndFrame()
+//
+//    Fence the segment used this frame and move on to the next one
+//
+void ESUTIL_API esUniformRingEndFrame ( void )
+{
+   if ( !s_ring.initialized )
+   {
+      return;
+   }
+
+   if ( s_ring.used > 0 )
+   {
+      // A frame that allocated but never uploaded did not wait for the
+      // segment's last fence, the new fence also covers that frame
+      if ( s_ring.fences[s_ring.frame] != NULL )
+      {
+         glDeleteSync ( s_ring.fences[s_ring.frame] );
+      }
+
+      s_ring.fences[s_ring.frame] = glFenceSync ( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+   }
+
+   s_ring.frame = ( s_ring.frame + 1 ) % UNIFORM_RING_FRAMES;
+   s_ring.used = 0;
+   s_ring.uploaded = 0;
+}
+
+///
+// esUniformRingShutdown()
+//
+//    Release the ring buffer and its fences
+//
+void ESUTIL_API esUniformRingShutdown ( void )
+{
+   int i;
+
+   if ( !s_ring.initialized )
+   {
+      return;
+   }
+
+   for ( i = 0; i < UNIFORM_RING_FRAMES; i++ )
+   {
+      if ( s_ring.fences[i] != NULL )
+      {
+         glDeleteSync ( s_ring.fences[i] );
+      }
+   }
+
+   glDeleteBuffers ( 1, &s_ring.buffer );
+   free ( s_ring.staging );
+   memset ( &s_ring, 0, sizeof ( UniformRing ) );
+}
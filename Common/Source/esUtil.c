@@ -43,6 +43,7 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
+#include <math.h>
 #include "esUtil.h"
 #include "esUtil_win.h"
 
@@ -59,11 +60,36 @@ typedef FILE esFile;
 #include "FileWrapper.h"
 #endif
 
+#if defined(__linux__) && !defined(ANDROID)
+#define TGA_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define TGA_NEON
+#include <arm_neon.h>
+#elif defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+#define TGA_SSE2
+#include <emmintrin.h>
+#if defined(__SSSE3__) || defined(__GNUC__)
+#define TGA_SSSE3
+#include <tmmintrin.h>
+#endif
+#endif
+
 ///
 //  Macros
 //
 #define INVERTED_BIT            (1 << 5)
 
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA     0x31DD
+#endif
+
 ///
 //  Types
 //
@@ -96,6 +122,23 @@ __attribute__ ( ( packed ) )
 #pragma pack(pop,x1)
 #endif
 
+#ifdef TGA_MMAP
+typedef struct MappedTGA
+{
+   // Pixel data handed out by esMapTGA
+   const char       *pixels;
+
+   // Start and length of the file mapping
+   void             *base;
+   size_t            length;
+
+   struct MappedTGA *next;
+} MappedTGA;
+
+static MappedTGA       *s_mappedTGAs = NULL;
+static pthread_mutex_t  s_mappedTGALock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
 #ifndef __APPLE__
 
 ///
@@ -119,6 +162,37 @@ EGLint GetContextRenderableType ( EGLDisplay eglDisplay )
    // extension is not supported
    return EGL_OPENGL_ES2_BIT;
 }
+
+///
+// GetOffscreenDisplay()
+//
+//    Get an EGL display that does not need a window system.  Prefer the
+//    EGL_MESA_platform_surfaceless platform so that no X server is required,
+//    otherwise fall back to the default display.
+//
+static EGLDisplay GetOffscreenDisplay ( void )
+{
+#ifdef EGL_EXT_platform_base
+   const char *extensions = eglQueryString ( EGL_NO_DISPLAY, EGL_EXTENSIONS );
+
+   if ( extensions != NULL && strstr ( extensions, "EGL_MESA_platform_surfaceless" ) )
+   {
+      PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+         ( PFNEGLGETPLATFORMDISPLAYEXTPROC ) eglGetProcAddress ( "eglGetPlatformDisplayEXT" );
+
+      if ( getPlatformDisplay != NULL )
+      {
+         EGLDisplay display = getPlatformDisplay ( EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL );
+
+         if ( display != EGL_NO_DISPLAY )
+         {
+            return display;
+         }
+      }
+   }
+#endif
+   return eglGetDisplay ( EGL_DEFAULT_DISPLAY );
+}
 #endif
 
 //////////////////////////////////////////////////////////////////
@@ -138,6 +212,7 @@ EGLint GetContextRenderableType ( EGLDisplay eglDisplay )
 //          ES_WINDOW_DEPTH       - specifies that a depth buffer should be created
 //          ES_WINDOW_STENCIL     - specifies that a stencil buffer should be created
 //          ES_WINDOW_MULTISAMPLE - specifies that a multi-sample buffer should be created
+//          ES_WINDOW_OFFSCREEN   - render to a pbuffer, no native window is created
 //
 GLboolean ESUTIL_API esCreateWindow ( ESContext *esContext, const char *title, GLint width, GLint height, GLuint flags )
 {
@@ -160,14 +235,41 @@ GLboolean ESUTIL_API esCreateWindow ( ESContext *esContext, const char *title, G
 #else
    esContext->width = width;
    esContext->height = height;
+
+   // Allow any sample to be run headless without modifying it
+   if ( getenv ( "ES_OFFSCREEN" ) != NULL )
+   {
+      flags |= ES_WINDOW_OFFSCREEN;
+   }
+
+   if ( getenv ( "ES_FIXED_TIMESTEP" ) != NULL )
+   {
+      const char *maxSteps = getenv ( "ES_FIXED_TIMESTEP_MAX_STEPS" );
+
+      esSetFixedTimestep ( esContext, ( float ) atof ( getenv ( "ES_FIXED_TIMESTEP" ) ),
+                           maxSteps != NULL ? atoi ( maxSteps ) : 5 );
+   }
 #endif
 
-   if ( !WinCreate ( esContext, title ) )
+#ifdef ANDROID
+   // Android always renders to the window provided by the activity
+   flags &= ~ES_WINDOW_OFFSCREEN;
+#endif
+
+   if ( flags & ES_WINDOW_OFFSCREEN )
    {
-      return GL_FALSE;
+      esContext->eglDisplay = GetOffscreenDisplay ();
+   }
+   else
+   {
+      if ( !WinCreate ( esContext, title ) )
+      {
+         return GL_FALSE;
+      }
+
+      esContext->eglDisplay = eglGetDisplay( esContext->eglNativeDisplay );
    }
 
-   esContext->eglDisplay = eglGetDisplay( esContext->eglNativeDisplay );
    if ( esContext->eglDisplay == EGL_NO_DISPLAY )
    {
       return GL_FALSE;
@@ -189,6 +291,7 @@ GLboolean ESUTIL_API esCreateWindow ( ESContext *esContext, const char *title, G
          EGL_ALPHA_SIZE,     ( flags & ES_WINDOW_ALPHA ) ? 8 : EGL_DONT_CARE,
          EGL_DEPTH_SIZE,     ( flags & ES_WINDOW_DEPTH ) ? 8 : EGL_DONT_CARE,
          EGL_STENCIL_SIZE,   ( flags & ES_WINDOW_STENCIL ) ? 8 : EGL_DONT_CARE,
+         EGL_SURFACE_TYPE,   ( flags & ES_WINDOW_OFFSCREEN ) ? EGL_PBUFFER_BIT : EGL_WINDOW_BIT,
          // EGL_SAMPLE_BUFFERS, ( flags & ES_WINDOW_MULTISAMPLE ) ? 1 : 0,
          // EGL_SAMPLES, 16,
          // if EGL_KHR_create_context extension is supported, then we will use
@@ -220,8 +323,22 @@ GLboolean ESUTIL_API esCreateWindow ( ESContext *esContext, const char *title, G
 #endif // ANDROID
 
    // Create a surface
-   esContext->eglSurface = eglCreateWindowSurface ( esContext->eglDisplay, config, 
-                                                    esContext->eglNativeWindow, NULL );
+   if ( flags & ES_WINDOW_OFFSCREEN )
+   {
+      EGLint pbufferAttribs[] =
+      {
+         EGL_WIDTH,  esContext->width,
+         EGL_HEIGHT, esContext->height,
+         EGL_NONE
+      };
+
+      esContext->eglSurface = eglCreatePbufferSurface ( esContext->eglDisplay, config, pbufferAttribs );
+   }
+   else
+   {
+      esContext->eglSurface = eglCreateWindowSurface ( esContext->eglDisplay, config, 
+                                                       esContext->eglNativeWindow, NULL );
+   }
 
    if ( esContext->eglSurface == EGL_NO_SURFACE )
    {
@@ -273,6 +390,62 @@ void ESUTIL_API esRegisterUpdateFunc ( ESContext *esContext, void ( ESCALLBACK *
    esContext->updateFunc = updateFunc;
 }
 
+///
+//  esSetFixedTimestep()
+//
+void ESUTIL_API esSetFixedTimestep ( ESContext *esContext, float timestep, int maxSteps )
+{
+   esContext->fixedTimestep = timestep > 0.0f ? timestep : 0.0f;
+   esContext->maxUpdateSteps = maxSteps > 0 ? maxSteps : 0;
+   esContext->timeAccumulator = 0.0f;
+}
+
+///
+//  esStepUpdate()
+//
+//    Called by the platform loop once per frame.  With a fixed timestep the
+//    elapsed time goes into an accumulator that is drained in whole steps,
+//    capped at maxUpdateSteps so a slow frame cannot cause a spiral of updates.
+//
+void esStepUpdate ( ESContext *esContext, float deltaTime )
+{
+   int steps = 0;
+
+   if ( esContext->updateFunc == NULL )
+   {
+      return;
+   }
+
+   if ( esContext->fixedTimestep <= 0.0f )
+   {
+      esContext->updateFunc ( esContext, deltaTime );
+      return;
+   }
+
+   // Lockstep, one update per frame so runs are reproducible
+   if ( esContext->maxUpdateSteps == 0 )
+   {
+      esContext->updateFunc ( esContext, esContext->fixedTimestep );
+      return;
+   }
+
+   esContext->timeAccumulator += deltaTime;
+
+   while ( esContext->timeAccumulator >= esContext->fixedTimestep &&
+           steps < esContext->maxUpdateSteps )
+   {
+      esContext->updateFunc ( esContext, esContext->fixedTimestep );
+      esContext->timeAccumulator -= esContext->fixedTimestep;
+      steps++;
+   }
+
+   // Drop whatever could not be caught up, keeping the fractional step
+   if ( esContext->timeAccumulator >= esContext->fixedTimestep )
+   {
+      esContext->timeAccumulator = fmodf ( esContext->timeAccumulator, esContext->fixedTimestep );
+   }
+}
+
 
 ///
 //  esRegisterKeyFunc()
@@ -356,7 +529,7 @@ static void esFileClose ( esFile *pFile )
 ///
 // esFileRead()
 //
-//    Wrapper for platform specific File read
+//    Wrapper for platform specific File read, returns the number of bytes read
 //
 static int esFileRead ( esFile *pFile, int bytesToRead, void *buffer )
 {
@@ -370,55 +543,550 @@ static int esFileRead ( esFile *pFile, int bytesToRead, void *buffer )
 #ifdef ANDROID
    bytesRead = AAsset_read ( pFile, buffer, bytesToRead );
 #else
-   bytesRead = fread ( buffer, bytesToRead, 1, pFile );
+   bytesRead = fread ( buffer, 1, bytesToRead, pFile );
 #endif
 
    return bytesRead;
 }
 
 ///
-// esLoadTGA()
+// esFileLength()
 //
-//    Loads a 8-bit, 24-bit or 32-bit TGA image from a file
+//    Wrapper for platform specific File size query
 //
-char *ESUTIL_API esLoadTGA ( void *ioContext, const char *fileName, int *width, int *height )
+static long esFileLength ( esFile *pFile )
+{
+   long length = 0;
+
+   if ( pFile == NULL )
+   {
+      return length;
+   }
+
+#ifdef ANDROID
+   length = AAsset_getLength ( pFile );
+#else
+   fseek ( pFile, 0, SEEK_END );
+   length = ftell ( pFile );
+   fseek ( pFile, 0, SEEK_SET );
+#endif
+
+   return length;
+}
+
+#ifdef TGA_MMAP
+///
+// MapFile()
+//
+//    Map a whole file read-only into memory
+//
+static int MapFile ( const char *fileName, void **base, size_t *length )
+{
+   struct stat st;
+   int fd = open ( fileName, O_RDONLY );
+
+   if ( fd < 0 )
+   {
+      return 0;
+   }
+
+   if ( fstat ( fd, &st ) != 0 || st.st_size < ( off_t ) sizeof ( TGA_HEADER ) )
+   {
+      close ( fd );
+      return 0;
+   }
+
+   *base = mmap ( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+   *length = st.st_size;
+   close ( fd );
+
+   return *base != MAP_FAILED;
+}
+#endif
+
+#ifdef TGA_SSSE3
+///
+// SwizzleBGR_SSSE3()
+//
+//    SSSE3 kernel for SwizzleBGR, returns the number of pixels converted.
+//    Each step converts 5 pixels with a 16 byte load and store; the last
+//    byte is stored unchanged and rewritten by the next step.
+//
+#ifndef __SSSE3__
+__attribute__ ( ( target ( "ssse3" ) ) )
+#endif
+static int SwizzleBGR_SSSE3 ( unsigned char *dst, const unsigned char *src, int count )
+{
+   const __m128i shuffle = _mm_setr_epi8 ( 2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15 );
+   int i;
+
+   for ( i = 0; i + 6 <= count; i += 5 )
+   {
+      __m128i pixels = _mm_loadu_si128 ( ( const __m128i * ) ( src + i * 3 ) );
+      _mm_storeu_si128 ( ( __m128i * ) ( dst + i * 3 ), _mm_shuffle_epi8 ( pixels, shuffle ) );
+   }
+
+   return i;
+}
+#endif
+
+///
+// SwizzleBGR()
+//
+//    Convert count BGR pixels to RGB.  dst and src may be the same.
+//
+static void SwizzleBGR ( unsigned char *dst, const unsigned char *src, int count )
+{
+   int i = 0;
+
+#if defined(TGA_NEON)
+
+   for ( ; i + 16 <= count; i += 16 )
+   {
+      uint8x16x3_t pixels = vld3q_u8 ( src + i * 3 );
+      uint8x16_t   blue = pixels.val[0];
+
+      pixels.val[0] = pixels.val[2];
+      pixels.val[2] = blue;
+      vst3q_u8 ( dst + i * 3, pixels );
+   }
+
+#elif defined(TGA_SSSE3)
+#ifndef __SSSE3__
+
+   if ( __builtin_cpu_supports ( "ssse3" ) )
+#endif
+   {
+      i = SwizzleBGR_SSSE3 ( dst, src, count );
+   }
+
+#endif
+
+   for ( ; i < count; i++ )
+   {
+      unsigned char blue = src[i * 3 + 0];
+      unsigned char green = src[i * 3 + 1];
+
+      dst[i * 3 + 0] = src[i * 3 + 2];
+      dst[i * 3 + 1] = green;
+      dst[i * 3 + 2] = blue;
+   }
+}
+
+///
+// SwizzleBGRA()
+//
+//    Convert count BGRA pixels to RGBA.  dst and src may be the same.
+//
+static void SwizzleBGRA ( unsigned char *dst, const unsigned char *src, int count )
+{
+   int i = 0;
+
+#if defined(TGA_NEON)
+
+   for ( ; i + 16 <= count; i += 16 )
+   {
+      uint8x16x4_t pixels = vld4q_u8 ( src + i * 4 );
+      uint8x16_t   blue = pixels.val[0];
+
+      pixels.val[0] = pixels.val[2];
+      pixels.val[2] = blue;
+      vst4q_u8 ( dst + i * 4, pixels );
+   }
+
+#elif defined(TGA_SSE2)
+   // Keep alpha and green, swap the bytes holding blue and red
+   const __m128i alphaGreen = _mm_set1_epi32 ( ( int ) 0xFF00FF00 );
+
+   for ( ; i + 4 <= count; i += 4 )
+   {
+      __m128i pixels = _mm_loadu_si128 ( ( const __m128i * ) ( src + i * 4 ) );
+      __m128i blueRed = _mm_andnot_si128 ( alphaGreen, pixels );
+
+      blueRed = _mm_or_si128 ( _mm_slli_epi32 ( blueRed, 16 ), _mm_srli_epi32 ( blueRed, 16 ) );
+      pixels = _mm_or_si128 ( _mm_and_si128 ( pixels, alphaGreen ), blueRed );
+      _mm_storeu_si128 ( ( __m128i * ) ( dst + i * 4 ), pixels );
+   }
+
+#endif
+
+   for ( ; i < count; i++ )
+   {
+      unsigned char blue = src[i * 4 + 0];
+
+      dst[i * 4 + 0] = src[i * 4 + 2];
+      dst[i * 4 + 1] = src[i * 4 + 1];
+      dst[i * 4 + 2] = blue;
+      dst[i * 4 + 3] = src[i * 4 + 3];
+   }
+}
+
+///
+// ConvertTGAPixels()
+//
+//    Convert count pixels as stored in the file to the upload format
+//
+static void ConvertTGAPixels ( const TGA_HEADER *header, const unsigned char *palette,
+                               unsigned char *dst, const unsigned char *src, int count )
+{
+   int i;
+
+   switch ( header->ImageType & ~8 )
+   {
+      case 1:
+      {
+         int entryBytes = header->PaletteEntryDepth / 8;
+
+         for ( i = 0; i < count; i++ )
+         {
+            memcpy ( dst + i * entryBytes, palette + src[i] * entryBytes, entryBytes );
+         }
+      }
+      break;
+
+      case 2:
+         if ( header->ColorDepth == 24 )
+         {
+            SwizzleBGR ( dst, src, count );
+         }
+         else
+         {
+            SwizzleBGRA ( dst, src, count );
+         }
+
+         break;
+
+      default:
+         memcpy ( dst, src, count );
+         break;
+   }
+}
+
+///
+// DecodeTGA()
+//
+//    Decode a TGA file held in memory into a buffer that can be passed to
+//    glTexImage2D: bottom row first and RGB(A) channel order.  Handles
+//    color-mapped, true-color and grayscale images, uncompressed (types 1, 2, 3)
+//    or RLE compressed (types 9, 10, 11).  Returns the bytes per pixel in
+//    channels.
+//
+static char *DecodeTGA ( const unsigned char *data, size_t size, int *width, int *height, int *channels )
+{
+   TGA_HEADER           header;
+   const unsigned char *src;
+   const unsigned char *end = data + size;
+   unsigned char        palette[256 * 4];
+   unsigned char        runPixel[4];
+   unsigned char       *buffer;
+   int                  inBytes;
+   int                  outBytes;
+   int                  rle;
+   int                  runCount = 0;
+   int                  runRepeat = 0;
+   int                  x, y;
+
+   if ( size < sizeof ( TGA_HEADER ) )
+   {
+      return NULL;
+   }
+
+   memcpy ( &header, data, sizeof ( TGA_HEADER ) );
+   src = data + sizeof ( TGA_HEADER ) + header.IdSize;
+   inBytes = header.ColorDepth / 8;
+   rle = header.ImageType & 8;
+
+   switch ( header.ImageType & ~8 )
+   {
+      case 1:
+         outBytes = header.PaletteEntryDepth / 8;
+
+         if ( header.MapType != 1 || header.ColorDepth != 8 || ( outBytes != 3 && outBytes != 4 ) ||
+               header.PaletteStart + header.PaletteSize > 256 ||
+               src + header.PaletteSize * outBytes > end )
+         {
+            return NULL;
+         }
+
+         // Convert the palette once so pixels can be copied straight out of it
+         memset ( palette, 0, sizeof ( palette ) );
+
+         if ( outBytes == 3 )
+         {
+            SwizzleBGR ( palette + header.PaletteStart * 3, src, header.PaletteSize );
+         }
+         else
+         {
+            SwizzleBGRA ( palette + header.PaletteStart * 4, src, header.PaletteSize );
+         }
+
+         break;
+
+      case 2:
+         if ( header.ColorDepth != 24 && header.ColorDepth != 32 )
+         {
+            return NULL;
+         }
+
+         outBytes = inBytes;
+         break;
+
+      case 3:
+         if ( header.ColorDepth != 8 )
+         {
+            return NULL;
+         }
+
+         outBytes = inBytes;
+         break;
+
+      default:
+         return NULL;
+   }
+
+   // Skip the color map
+   if ( header.MapType == 1 )
+   {
+      src += header.PaletteSize * ( ( header.PaletteEntryDepth + 7 ) / 8 );
+   }
+
+   buffer = ( unsigned char * ) malloc ( ( size_t ) header.Width * header.Height * outBytes );
+
+   if ( buffer == NULL )
+   {
+      return NULL;
+   }
+
+   for ( y = 0; y < header.Height; y++ )
+   {
+      // Rows are stored bottom up unless the origin is at the top left
+      int row = ( header.Descriptor & INVERTED_BIT ) ? header.Height - 1 - y : y;
+      unsigned char *dst = buffer + ( size_t ) row * header.Width * outBytes;
+
+      for ( x = 0; x < header.Width; )
+      {
+         int count = header.Width - x;
+
+         // RLE packets may span rows
+         if ( rle )
+         {
+            if ( runCount == 0 )
+            {
+               if ( src >= end )
+               {
+                  break;
+               }
+
+               runRepeat = *src & 0x80;
+               runCount = ( *src++ & 0x7F ) + 1;
+
+               if ( runRepeat )
+               {
+                  if ( src + inBytes > end )
+                  {
+                     break;
+                  }
+
+                  ConvertTGAPixels ( &header, palette, runPixel, src, 1 );
+                  src += inBytes;
+               }
+            }
+
+            if ( count > runCount )
+            {
+               count = runCount;
+            }
+
+            runCount -= count;
+         }
+
+         if ( rle && runRepeat )
+         {
+            int i;
+
+            for ( i = 0; i < count; i++ )
+            {
+               memcpy ( dst + ( x + i ) * outBytes, runPixel, outBytes );
+            }
+         }
+         else
+         {
+            if ( src + ( size_t ) count * inBytes > end )
+            {
+               break;
+            }
+
+            ConvertTGAPixels ( &header, palette, dst + x * outBytes, src, count );
+            src += ( size_t ) count * inBytes;
+         }
+
+         x += count;
+      }
+
+      if ( x < header.Width )
+      {
+         // Truncated file
+         free ( buffer );
+         return NULL;
+      }
+   }
+
+   *width = header.Width;
+   *height = header.Height;
+   *channels = outBytes;
+
+   return ( char * ) buffer;
+}
+
+///
+// esLoadTGAChannels()
+//
+//    Loads a TGA image from a file and converts it to RGB(A) with the
+//    first row at the bottom, reports the bytes per pixel in channels
+//
+char *ESUTIL_API esLoadTGAChannels ( void *ioContext, const char *fileName, int *width, int *height, int *channels )
 {
-   char        *buffer;
-   esFile      *fp;
-   TGA_HEADER   Header;
-   int          bytesRead;
+   char        *buffer = NULL;
+#ifdef TGA_MMAP
+   void        *base;
+   size_t       length;
+
+   if ( MapFile ( fileName, &base, &length ) )
+   {
+      buffer = DecodeTGA ( ( const unsigned char * ) base, length, width, height, channels );
+      munmap ( base, length );
+   }
+   else
+#endif
+   {
+      // Read the whole file and decode it from memory
+      esFile *fp = esFileOpen ( ioContext, fileName );
+      long    length = esFileLength ( fp );
+      unsigned char *data = length > 0 ? ( unsigned char * ) malloc ( length ) : NULL;
+
+      if ( data != NULL )
+      {
+         length = esFileRead ( fp, length, data );
+         buffer = DecodeTGA ( data, length, width, height, channels );
+         free ( data );
+      }
 
-   // Open the file for reading
-   fp = esFileOpen ( ioContext, fileName );
+      esFileClose ( fp );
+   }
 
-   if ( fp == NULL )
+   if ( buffer == NULL )
    {
       // Log error as 'error in opening the input file from apk'
       esLogMessage ( "esLoadTGA FAILED to load : { %s }\n", fileName );
-      return NULL;
    }
 
-   bytesRead = esFileRead ( fp, sizeof ( TGA_HEADER ), &Header );
+   return buffer;
+}
 
-   *width = Header.Width;
-   *height = Header.Height;
+///
+// esLoadTGA()
+//
+//    Loads a TGA image from a file and converts it to RGB(A) with the
+//    first row at the bottom
+//
+char *ESUTIL_API esLoadTGA ( void *ioContext, const char *fileName, int *width, int *height )
+{
+   int channels;
+
+   return esLoadTGAChannels ( ioContext, fileName, width, height, &channels );
+}
+
+///
+// esMapTGA()
+//
+//    Loads a TGA image, without copying the pixels where possible
+//
+const char *ESUTIL_API esMapTGA ( void *ioContext, const char *fileName, int *width, int *height )
+{
+#ifdef TGA_MMAP
+   void        *base;
+   size_t       length;
 
-   if ( Header.ColorDepth == 8 ||
-         Header.ColorDepth == 24 || Header.ColorDepth == 32 )
+   if ( MapFile ( fileName, &base, &length ) )
    {
-      int bytesToRead = sizeof ( char ) * ( *width ) * ( *height ) * Header.ColorDepth / 8;
+      TGA_HEADER   header;
+      MappedTGA   *mapped;
+      char        *buffer;
+      size_t       dataOffset;
+      int          channels;
 
-      // Allocate the image data buffer
-      buffer = ( char * ) malloc ( bytesToRead );
+      memcpy ( &header, base, sizeof ( TGA_HEADER ) );
+      dataOffset = sizeof ( TGA_HEADER ) + header.IdSize;
 
-      if ( buffer )
+      // Uncompressed grayscale stored bottom up is already upload ready,
+      // everything else has to be decoded
+      if ( header.ImageType == 3 && header.MapType == 0 && header.ColorDepth == 8 &&
+            ( header.Descriptor & INVERTED_BIT ) == 0 &&
+            dataOffset + ( size_t ) header.Width * header.Height <= length &&
+            ( mapped = ( MappedTGA * ) malloc ( sizeof ( MappedTGA ) ) ) != NULL )
       {
-         bytesRead = esFileRead ( fp, bytesToRead, buffer );
-         esFileClose ( fp );
+         // The pixels are about to be uploaded, start paging them in
+         madvise ( base, length, MADV_WILLNEED );
 
-         return ( buffer );
+         mapped->pixels = ( const char * ) base + dataOffset;
+         mapped->base = base;
+         mapped->length = length;
+
+         pthread_mutex_lock ( &s_mappedTGALock );
+         mapped->next = s_mappedTGAs;
+         s_mappedTGAs = mapped;
+         pthread_mutex_unlock ( &s_mappedTGALock );
+
+         *width = header.Width;
+         *height = header.Height;
+
+         return mapped->pixels;
       }
+
+      buffer = DecodeTGA ( ( const unsigned char * ) base, length, width, height, &channels );
+      munmap ( base, length );
+
+      if ( buffer == NULL )
+      {
+         esLogMessage ( "esMapTGA FAILED to load : { %s }\n", fileName );
+      }
+
+      return buffer;
    }
+#endif
+
+   return esLoadTGA ( ioContext, fileName, width, height );
+}
+
+///
+// esReleaseTGA()
+//
+//    Release an image returned by esMapTGA or esLoadTGA
+//
+void ESUTIL_API esReleaseTGA ( const char *buffer )
+{
+#ifdef TGA_MMAP
+   MappedTGA **link;
+
+   pthread_mutex_lock ( &s_mappedTGALock );
+
+   for ( link = &s_mappedTGAs; *link != NULL; link = &( *link )->next )
+   {
+      MappedTGA *mapped = *link;
+
+      if ( mapped->pixels == buffer )
+      {
+         *link = mapped->next;
+         pthread_mutex_unlock ( &s_mappedTGALock );
+
+         munmap ( mapped->base, mapped->length );
+         free ( mapped );
+         return;
+      }
+   }
+
+   pthread_mutex_unlock ( &s_mappedTGALock );
+#endif
 
-   return ( NULL );
+   free ( ( void * ) buffer );
 }
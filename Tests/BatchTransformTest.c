@@ -0,0 +1,300 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// BatchTransformTest.c
+//
+//    Checks esBatchTransform against esTranslate, esRotate, esScale and
+//    esMatrixMultiply on random instances, split across jobs and with
+//    angles of up to a million degrees.  The scalar chain rounds the angle
+//    to float radians before its sine and cosine, so the tolerance grows
+//    with the angle.  Angles too large to hold a fraction of a turn must
+//    still give a rotation.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include "esUtil.h"
+
+///
+// Defines
+//
+// Enough for NUM_THREADS jobs of BATCH_JOB_MIN_INSTANCES in esTransform.c,
+// and not a multiple of four, so a batch ends with a partial step
+#define NUM_INSTANCES    ( 4 * 16384 + 3 )
+#define NUM_THREADS      4
+#define PI               3.14159265358979323846
+#define TOLERANCE        1.0e-5
+
+///
+// Types
+//
+typedef struct
+{
+   GLfloat translate[3][NUM_INSTANCES];
+   GLfloat angle[NUM_INSTANCES];
+   GLfloat axis[3][NUM_INSTANCES];
+   GLfloat scale[3][NUM_INSTANCES];
+} Instances;
+
+///
+// ScalarTransform()
+//
+//    Matrix of one instance the way a sample builds it
+//
+static void ScalarTransform ( ESMatrix *result, const ESMatrix *viewProjection, const GLfloat translate[3],
+                              GLfloat angle, const GLfloat axis[3], const GLfloat scale[3] )
+{
+   ESMatrix model;
+
+   esMatrixLoadIdentity ( &model );
+   esTranslate ( &model, translate[0], translate[1], translate[2] );
+   esRotate ( &model, angle, axis[0], axis[1], axis[2] );
+   esScale ( &model, scale[0], scale[1], scale[2] );
+   esMatrixMultiply ( result, &model, ( ESMatrix * ) viewProjection );
+}
+
+///
+// CheckBatch()
+//
+//    Compare every batch matrix with the scalar chain.  Returns the number
+//    of instances outside the tolerance.
+//
+static int CheckBatch ( const char *name, const ESMatrix *viewProjection, const ESTransformBatch *batch,
+                        const ESMatrix *matrices )
+{
+   double maxError = 0.0;
+   int    numErrors = 0;
+   int    i, j;
+
+   for ( i = 0; i < NUM_INSTANCES; i++ )
+   {
+      GLfloat  translate[3], axis[3], scale[3], angle;
+      ESMatrix reference;
+      double   maxDiff = 0.0, maxValue = 1.0, error, tolerance;
+
+      for ( j = 0; j < 3; j++ )
+      {
+         translate[j] = batch->translate[j] != NULL ? batch->translate[j][i] : batch->sharedTranslate[j];
+         axis[j] = batch->axis[j] != NULL ? batch->axis[j][i] : batch->sharedAxis[j];
+         scale[j] = batch->scale[j] != NULL ? batch->scale[j][i] : batch->sharedScale[j];
+      }
+
+      angle = batch->angle != NULL ? batch->angle[i] : batch->sharedAngle;
+      ScalarTransform ( &reference, viewProjection, translate, angle, axis, scale );
+
+      for ( j = 0; j < 16; j++ )
+      {
+         double diff = fabs ( ( double ) matrices[i].m[0][j] - reference.m[0][j] );
+
+         maxDiff = diff > maxDiff ? diff : maxDiff;
+         maxValue = fabs ( reference.m[0][j] ) > maxValue ? fabs ( reference.m[0][j] ) : maxValue;
+      }
+
+      // The float radians of the scalar chain are off by up to half an ulp
+      error = maxDiff / maxValue;
+      tolerance = TOLERANCE + fabs ( angle ) * PI / 180.0 * FLT_EPSILON;
+      maxError = error > maxError ? error : maxError;
+
+      if ( error > tolerance )
+      {
+         if ( numErrors == 0 )
+         {
+            printf ( "%s: instance %d, angle %g, error %g above %g\n", name, i, angle, error, tolerance );
+         }
+
+         numErrors++;
+      }
+   }
+
+   printf ( "%s: %d instances, largest error %g, %d errors\n", name, NUM_INSTANCES, maxError, numErrors );
+
+   return numErrors;
+}
+
+///
+// CheckRandom()
+//
+//    Random per-instance transforms with angles up to maxAngle
+//
+static int CheckRandom ( const char *name, ESRandom *rng, const ESMatrix *viewProjection, GLfloat maxAngle,
+                         Instances *instances, ESMatrix *matrices )
+{
+   ESTransformBatch batch;
+   int              i, j;
+
+   memset ( &batch, 0, sizeof ( ESTransformBatch ) );
+
+   for ( j = 0; j < 3; j++ )
+   {
+      esRandomFloats ( rng, instances->translate[j], NUM_INSTANCES, -50.0f, 50.0f );
+      esRandomFloats ( rng, instances->axis[j], NUM_INSTANCES, -1.0f, 1.0f );
+      esRandomFloats ( rng, instances->scale[j], NUM_INSTANCES, 0.1f, 4.0f );
+      batch.translate[j] = instances->translate[j];
+      batch.axis[j] = instances->axis[j];
+      batch.scale[j] = instances->scale[j];
+   }
+
+   esRandomFloats ( rng, instances->angle, NUM_INSTANCES, -maxAngle, maxAngle );
+   batch.angle = instances->angle;
+
+   // Some instances have no rotation axis
+   for ( i = 0; i < NUM_INSTANCES; i += 7 )
+   {
+      instances->axis[0][i] = instances->axis[1][i] = instances->axis[2][i] = 0.0f;
+   }
+
+   esBatchTransform ( matrices, viewProjection, &batch, NUM_INSTANCES );
+
+   return CheckBatch ( name, viewProjection, &batch, matrices );
+}
+
+///
+// CheckShared()
+//
+//    The same transform for every instance from the shared values
+//
+static int CheckShared ( const ESMatrix *viewProjection, ESMatrix *matrices )
+{
+   ESTransformBatch batch;
+
+   memset ( &batch, 0, sizeof ( ESTransformBatch ) );
+   batch.sharedTranslate[0] = 1.0f;
+   batch.sharedTranslate[1] = -2.0f;
+   batch.sharedTranslate[2] = 3.0f;
+   batch.sharedAngle = 1234.5f;
+   batch.sharedAxis[0] = 0.3f;
+   batch.sharedAxis[1] = 1.0f;
+   batch.sharedAxis[2] = -0.5f;
+   batch.sharedScale[0] = 2.0f;
+   batch.sharedScale[1] = 0.5f;
+   batch.sharedScale[2] = 1.0f;
+
+   esBatchTransform ( matrices, viewProjection, &batch, NUM_INSTANCES );
+
+   return CheckBatch ( "Shared", viewProjection, &batch, matrices );
+}
+
+///
+// CheckHugeAngles()
+//
+//    Angles whose floats cannot hold a fraction of a turn must still give
+//    finite, orthonormal rotations
+//
+static int CheckHugeAngles ( void )
+{
+   static const GLfloat angles[] = { 1.0e9f, -3.0e9f, 1.0e12f, 1.0e20f, -1.0e30f, 3.0e38f, -FLT_MAX };
+   const int numAngles = sizeof ( angles ) / sizeof ( angles[0] );
+   ESTransformBatch batch;
+   ESMatrix identity, matrices[sizeof ( angles ) / sizeof ( angles[0] )];
+   int numErrors = 0;
+   int i, j, k;
+
+   esMatrixLoadIdentity ( &identity );
+   memset ( &batch, 0, sizeof ( ESTransformBatch ) );
+   batch.angle = angles;
+   batch.sharedAxis[0] = 0.48f;
+   batch.sharedAxis[1] = 0.6f;
+   batch.sharedAxis[2] = 0.64f;
+   batch.sharedScale[0] = batch.sharedScale[1] = batch.sharedScale[2] = 1.0f;
+
+   esBatchTransform ( matrices, &identity, &batch, numAngles );
+
+   for ( i = 0; i < numAngles; i++ )
+   {
+      double maxError = 0.0;
+
+      for ( j = 0; j < 3; j++ )
+      {
+         for ( k = 0; k < 3; k++ )
+         {
+            double dot = 0.0, error;
+            int    c;
+
+            for ( c = 0; c < 3; c++ )
+            {
+               dot += ( double ) matrices[i].m[j][c] * matrices[i].m[k][c];
+            }
+
+            error = fabs ( dot - ( j == k ? 1.0 : 0.0 ) );
+            maxError = error > maxError || error != error ? error : maxError;
+         }
+      }
+
+      if ( !( maxError <= TOLERANCE * 10.0 ) )
+      {
+         printf ( "Huge angles: angle %g gives no rotation, orthonormality error %g\n", angles[i], maxError );
+         numErrors++;
+      }
+   }
+
+   printf ( "Huge angles: %d angles, %d errors\n", numAngles, numErrors );
+
+   return numErrors;
+}
+
+int main ( void )
+{
+   Instances *instances = malloc ( sizeof ( Instances ) );
+   ESMatrix  *matrices = malloc ( NUM_INSTANCES * sizeof ( ESMatrix ) );
+   ESMatrix   viewProjection, view;
+   ESRandom   rng;
+   int        numErrors = 0;
+
+   if ( instances == NULL || matrices == NULL )
+   {
+      printf ( "Out of memory\n" );
+      free ( instances );
+      free ( matrices );
+      return 1;
+   }
+
+   esRandomSeed ( &rng, 15, 0 );
+   esJobsSetThreads ( NUM_THREADS );
+
+   esMatrixLoadIdentity ( &viewProjection );
+   esPerspective ( &viewProjection, 60.0f, 1.5f, 1.0f, 200.0f );
+   esMatrixLookAt ( &view, 10.0f, 20.0f, 100.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f );
+   esMatrixMultiply ( &viewProjection, &view, &viewProjection );
+
+   numErrors += CheckRandom ( "One turn", &rng, &viewProjection, 360.0f, instances, matrices );
+   numErrors += CheckRandom ( "Many turns", &rng, &viewProjection, 1.0e4f, instances, matrices );
+   numErrors += CheckRandom ( "Million degrees", &rng, &viewProjection, 1.0e6f, instances, matrices );
+   numErrors += CheckShared ( &viewProjection, matrices );
+   numErrors += CheckHugeAngles ();
+
+   esJobsShutdown ();
+   free ( instances );
+   free ( matrices );
+
+   return numErrors == 0 ? 0 : 1;
+}
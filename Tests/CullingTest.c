@@ -0,0 +1,228 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// CullingTest.c
+//
+//    Checks esCullSpheres and esCullBoxes, which test four volumes at a
+//    time, against esSphereInFrustum and esBoxInFrustum on random volumes
+//    around a perspective and an orthographic frustum.  Volumes that touch
+//    a plane to within rounding may go either way.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "esUtil.h"
+
+///
+// Defines
+//
+// Not a multiple of four, so the batches end with a partial step
+#define NUM_VOLUMES      10003
+#define BOUNDARY_EPSILON 1.0e-4f
+
+///
+// SphereMargin()
+//
+//    Distance the sphere reaches into the frustum past its outermost plane,
+//    negative when it is outside
+//
+static GLfloat SphereMargin ( const GLfloat planes[6][4], const GLfloat *sphere )
+{
+   GLfloat margin = 1.0e30f;
+   int     i;
+
+   for ( i = 0; i < 6; i++ )
+   {
+      GLfloat dist = planes[i][0] * sphere[0] + planes[i][1] * sphere[1] + planes[i][2] * sphere[2] +
+                     planes[i][3] + sphere[3];
+
+      margin = dist < margin ? dist : margin;
+   }
+
+   return margin;
+}
+
+///
+// BoxMargin()
+//
+//    Distance the box's corner furthest along each plane normal reaches
+//    into the frustum past the outermost plane
+//
+static GLfloat BoxMargin ( const GLfloat planes[6][4], const GLfloat *box )
+{
+   GLfloat margin = 1.0e30f;
+   int     i;
+
+   for ( i = 0; i < 6; i++ )
+   {
+      GLfloat x = planes[i][0] >= 0.0f ? box[3] : box[0];
+      GLfloat y = planes[i][1] >= 0.0f ? box[4] : box[1];
+      GLfloat z = planes[i][2] >= 0.0f ? box[5] : box[2];
+      GLfloat dist = planes[i][0] * x + planes[i][1] * y + planes[i][2] * z + planes[i][3];
+
+      margin = dist < margin ? dist : margin;
+   }
+
+   return margin;
+}
+
+///
+// CheckVisible()
+//
+//    Compare the batch result against the single volume tests.  Returns the
+//    number of volumes they disagree on away from the boundary.
+//
+static int CheckVisible ( const char *name, const GLfloat planes[6][4], const GLfloat *volumes, int stride,
+                          const GLuint *visible, int numVisible, GLboolean boxes )
+{
+   GLboolean *batch = calloc ( NUM_VOLUMES, sizeof ( GLboolean ) );
+   int        numScalar = 0;
+   int        numErrors = 0;
+   int        i;
+
+   for ( i = 0; i < numVisible; i++ )
+   {
+      if ( visible[i] >= NUM_VOLUMES || ( i > 0 && visible[i] <= visible[i - 1] ) )
+      {
+         printf ( "%s: visible index %d (%u) out of order or range\n", name, i, visible[i] );
+         free ( batch );
+         return 1;
+      }
+
+      batch[visible[i]] = GL_TRUE;
+   }
+
+   for ( i = 0; i < NUM_VOLUMES; i++ )
+   {
+      const GLfloat *volume = volumes + i * stride;
+      GLboolean scalar = boxes ? esBoxInFrustum ( planes, volume, volume + 3 ) :
+                                 esSphereInFrustum ( planes, volume, volume[3] );
+      GLfloat margin = boxes ? BoxMargin ( planes, volume ) : SphereMargin ( planes, volume );
+
+      numScalar += scalar;
+
+      if ( scalar != batch[i] && fabsf ( margin ) > BOUNDARY_EPSILON )
+      {
+         if ( numErrors == 0 )
+         {
+            printf ( "%s: volume %d is %s by the batch test, %s by the single test\n", name, i,
+                     batch[i] ? "visible" : "culled", scalar ? "visible" : "culled" );
+         }
+
+         numErrors++;
+      }
+   }
+
+   printf ( "%s: %d of %d visible, %d by the single test, %d errors\n", name, numVisible, NUM_VOLUMES,
+            numScalar, numErrors );
+
+   free ( batch );
+   return numErrors;
+}
+
+///
+// CheckFrustum()
+//
+//    Cull random spheres and boxes around the frustum of a projection
+//
+static int CheckFrustum ( const char *name, const ESMatrix *projection, ESRandom *rng )
+{
+   GLfloat  planes[6][4];
+   GLfloat *spheres = malloc ( NUM_VOLUMES * 4 * sizeof ( GLfloat ) );
+   GLfloat *boxes = malloc ( NUM_VOLUMES * 6 * sizeof ( GLfloat ) );
+   GLuint  *visible = malloc ( NUM_VOLUMES * sizeof ( GLuint ) );
+   ESMatrix view, viewProjection;
+   char     label[64];
+   int      numErrors = 0;
+   int      i, j;
+
+   if ( spheres == NULL || boxes == NULL || visible == NULL )
+   {
+      printf ( "Out of memory\n" );
+      free ( spheres );
+      free ( boxes );
+      free ( visible );
+      return 1;
+   }
+
+   esMatrixLookAt ( &view, 3.0f, 2.0f, 10.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f );
+   esMatrixMultiply ( &viewProjection, &view, ( ESMatrix * ) projection );
+   esFrustumPlanesFromMatrix ( planes, &viewProjection );
+
+   for ( i = 0; i < NUM_VOLUMES; i++ )
+   {
+      GLfloat *box = boxes + i * 6;
+
+      esRandomFloats ( rng, spheres + i * 4, 3, -20.0f, 20.0f );
+      spheres[i * 4 + 3] = esRandomRange ( rng, 0.0f, 3.0f );
+
+      esRandomFloats ( rng, box, 3, -20.0f, 20.0f );
+
+      for ( j = 0; j < 3; j++ )
+      {
+         box[j + 3] = box[j] + esRandomRange ( rng, 0.0f, 4.0f );
+      }
+   }
+
+   snprintf ( label, sizeof ( label ), "%s spheres", name );
+   numErrors += CheckVisible ( label, planes, spheres, 4, visible,
+                               esCullSpheres ( planes, spheres, NUM_VOLUMES, visible ), GL_FALSE );
+
+   snprintf ( label, sizeof ( label ), "%s boxes", name );
+   numErrors += CheckVisible ( label, planes, boxes, 6, visible,
+                               esCullBoxes ( planes, boxes, NUM_VOLUMES, visible ), GL_TRUE );
+
+   free ( spheres );
+   free ( boxes );
+   free ( visible );
+
+   return numErrors;
+}
+
+int main ( void )
+{
+   ESMatrix perspective, ortho;
+   ESRandom rng;
+   int      numErrors = 0;
+
+   esRandomSeed ( &rng, 17, 0 );
+
+   esMatrixLoadIdentity ( &perspective );
+   esPerspective ( &perspective, 60.0f, 4.0f / 3.0f, 1.0f, 30.0f );
+   numErrors += CheckFrustum ( "Perspective", &perspective, &rng );
+
+   esMatrixLoadIdentity ( &ortho );
+   esOrtho ( &ortho, -8.0f, 8.0f, -6.0f, 6.0f, 1.0f, 30.0f );
+   numErrors += CheckFrustum ( "Orthographic", &ortho, &rng );
+
+   return numErrors == 0 ? 0 : 1;
+}
@@ -0,0 +1,332 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// ImageCompare.c
+//
+//    Compares a captured frame against a golden image for the regression
+//    tests.  Reads uncompressed and RLE compressed 24/32-bit TGA files and
+//    writes golden images RLE compressed to keep them small.
+//
+//    ImageCompare <golden.tga> <frame.tga> [maxChannelDiff] [maxBadPixelPercent]
+//    ImageCompare --update <frame.tga> <golden.tga>
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+///
+// Defines
+//
+#define DEFAULT_CHANNEL_TOLERANCE    8
+#define DEFAULT_BAD_PIXEL_PERCENT    0.5
+
+///
+// Types
+//
+typedef struct
+{
+   int            width;
+   int            height;
+
+   // RGBA, bottom row first
+   unsigned char *pixels;
+} Image;
+
+///
+// LoadImage()
+//
+//    Load a type 2 or type 10 TGA into 32-bit RGBA with a bottom-left origin.
+//    The pixels are NULL if the file cannot be loaded, release them with
+//    FreeImage either way.
+//
+static int LoadImage ( const char *fileName, Image *image )
+{
+   unsigned char header[18];
+   int bytesPerPixel, numPixels, i;
+   FILE *fp = fopen ( fileName, "rb" );
+
+   image->pixels = NULL;
+
+   if ( fp == NULL || fread ( header, sizeof ( header ), 1, fp ) != 1 )
+   {
+      fprintf ( stderr, "Cannot read %s\n", fileName );
+      if ( fp != NULL )
+      {
+         fclose ( fp );
+      }
+      return 0;
+   }
+
+   image->width = header[12] | ( header[13] << 8 );
+   image->height = header[14] | ( header[15] << 8 );
+   bytesPerPixel = header[16] / 8;
+   numPixels = image->width * image->height;
+
+   if ( ( header[2] != 2 && header[2] != 10 ) || ( bytesPerPixel != 3 && bytesPerPixel != 4 ) )
+   {
+      fprintf ( stderr, "%s: unsupported TGA type %d, %d bpp\n", fileName, header[2], header[16] );
+      fclose ( fp );
+      return 0;
+   }
+
+   fseek ( fp, header[0], SEEK_CUR );
+   image->pixels = malloc ( ( size_t ) numPixels * 4 );
+
+   if ( image->pixels == NULL )
+   {
+      fprintf ( stderr, "%s: out of memory\n", fileName );
+      fclose ( fp );
+      return 0;
+   }
+
+   for ( i = 0; i < numPixels; )
+   {
+      unsigned char packet = 0x80;
+      unsigned char bgra[4] = { 0, 0, 0, 255 };
+      int count = 1, repeat = 0, j;
+
+      if ( header[2] == 10 )
+      {
+         packet = ( unsigned char ) fgetc ( fp );
+         count = ( packet & 0x7F ) + 1;
+         repeat = packet & 0x80;
+      }
+
+      for ( j = 0; j < count && i < numPixels; j++, i++ )
+      {
+         if ( j == 0 || !repeat )
+         {
+            if ( fread ( bgra, bytesPerPixel, 1, fp ) != 1 )
+            {
+               fprintf ( stderr, "%s: truncated\n", fileName );
+               fclose ( fp );
+               free ( image->pixels );
+               image->pixels = NULL;
+               return 0;
+            }
+         }
+
+         image->pixels[i * 4 + 0] = bgra[2];
+         image->pixels[i * 4 + 1] = bgra[1];
+         image->pixels[i * 4 + 2] = bgra[0];
+         image->pixels[i * 4 + 3] = bgra[3];
+      }
+   }
+
+   fclose ( fp );
+
+   // Flip top-left origin images
+   if ( header[17] & ( 1 << 5 ) )
+   {
+      int rowBytes = image->width * 4;
+      unsigned char *row = malloc ( rowBytes );
+
+      for ( i = 0; i < image->height / 2; i++ )
+      {
+         unsigned char *top = image->pixels + i * rowBytes;
+         unsigned char *bottom = image->pixels + ( image->height - 1 - i ) * rowBytes;
+         memcpy ( row, top, rowBytes );
+         memcpy ( top, bottom, rowBytes );
+         memcpy ( bottom, row, rowBytes );
+      }
+
+      free ( row );
+   }
+
+   return 1;
+}
+
+///
+// FreeImage()
+//
+static void FreeImage ( Image *image )
+{
+   free ( image->pixels );
+   image->pixels = NULL;
+}
+
+///
+// WriteImageRLE()
+//
+//    Write a 32-bit type 10 (RLE) TGA
+//
+static int WriteImageRLE ( const char *fileName, const Image *image )
+{
+   unsigned char header[18];
+   int numPixels = image->width * image->height;
+   const unsigned int *px = ( const unsigned int * ) image->pixels;
+   FILE *fp = fopen ( fileName, "wb" );
+   int i = 0;
+
+   if ( fp == NULL )
+   {
+      fprintf ( stderr, "Cannot write %s\n", fileName );
+      return 0;
+   }
+
+   memset ( header, 0, sizeof ( header ) );
+   header[2] = 10;
+   header[12] = image->width & 0xFF;
+   header[13] = ( image->width >> 8 ) & 0xFF;
+   header[14] = image->height & 0xFF;
+   header[15] = ( image->height >> 8 ) & 0xFF;
+   header[16] = 32;
+   header[17] = 8;
+   fwrite ( header, sizeof ( header ), 1, fp );
+
+   while ( i < numPixels )
+   {
+      int run = 1, repeat, j;
+
+      while ( i + run < numPixels && run < 128 && px[i + run] == px[i] )
+      {
+         run++;
+      }
+
+      repeat = run > 1;
+
+      if ( !repeat )
+      {
+         // Raw packet up to the start of the next run of equal pixels
+         while ( i + run < numPixels && run < 128 &&
+                 ( i + run + 1 == numPixels || px[i + run] != px[i + run + 1] ) )
+         {
+            run++;
+         }
+      }
+
+      fputc ( ( repeat ? 0x80 : 0 ) | ( run - 1 ), fp );
+
+      for ( j = 0; j < ( repeat ? 1 : run ); j++ )
+      {
+         const unsigned char *rgba = image->pixels + ( i + j ) * 4;
+         unsigned char bgra[4] = { rgba[2], rgba[1], rgba[0], rgba[3] };
+         fwrite ( bgra, 4, 1, fp );
+      }
+
+      i += run;
+   }
+
+   fclose ( fp );
+   return 1;
+}
+
+int main ( int argc, char *argv[] )
+{
+   Image golden, frame;
+   int channelTolerance = DEFAULT_CHANNEL_TOLERANCE;
+   double badPixelPercent = DEFAULT_BAD_PIXEL_PERCENT;
+   int maxDiff = 0, numBad = 0, numPixels, i, c;
+   int result;
+
+   if ( argc == 4 && strcmp ( argv[1], "--update" ) == 0 )
+   {
+      result = LoadImage ( argv[2], &frame ) && WriteImageRLE ( argv[3], &frame ) ? 0 : 1;
+      FreeImage ( &frame );
+
+      if ( result == 0 )
+      {
+         printf ( "Updated %s\n", argv[3] );
+      }
+
+      return result;
+   }
+
+   if ( argc < 3 )
+   {
+      fprintf ( stderr, "usage: %s <golden.tga> <frame.tga> [maxChannelDiff] [maxBadPixelPercent]\n"
+                        "       %s --update <frame.tga> <golden.tga>\n", argv[0], argv[0] );
+      return 2;
+   }
+
+   if ( argc > 3 )
+   {
+      channelTolerance = atoi ( argv[3] );
+   }
+
+   if ( argc > 4 )
+   {
+      badPixelPercent = atof ( argv[4] );
+   }
+
+   frame.pixels = NULL;
+
+   if ( !LoadImage ( argv[1], &golden ) || !LoadImage ( argv[2], &frame ) )
+   {
+      FreeImage ( &golden );
+      FreeImage ( &frame );
+      return 1;
+   }
+
+   if ( golden.width != frame.width || golden.height != frame.height )
+   {
+      printf ( "Size mismatch: golden %dx%d, frame %dx%d\n",
+               golden.width, golden.height, frame.width, frame.height );
+      FreeImage ( &golden );
+      FreeImage ( &frame );
+      return 1;
+   }
+
+   numPixels = golden.width * golden.height;
+
+   for ( i = 0; i < numPixels; i++ )
+   {
+      int pixelDiff = 0;
+
+      for ( c = 0; c < 4; c++ )
+      {
+         int diff = abs ( golden.pixels[i * 4 + c] - frame.pixels[i * 4 + c] );
+
+         if ( diff > pixelDiff )
+         {
+            pixelDiff = diff;
+         }
+      }
+
+      if ( pixelDiff > maxDiff )
+      {
+         maxDiff = pixelDiff;
+      }
+
+      if ( pixelDiff > channelTolerance )
+      {
+         numBad++;
+      }
+   }
+
+   printf ( "Max channel difference %d, %d of %d pixels (%.3f%%) above tolerance %d\n",
+            maxDiff, numBad, numPixels, 100.0 * numBad / numPixels, channelTolerance );
+
+   FreeImage ( &golden );
+   FreeImage ( &frame );
+
+   return 100.0 * numBad / numPixels > badPixelPercent ? 1 : 0;
+}
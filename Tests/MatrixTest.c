@@ -0,0 +1,299 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// MatrixTest.c
+//
+//    Checks esMatrixInverse and esMatrixNormal3x3 against a double
+//    precision cofactor inverse on random model view and projection
+//    matrices, including inverting in place and singular matrices.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "esUtil.h"
+
+///
+// Defines
+//
+#define NUM_MATRICES     1000
+
+// Largest error accepted, relative to the largest element of the inverse
+#define TOLERANCE        1.0e-4
+
+///
+// Determinant3()
+//
+//    Determinant of the 3x3 of a 4x4 array without row skipRow and column
+//    skipColumn
+//
+static double Determinant3 ( const double m[4][4], int skipRow, int skipColumn )
+{
+   double a[3][3];
+   int    i, j, r = 0;
+
+   for ( i = 0; i < 4; i++ )
+   {
+      int c = 0;
+
+      if ( i == skipRow )
+      {
+         continue;
+      }
+
+      for ( j = 0; j < 4; j++ )
+      {
+         if ( j != skipColumn )
+         {
+            a[r][c++] = m[i][j];
+         }
+      }
+
+      r++;
+   }
+
+   return a[0][0] * ( a[1][1] * a[2][2] - a[1][2] * a[2][1] ) -
+          a[0][1] * ( a[1][0] * a[2][2] - a[1][2] * a[2][0] ) +
+          a[0][2] * ( a[1][0] * a[2][1] - a[1][1] * a[2][0] );
+}
+
+///
+// ReferenceInverse()
+//
+//    Inverse of the elements of a matrix as a plain 4x4 array, the adjugate
+//    over the determinant.  The transpose of the inverse is the inverse of
+//    the transpose, so this is the inverse whichever way the array is read.
+//
+static void ReferenceInverse ( const ESMatrix *src, double inv[4][4] )
+{
+   double m[4][4];
+   double det = 0.0;
+   int    i, j;
+
+   for ( i = 0; i < 4; i++ )
+   {
+      for ( j = 0; j < 4; j++ )
+      {
+         m[i][j] = src->m[i][j];
+      }
+   }
+
+   for ( j = 0; j < 4; j++ )
+   {
+      det += ( j % 2 ? -1.0 : 1.0 ) * m[0][j] * Determinant3 ( m, 0, j );
+   }
+
+   for ( i = 0; i < 4; i++ )
+   {
+      for ( j = 0; j < 4; j++ )
+      {
+         inv[j][i] = ( ( i + j ) % 2 ? -1.0 : 1.0 ) * Determinant3 ( m, i, j ) / det;
+      }
+   }
+}
+
+///
+// RelativeError()
+//
+//    Largest difference between count elements, relative to the largest
+//    reference element
+//
+static double RelativeError ( const GLfloat *values, const double *reference, int count )
+{
+   double maxDiff = 0.0, maxValue = 0.0;
+   int    i;
+
+   for ( i = 0; i < count; i++ )
+   {
+      double diff = fabs ( values[i] - reference[i] );
+
+      maxDiff = diff > maxDiff ? diff : maxDiff;
+      maxValue = fabs ( reference[i] ) > maxValue ? fabs ( reference[i] ) : maxValue;
+   }
+
+   return maxDiff / ( maxValue > 1.0 ? maxValue : 1.0 );
+}
+
+///
+// RandomModelView()
+//
+//    Rotated, non-uniformly scaled and translated model in front of a
+//    camera
+//
+static void RandomModelView ( ESRandom *rng, ESMatrix *modelview )
+{
+   GLfloat axis[3], offset[3];
+
+   esRandomFloats ( rng, axis, 3, -1.0f, 1.0f );
+   esRandomFloats ( rng, offset, 3, -10.0f, 10.0f );
+
+   esMatrixLoadIdentity ( modelview );
+   esTranslate ( modelview, offset[0], offset[1], offset[2] - 20.0f );
+   esRotate ( modelview, esRandomRange ( rng, 0.0f, 360.0f ), axis[0], axis[1], axis[2] + 1.5f );
+   esScale ( modelview, esRandomRange ( rng, 0.2f, 3.0f ), esRandomRange ( rng, 0.2f, 3.0f ),
+             esRandomRange ( rng, 0.2f, 3.0f ) );
+}
+
+///
+// CheckInverse()
+//
+//    Invert a matrix into a separate result and in place.  Returns the
+//    number of failures.
+//
+static int CheckInverse ( const char *name, int index, const ESMatrix *src )
+{
+   ESMatrix result, inPlace = *src;
+   double   reference[4][4];
+   double   error;
+
+   ReferenceInverse ( src, reference );
+
+   if ( !esMatrixInverse ( &result, src ) || !esMatrixInverse ( &inPlace, &inPlace ) )
+   {
+      printf ( "%s %d: esMatrixInverse reports a regular matrix as singular\n", name, index );
+      return 1;
+   }
+
+   error = RelativeError ( result.m[0], reference[0], 16 );
+
+   if ( error > TOLERANCE || memcmp ( &result, &inPlace, sizeof ( ESMatrix ) ) != 0 )
+   {
+      printf ( "%s %d: esMatrixInverse error %g, in place %s\n", name, index, error,
+               memcmp ( &result, &inPlace, sizeof ( ESMatrix ) ) ? "differs" : "matches" );
+      return 1;
+   }
+
+   return 0;
+}
+
+///
+// CheckNormal()
+//
+//    Compare esMatrixNormal3x3 with the transposed inverse of the upper
+//    3x3, from the inverse of the model view with its translation removed
+//
+static int CheckNormal ( int index, const ESMatrix *modelview )
+{
+   ESMatrix linear = *modelview;
+   GLfloat  result[3][3];
+   double   inverse[4][4], reference[3][3];
+   double   error;
+   int      i, j;
+
+   linear.m[3][0] = linear.m[3][1] = linear.m[3][2] = 0.0f;
+   ReferenceInverse ( &linear, inverse );
+
+   for ( i = 0; i < 3; i++ )
+   {
+      for ( j = 0; j < 3; j++ )
+      {
+         reference[i][j] = inverse[j][i];
+      }
+   }
+
+   if ( !esMatrixNormal3x3 ( result, modelview ) )
+   {
+      printf ( "Normal %d: esMatrixNormal3x3 reports a regular matrix as singular\n", index );
+      return 1;
+   }
+
+   error = RelativeError ( result[0], reference[0], 9 );
+
+   if ( error > TOLERANCE )
+   {
+      printf ( "Normal %d: esMatrixNormal3x3 error %g\n", index, error );
+      return 1;
+   }
+
+   return 0;
+}
+
+///
+// CheckSingular()
+//
+//    A flattened model view must be reported singular with the result
+//    left alone
+//
+static int CheckSingular ( void )
+{
+   ESMatrix flat, result, untouched;
+   GLfloat  normal[3][3], normalUntouched[3][3];
+
+   esMatrixLoadIdentity ( &flat );
+   esTranslate ( &flat, 1.0f, 2.0f, 3.0f );
+   esScale ( &flat, 2.0f, 0.0f, 2.0f );
+
+   memset ( &result, 0x5A, sizeof ( ESMatrix ) );
+   memset ( normal, 0x5A, sizeof ( normal ) );
+   untouched = result;
+   memcpy ( normalUntouched, normal, sizeof ( normal ) );
+
+   if ( esMatrixInverse ( &result, &flat ) || memcmp ( &result, &untouched, sizeof ( ESMatrix ) ) != 0 ||
+         esMatrixNormal3x3 ( normal, &flat ) || memcmp ( normal, normalUntouched, sizeof ( normal ) ) != 0 )
+   {
+      printf ( "Singular: not reported, or the result was changed\n" );
+      return 1;
+   }
+
+   return 0;
+}
+
+int main ( void )
+{
+   ESRandom rng;
+   int      numErrors = 0;
+   int      i;
+
+   esRandomSeed ( &rng, 16, 0 );
+
+   for ( i = 0; i < NUM_MATRICES; i++ )
+   {
+      ESMatrix modelview, projection, mvp;
+
+      RandomModelView ( &rng, &modelview );
+
+      esMatrixLoadIdentity ( &projection );
+      esPerspective ( &projection, esRandomRange ( &rng, 30.0f, 90.0f ), esRandomRange ( &rng, 0.5f, 2.0f ),
+                      esRandomRange ( &rng, 0.1f, 2.0f ), esRandomRange ( &rng, 50.0f, 100.0f ) );
+      esMatrixMultiply ( &mvp, &modelview, &projection );
+
+      numErrors += CheckInverse ( "Model view", i, &modelview );
+      numErrors += CheckInverse ( "Projection", i, &projection );
+      numErrors += CheckInverse ( "Model view projection", i, &mvp );
+      numErrors += CheckNormal ( i, &modelview );
+   }
+
+   numErrors += CheckSingular ();
+
+   printf ( "%d matrices, %d errors\n", NUM_MATRICES, numErrors );
+
+   return numErrors == 0 ? 0 : 1;
+}
@@ -0,0 +1,250 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// MeshOptimizerTest.c
+//
+//    Shuffles the triangles of a sphere and of a grid, which thrashes the
+//    vertex cache, and runs esOptimizeMesh on them.  The reported ACMR must
+//    match esComputeACMR and drop, and the optimized mesh must hold the
+//    same triangles with the same winding.  The texture coordinates carry
+//    each vertex's original index, so the triangles can be compared after
+//    the vertices are renumbered.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esUtil.h"
+
+///
+// Defines
+//
+#define SPHERE_SLICES    20
+#define GRID_SIZE        32
+
+// Cache size esOptimizeMesh reports the ACMR for
+#define CACHE_SIZE       16
+
+///
+// ShuffleTriangles()
+//
+//    Put the triangles in random order, each keeping its winding
+//
+static void ShuffleTriangles ( ESRandom *rng, GLuint *indices, int numIndices )
+{
+   int i;
+
+   for ( i = numIndices / 3 - 1; i > 0; i-- )
+   {
+      int    j = ( int ) ( esRandomUint ( rng ) % ( GLuint ) ( i + 1 ) );
+      GLuint triangle[3];
+
+      memcpy ( triangle, &indices[i * 3], sizeof ( triangle ) );
+      memcpy ( &indices[i * 3], &indices[j * 3], sizeof ( triangle ) );
+      memcpy ( &indices[j * 3], triangle, sizeof ( triangle ) );
+   }
+}
+
+///
+// CompareTriangles()
+//
+static int CompareTriangles ( const void *a, const void *b )
+{
+   const GLuint *ta = a;
+   const GLuint *tb = b;
+   int i;
+
+   for ( i = 0; i < 3; i++ )
+   {
+      if ( ta[i] != tb[i] )
+      {
+         return ta[i] < tb[i] ? -1 : 1;
+      }
+   }
+
+   return 0;
+}
+
+///
+// CanonicalTriangles()
+//
+//    Rotate each triangle to start at its smallest index, which keeps the
+//    winding, and sort the triangles
+//
+static void CanonicalTriangles ( GLuint *triangles, int numIndices )
+{
+   int i;
+
+   for ( i = 0; i < numIndices; i += 3 )
+   {
+      GLuint *t = &triangles[i];
+
+      while ( t[0] > t[1] || t[0] > t[2] )
+      {
+         GLuint first = t[0];
+
+         t[0] = t[1];
+         t[1] = t[2];
+         t[2] = first;
+      }
+   }
+
+   qsort ( triangles, numIndices / 3, 3 * sizeof ( GLuint ), CompareTriangles );
+}
+
+///
+// CheckMesh()
+//
+//    Optimize a shuffled mesh and check it.  The texture coordinates are
+//    overwritten with the vertex indices.  Returns the number of failures.
+//
+static int CheckMesh ( const char *name, ESRandom *rng, GLuint *indices, int numIndices, int numVertices,
+                       GLfloat *vertices, GLfloat *normals, GLfloat *texCoords )
+{
+   GLuint  *before = malloc ( sizeof ( GLuint ) * numIndices );
+   GLuint  *after = malloc ( sizeof ( GLuint ) * numIndices );
+   GLfloat *original = malloc ( sizeof ( GLfloat ) * 3 * numVertices );
+   float    acmrShuffled, acmrBefore, acmrAfter;
+   int      numErrors = 0;
+   int      i;
+
+   if ( before == NULL || after == NULL || original == NULL )
+   {
+      printf ( "%s: out of memory\n", name );
+      numErrors++;
+      goto done;
+   }
+
+   for ( i = 0; i < numVertices; i++ )
+   {
+      texCoords[i * 2] = ( GLfloat ) i;
+      texCoords[i * 2 + 1] = 0.0f;
+   }
+
+   if ( vertices != NULL )
+   {
+      memcpy ( original, vertices, sizeof ( GLfloat ) * 3 * numVertices );
+   }
+
+   ShuffleTriangles ( rng, indices, numIndices );
+   memcpy ( before, indices, sizeof ( GLuint ) * numIndices );
+   acmrShuffled = esComputeACMR ( indices, numIndices, numVertices, CACHE_SIZE );
+
+   esOptimizeMesh ( indices, numIndices, numVertices, vertices, normals, texCoords, &acmrBefore, &acmrAfter );
+
+   printf ( "%s: %d triangles, ACMR %.3f -> %.3f\n", name, numIndices / 3, acmrBefore, acmrAfter );
+
+   if ( acmrBefore != acmrShuffled || acmrAfter != esComputeACMR ( indices, numIndices, numVertices, CACHE_SIZE ) )
+   {
+      printf ( "%s: reported ACMR differs from esComputeACMR\n", name );
+      numErrors++;
+   }
+
+   if ( !( acmrAfter < acmrBefore ) )
+   {
+      printf ( "%s: ACMR did not drop\n", name );
+      numErrors++;
+   }
+
+   // Back to the original vertex indices through the texture coordinates,
+   // whose positions must have moved with them
+   for ( i = 0; i < numIndices; i++ )
+   {
+      GLuint index = indices[i];
+
+      after[i] = index < ( GLuint ) numVertices ? ( GLuint ) texCoords[index * 2] : ( GLuint ) numVertices;
+
+      if ( index >= ( GLuint ) numVertices ||
+            ( vertices != NULL && memcmp ( &vertices[index * 3], &original[after[i] * 3], 3 * sizeof ( GLfloat ) ) != 0 ) )
+      {
+         printf ( "%s: index %d refers to vertex %u, which did not move with its attributes\n", name, i, index );
+         numErrors++;
+         goto done;
+      }
+   }
+
+   CanonicalTriangles ( before, numIndices );
+   CanonicalTriangles ( after, numIndices );
+
+   if ( memcmp ( before, after, sizeof ( GLuint ) * numIndices ) != 0 )
+   {
+      printf ( "%s: the optimized triangles differ from the original ones\n", name );
+      numErrors++;
+   }
+
+done:
+   free ( before );
+   free ( after );
+   free ( original );
+
+   return numErrors;
+}
+
+int main ( void )
+{
+   GLfloat *vertices = NULL, *normals = NULL, *texCoords = NULL;
+   GLuint  *indices = NULL;
+   ESRandom rng;
+   int      numIndices, numVertices;
+   int      numErrors = 0;
+
+   esRandomSeed ( &rng, 18, 0 );
+
+   // Positions given, so the overdraw clustering runs too
+   numIndices = esGenSphere ( SPHERE_SLICES, 1.0f, &vertices, &normals, &texCoords, &indices );
+   numVertices = ( SPHERE_SLICES / 2 + 1 ) * ( SPHERE_SLICES + 1 );
+   numErrors += CheckMesh ( "Sphere", &rng, indices, numIndices, numVertices, vertices, normals, texCoords );
+   free ( vertices );
+   free ( normals );
+   free ( texCoords );
+   free ( indices );
+
+   // Without positions only the triangle and vertex orders change
+   numIndices = esGenSquareGrid ( GRID_SIZE, NULL, &indices );
+   numVertices = GRID_SIZE * GRID_SIZE;
+   texCoords = malloc ( sizeof ( GLfloat ) * 2 * numVertices );
+
+   if ( texCoords == NULL )
+   {
+      printf ( "Grid: out of memory\n" );
+      numErrors++;
+   }
+   else
+   {
+      numErrors += CheckMesh ( "Grid", &rng, indices, numIndices, numVertices, NULL, NULL, texCoords );
+   }
+
+   free ( texCoords );
+   free ( indices );
+
+   printf ( "%d errors\n", numErrors );
+
+   return numErrors == 0 ? 0 : 1;
+}
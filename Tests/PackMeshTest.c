@@ -0,0 +1,460 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// PackMeshTest.c
+//
+//    Packs vertices with esPackMesh, decodes them as the GL would and
+//    checks each attribute against the floats within the precision of its
+//    format: normalized unsigned and signed shorts, half floats including
+//    denormals, rounding and overflow, and GL_INT_2_10_10_10_REV normals.
+//    Also checks that indices are narrowed to 16 bits with the primitive
+//    restart index kept.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include "esUtil.h"
+
+///
+// Defines
+//
+#define NUM_VERTICES     1000
+
+// Index that restarts a strip, 0xFFFF once narrowed
+#define RESTART_INDEX    0xFFFFFFFF
+
+// Largest vertex count with 16-bit indices, as in esShapes.c
+#define MAX_SHORT_INDEX_VERTICES   0xFFFF
+
+///
+// HalfToFloat()
+//
+//    Decode an IEEE half float
+//
+static double HalfToFloat ( GLushort half )
+{
+   int    exponent = ( half >> 10 ) & 0x1f;
+   int    mantissa = half & 0x3ff;
+   double value;
+
+   if ( exponent == 0x1f )
+   {
+      value = mantissa ? NAN : INFINITY;
+   }
+   else if ( exponent == 0 )
+   {
+      value = ldexp ( mantissa, -24 );
+   }
+   else
+   {
+      value = ldexp ( mantissa | 0x400, exponent - 25 );
+   }
+
+   return half & 0x8000 ? -value : value;
+}
+
+///
+// HalfError()
+//
+//    Largest error of rounding value to the nearest half float, half a
+//    step of the denormals or of its binade
+//
+static double HalfError ( double value )
+{
+   int exponent;
+
+   frexp ( value, &exponent );
+
+   return ldexp ( 1.0, ( exponent < -13 ? -13 : exponent ) - 12 );
+}
+
+///
+// DecodeComponent()
+//
+//    Decode one component of a position or texture coordinate as the GL
+//    does for its type, the signed shorts clamped to -1
+//
+static double DecodeComponent ( const GLushort *src, GLenum type )
+{
+   if ( type == GL_UNSIGNED_SHORT )
+   {
+      return *src / 65535.0;
+   }
+
+   if ( type == GL_SHORT )
+   {
+      double value = ( GLshort ) *src / 32767.0;
+      return value < -1.0 ? -1.0 : value;
+   }
+
+   return HalfToFloat ( *src );
+}
+
+///
+// NormalizedError()
+//
+//    Largest error of packing to a normalized integer with maxValue steps,
+//    half a step and the float rounding of the scaled value
+//
+static double NormalizedError ( int maxValue )
+{
+   return ( 0.5 + maxValue * FLT_EPSILON ) / maxValue;
+}
+
+///
+// ComponentError()
+//
+//    Largest error packing value to type may give
+//
+static double ComponentError ( double value, GLenum type )
+{
+   if ( type == GL_UNSIGNED_SHORT )
+   {
+      return NormalizedError ( 65535 );
+   }
+
+   if ( type == GL_SHORT )
+   {
+      return NormalizedError ( 32767 );
+   }
+
+   return HalfError ( value );
+}
+
+///
+// CheckComponents()
+//
+//    Decode count components from each vertex of a packed attribute and
+//    compare them with the floats.  Returns the number of failures.
+//
+static int CheckComponents ( const char *name, const ESPackedMesh *mesh, GLint offset, GLenum type,
+                             const GLfloat *values, int count )
+{
+   int numErrors = 0;
+   int i, j;
+
+   for ( i = 0; i < mesh->numVertices; i++ )
+   {
+      const GLushort *src = ( const GLushort * ) ( ( const GLubyte * ) mesh->vertices + i * mesh->stride + offset );
+
+      for ( j = 0; j < count; j++ )
+      {
+         double value = values[i * count + j];
+         double decoded = DecodeComponent ( &src[j], type );
+         double error = fabs ( decoded - value );
+
+         if ( !( error <= ComponentError ( value, type ) ) && numErrors++ == 0 )
+         {
+            printf ( "%s: vertex %d component %d is %.9g, decoded %.9g\n", name, i, j, value, decoded );
+         }
+      }
+   }
+
+   return numErrors;
+}
+
+///
+// CheckPositions()
+//
+//    Positions must be packed as type with w = 1
+//
+static int CheckPositions ( const char *name, const GLfloat *vertices, int numVertices, GLenum type )
+{
+   ESPackedMesh mesh;
+   int          numErrors = 0;
+   int          i;
+
+   if ( !esPackMesh ( numVertices, vertices, NULL, NULL, NULL, 0, &mesh ) )
+   {
+      printf ( "%s: esPackMesh failed\n", name );
+      return 1;
+   }
+
+   if ( mesh.positionType != type || mesh.positionOffset != 0 || mesh.stride != 8 )
+   {
+      printf ( "%s: positions packed as 0x%04x at %d with stride %d\n", name, mesh.positionType,
+               mesh.positionOffset, mesh.stride );
+      esFreePackedMesh ( &mesh );
+      return 1;
+   }
+
+   numErrors += CheckComponents ( name, &mesh, 0, type, vertices, 3 );
+
+   for ( i = 0; i < numVertices; i++ )
+   {
+      const GLushort *src = ( const GLushort * ) ( ( const GLubyte * ) mesh.vertices + i * mesh.stride );
+
+      if ( DecodeComponent ( &src[3], type ) != 1.0 && numErrors++ == 0 )
+      {
+         printf ( "%s: vertex %d has w %g\n", name, i, DecodeComponent ( &src[3], type ) );
+      }
+   }
+
+   esFreePackedMesh ( &mesh );
+
+   return numErrors;
+}
+
+///
+// CheckHalfBits()
+//
+//    Exact half floats of values that round to even, go denormal,
+//    underflow or overflow.  The 2 makes the texture coordinates half
+//    floats.
+//
+static int CheckHalfBits ( void )
+{
+   static const struct
+   {
+      GLfloat  value;
+      GLushort half;
+   } cases[] =
+   {
+      { 2.0f, 0x4000 },
+      { 1.0f + 1.0f / 2048.0f, 0x3c00 },            // Halfway, rounds down to even
+      { 1.0f + 3.0f / 2048.0f, 0x3c02 },            // Halfway, rounds up to even
+      { 65504.0f, 0x7bff },                         // Largest half
+      { 65519.0f, 0x7bff },                         // Below halfway to infinity
+      { 65520.0f, 0x7c00 },                         // Halfway, rounds to infinity
+      { -1.0e6f, 0xfc00 },
+      { 6.103515625e-05f, 0x0400 },                 // Smallest normal half
+      { 6.0975551605224609e-05f, 0x03ff },          // Largest denormal half
+      { 5.9604644775390625e-08f, 0x0001 },          // Smallest denormal half
+      { 2.98023223876953125e-08f, 0x0000 },         // Halfway, rounds down to even zero
+      { 8.94069671630859375e-08f, 0x0002 },         // Halfway, rounds up to even
+      { -1.0e-5f, 0x80a8 },
+      { 1.0e-10f, 0x0000 },
+      { -1.0e-10f, 0x8000 }
+   };
+   int          numCases = sizeof ( cases ) / sizeof ( cases[0] );
+   GLfloat      texCoords[2 * sizeof ( cases ) / sizeof ( cases[0] )];
+   ESPackedMesh mesh;
+   int          numErrors = 0;
+   int          i;
+
+   for ( i = 0; i < numCases; i++ )
+   {
+      texCoords[i * 2] = cases[i].value;
+      texCoords[i * 2 + 1] = -cases[i].value;
+   }
+
+   if ( !esPackMesh ( numCases, NULL, NULL, texCoords, NULL, 0, &mesh ) )
+   {
+      printf ( "Half bits: esPackMesh failed\n" );
+      return 1;
+   }
+
+   if ( mesh.texCoordType != GL_HALF_FLOAT )
+   {
+      printf ( "Half bits: texture coordinates packed as 0x%04x\n", mesh.texCoordType );
+      esFreePackedMesh ( &mesh );
+      return 1;
+   }
+
+   for ( i = 0; i < numCases; i++ )
+   {
+      const GLushort *src = ( const GLushort * ) ( ( const GLubyte * ) mesh.vertices + i * mesh.stride );
+
+      if ( src[0] != cases[i].half || src[1] != ( cases[i].half ^ 0x8000 ) )
+      {
+         printf ( "Half bits: %.9g packed as 0x%04x and 0x%04x, expected 0x%04x\n", cases[i].value,
+                  src[0], src[1], cases[i].half );
+         numErrors++;
+      }
+   }
+
+   esFreePackedMesh ( &mesh );
+
+   return numErrors;
+}
+
+///
+// CheckNormals()
+//
+//    Normals must be packed as GL_INT_2_10_10_10_REV with w = 0, decoded
+//    as signed normalized 10-bit integers
+//
+static int CheckNormals ( ESRandom *rng )
+{
+   static const GLfloat axes[6 * 3] =
+   {
+      1.0f, 0.0f, 0.0f,  -1.0f, 0.0f, 0.0f,
+      0.0f, 1.0f, 0.0f,  0.0f, -1.0f, 0.0f,
+      0.0f, 0.0f, 1.0f,  0.0f, 0.0f, -1.0f
+   };
+   GLfloat      normals[NUM_VERTICES * 3];
+   ESPackedMesh mesh;
+   int          numErrors = 0;
+   int          i, j;
+
+   memcpy ( normals, axes, sizeof ( axes ) );
+
+   for ( i = 6; i < NUM_VERTICES; i++ )
+   {
+      GLfloat *n = &normals[i * 3];
+      GLfloat  length;
+
+      esRandomFloats ( rng, n, 3, -1.0f, 1.0f );
+      length = sqrtf ( n[0] * n[0] + n[1] * n[1] + n[2] * n[2] );
+
+      for ( j = 0; j < 3; j++ )
+      {
+         n[j] = length > 0.0f ? n[j] / length : 0.0f;
+      }
+   }
+
+   if ( !esPackMesh ( NUM_VERTICES, NULL, normals, NULL, NULL, 0, &mesh ) )
+   {
+      printf ( "Normals: esPackMesh failed\n" );
+      return 1;
+   }
+
+   for ( i = 0; i < NUM_VERTICES; i++ )
+   {
+      GLuint packed = * ( const GLuint * ) ( ( const GLubyte * ) mesh.vertices + i * mesh.stride + mesh.normalOffset );
+
+      for ( j = 0; j < 3; j++ )
+      {
+         int    bits = ( packed >> ( j * 10 ) ) & 0x3ff;
+         double decoded = ( bits & 0x200 ? bits - 0x400 : bits ) / 511.0;
+         double value = normals[i * 3 + j];
+
+         decoded = decoded < -1.0 ? -1.0 : decoded;
+
+         if ( fabs ( decoded - value ) > NormalizedError ( 511 ) && numErrors++ == 0 )
+         {
+            printf ( "Normals: vertex %d component %d is %.9g, decoded %.9g\n", i, j, value, decoded );
+         }
+      }
+
+      if ( ( packed >> 30 ) != 0 && numErrors++ == 0 )
+      {
+         printf ( "Normals: vertex %d has w %u\n", i, packed >> 30 );
+      }
+   }
+
+   esFreePackedMesh ( &mesh );
+
+   return numErrors;
+}
+
+///
+// CheckIndices()
+//
+//    Indices of numVertices vertices must be narrowed to 16 bits when the
+//    vertices allow it, the restart index to 0xFFFF, and kept otherwise
+//
+static int CheckIndices ( int numVertices, GLenum type )
+{
+   GLuint       indices[NUM_VERTICES];
+   ESPackedMesh mesh;
+   int          numErrors = 0;
+   int          i;
+
+   for ( i = 0; i < NUM_VERTICES; i++ )
+   {
+      indices[i] = i % 5 == 4 ? RESTART_INDEX : ( GLuint ) ( ( i * 7919 ) % numVertices );
+   }
+
+   indices[0] = numVertices - 1;
+
+   // No attributes, so only the indices are allocated
+   if ( !esPackMesh ( numVertices, NULL, NULL, NULL, indices, NUM_VERTICES, &mesh ) )
+   {
+      printf ( "Indices: esPackMesh failed\n" );
+      return 1;
+   }
+
+   if ( mesh.indexType != type || mesh.numIndices != NUM_VERTICES )
+   {
+      printf ( "Indices: %d vertices give %d indices of type 0x%04x\n", numVertices, mesh.numIndices, mesh.indexType );
+      esFreePackedMesh ( &mesh );
+      return 1;
+   }
+
+   for ( i = 0; i < NUM_VERTICES; i++ )
+   {
+      GLuint index = type == GL_UNSIGNED_SHORT ? ( ( const GLushort * ) mesh.indices )[i] :
+                     ( ( const GLuint * ) mesh.indices )[i];
+      GLuint expected = type == GL_UNSIGNED_SHORT && indices[i] == RESTART_INDEX ? 0xFFFF : indices[i];
+
+      if ( index != expected && numErrors++ == 0 )
+      {
+         printf ( "Indices: %d vertices, index %d is %u, expected %u\n", numVertices, i, index, expected );
+      }
+   }
+
+   esFreePackedMesh ( &mesh );
+
+   return numErrors;
+}
+
+int main ( void )
+{
+   GLfloat  values[NUM_VERTICES * 3];
+   ESRandom rng;
+   int      numErrors = 0;
+   int      i;
+
+   esRandomSeed ( &rng, 19, 0 );
+
+   // Both ends of each range, then random values within it
+   values[0] = 0.0f;
+   values[1] = 1.0f;
+   esRandomFloats ( &rng, values + 2, NUM_VERTICES * 3 - 2, 0.0f, 1.0f );
+   numErrors += CheckPositions ( "Unsigned short", values, NUM_VERTICES, GL_UNSIGNED_SHORT );
+
+   values[0] = -1.0f;
+   values[1] = 1.0f;
+   esRandomFloats ( &rng, values + 2, NUM_VERTICES * 3 - 2, -1.0f, 1.0f );
+   numErrors += CheckPositions ( "Short", values, NUM_VERTICES, GL_SHORT );
+
+   // Half floats over their whole range, with denormals
+   for ( i = 0; i < NUM_VERTICES * 3; i++ )
+   {
+      values[i] = ldexpf ( esRandomRange ( &rng, -1.0f, 1.0f ), ( int ) esRandomRange ( &rng, -26.0f, 16.0f ) );
+   }
+
+   values[0] = 2.0f;
+   numErrors += CheckPositions ( "Half float", values, NUM_VERTICES, GL_HALF_FLOAT );
+
+   numErrors += CheckHalfBits ();
+   numErrors += CheckNormals ( &rng );
+   numErrors += CheckIndices ( 1000, GL_UNSIGNED_SHORT );
+   numErrors += CheckIndices ( MAX_SHORT_INDEX_VERTICES, GL_UNSIGNED_SHORT );
+   numErrors += CheckIndices ( MAX_SHORT_INDEX_VERTICES + 1, GL_UNSIGNED_INT );
+
+   printf ( "%d errors\n", numErrors );
+
+   return numErrors == 0 ? 0 : 1;
+}
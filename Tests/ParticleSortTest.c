@@ -0,0 +1,474 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// ParticleSortTest.c
+//
+//    Checks the back to front sort of ES_PARTICLES_CPU.  The particles are
+//    streamed once unsorted with additive blending, then staged and drawn
+//    alpha blended.  The sorted stream and the draw calls are captured by
+//    wrapping glMapBufferRange, glUnmapBuffer and glDrawArrays.  Each
+//    emitter must be one draw, the emitters back to front, and within an
+//    emitter the quantized depth must not grow while particles with equal
+//    keys keep their unsorted order.  The second emitter is flat, so all of
+//    its keys are equal.  The sort on one job and on several must give the
+//    same stream and the same frame.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esUtil.h"
+
+///
+// Defines
+//
+#define WINDOW_SIZE      128
+#define TEXTURE_SIZE     16
+#define NUM_EMITTERS     2
+
+// Enough particles for the sort to split into NUM_THREADS jobs
+#define NUM_PARTICLES    40000
+#define NUM_THREADS      4
+#define MAX_PARTICLES    ( NUM_EMITTERS * NUM_PARTICLES )
+
+///
+// Types
+//
+typedef void *( GL_APIENTRY *MapBufferRangeProc ) ( GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access );
+typedef GLboolean ( GL_APIENTRY *UnmapBufferProc ) ( GLenum target );
+typedef void ( GL_APIENTRY *DrawArraysProc ) ( GLenum mode, GLint first, GLsizei count );
+
+// Particles streamed by one update or draw, and the draws of their ranges
+typedef struct
+{
+   GLfloat particles[MAX_PARTICLES * 4];
+   int     count;
+   int     first[NUM_EMITTERS];
+   int     drawCount[NUM_EMITTERS];
+   int     numDraws;
+} Capture;
+
+// Particle and its index in the unsorted stream, to find it after the sort
+typedef struct
+{
+   GLfloat particle[4];
+   int     index;
+} Entry;
+
+static MapBufferRangeProc s_mapBufferRange;
+static UnmapBufferProc    s_unmapBuffer;
+static DrawArraysProc     s_drawArrays;
+static GLfloat           *s_mapped;
+static int                s_mappedFirst;
+static Capture            s_capture;
+
+///
+// glMapBufferRange()
+//
+//    Remember the mapped range of the stream buffer
+//
+void *GL_APIENTRY glMapBufferRange ( GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access )
+{
+   s_mapped = s_mapBufferRange ( target, offset, length, access );
+   s_mappedFirst = ( int ) ( offset / ( 4 * sizeof ( GLfloat ) ) );
+   s_capture.count = s_mapped != NULL ? ( int ) ( length / ( 4 * sizeof ( GLfloat ) ) ) : 0;
+   s_capture.numDraws = 0;
+   return s_mapped;
+}
+
+///
+// glUnmapBuffer()
+//
+//    Capture the particles written to the mapped range
+//
+GLboolean GL_APIENTRY glUnmapBuffer ( GLenum target )
+{
+   if ( s_mapped != NULL && s_capture.count <= MAX_PARTICLES )
+   {
+      memcpy ( s_capture.particles, s_mapped, s_capture.count * 4 * sizeof ( GLfloat ) );
+   }
+
+   s_mapped = NULL;
+   return s_unmapBuffer ( target );
+}
+
+///
+// glDrawArrays()
+//
+//    Capture the range of the stream each draw reads
+//
+void GL_APIENTRY glDrawArrays ( GLenum mode, GLint first, GLsizei count )
+{
+   if ( s_capture.numDraws < NUM_EMITTERS )
+   {
+      s_capture.first[s_capture.numDraws] = first - s_mappedFirst;
+      s_capture.drawCount[s_capture.numDraws] = count;
+   }
+
+   s_capture.numDraws++;
+   s_drawArrays ( mode, first, count );
+}
+
+///
+// CompareEntries()
+//
+static int CompareEntries ( const void *a, const void *b )
+{
+   return memcmp ( ( ( const Entry * ) a )->particle, ( ( const Entry * ) b )->particle, 4 * sizeof ( GLfloat ) );
+}
+
+///
+// CreateTexture()
+//
+//    Soft white disc, so overlapping particles blend partially
+//
+static GLuint CreateTexture ( void )
+{
+   GLubyte pixels[TEXTURE_SIZE * TEXTURE_SIZE * 4];
+   GLuint  textureId;
+   int     x, y;
+
+   for ( y = 0; y < TEXTURE_SIZE; y++ )
+   {
+      for ( x = 0; x < TEXTURE_SIZE; x++ )
+      {
+         GLfloat dx = ( x + 0.5f ) / TEXTURE_SIZE * 2.0f - 1.0f;
+         GLfloat dy = ( y + 0.5f ) / TEXTURE_SIZE * 2.0f - 1.0f;
+         GLfloat a = 1.0f - ( dx * dx + dy * dy );
+         GLubyte *texel = &pixels[( y * TEXTURE_SIZE + x ) * 4];
+
+         texel[0] = texel[1] = texel[2] = 255;
+         texel[3] = ( GLubyte ) ( a > 0.0f ? a * 255.0f : 0.0f );
+      }
+   }
+
+   glGenTextures ( 1, &textureId );
+   glBindTexture ( GL_TEXTURE_2D, textureId );
+   glTexImage2D ( GL_TEXTURE_2D, 0, GL_RGBA, TEXTURE_SIZE, TEXTURE_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels );
+   glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+   glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+
+   return textureId;
+}
+
+///
+// CreateParticles()
+//
+//    Two overlapping clouds of differently colored particles, moved on
+//    from their burst so they spread out.  The first is the farther and
+//    spreads in depth, the second is flat.  The unsorted stream is
+//    captured into unsorted, then the particles are staged for alpha
+//    blending.
+//
+static ESParticleSystem *CreateParticles ( Capture *unsorted )
+{
+   static const GLfloat colors[NUM_EMITTERS][4] =
+   {
+      { 1.0f, 0.5f, 0.25f, 0.5f },
+      { 0.25f, 0.5f, 1.0f, 0.5f }
+   };
+   ESParticleDrawOptions options;
+   ESParticleEmitter emitter;
+   ESParticleSystem *system = esParticleSystemCreate ( NUM_EMITTERS * NUM_PARTICLES, ES_PARTICLES_CPU );
+   int i;
+
+   if ( system == NULL )
+   {
+      return NULL;
+   }
+
+   for ( i = 0; i < NUM_EMITTERS; i++ )
+   {
+      memset ( &emitter, 0, sizeof ( ESParticleEmitter ) );
+      emitter.lifetime = 2.0f;
+      emitter.capacity = NUM_PARTICLES;
+      emitter.position[0] = i == 0 ? -0.1f : 0.1f;
+      emitter.position[2] = i == 0 ? 0.1f : -0.1f;
+      emitter.positionSpread[0] = emitter.positionSpread[1] = 0.25f;
+      emitter.positionSpread[2] = i == 0 ? 0.25f : 0.0f;
+      emitter.velocitySpread[0] = emitter.velocitySpread[1] = 0.5f;
+      emitter.velocitySpread[2] = i == 0 ? 0.5f : 0.0f;
+      emitter.minSize = 4.0f;
+      emitter.maxSize = 12.0f;
+      memcpy ( emitter.color, colors[i], sizeof ( emitter.color ) );
+
+      if ( esParticleSystemAddEmitter ( system, &emitter ) < 0 ||
+            esParticleSystemBurst ( system, i, NUM_PARTICLES ) != NUM_PARTICLES )
+      {
+         esParticleSystemDestroy ( system );
+         return NULL;
+      }
+   }
+
+   esParticleSystemUpdate ( system, 0.5f );
+   *unsorted = s_capture;
+
+   // Stage the same particles again, a zero step does not move them
+   memset ( &options, 0, sizeof ( ESParticleDrawOptions ) );
+   options.blend = ES_PARTICLES_BLEND_ALPHA;
+   options.downsample = 1;
+
+   if ( !esParticleSystemSetDrawOptions ( system, &options ) )
+   {
+      esParticleSystemDestroy ( system );
+      return NULL;
+   }
+
+   esParticleSystemUpdate ( system, 0.0f );
+
+   return system;
+}
+
+///
+// DrawFrame()
+//
+//    Sort and draw the staged particles with numThreads threads, capture
+//    the sorted stream and read back the frame
+//
+static void DrawFrame ( ESParticleSystem *system, GLuint textureId, int numThreads, Capture *sorted, GLubyte *pixels )
+{
+   ESMatrix identity;
+
+   esJobsSetThreads ( numThreads );
+   esMatrixLoadIdentity ( &identity );
+
+   glViewport ( 0, 0, WINDOW_SIZE, WINDOW_SIZE );
+   glClear ( GL_COLOR_BUFFER_BIT );
+
+   esParticleSystemDraw ( system, &identity, textureId );
+   *sorted = s_capture;
+
+   glReadPixels ( 0, 0, WINDOW_SIZE, WINDOW_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, pixels );
+}
+
+///
+// CheckOrder()
+//
+//    Check that sorted holds the particles of unsorted back to front.  The
+//    depth of a particle under the identity matrix is its z, quantized as
+//    esParticleSystemDraw does.  Returns GL_FALSE on the first particle out
+//    of order.
+//
+static GLboolean CheckOrder ( const Capture *unsorted, const Capture *sorted, Entry *entries, GLubyte *used )
+{
+   GLfloat minDepth = 1.0e30f;
+   GLfloat maxDepth = -1.0e30f;
+   GLfloat depthScale;
+   GLfloat lastEmitterDepth = 1.0e30f;
+   int     numTies = 0;
+   int     draw, i;
+
+   if ( unsorted->count != MAX_PARTICLES || sorted->count != MAX_PARTICLES || sorted->numDraws != NUM_EMITTERS )
+   {
+      printf ( "Streamed %d and %d particles in %d draws, expected %d in %d\n",
+               unsorted->count, sorted->count, sorted->numDraws, MAX_PARTICLES, NUM_EMITTERS );
+      return GL_FALSE;
+   }
+
+   for ( i = 0; i < MAX_PARTICLES; i++ )
+   {
+      GLfloat depth = unsorted->particles[i * 4 + 2];
+
+      memcpy ( entries[i].particle, unsorted->particles + i * 4, 4 * sizeof ( GLfloat ) );
+      entries[i].index = i;
+      minDepth = depth < minDepth ? depth : minDepth;
+      maxDepth = depth > maxDepth ? depth : maxDepth;
+   }
+
+   qsort ( entries, MAX_PARTICLES, sizeof ( Entry ), CompareEntries );
+   memset ( used, 0, MAX_PARTICLES );
+   depthScale = maxDepth > minDepth ? 65535.0f / ( maxDepth - minDepth ) : 0.0f;
+
+   for ( draw = 0; draw < NUM_EMITTERS; draw++ )
+   {
+      int    first = sorted->first[draw];
+      int    count = sorted->drawCount[draw];
+      int    emitter = -1;
+      GLuint lastKey = 0;
+      int    lastIndex = -1;
+
+      if ( first < 0 || count != NUM_PARTICLES || first + count > MAX_PARTICLES )
+      {
+         printf ( "Draw %d reads %d particles from %d\n", draw, count, first );
+         return GL_FALSE;
+      }
+
+      for ( i = first; i < first + count; i++ )
+      {
+         Entry        key;
+         const Entry *entry;
+         GLfloat      depth;
+         GLuint       q;
+
+         memcpy ( key.particle, sorted->particles + i * 4, 4 * sizeof ( GLfloat ) );
+         entry = bsearch ( &key, entries, MAX_PARTICLES, sizeof ( Entry ), CompareEntries );
+
+         if ( entry == NULL || used[entry->index] )
+         {
+            printf ( "Sorted particle %d is %s\n", i, entry == NULL ? "not one of the streamed ones" : "a duplicate" );
+            return GL_FALSE;
+         }
+
+         used[entry->index] = 1;
+
+         // The emitters are streamed in order, full
+         if ( emitter < 0 )
+         {
+            emitter = entry->index / NUM_PARTICLES;
+         }
+         else if ( emitter != entry->index / NUM_PARTICLES )
+         {
+            printf ( "Draw %d mixes the particles of emitters %d and %d\n", draw, emitter, entry->index / NUM_PARTICLES );
+            return GL_FALSE;
+         }
+
+         depth = ( key.particle[2] - minDepth ) * depthScale;
+         q = depth <= 0.0f ? 0 : depth >= 65535.0f ? 65535 : ( GLuint ) depth;
+
+         if ( lastIndex >= 0 && q > lastKey )
+         {
+            printf ( "Particle %d of draw %d is nearer than the next one (depth %u < %u)\n", i - 1, draw, lastKey, q );
+            return GL_FALSE;
+         }
+
+         if ( lastIndex >= 0 && q == lastKey )
+         {
+            if ( entry->index < lastIndex )
+            {
+               printf ( "Particles %d and %d of draw %d have equal keys but swapped order\n", i - 1, i, draw );
+               return GL_FALSE;
+            }
+
+            numTies++;
+         }
+
+         lastKey = q;
+         lastIndex = entry->index;
+      }
+
+      // Emitter 0 is at z 0.1, emitter 1 at z -0.1
+      if ( ( emitter == 0 ? 0.1f : -0.1f ) > lastEmitterDepth )
+      {
+         printf ( "Emitter %d is drawn after a nearer one\n", emitter );
+         return GL_FALSE;
+      }
+
+      lastEmitterDepth = emitter == 0 ? 0.1f : -0.1f;
+   }
+
+   printf ( "%d particles back to front, %d with the key of the one before\n", MAX_PARTICLES, numTies );
+
+   return GL_TRUE;
+}
+
+///
+// esMain()
+//
+//    Runs the check, a failure fails the program before the platform loop
+//    starts.  Run with ES_BENCHMARK_FRAMES=1 so the loop ends.
+//
+int esMain ( ESContext *esContext )
+{
+   size_t            frameSize = WINDOW_SIZE * WINDOW_SIZE * 4;
+   GLubyte          *single = malloc ( frameSize );
+   GLubyte          *threaded = malloc ( frameSize );
+   Capture          *captures = malloc ( 3 * sizeof ( Capture ) );
+   Entry            *entries = malloc ( MAX_PARTICLES * sizeof ( Entry ) );
+   GLubyte          *used = malloc ( MAX_PARTICLES );
+   ESParticleSystem *system = NULL;
+   GLuint            textureId = 0;
+   GLboolean         passed = GL_FALSE;
+   int               numDiff = 0;
+   int               numCovered = 0;
+   size_t            i;
+
+   s_mapBufferRange = ( MapBufferRangeProc ) eglGetProcAddress ( "glMapBufferRange" );
+   s_unmapBuffer = ( UnmapBufferProc ) eglGetProcAddress ( "glUnmapBuffer" );
+   s_drawArrays = ( DrawArraysProc ) eglGetProcAddress ( "glDrawArrays" );
+
+   if ( single == NULL || threaded == NULL || captures == NULL || entries == NULL || used == NULL ||
+         s_mapBufferRange == NULL || s_unmapBuffer == NULL || s_drawArrays == NULL ||
+         !esCreateWindow ( esContext, "ParticleSortTest", WINDOW_SIZE, WINDOW_SIZE, ES_WINDOW_RGB | ES_WINDOW_OFFSCREEN ) )
+   {
+      goto done;
+   }
+
+   textureId = CreateTexture ();
+   system = CreateParticles ( &captures[0] );
+
+   if ( system == NULL )
+   {
+      printf ( "Cannot create the particle system\n" );
+      goto done;
+   }
+
+   glClearColor ( 0.0f, 0.0f, 0.0f, 1.0f );
+
+   DrawFrame ( system, textureId, 1, &captures[1], single );
+   DrawFrame ( system, textureId, NUM_THREADS, &captures[2], threaded );
+
+   for ( i = 0; i < frameSize; i += 4 )
+   {
+      numDiff += memcmp ( single + i, threaded + i, 4 ) != 0;
+      numCovered += single[i] != 0 || single[i + 1] != 0 || single[i + 2] != 0;
+   }
+
+   printf ( "%d particles, %d of %d pixels covered, %d differ between 1 and %d threads\n",
+            esParticleSystemLiveCount ( system ), numCovered, WINDOW_SIZE * WINDOW_SIZE, numDiff, NUM_THREADS );
+
+   passed = CheckOrder ( &captures[0], &captures[1], entries, used );
+
+   if ( passed && memcmp ( captures[1].particles, captures[2].particles, sizeof ( captures[1].particles ) ) != 0 )
+   {
+      printf ( "The sorted streams differ between 1 and %d threads\n", NUM_THREADS );
+      passed = GL_FALSE;
+   }
+
+   passed = passed && numDiff == 0 && numCovered > 0;
+
+done:
+   if ( system != NULL )
+   {
+      esParticleSystemDestroy ( system );
+   }
+
+   if ( textureId != 0 )
+   {
+      glDeleteTextures ( 1, &textureId );
+   }
+
+   free ( single );
+   free ( threaded );
+   free ( captures );
+   free ( entries );
+   free ( used );
+
+   return passed;
+}
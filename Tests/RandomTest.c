@@ -0,0 +1,143 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// RandomTest.c
+//
+//    Checks that esRandomFloats gives the same values as the same number
+//    of esRandomRange calls and leaves the generator in the same state,
+//    for every count, every position in the generator's four lane buffer
+//    and several seeds, streams and ranges.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esUtil.h"
+
+///
+// Defines
+//
+#define MAX_COUNT        37
+#define MAX_SKIP         4
+#define NUM_SEEDS        3
+#define NUM_RANGES       3
+
+///
+// CheckFloats()
+//
+//    Draw skip values one at a time from two copies of a generator, then
+//    count values with esRandomFloats from one and esRandomRange from the
+//    other.  Returns GL_FALSE if the values or the following draws differ.
+//
+static GLboolean CheckFloats ( const ESRandom *seeded, int skip, int count, GLfloat min, GLfloat max )
+{
+   ESRandom batch = *seeded, single = *seeded;
+   GLfloat  values[MAX_COUNT + 1];
+   int      i;
+
+   for ( i = 0; i < skip; i++ )
+   {
+      esRandomUint ( &batch );
+      esRandomUint ( &single );
+   }
+
+   // The guard value after the last one must not be written
+   values[count] = -1.0f;
+   esRandomFloats ( &batch, values, count, min, max );
+
+   for ( i = 0; i < count; i++ )
+   {
+      GLfloat value = esRandomRange ( &single, min, max );
+
+      if ( memcmp ( &value, &values[i], sizeof ( GLfloat ) ) != 0 )
+      {
+         printf ( "skip %d count %d [%g, %g): value %d is %.9g, esRandomRange gives %.9g\n",
+                  skip, count, min, max, i, values[i], value );
+         return GL_FALSE;
+      }
+   }
+
+   if ( values[count] != -1.0f )
+   {
+      printf ( "skip %d count %d: esRandomFloats wrote past the end\n", skip, count );
+      return GL_FALSE;
+   }
+
+   for ( i = 0; i < 2 * MAX_SKIP; i++ )
+   {
+      if ( esRandomUint ( &batch ) != esRandomUint ( &single ) )
+      {
+         printf ( "skip %d count %d [%g, %g): generators differ %d draws later\n", skip, count, min, max, i );
+         return GL_FALSE;
+      }
+   }
+
+   return GL_TRUE;
+}
+
+int main ( void )
+{
+   static const unsigned long long seeds[NUM_SEEDS] = { 0, 23, 0x123456789ABCDEFULL };
+   static const GLfloat ranges[NUM_RANGES][2] =
+   {
+      { 0.0f, 1.0f },
+      { -0.5f, 0.5f },
+      { 10.0f, 1000.0f }
+   };
+   int numChecks = 0;
+   int numErrors = 0;
+   int seed, stream, range, skip, count;
+
+   for ( seed = 0; seed < NUM_SEEDS; seed++ )
+   {
+      for ( stream = 0; stream < 2; stream++ )
+      {
+         ESRandom rng;
+
+         esRandomSeed ( &rng, seeds[seed], ( unsigned int ) stream );
+
+         for ( range = 0; range < NUM_RANGES; range++ )
+         {
+            for ( skip = 0; skip < MAX_SKIP; skip++ )
+            {
+               for ( count = 0; count <= MAX_COUNT; count++ )
+               {
+                  numErrors += !CheckFloats ( &rng, skip, count, ranges[range][0], ranges[range][1] );
+                  numChecks++;
+               }
+            }
+         }
+      }
+   }
+
+   printf ( "%d checks, %d errors\n", numChecks, numErrors );
+
+   return numErrors == 0 ? 0 : 1;
+}
@@ -0,0 +1,60 @@
+# Runs a single sample for the golden image regression tests.
+#
+# Expects SAMPLE, WORKING_DIR, OUTPUT_DIR, GOLDEN, COMPARE, FRAMES,
+# CHANNEL_TOLERANCE, BAD_PIXEL_PERCENT and UPDATE_GOLDEN to be defined.
+# ENVIRONMENT is an optional NAME=VALUE setting the sample runs with.
+# The benchmark report with the frame times is kept in
+# OUTPUT_DIR/benchmark.txt next to the captured frame.  The program binary
+# cache is kept in OUTPUT_DIR as well, so every run starts from an empty
+# cache and nothing is written to the user's cache directory.
+
+file( REMOVE_RECURSE ${OUTPUT_DIR} )
+file( MAKE_DIRECTORY ${OUTPUT_DIR} )
+
+set( ENV{ES_OFFSCREEN} 1 )
+set( ENV{ES_BENCHMARK_FRAMES} ${FRAMES} )
+set( ENV{ES_FIXED_TIMESTEP} 0.0166667 )
+set( ENV{ES_FIXED_TIMESTEP_MAX_STEPS} 0 )
+set( ENV{ES_CAPTURE_DIR} ${OUTPUT_DIR} )
+set( ENV{ES_CAPTURE_INTERVAL} ${FRAMES} )
+set( ENV{ES_CAPTURE_FORMAT} tga )
+set( ENV{ES_PROGRAM_CACHE_DIR} ${OUTPUT_DIR}/program_cache )
+
+if( ENVIRONMENT MATCHES "^([^=]+)=(.*)$" )
+   set( ENV{${CMAKE_MATCH_1}} "${CMAKE_MATCH_2}" )
+endif()
+
+execute_process( COMMAND ${SAMPLE}
+                 WORKING_DIRECTORY ${WORKING_DIR}
+                 RESULT_VARIABLE result
+                 OUTPUT_VARIABLE output
+                 ERROR_VARIABLE output
+                 TIMEOUT 300 )
+
+file( WRITE ${OUTPUT_DIR}/benchmark.txt "${output}" )
+string( REGEX MATCH "Benchmark:.*" report "${output}" )
+message( "${report}" )
+
+if( NOT result EQUAL 0 )
+   message( FATAL_ERROR "${SAMPLE} failed (${result}):\n${output}" )
+endif()
+
+file( GLOB frames ${OUTPUT_DIR}/frame_*.tga )
+list( LENGTH frames numFrames )
+
+if( NOT numFrames EQUAL 1 )
+   message( FATAL_ERROR "Expected one captured frame in ${OUTPUT_DIR}, found ${numFrames}" )
+endif()
+
+if( UPDATE_GOLDEN )
+   execute_process( COMMAND ${COMPARE} --update ${frames} ${GOLDEN} RESULT_VARIABLE result )
+elseif( NOT EXISTS ${GOLDEN} )
+   message( FATAL_ERROR "Missing golden image ${GOLDEN}, configure with -DES_UPDATE_GOLDEN=ON to create it" )
+else()
+   execute_process( COMMAND ${COMPARE} ${GOLDEN} ${frames} ${CHANNEL_TOLERANCE} ${BAD_PIXEL_PERCENT}
+                    RESULT_VARIABLE result )
+endif()
+
+if( NOT result EQUAL 0 )
+   message( FATAL_ERROR "Image comparison against ${GOLDEN} failed" )
+endif()
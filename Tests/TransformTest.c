@@ -0,0 +1,202 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// TransformTest.c
+//
+//    Checks esMatrixTransformVec4 and esMatrixMultiply against a scalar
+//    reference on random matrices and vectors.  Every path sums in the same
+//    order, so the results must be bit identical.  The vector counts cover
+//    the AVX kernel, which takes pairs of vectors when the CPU has AVX, the
+//    SSE or NEON loop on its own and as the tail after the AVX pairs, and
+//    transforming in place.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "esUtil.h"
+
+///
+// Defines
+//
+#define NUM_MATRICES     200
+#define MAX_VECTORS      37
+
+// Written after the vectors, must be left alone
+#define GUARD            12345.0f
+
+///
+// ReferenceTransform()
+//
+//    dst[i] = src[i].x * m[0] + src[i].y * m[1] + src[i].z * m[2] + src[i].w * m[3],
+//    summed from the left
+//
+static void ReferenceTransform ( GLfloat *dst, const ESMatrix *matrix, const GLfloat *src, int count )
+{
+   int i, j;
+
+   for ( i = 0; i < count; i++ )
+   {
+      for ( j = 0; j < 4; j++ )
+      {
+         dst[i * 4 + j] = src[i * 4 + 0] * matrix->m[0][j] +
+                          src[i * 4 + 1] * matrix->m[1][j] +
+                          src[i * 4 + 2] * matrix->m[2][j] +
+                          src[i * 4 + 3] * matrix->m[3][j];
+      }
+   }
+}
+
+///
+// RandomValues()
+//
+//    Random values of mixed magnitudes, so a change in the order of the
+//    sums changes the result
+//
+static void RandomValues ( ESRandom *rng, GLfloat *values, int count )
+{
+   int i;
+
+   for ( i = 0; i < count; i++ )
+   {
+      values[i] = ldexpf ( esRandomRange ( rng, -1.0f, 1.0f ), ( int ) esRandomRange ( rng, -8.0f, 8.0f ) );
+   }
+}
+
+///
+// CheckTransform()
+//
+//    Transform count vectors into a separate array and in place.  Returns
+//    the number of failures.
+//
+static int CheckTransform ( int index, const ESMatrix *matrix, const GLfloat *src, int count )
+{
+   GLfloat reference[MAX_VECTORS * 4];
+   GLfloat result[MAX_VECTORS * 4 + 1];
+   GLfloat inPlace[MAX_VECTORS * 4 + 1];
+
+   ReferenceTransform ( reference, matrix, src, count );
+
+   result[count * 4] = GUARD;
+   esMatrixTransformVec4 ( result, matrix, src, count );
+
+   memcpy ( inPlace, src, count * 4 * sizeof ( GLfloat ) );
+   inPlace[count * 4] = GUARD;
+   esMatrixTransformVec4 ( inPlace, matrix, inPlace, count );
+
+   if ( memcmp ( result, reference, count * 4 * sizeof ( GLfloat ) ) != 0 ||
+         memcmp ( inPlace, reference, count * 4 * sizeof ( GLfloat ) ) != 0 ||
+         result[count * 4] != GUARD || inPlace[count * 4] != GUARD )
+   {
+      printf ( "Transform %d: %d vectors differ from the reference or were overrun\n", index, count );
+      return 1;
+   }
+
+   return 0;
+}
+
+///
+// CheckMultiply()
+//
+//    esMatrixMultiply is the transform of the rows of srcA by srcB, also
+//    with the result in place of either.  Returns the number of failures.
+//
+static int CheckMultiply ( int index, const ESMatrix *a, const ESMatrix *b )
+{
+   ESMatrix reference, result, srcA = *a, srcB = *b;
+
+   ReferenceTransform ( reference.m[0], b, a->m[0], 4 );
+
+   esMatrixMultiply ( &result, &srcA, &srcB );
+
+   if ( memcmp ( &result, &reference, sizeof ( ESMatrix ) ) != 0 )
+   {
+      printf ( "Multiply %d: differs from the reference\n", index );
+      return 1;
+   }
+
+   esMatrixMultiply ( &srcB, &srcA, &srcB );
+
+   if ( memcmp ( &srcB, &reference, sizeof ( ESMatrix ) ) != 0 )
+   {
+      printf ( "Multiply %d: differs from the reference in place of srcB\n", index );
+      return 1;
+   }
+
+   srcB = *b;
+   esMatrixMultiply ( &srcA, &srcA, &srcB );
+
+   if ( memcmp ( &srcA, &reference, sizeof ( ESMatrix ) ) != 0 )
+   {
+      printf ( "Multiply %d: differs from the reference in place of srcA\n", index );
+      return 1;
+   }
+
+   return 0;
+}
+
+int main ( void )
+{
+   static const int counts[] = { 0, 1, 2, 3, 4, 5, 8, 16, 31, MAX_VECTORS };
+   GLfloat  vectors[MAX_VECTORS * 4];
+   ESRandom rng;
+   int      numErrors = 0;
+   int      i, j;
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+   printf ( "AVX %s\n", __builtin_cpu_supports ( "avx" ) ? "supported, testing its kernel" : "not supported" );
+#endif
+
+   esRandomSeed ( &rng, 14, 0 );
+
+   for ( i = 0; i < NUM_MATRICES; i++ )
+   {
+      ESMatrix a, b;
+
+      RandomValues ( &rng, a.m[0], 16 );
+      RandomValues ( &rng, b.m[0], 16 );
+      RandomValues ( &rng, vectors, MAX_VECTORS * 4 );
+
+      for ( j = 0; j < ( int ) ( sizeof ( counts ) / sizeof ( counts[0] ) ); j++ )
+      {
+         numErrors += CheckTransform ( i, &a, vectors, counts[j] );
+      }
+
+      // Source off the 16 byte alignment
+      numErrors += CheckTransform ( i, &a, vectors + 1, MAX_VECTORS - 1 );
+
+      numErrors += CheckMultiply ( i, &a, &b );
+   }
+
+   printf ( "%d matrices, %d errors\n", NUM_MATRICES, numErrors );
+
+   return numErrors == 0 ? 0 : 1;
+}
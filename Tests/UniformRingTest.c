@@ -0,0 +1,180 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// UniformRingTest.c
+//
+//    Runs the uniform ring through frames that upload, frames that
+//    allocate without uploading and frames whose allocation fails and are
+//    ended early.  The ring must keep serving blocks after a failed frame
+//    and must never hold more than one fence per segment.  The fences are
+//    counted by wrapping glFenceSync and glDeleteSync.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esUtil.h"
+
+///
+// Defines
+//
+#define FRAME_SIZE       1024
+#define BLOCK_SIZE       256
+#define NUM_FRAMES       30
+
+// Frames the ring holds, as UNIFORM_RING_FRAMES in esUniformRing.c
+#define RING_FRAMES      3
+
+///
+// Types
+//
+typedef GLsync ( GL_APIENTRY *FenceSyncProc ) ( GLenum condition, GLbitfield flags );
+typedef void ( GL_APIENTRY *DeleteSyncProc ) ( GLsync sync );
+
+static FenceSyncProc  s_fenceSync;
+static DeleteSyncProc s_deleteSync;
+static int            s_liveFences;
+
+///
+// glFenceSync()
+//
+//    Count the fences the ring creates
+//
+GLsync GL_APIENTRY glFenceSync ( GLenum condition, GLbitfield flags )
+{
+   s_liveFences++;
+   return s_fenceSync ( condition, flags );
+}
+
+///
+// glDeleteSync()
+//
+//    Count the fences the ring deletes
+//
+void GL_APIENTRY glDeleteSync ( GLsync sync )
+{
+   if ( sync != NULL )
+   {
+      s_liveFences--;
+   }
+
+   s_deleteSync ( sync );
+}
+
+///
+// RunFrame()
+//
+//    Frame 0 of every three uploads, frame 1 allocates without uploading
+//    and frame 2 fails an allocation and is ended early, as a sample does.
+//    Returns GL_FALSE if the ring does not behave.
+//
+static GLboolean RunFrame ( int frame )
+{
+   GLintptr offset;
+   void    *block = esUniformRingAlloc ( BLOCK_SIZE, &offset );
+
+   if ( block == NULL )
+   {
+      printf ( "Frame %d: no block from a fresh segment\n", frame );
+      return GL_FALSE;
+   }
+
+   memset ( block, frame, BLOCK_SIZE );
+
+   switch ( frame % 3 )
+   {
+      case 0:
+         esUniformRingUpload ();
+         esUniformRingBind ( 0, offset, BLOCK_SIZE );
+         break;
+
+      case 2:
+         if ( esUniformRingAlloc ( FRAME_SIZE, &offset ) != NULL )
+         {
+            printf ( "Frame %d: a block larger than the segment left was allocated\n", frame );
+            return GL_FALSE;
+         }
+
+         break;
+   }
+
+   esUniformRingEndFrame ();
+
+   if ( s_liveFences > RING_FRAMES )
+   {
+      printf ( "Frame %d: %d fences alive, more than the %d segments\n", frame, s_liveFences, RING_FRAMES );
+      return GL_FALSE;
+   }
+
+   return GL_TRUE;
+}
+
+///
+// esMain()
+//
+//    Runs the check, a failure fails the program before the platform loop
+//    starts.  Run with ES_BENCHMARK_FRAMES=1 so the loop ends.
+//
+int esMain ( ESContext *esContext )
+{
+   GLboolean passed = GL_TRUE;
+   int       frame;
+
+   if ( !esCreateWindow ( esContext, "UniformRingTest", 64, 64, ES_WINDOW_RGB | ES_WINDOW_OFFSCREEN ) )
+   {
+      return GL_FALSE;
+   }
+
+   s_fenceSync = ( FenceSyncProc ) eglGetProcAddress ( "glFenceSync" );
+   s_deleteSync = ( DeleteSyncProc ) eglGetProcAddress ( "glDeleteSync" );
+
+   if ( s_fenceSync == NULL || s_deleteSync == NULL || !esUniformRingInit ( FRAME_SIZE ) )
+   {
+      printf ( "Cannot create the uniform ring\n" );
+      return GL_FALSE;
+   }
+
+   for ( frame = 0; frame < NUM_FRAMES && passed; frame++ )
+   {
+      passed = RunFrame ( frame );
+   }
+
+   esUniformRingShutdown ();
+
+   if ( passed && s_liveFences != 0 )
+   {
+      printf ( "%d fences left after esUniformRingShutdown\n", s_liveFences );
+      passed = GL_FALSE;
+   }
+
+   printf ( "%d frames, %s\n", frame, passed ? "passed" : "failed" );
+
+   return passed;
+}